@@ -8,6 +8,11 @@
  * https://www.openssl.org/source/license.html
  */
 
+/* For sched_setaffinity() and the CPU_* macros on Linux */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #undef SECONDS
 #define SECONDS                 3
 #define PRIME_SECONDS   10
@@ -27,6 +32,7 @@
 #include <openssl/evp.h>
 #include <openssl/objects.h>
 #include <openssl/async.h>
+#include <openssl/ssl.h>
 #if !defined(OPENSSL_SYS_MSDOS)
 # include OPENSSL_UNISTD
 #endif
@@ -112,11 +118,22 @@
 # define NO_FORK
 #endif
 
+#if defined(OPENSSL_THREADS) && defined(OPENSSL_SYS_UNIX) \
+    && !defined(OPENSSL_SYS_VMS)
+# include <pthread.h>
+# include <time.h>
+# ifdef __linux
+#  include <sched.h>
+# endif
+#else
+# define NO_THREADS
+#endif
+
 #undef BUFSIZE
 #define BUFSIZE (1024*16+1)
 #define MAX_MISALIGNMENT 63
 
-#define ALGOR_NUM       30
+#define ALGOR_NUM       36
 #define SIZE_NUM        6
 #define PRIME_NUM       3
 #define RSA_NUM         7
@@ -130,6 +147,38 @@ static volatile int run = 0;
 
 static int mr = 0;
 static int usertime = 1;
+static int threads = 0;
+
+#ifndef NO_THREADS
+/*
+ * Per operation latencies, in microseconds. Every |stride|th operation is
+ * timed. When |samples| fills up every other sample is dropped and the
+ * stride doubles, so that a run of any length keeps a spread of samples
+ * without timing every single operation.
+ */
+#define LAT_SAMPLES     (1 << 16)
+typedef struct latency_st {
+    double *samples;
+    size_t num;
+    size_t stride;
+    size_t skip;
+    double start;
+    int timing;
+} LATENCY;
+
+/* Latency percentiles of one benchmark run with -threads */
+typedef struct lat_result_st {
+    char name[40];
+    const char *op;
+    int size;                   /* bits for public key algorithms */
+    int is_pkey;
+    double ops;
+    double secs;
+    double pct[4];
+} LAT_RESULT;
+
+static const double lat_pcts[4] = { 50, 90, 99, 99.9 };
+#endif
 
 typedef struct loopargs_st {
     ASYNC_JOB *inprogress_job;
@@ -155,6 +204,13 @@ typedef struct loopargs_st {
     EVP_CIPHER_CTX *ctx;
     HMAC_CTX *hctx;
     GCM128_CONTEXT *gcm_ctx;
+#ifndef NO_THREADS
+    LATENCY lat;
+    pthread_t thread;
+    int (*loop_function) (void *);
+    int cpu;
+    int count;
+#endif
 } loopargs_t;
 
 #ifndef OPENSSL_NO_MD2
@@ -208,14 +264,29 @@ static int DSA_verify_loop(void *args);
 static int ECDSA_sign_loop(void *args);
 static int ECDSA_verify_loop(void *args);
 #endif
-static int run_benchmark(int async_jobs, int (*loop_function) (void *),
-                         loopargs_t * loopargs);
+static long run_benchmark(int async_jobs, int (*loop_function) (void *),
+                          loopargs_t * loopargs);
 
 static double Time_F(int s);
 static void print_message(const char *s, long num, int length);
 static void pkey_print_message(const char *str, const char *str2,
                                long num, int bits, int sec);
-static void print_result(int alg, int run_no, int count, double time_used);
+static void print_result(int alg, int run_no, long count, double time_used);
+static void print_json(const int *doit,
+#ifndef OPENSSL_NO_RSA
+                       const int *rsa_doit, const unsigned int *rsa_bits,
+#endif
+#ifndef OPENSSL_NO_DSA
+                       const int *dsa_doit, const unsigned int *dsa_bits,
+#endif
+#ifndef OPENSSL_NO_EC
+                       const int *ecdsa_doit, const int *ecdh_doit,
+                       const char **curve_names, const int *curve_bits
+#endif
+                       );
+#ifndef NO_THREADS
+static void print_latency(void);
+#endif
 #ifndef NO_FORK
 static int do_multi(int multi);
 #endif
@@ -227,7 +298,8 @@ static const char *names[ALGOR_NUM] = {
     "aes-128 cbc", "aes-192 cbc", "aes-256 cbc",
     "camellia-128 cbc", "camellia-192 cbc", "camellia-256 cbc",
     "evp", "sha256", "sha512", "whirlpool",
-    "aes-128 ige", "aes-192 ige", "aes-256 ige", "ghash"
+    "aes-128 ige", "aes-192 ige", "aes-256 ige", "ghash",
+    "sha3-224", "sha3-256", "sha3-384", "sha3-512", "shake128", "shake256"
 };
 
 static double results[ALGOR_NUM][SIZE_NUM];
@@ -328,6 +400,9 @@ static double Time_F(int s)
 #endif
 
 static void multiblock_speed(const EVP_CIPHER *evp_cipher);
+#if !defined(OPENSSL_NO_PSK) && !defined(OPENSSL_NO_TLS1_2)
+static void writev_speed(void);
+#endif
 
 static int found(const char *name, const OPT_PAIR *pairs, int *result)
 {
@@ -342,7 +417,8 @@ static int found(const char *name, const OPT_PAIR *pairs, int *result)
 typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
     OPT_ELAPSED, OPT_EVP, OPT_DECRYPT, OPT_ENGINE, OPT_MULTI,
-    OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS
+    OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS, OPT_WRITEV, OPT_THREADS,
+    OPT_JSON
 } OPTION_CHOICE;
 
 const OPTIONS speed_options[] = {
@@ -353,8 +429,13 @@ const OPTIONS speed_options[] = {
     {"decrypt", OPT_DECRYPT, '-',
      "Time decryption instead of encryption (only EVP)"},
     {"mr", OPT_MR, '-', "Produce machine readable output"},
+    {"json", OPT_JSON, '-', "Print the results as JSON"},
     {"mb", OPT_MB, '-',
      "Enable (tls1.1) multi-block mode on evp_cipher requested with -evp"},
+#if !defined(OPENSSL_NO_PSK) && !defined(OPENSSL_NO_TLS1_2)
+    {"writev", OPT_WRITEV, '-',
+     "Compare SSL_writev_ex() with copying the data for SSL_write_ex()"},
+#endif
     {"misalign", OPT_MISALIGN, 'n', "Amount to mis-align buffers"},
     {"elapsed", OPT_ELAPSED, '-',
      "Measure time in real time instead of CPU user time"},
@@ -365,6 +446,10 @@ const OPTIONS speed_options[] = {
     {"async_jobs", OPT_ASYNCJOBS, 'p',
      "Enable async mode and start pnum jobs"},
 #endif
+#ifndef NO_THREADS
+    {"threads", OPT_THREADS, 'p',
+     "Run public key and -evp benchmarks in pnum threads at once"},
+#endif
 #ifndef OPENSSL_NO_ENGINE
     {"engine", OPT_ENGINE, 's', "Use engine, possibly a hardware device"},
 #endif
@@ -401,6 +486,12 @@ const OPTIONS speed_options[] = {
 #define D_IGE_192_AES   27
 #define D_IGE_256_AES   28
 #define D_GHASH         29
+#define D_SHA3_224      30
+#define D_SHA3_256      31
+#define D_SHA3_384      32
+#define D_SHA3_512      33
+#define D_SHAKE128      34
+#define D_SHAKE256      35
 static OPT_PAIR doit_choices[] = {
 #ifndef OPENSSL_NO_MD2
     {"md2", D_MD2},
@@ -418,6 +509,12 @@ static OPT_PAIR doit_choices[] = {
     {"sha1", D_SHA1},
     {"sha256", D_SHA256},
     {"sha512", D_SHA512},
+    {"sha3-224", D_SHA3_224},
+    {"sha3-256", D_SHA3_256},
+    {"sha3-384", D_SHA3_384},
+    {"sha3-512", D_SHA3_512},
+    {"shake128", D_SHAKE128},
+    {"shake256", D_SHAKE256},
 #ifndef OPENSSL_NO_WHIRLPOOL
     {"whirlpool", D_WHIRLPOOL},
 #endif
@@ -567,6 +664,48 @@ static OPT_PAIR ecdh_choices[] = {
 # define COUNT(d) (count)
 #endif                          /* SIGALRM */
 
+#ifndef NO_THREADS
+/* Called before each operation in the loops that support -threads */
+# define LAT_TICK(la) ((la)->lat.samples == NULL || lat_tick(&(la)->lat))
+
+static double lat_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int lat_tick(LATENCY *lat)
+{
+    int arm = ++lat->skip >= lat->stride;
+    double now;
+    size_t i;
+
+    if (!lat->timing && !arm)
+        return 1;
+
+    now = lat_now();
+    if (lat->timing) {
+        if (lat->num == LAT_SAMPLES) {
+            for (i = 0; i < LAT_SAMPLES / 2; i++)
+                lat->samples[i] = lat->samples[2 * i + 1];
+            lat->num = LAT_SAMPLES / 2;
+            lat->stride *= 2;
+        }
+        lat->samples[lat->num++] = now - lat->start;
+    }
+    lat->timing = arm;
+    if (arm) {
+        lat->skip = 0;
+        lat->start = now;
+    }
+    return 1;
+}
+#else
+# define LAT_TICK(la) 1
+#endif
+
 static int testnum;
 
 /* Nb of iterations to do per algorithm and key-size */
@@ -698,6 +837,41 @@ static int WHIRLPOOL_loop(void *args)
 }
 #endif
 
+static int sha3_alg;            /* D_SHA3_* or D_SHAKE* being timed */
+
+static const EVP_MD *sha3_md(int alg)
+{
+    switch (alg) {
+    case D_SHA3_224:
+        return EVP_sha3_224();
+    case D_SHA3_256:
+        return EVP_sha3_256();
+    case D_SHA3_384:
+        return EVP_sha3_384();
+    case D_SHA3_512:
+        return EVP_sha3_512();
+    case D_SHAKE128:
+        return EVP_shake128();
+    default:
+        return EVP_shake256();
+    }
+}
+
+static int EVP_Digest_SHA3_loop(void *args)
+{
+    loopargs_t *tempargs = *(loopargs_t **) args;
+    unsigned char *buf = tempargs->buf;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    const EVP_MD *evp_md = sha3_md(sha3_alg);
+    int count;
+    for (count = 0; COND(c[sha3_alg][testnum]); count++) {
+        if (!EVP_Digest(buf, (size_t)lengths[testnum], md, NULL, evp_md,
+                        NULL))
+            return -1;
+    }
+    return count;
+}
+
 #ifndef OPENSSL_NO_RMD160
 static int EVP_Digest_RMD160_loop(void *args)
 {
@@ -851,10 +1025,10 @@ static int EVP_Update_loop(void *args)
     int nb_iter = save_count * 4 * lengths[0] / lengths[testnum];
 #endif
     if (decrypt)
-        for (count = 0; COND(nb_iter); count++)
+        for (count = 0; COND(nb_iter) && LAT_TICK(tempargs); count++)
             EVP_DecryptUpdate(ctx, buf, &outl, buf, lengths[testnum]);
     else
-        for (count = 0; COND(nb_iter); count++)
+        for (count = 0; COND(nb_iter) && LAT_TICK(tempargs); count++)
             EVP_EncryptUpdate(ctx, buf, &outl, buf, lengths[testnum]);
     if (decrypt)
         EVP_DecryptFinal_ex(ctx, buf, &outl);
@@ -874,7 +1048,7 @@ static int EVP_Digest_loop(void *args)
     int nb_iter = save_count * 4 * lengths[0] / lengths[testnum];
 #endif
 
-    for (count = 0; COND(nb_iter); count++) {
+    for (count = 0; COND(nb_iter) && LAT_TICK(tempargs); count++) {
         if (!EVP_Digest(buf, lengths[testnum], md, NULL, evp_md, NULL))
             return -1;
     }
@@ -892,7 +1066,7 @@ static int RSA_sign_loop(void *args)
     unsigned int *rsa_num = &tempargs->siglen;
     RSA **rsa_key = tempargs->rsa_key;
     int ret, count;
-    for (count = 0; COND(rsa_c[testnum][0]); count++) {
+    for (count = 0; COND(rsa_c[testnum][0]) && LAT_TICK(tempargs); count++) {
         ret = RSA_sign(NID_md5_sha1, buf, 36, buf2, rsa_num, rsa_key[testnum]);
         if (ret == 0) {
             BIO_printf(bio_err, "RSA sign failure\n");
@@ -912,7 +1086,7 @@ static int RSA_verify_loop(void *args)
     unsigned int rsa_num = tempargs->siglen;
     RSA **rsa_key = tempargs->rsa_key;
     int ret, count;
-    for (count = 0; COND(rsa_c[testnum][1]); count++) {
+    for (count = 0; COND(rsa_c[testnum][1]) && LAT_TICK(tempargs); count++) {
         ret =
             RSA_verify(NID_md5_sha1, buf, 36, buf2, rsa_num, rsa_key[testnum]);
         if (ret <= 0) {
@@ -936,7 +1110,7 @@ static int DSA_sign_loop(void *args)
     DSA **dsa_key = tempargs->dsa_key;
     unsigned int *siglen = &tempargs->siglen;
     int ret, count;
-    for (count = 0; COND(dsa_c[testnum][0]); count++) {
+    for (count = 0; COND(dsa_c[testnum][0]) && LAT_TICK(tempargs); count++) {
         ret = DSA_sign(0, buf, 20, buf2, siglen, dsa_key[testnum]);
         if (ret == 0) {
             BIO_printf(bio_err, "DSA sign failure\n");
@@ -956,7 +1130,7 @@ static int DSA_verify_loop(void *args)
     DSA **dsa_key = tempargs->dsa_key;
     unsigned int siglen = tempargs->siglen;
     int ret, count;
-    for (count = 0; COND(dsa_c[testnum][1]); count++) {
+    for (count = 0; COND(dsa_c[testnum][1]) && LAT_TICK(tempargs); count++) {
         ret = DSA_verify(0, buf, 20, buf2, siglen, dsa_key[testnum]);
         if (ret <= 0) {
             BIO_printf(bio_err, "DSA verify failure\n");
@@ -979,7 +1153,7 @@ static int ECDSA_sign_loop(void *args)
     unsigned char *ecdsasig = tempargs->buf2;
     unsigned int *ecdsasiglen = &tempargs->siglen;
     int ret, count;
-    for (count = 0; COND(ecdsa_c[testnum][0]); count++) {
+    for (count = 0; COND(ecdsa_c[testnum][0]) && LAT_TICK(tempargs); count++) {
         ret = ECDSA_sign(0, buf, 20, ecdsasig, ecdsasiglen, ecdsa[testnum]);
         if (ret == 0) {
             BIO_printf(bio_err, "ECDSA sign failure\n");
@@ -999,7 +1173,7 @@ static int ECDSA_verify_loop(void *args)
     unsigned char *ecdsasig = tempargs->buf2;
     unsigned int ecdsasiglen = tempargs->siglen;
     int ret, count;
-    for (count = 0; COND(ecdsa_c[testnum][1]); count++) {
+    for (count = 0; COND(ecdsa_c[testnum][1]) && LAT_TICK(tempargs); count++) {
         ret = ECDSA_verify(0, buf, 20, ecdsasig, ecdsasiglen, ecdsa[testnum]);
         if (ret != 1) {
             BIO_printf(bio_err, "ECDSA verify failure\n");
@@ -1022,7 +1196,7 @@ static int ECDH_EVP_derive_key_loop(void *args)
     int count;
     size_t *outlen = &(tempargs->outlen[testnum]);
 
-    for (count = 0; COND(ecdh_c[testnum][0]); count++)
+    for (count = 0; COND(ecdh_c[testnum][0]) && LAT_TICK(tempargs); count++)
         EVP_PKEY_derive(ctx, derived_secret, outlen);
 
     return count;
@@ -1030,11 +1204,145 @@ static int ECDH_EVP_derive_key_loop(void *args)
 
 #endif                          /* OPENSSL_NO_EC */
 
-static int run_benchmark(int async_jobs,
-                         int (*loop_function) (void *), loopargs_t * loopargs)
+#ifndef NO_THREADS
+/* The benchmark about to run, as announced by (pkey_)print_message() */
+static LAT_RESULT lat_cur;
+static LAT_RESULT lat_results[SIZE_NUM + 2 * (RSA_NUM + DSA_NUM + EC_NUM)
+                              + EC_NUM];
+static int lat_results_num = 0;
+
+static void lat_label(const char *name, const char *op, int size, int is_pkey)
+{
+    OPENSSL_strlcpy(lat_cur.name, name, sizeof(lat_cur.name));
+    lat_cur.op = op;
+    lat_cur.size = size;
+    lat_cur.is_pkey = is_pkey;
+}
+
+static int lat_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Record the latency percentiles of the run that has just finished */
+static void lat_record(loopargs_t *loopargs, long count, double secs)
+{
+    LAT_RESULT *r;
+    double *all;
+    size_t i, n = 0;
+    int k;
+
+    if (lat_results_num == OSSL_NELEM(lat_results))
+        return;
+    r = &lat_results[lat_results_num++];
+    *r = lat_cur;
+    r->ops = count;
+    r->secs = secs;
+
+    for (k = 0; k < threads; k++)
+        n += loopargs[k].lat.num;
+    if (n == 0)
+        return;
+    all = app_malloc(n * sizeof(*all), "latency samples");
+    for (k = 0, n = 0; k < threads; k++) {
+        memcpy(all + n, loopargs[k].lat.samples,
+               loopargs[k].lat.num * sizeof(*all));
+        n += loopargs[k].lat.num;
+    }
+    qsort(all, n, sizeof(*all), lat_cmp);
+    for (i = 0; i < OSSL_NELEM(lat_pcts); i++)
+        r->pct[i] = all[(size_t)(lat_pcts[i] / 100 * (n - 1) + 0.5)];
+    OPENSSL_free(all);
+}
+
+static void *thread_loop(void *arg)
+{
+    loopargs_t *looparg = arg;
+
+# ifdef __linux
+    if (looparg->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(looparg->cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+# endif
+    looparg->count = looparg->loop_function((void *)&looparg);
+    OPENSSL_thread_stop();
+    return NULL;
+}
+
+/*
+ * Run |loop_function| in |threads| threads at once, one for each of the
+ * |loopargs|. Each thread is pinned to a CPU of its own while there are
+ * enough of them.
+ */
+static long run_threads(int (*loop_function) (void *), loopargs_t *loopargs)
+{
+    long total_op_count = 0;
+    int i, n, error = 0;
+    double start;
+# ifdef __linux
+    static int cpus[CPU_SETSIZE];
+    static int ncpus = -1;
+
+    if (ncpus < 0) {
+        cpu_set_t set;
+
+        ncpus = 0;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (i = 0; i < CPU_SETSIZE; i++)
+                if (CPU_ISSET(i, &set))
+                    cpus[ncpus++] = i;
+        }
+    }
+# endif
+
+    start = lat_now();
+    for (n = 0; n < threads; n++) {
+        loopargs_t *looparg = loopargs + n;
+
+        looparg->loop_function = loop_function;
+        looparg->cpu = -1;
+# ifdef __linux
+        if (ncpus > 0)
+            looparg->cpu = cpus[n % ncpus];
+# endif
+        looparg->lat.num = looparg->lat.skip = 0;
+        looparg->lat.stride = 1;
+        looparg->lat.timing = 0;
+        if (pthread_create(&looparg->thread, NULL, thread_loop,
+                           looparg) != 0) {
+            BIO_printf(bio_err, "Failure starting thread %d\n", n);
+            /* Stop the ones already running */
+            run = 0;
+            error = 1;
+            break;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        pthread_join(loopargs[i].thread, NULL);
+        if (loopargs[i].count < 0)
+            error = 1;
+        else
+            total_op_count += loopargs[i].count;
+    }
+    if (error)
+        return -1;
+
+    lat_record(loopargs, total_op_count, (lat_now() - start) / 1e6);
+    return total_op_count;
+}
+#endif
+
+static long run_benchmark(int async_jobs,
+                          int (*loop_function) (void *), loopargs_t * loopargs)
 {
     int job_op_count = 0;
-    int total_op_count = 0;
+    long total_op_count = 0;
     int num_inprogress = 0;
     int error = 0, i = 0, ret = 0;
     OSSL_ASYNC_FD job_fd = 0;
@@ -1042,6 +1350,11 @@ static int run_benchmark(int async_jobs,
 
     run = 1;
 
+#ifndef NO_THREADS
+    if (threads > 0)
+        return run_threads(loop_function, loopargs);
+#endif
+
     if (async_jobs == 0) {
         return loop_function((void *)&loopargs);
     }
@@ -1194,7 +1507,7 @@ int speed_main(int argc, char **argv)
     const EVP_CIPHER *evp_cipher = NULL;
     double d = 0.0;
     OPTION_CHOICE o;
-    int multiblock = 0, pr_header = 0;
+    int multiblock = 0, writev = 0, json = 0, pr_header = 0;
     int doit[ALGOR_NUM] = { 0 };
     int ret = 1, i, k, misalign = 0;
     long count = 0;
@@ -1408,6 +1721,21 @@ int speed_main(int argc, char **argv)
                        "%s: -mb specified but multi-block support is disabled\n",
                        prog);
             goto end;
+#endif
+            break;
+        case OPT_WRITEV:
+            writev = 1;
+            break;
+        case OPT_JSON:
+            json = 1;
+            break;
+        case OPT_THREADS:
+#ifndef NO_THREADS
+            threads = atoi(opt_arg());
+            if (threads > 1024) {
+                BIO_printf(bio_err, "%s: too many threads\n", prog);
+                goto opterr;
+            }
 #endif
             break;
         }
@@ -1491,6 +1819,27 @@ int speed_main(int argc, char **argv)
         goto end;
     }
 
+    if (threads > 0) {
+        if (async_jobs > 0 || multiblock || writev
+#ifndef NO_FORK
+            || multi
+#endif
+            ) {
+            BIO_printf(bio_err,
+                       "%s: -threads cannot be combined with -async_jobs, "
+                       "-multi, -mb or -writev\n", prog);
+            goto end;
+        }
+        for (i = 0; i < ALGOR_NUM; i++) {
+            if (doit[i] && i != D_EVP) {
+                BIO_printf(bio_err,
+                           "%s: %s is not supported with -threads, use -evp\n",
+                           prog, names[i]);
+                goto end;
+            }
+        }
+    }
+
     /* Initialize the job pool if async mode is enabled */
     if (async_jobs > 0) {
         async_init = ASYNC_init_thread(async_jobs, async_jobs);
@@ -1501,6 +1850,8 @@ int speed_main(int argc, char **argv)
     }
 
     loopargs_len = (async_jobs == 0 ? 1 : async_jobs);
+    if (threads > 0)
+        loopargs_len = threads;
     loopargs =
         app_malloc(loopargs_len * sizeof(loopargs_t), "array of loopargs");
     memset(loopargs, 0, loopargs_len * sizeof(loopargs_t));
@@ -1521,6 +1872,11 @@ int speed_main(int argc, char **argv)
         /* Align the start of buffers on a 64 byte boundary */
         loopargs[i].buf = loopargs[i].buf_malloc + misalign;
         loopargs[i].buf2 = loopargs[i].buf2_malloc + misalign;
+#ifndef NO_THREADS
+        if (threads > 0)
+            loopargs[i].lat.samples =
+                app_malloc(LAT_SAMPLES * sizeof(double), "latency samples");
+#endif
 #ifndef OPENSSL_NO_EC
         loopargs[i].secret_a = app_malloc(MAX_ECDH_SIZE, "ECDH secret a");
         loopargs[i].secret_b = app_malloc(MAX_ECDH_SIZE, "ECDH secret b");
@@ -1538,7 +1894,7 @@ int speed_main(int argc, char **argv)
     /* No parameters; turn on everything. */
     if ((argc == 0) && !doit[D_EVP]) {
         for (i = 0; i < ALGOR_NUM; i++)
-            if (i != D_EVP)
+            if (i != D_EVP && threads == 0)
                 doit[i] = 1;
 #ifndef OPENSSL_NO_RSA
         for (i = 0; i < RSA_NUM; i++)
@@ -1563,12 +1919,21 @@ int speed_main(int argc, char **argv)
         BIO_printf(bio_err,
                    "You have chosen to measure elapsed time "
                    "instead of user CPU time.\n");
+    /* CPU time would add up the time of all the threads */
+    if (threads > 0)
+        usertime = 0;
 
 #ifndef OPENSSL_NO_RSA
     for (i = 0; i < loopargs_len; i++) {
         for (k = 0; k < RSA_NUM; k++) {
             const unsigned char *p;
 
+            if (threads > 0 && i > 0) {
+                /* The threads all share one key */
+                RSA_up_ref(loopargs[0].rsa_key[k]);
+                loopargs[i].rsa_key[k] = loopargs[0].rsa_key[k];
+                continue;
+            }
             p = rsa_data[k];
             loopargs[i].rsa_key[k] =
                 d2i_RSAPrivateKey(NULL, &p, rsa_data_length[k]);
@@ -1582,6 +1947,14 @@ int speed_main(int argc, char **argv)
 #endif
 #ifndef OPENSSL_NO_DSA
     for (i = 0; i < loopargs_len; i++) {
+        if (threads > 0 && i > 0) {
+            for (k = 0; k < DSA_NUM; k++) {
+                if (loopargs[0].dsa_key[k] != NULL)
+                    DSA_up_ref(loopargs[0].dsa_key[k]);
+                loopargs[i].dsa_key[k] = loopargs[0].dsa_key[k];
+            }
+            continue;
+        }
         loopargs[i].dsa_key[0] = get_dsa(512);
         loopargs[i].dsa_key[1] = get_dsa(1024);
         loopargs[i].dsa_key[2] = get_dsa(2048);
@@ -1664,6 +2037,8 @@ int speed_main(int argc, char **argv)
     c[D_IGE_192_AES][0] = count;
     c[D_IGE_256_AES][0] = count;
     c[D_GHASH][0] = count;
+    for (i = D_SHA3_224; i <= D_SHAKE256; i++)
+        c[i][0] = count;
 
     for (i = 1; i < SIZE_NUM; i++) {
         long l0, l1;
@@ -1682,6 +2057,8 @@ int speed_main(int argc, char **argv)
         c[D_SHA512][i] = c[D_SHA512][0] * 4 * l0 / l1;
         c[D_WHIRLPOOL][i] = c[D_WHIRLPOOL][0] * 4 * l0 / l1;
         c[D_GHASH][i] = c[D_GHASH][0] * 4 * l0 / l1;
+        for (k = D_SHA3_224; k <= D_SHAKE256; k++)
+            c[k][i] = c[k][0] * 4 * l0 / l1;
 
         l0 = (long)lengths[i - 1];
 
@@ -1828,6 +2205,18 @@ int speed_main(int argc, char **argv)
 # endif
 #endif                          /* SIGALRM */
 
+#if !defined(OPENSSL_NO_PSK) && !defined(OPENSSL_NO_TLS1_2)
+    if (writev) {
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported, exiting...");
+            exit(1);
+        }
+        writev_speed();
+        ret = 0;
+        goto end;
+    }
+#endif
+
 #ifndef OPENSSL_NO_MD2
     if (doit[D_MD2]) {
         for (testnum = 0; testnum < SIZE_NUM; testnum++) {
@@ -1941,6 +2330,19 @@ int speed_main(int argc, char **argv)
     }
 #endif
 
+    for (k = D_SHA3_224; k <= D_SHAKE256; k++) {
+        if (!doit[k])
+            continue;
+        sha3_alg = k;
+        for (testnum = 0; testnum < SIZE_NUM; testnum++) {
+            print_message(names[k], c[k][testnum], lengths[testnum]);
+            Time_F(START);
+            count = run_benchmark(async_jobs, EVP_Digest_SHA3_loop, loopargs);
+            d = Time_F(STOP);
+            print_result(k, testnum, count, d);
+        }
+    }
+
 #ifndef OPENSSL_NO_RMD160
     if (doit[D_RMD160]) {
         for (testnum = 0; testnum < SIZE_NUM; testnum++) {
@@ -2470,6 +2872,11 @@ int speed_main(int argc, char **argv)
         if (!ecdsa_doit[testnum])
             continue;           /* Ignore Curve */
         for (i = 0; i < loopargs_len; i++) {
+            if (threads > 0 && i > 0) {
+                EC_KEY_up_ref(loopargs[0].ecdsa[testnum]);
+                loopargs[i].ecdsa[testnum] = loopargs[0].ecdsa[testnum];
+                continue;
+            }
             loopargs[i].ecdsa[testnum] =
                 EC_KEY_new_by_curve_name(test_curves[testnum]);
             if (loopargs[i].ecdsa[testnum] == NULL) {
@@ -2483,9 +2890,11 @@ int speed_main(int argc, char **argv)
             rsa_count = 1;
         } else {
             for (i = 0; i < loopargs_len; i++) {
-                EC_KEY_precompute_mult(loopargs[i].ecdsa[testnum], NULL);
+                if (threads == 0 || i == 0) {
+                    EC_KEY_precompute_mult(loopargs[i].ecdsa[testnum], NULL);
+                    EC_KEY_generate_key(loopargs[i].ecdsa[testnum]);
+                }
                 /* Perform ECDSA signature test */
-                EC_KEY_generate_key(loopargs[i].ecdsa[testnum]);
                 st = ECDSA_sign(0, loopargs[i].buf, 20, loopargs[i].buf2,
                                 &loopargs[i].siglen,
                                 loopargs[i].ecdsa[testnum]);
@@ -2713,6 +3122,21 @@ int speed_main(int argc, char **argv)
 #ifndef NO_FORK
  show_res:
 #endif
+    if (json) {
+        print_json(doit,
+#ifndef OPENSSL_NO_RSA
+                   rsa_doit, rsa_bits,
+#endif
+#ifndef OPENSSL_NO_DSA
+                   dsa_doit, dsa_bits,
+#endif
+#ifndef OPENSSL_NO_EC
+                   ecdsa_doit, ecdh_doit, test_curves_names, test_curves_bits
+#endif
+                   );
+        ret = 0;
+        goto end;
+    }
     if (!mr) {
         printf("%s\n", OpenSSL_version(OPENSSL_VERSION));
         printf("%s\n", OpenSSL_version(OPENSSL_BUILT_ON));
@@ -2843,6 +3267,10 @@ int speed_main(int argc, char **argv)
                    1.0 / ecdh_results[k][0], ecdh_results[k][0]);
     }
 #endif
+#ifndef NO_THREADS
+    if (threads > 0)
+        print_latency();
+#endif
 
     ret = 0;
 
@@ -2851,6 +3279,9 @@ int speed_main(int argc, char **argv)
     for (i = 0; i < loopargs_len; i++) {
         OPENSSL_free(loopargs[i].buf_malloc);
         OPENSSL_free(loopargs[i].buf2_malloc);
+#ifndef NO_THREADS
+        OPENSSL_free(loopargs[i].lat.samples);
+#endif
 
 #ifndef OPENSSL_NO_RSA
         for (k = 0; k < RSA_NUM; k++)
@@ -2885,6 +3316,9 @@ int speed_main(int argc, char **argv)
 
 static void print_message(const char *s, long num, int length)
 {
+#ifndef NO_THREADS
+    lat_label(s, "", length, 0);
+#endif
 #ifdef SIGALRM
     BIO_printf(bio_err,
                mr ? "+DT:%s:%d:%d\n"
@@ -2902,6 +3336,9 @@ static void print_message(const char *s, long num, int length)
 static void pkey_print_message(const char *str, const char *str2, long num,
                                int bits, int tm)
 {
+#ifndef NO_THREADS
+    lat_label(str2, str, bits, 1);
+#endif
 #ifdef SIGALRM
     BIO_printf(bio_err,
                mr ? "+DTP:%d:%s:%s:%d\n"
@@ -2916,18 +3353,176 @@ static void pkey_print_message(const char *str, const char *str2, long num,
 #endif
 }
 
-static void print_result(int alg, int run_no, int count, double time_used)
+static void print_result(int alg, int run_no, long count, double time_used)
 {
     if (count == -1) {
         BIO_puts(bio_err, "EVP error!\n");
         exit(1);
     }
     BIO_printf(bio_err,
-               mr ? "+R:%d:%s:%f\n"
-               : "%d %s's in %.2fs\n", count, names[alg], time_used);
+               mr ? "+R:%ld:%s:%f\n"
+               : "%ld %s's in %.2fs\n", count, names[alg], time_used);
     results[alg][run_no] = ((double)count) / time_used * lengths[run_no];
 }
 
+/* Print |str| as a JSON string */
+static void json_string(const char *str)
+{
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            printf("\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            printf("\\u%04x", (unsigned char)*str);
+        else
+            putchar(*str);
+    }
+    putchar('"');
+}
+
+static void print_json(const int *doit,
+#ifndef OPENSSL_NO_RSA
+                       const int *rsa_doit, const unsigned int *rsa_bits,
+#endif
+#ifndef OPENSSL_NO_DSA
+                       const int *dsa_doit, const unsigned int *dsa_bits,
+#endif
+#ifndef OPENSSL_NO_EC
+                       const int *ecdsa_doit, const int *ecdh_doit,
+                       const char **curve_names, const int *curve_bits
+#endif
+                       )
+{
+    const char *sep = "";
+    int k, j;
+
+    printf("{\n  \"version\": ");
+    json_string(OpenSSL_version(OPENSSL_VERSION));
+    printf(",\n  \"built_on\": ");
+    json_string(OpenSSL_version(OPENSSL_BUILT_ON));
+    printf(",\n  \"compiler\": ");
+    json_string(OpenSSL_version(OPENSSL_CFLAGS));
+    printf(",\n  \"elapsed\": %s", usertime ? "false" : "true");
+    printf(",\n  \"threads\": %d", threads);
+
+    printf(",\n  \"ciphers\": [");
+    for (k = 0; k < ALGOR_NUM; k++) {
+        if (!doit[k])
+            continue;
+        printf("%s\n    {\"name\": ", sep);
+        json_string(names[k]);
+        printf(", \"bytes_per_second\": {");
+        for (j = 0; j < SIZE_NUM; j++)
+            printf("%s\"%d\": %.2f", j > 0 ? ", " : "", lengths[j],
+                   results[k][j]);
+        printf("}}");
+        sep = ",";
+    }
+    printf("\n  ]");
+#ifndef OPENSSL_NO_RSA
+    printf(",\n  \"rsa\": [");
+    for (k = 0, sep = ""; k < RSA_NUM; k++) {
+        if (!rsa_doit[k])
+            continue;
+        printf("%s\n    {\"bits\": %u, \"sign_per_second\": %.1f, "
+               "\"verify_per_second\": %.1f}",
+               sep, rsa_bits[k], rsa_results[k][0], rsa_results[k][1]);
+        sep = ",";
+    }
+    printf("\n  ]");
+#endif
+#ifndef OPENSSL_NO_DSA
+    printf(",\n  \"dsa\": [");
+    for (k = 0, sep = ""; k < DSA_NUM; k++) {
+        if (!dsa_doit[k])
+            continue;
+        printf("%s\n    {\"bits\": %u, \"sign_per_second\": %.1f, "
+               "\"verify_per_second\": %.1f}",
+               sep, dsa_bits[k], dsa_results[k][0], dsa_results[k][1]);
+        sep = ",";
+    }
+    printf("\n  ]");
+#endif
+#ifndef OPENSSL_NO_EC
+    printf(",\n  \"ecdsa\": [");
+    for (k = 0, sep = ""; k < EC_NUM; k++) {
+        if (!ecdsa_doit[k])
+            continue;
+        printf("%s\n    {\"curve\": \"%s\", \"bits\": %d, "
+               "\"sign_per_second\": %.1f, \"verify_per_second\": %.1f}",
+               sep, curve_names[k], curve_bits[k],
+               ecdsa_results[k][0], ecdsa_results[k][1]);
+        sep = ",";
+    }
+    printf("\n  ]");
+    printf(",\n  \"ecdh\": [");
+    for (k = 0, sep = ""; k < EC_NUM; k++) {
+        if (!ecdh_doit[k])
+            continue;
+        printf("%s\n    {\"curve\": \"%s\", \"bits\": %d, "
+               "\"ops_per_second\": %.1f}",
+               sep, curve_names[k], curve_bits[k], ecdh_results[k][0]);
+        sep = ",";
+    }
+    printf("\n  ]");
+#endif
+#ifndef NO_THREADS
+    if (threads > 0) {
+        printf(",\n  \"latency\": [");
+        for (k = 0, sep = ""; k < lat_results_num; k++) {
+            const LAT_RESULT *r = &lat_results[k];
+
+            printf("%s\n    {\"name\": ", sep);
+            json_string(r->name);
+            if (r->is_pkey)
+                printf(", \"op\": \"%s\", \"bits\": %d", r->op, r->size);
+            else
+                printf(", \"size\": %d", r->size);
+            printf(", \"ops_per_second\": %.1f, \"p50_us\": %.2f, "
+                   "\"p90_us\": %.2f, \"p99_us\": %.2f, \"p99_9_us\": %.2f}",
+                   r->ops / r->secs, r->pct[0], r->pct[1], r->pct[2],
+                   r->pct[3]);
+            sep = ",";
+        }
+        printf("\n  ]");
+    }
+#endif
+    printf("\n}\n");
+}
+
+#ifndef NO_THREADS
+static void print_latency(void)
+{
+    char label[64];
+    int k;
+
+    if (!mr)
+        printf("%d threads%32sop/s   p50(us)   p90(us)   p99(us) "
+               "p99.9(us)\n", threads, " ");
+    for (k = 0; k < lat_results_num; k++) {
+        const LAT_RESULT *r = &lat_results[k];
+
+        if (mr) {
+            printf("+L:%d:%s:%s:%d:%f:%f:%f:%f:%f\n", threads, r->name, r->op,
+                   r->size, r->ops / r->secs, r->pct[0], r->pct[1],
+                   r->pct[2], r->pct[3]);
+            continue;
+        }
+        if (!r->is_pkey)
+            BIO_snprintf(label, sizeof(label), "%s %d bytes", r->name,
+                         r->size);
+        else if (*r->op != '\0')
+            BIO_snprintf(label, sizeof(label), "%d bit %s %s", r->size,
+                         r->op, r->name);
+        else
+            BIO_snprintf(label, sizeof(label), "%d bit %s", r->size,
+                         r->name);
+        printf("%-32s %12.1f %9.2f %9.2f %9.2f %9.2f\n", label,
+               r->ops / r->secs, r->pct[0], r->pct[1], r->pct[2], r->pct[3]);
+    }
+}
+#endif
+
 #ifndef NO_FORK
 static char *sstrsep(char **string, const char *delim)
 {
@@ -3184,3 +3779,175 @@ static void multiblock_speed(const EVP_CIPHER *evp_cipher)
     OPENSSL_free(out);
     EVP_CIPHER_CTX_free(ctx);
 }
+
+#if !defined(OPENSSL_NO_PSK) && !defined(OPENSSL_NO_TLS1_2)
+/*
+ * A TLS connection for the -writev test, set up with a pre-shared key so
+ * that no certificate is needed.
+ */
+static const unsigned char writev_psk[16] = {
+    0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+    0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x12
+};
+
+static unsigned int writev_psk_client_cb(SSL *ssl, const char *hint,
+                                         char *identity,
+                                         unsigned int max_identity_len,
+                                         unsigned char *psk,
+                                         unsigned int max_psk_len)
+{
+    if (max_identity_len < sizeof("speed")
+            || max_psk_len < sizeof(writev_psk))
+        return 0;
+    strcpy(identity, "speed");
+    memcpy(psk, writev_psk, sizeof(writev_psk));
+    return sizeof(writev_psk);
+}
+
+static unsigned int writev_psk_server_cb(SSL *ssl, const char *identity,
+                                         unsigned char *psk,
+                                         unsigned int max_psk_len)
+{
+    if (max_psk_len < sizeof(writev_psk))
+        return 0;
+    memcpy(psk, writev_psk, sizeof(writev_psk));
+    return sizeof(writev_psk);
+}
+
+/*
+ * Time writing a message made of a small header and a body of each of the
+ * usual lengths, either by copying both into one buffer and calling
+ * SSL_write_ex() or by handing SSL_writev_ex() the two pieces. Only the
+ * sending side is timed: the records go into a memory BIO that is emptied
+ * after each write.
+ */
+static void writev_speed(void)
+{
+    static const char *wvnames[] = { "copy+write", "writev" };
+    unsigned char hdr[32], *body = NULL, *copy = NULL;
+    SSL_CTX *ctx = NULL;
+    SSL *client = NULL, *server = NULL;
+    BIO *cbio = NULL, *sbio = NULL, *mem;
+    double wvresults[OSSL_NELEM(wvnames)][SIZE_NUM];
+    int i, j, k, count, cdone = 0, sdone = 0;
+    double d = 0.0;
+
+    body = app_malloc(lengths[SIZE_NUM - 1], "writev body");
+    copy = app_malloc(sizeof(hdr) + lengths[SIZE_NUM - 1], "writev copy");
+    memset(hdr, 0x5a, sizeof(hdr));
+    memset(body, 0xa5, lengths[SIZE_NUM - 1]);
+
+    if ((ctx = SSL_CTX_new(TLS_method())) == NULL
+            || !SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION)
+            || !SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION)
+            || !SSL_CTX_set_cipher_list(ctx, "PSK-AES128-GCM-SHA256"))
+        goto err;
+    SSL_CTX_set_psk_client_callback(ctx, writev_psk_client_cb);
+    SSL_CTX_set_psk_server_callback(ctx, writev_psk_server_cb);
+    if ((client = SSL_new(ctx)) == NULL || (server = SSL_new(ctx)) == NULL
+            || !BIO_new_bio_pair(&cbio, 0, &sbio, 0))
+        goto err;
+    SSL_set_bio(client, cbio, cbio);
+    SSL_set_bio(server, sbio, sbio);
+    SSL_set_connect_state(client);
+    SSL_set_accept_state(server);
+
+    for (i = 0; i < 100 && (!cdone || !sdone); i++) {
+        if (!cdone) {
+            k = SSL_do_handshake(client);
+            if (k == 1)
+                cdone = 1;
+            else if (SSL_get_error(client, k) != SSL_ERROR_WANT_READ)
+                goto err;
+        }
+        if (!sdone) {
+            k = SSL_do_handshake(server);
+            if (k == 1)
+                sdone = 1;
+            else if (SSL_get_error(server, k) != SSL_ERROR_WANT_READ)
+                goto err;
+        }
+    }
+    if (!cdone || !sdone)
+        goto err;
+
+    /* From now on the client's records are written to, and dropped in, mem */
+    if ((mem = BIO_new(BIO_s_mem())) == NULL)
+        goto err;
+    SSL_set0_wbio(client, mem);
+
+    /* Alternate between the two so that neither gets all the warm-up */
+    for (j = 0; j < SIZE_NUM; j++) {
+        for (k = 0; k < (int)OSSL_NELEM(wvnames); k++) {
+            SSL_IOVEC iov[2];
+            size_t len = sizeof(hdr) + lengths[j], written;
+
+            iov[0].iov_base = hdr;
+            iov[0].iov_len = sizeof(hdr);
+            iov[1].iov_base = body;
+            iov[1].iov_len = lengths[j];
+
+            print_message(wvnames[k], 0, (int)len);
+            Time_F(START);
+            for (count = 0, run = 1; run && count < 0x7fffffff; count++) {
+                if (k == 0) {
+                    memcpy(copy, hdr, sizeof(hdr));
+                    memcpy(copy + sizeof(hdr), body, lengths[j]);
+                    if (!SSL_write_ex(client, copy, len, &written))
+                        break;
+                } else if (!SSL_writev_ex(client, iov, 2, &written)) {
+                    break;
+                }
+                (void)BIO_reset(mem);
+            }
+            d = Time_F(STOP);
+            if (run)
+                goto err;
+            BIO_printf(bio_err, mr ? "+R:%d:%s:%f\n"
+                       : "%d %s's in %.2fs\n", count, wvnames[k], d);
+            wvresults[k][j] = ((double)count) / d * len;
+        }
+    }
+
+    if (mr) {
+        fprintf(stdout, "+H");
+        for (j = 0; j < SIZE_NUM; j++)
+            fprintf(stdout, ":%d", (int)sizeof(hdr) + lengths[j]);
+        fprintf(stdout, "\n");
+        for (k = 0; k < (int)OSSL_NELEM(wvnames); k++) {
+            fprintf(stdout, "+F:%d:%s", k, wvnames[k]);
+            for (j = 0; j < SIZE_NUM; j++)
+                fprintf(stdout, ":%.2f", wvresults[k][j]);
+            fprintf(stdout, "\n");
+        }
+    } else {
+        fprintf(stdout,
+                "The 'numbers' are in 1000s of bytes per second processed.\n");
+        fprintf(stdout, "type        ");
+        for (j = 0; j < SIZE_NUM; j++)
+            fprintf(stdout, "%7d bytes", (int)sizeof(hdr) + lengths[j]);
+        fprintf(stdout, "\n");
+        for (k = 0; k < (int)OSSL_NELEM(wvnames); k++) {
+            fprintf(stdout, "%-13s", wvnames[k]);
+            for (j = 0; j < SIZE_NUM; j++) {
+                if (wvresults[k][j] > 10000)
+                    fprintf(stdout, " %11.2fk", wvresults[k][j] / 1e3);
+                else
+                    fprintf(stdout, " %11.2f ", wvresults[k][j]);
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+    goto end;
+
+ err:
+    BIO_printf(bio_err, "writev: error setting up or writing to connection\n");
+    ERR_print_errors(bio_err);
+ end:
+    SSL_free(client);
+    SSL_free(server);
+    SSL_CTX_free(ctx);
+    OPENSSL_free(body);
+    OPENSSL_free(copy);
+}
+#endif
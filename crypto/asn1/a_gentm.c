@@ -227,14 +227,14 @@ ASN1_GENERALIZEDTIME *ASN1_GENERALIZEDTIME_adj(ASN1_GENERALIZEDTIME *s,
     }
 
     p = (char *)tmps->data;
-    if ((p == NULL) || ((size_t)tmps->length < len)) {
+    if ((p == NULL) || ((size_t)tmps->length < len)
+            || (tmps->flags & ASN1_STRING_FLAG_BORROWED)) {
         p = OPENSSL_malloc(len);
         if (p == NULL) {
             ASN1err(ASN1_F_ASN1_GENERALIZEDTIME_ADJ, ERR_R_MALLOC_FAILURE);
             goto err;
         }
-        OPENSSL_free(tmps->data);
-        tmps->data = (unsigned char *)p;
+        ASN1_STRING_set0(tmps, p, 0);
     }
 
     tmps->length = BIO_snprintf(p, len, "%04d%02d%02d%02d%02d%02dZ",
@@ -189,14 +189,14 @@ ASN1_UTCTIME *ASN1_UTCTIME_adj(ASN1_UTCTIME *s, time_t t,
         goto err;
 
     p = (char *)s->data;
-    if ((p == NULL) || ((size_t)s->length < len)) {
+    if ((p == NULL) || ((size_t)s->length < len)
+            || (s->flags & ASN1_STRING_FLAG_BORROWED)) {
         p = OPENSSL_malloc(len);
         if (p == NULL) {
             ASN1err(ASN1_F_ASN1_UTCTIME_ADJ, ERR_R_MALLOC_FAILURE);
             goto err;
         }
-        OPENSSL_free(s->data);
-        s->data = (unsigned char *)p;
+        ASN1_STRING_set0(s, p, 0);
     }
 
     s->length = BIO_snprintf(p, len, "%02d%02d%02d%02d%02d%02dZ",
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include "internal/cryptlib.h"
+#include <openssl/asn1.h>
+#include <openssl/asn1t.h>
+#include <openssl/err.h>
+#include "asn1_locl.h"
+
+/*
+ * An ASN1_ARENA holds the memory for the structures that the template
+ * decoder builds: SEQUENCEs and CHOICEs, ANY values, strings and their
+ * content, and saved encodings.  The arena is passed down through the
+ * template code, which allocates these with asn1_arena_malloc() and
+ * releases them with asn1_arena_free(), which leaves memory from the arena
+ * alone.  String content in the arena is marked as borrowed, so it is never
+ * freed or changed in place.  Anything else, such as stacks, keys decoded
+ * by callbacks and locks, comes from the heap as usual and is freed when
+ * the decoded structures are.
+ */
+
+typedef struct asn1_arena_chunk_st ASN1_ARENA_CHUNK;
+struct asn1_arena_chunk_st {
+    ASN1_ARENA_CHUNK *next;
+    unsigned char *data;
+    size_t size;
+    size_t used;
+};
+
+typedef struct asn1_arena_root_st ASN1_ARENA_ROOT;
+struct asn1_arena_root_st {
+    ASN1_ARENA_ROOT *next;
+    ASN1_VALUE *val;
+    const ASN1_ITEM *it;
+};
+
+struct asn1_arena_st {
+    ASN1_ARENA_CHUNK *chunks;   /* newest first */
+    ASN1_ARENA_ROOT *roots;     /* decoded structures */
+};
+
+/* Each block is aligned as malloc() would */
+#define ARENA_ALIGN             16
+#define ARENA_ROUND(n)          (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_CHUNK_HDR         ARENA_ROUND(sizeof(ASN1_ARENA_CHUNK))
+#define ARENA_MIN_CHUNK         4096
+#define ARENA_MAX_CHUNK         (1024 * 1024)
+
+/* As OPENSSL_malloc(), but from |arena| if it isn't NULL */
+void *asn1_arena_malloc(ASN1_ARENA *arena, size_t num)
+{
+    ASN1_ARENA_CHUNK *c;
+    size_t need = ARENA_ROUND(num);
+    unsigned char *p;
+
+    if (arena == NULL)
+        return OPENSSL_malloc(num);
+
+    c = arena->chunks;
+    if (c == NULL || c->size - c->used < need) {
+        size_t size = c == NULL ? ARENA_MIN_CHUNK : c->size * 2;
+
+        if (size > ARENA_MAX_CHUNK)
+            size = ARENA_MAX_CHUNK;
+        if (size < need)
+            size = need;
+        c = OPENSSL_malloc(ARENA_CHUNK_HDR + size);
+        if (c == NULL)
+            return NULL;
+        c->data = (unsigned char *)c + ARENA_CHUNK_HDR;
+        c->size = size;
+        c->used = 0;
+        c->next = arena->chunks;
+        arena->chunks = c;
+    }
+    p = c->data + c->used;
+    c->used += need;
+    return p;
+}
+
+/* As OPENSSL_zalloc(), but from |arena| if it isn't NULL */
+void *asn1_arena_zalloc(ASN1_ARENA *arena, size_t num)
+{
+    void *ret;
+
+    if (arena == NULL)
+        return OPENSSL_zalloc(num);
+    if ((ret = asn1_arena_malloc(arena, num)) != NULL)
+        memset(ret, 0, num);
+    return ret;
+}
+
+/* Returns 1 if |ptr| was allocated from |arena|, which may be NULL */
+int asn1_arena_owns(const ASN1_ARENA *arena, const void *ptr)
+{
+    const ASN1_ARENA_CHUNK *c;
+    const unsigned char *p = ptr;
+
+    if (arena == NULL || ptr == NULL)
+        return 0;
+    for (c = arena->chunks; c != NULL; c = c->next)
+        if (p >= c->data && p < c->data + c->used)
+            return 1;
+    return 0;
+}
+
+/* As OPENSSL_free(), but memory from |arena| is released with the arena */
+void asn1_arena_free(const ASN1_ARENA *arena, void *ptr)
+{
+    if (!asn1_arena_owns(arena, ptr))
+        OPENSSL_free(ptr);
+}
+
+ASN1_ARENA *ASN1_ARENA_new(void)
+{
+    ASN1_ARENA *arena = OPENSSL_zalloc(sizeof(*arena));
+
+    if (arena == NULL)
+        ASN1err(ASN1_F_ASN1_ARENA_NEW, ERR_R_MALLOC_FAILURE);
+    return arena;
+}
+
+/*
+ * Free everything decoded into |arena|, and all its memory apart from the
+ * newest chunk if |keep| is set.
+ */
+static void arena_release(ASN1_ARENA *arena, int keep)
+{
+    ASN1_ARENA_ROOT *r;
+    ASN1_ARENA_CHUNK *c, *next;
+
+    /* Only heap memory hanging off the structures is actually freed */
+    for (r = arena->roots; r != NULL; r = r->next)
+        asn1_item_arena_free(&r->val, r->it, arena);
+    arena->roots = NULL;
+
+    c = arena->chunks;
+    if (keep && c != NULL) {
+        c->used = 0;
+        next = c->next;
+        c->next = NULL;
+        c = next;
+    } else {
+        arena->chunks = NULL;
+    }
+    for (; c != NULL; c = next) {
+        next = c->next;
+        OPENSSL_free(c);
+    }
+}
+
+void ASN1_ARENA_reset(ASN1_ARENA *arena)
+{
+    if (arena != NULL)
+        arena_release(arena, 1);
+}
+
+void ASN1_ARENA_free(ASN1_ARENA *arena)
+{
+    if (arena == NULL)
+        return;
+    arena_release(arena, 0);
+    OPENSSL_free(arena);
+}
+
+/* Record |val|, just decoded into |arena|, to be freed with it */
+int asn1_arena_add_root(ASN1_ARENA *arena, ASN1_VALUE *val,
+                        const ASN1_ITEM *it)
+{
+    ASN1_ARENA_ROOT *root = asn1_arena_malloc(arena, sizeof(*root));
+
+    if (root == NULL)
+        return 0;
+    root->val = val;
+    root->it = it;
+    root->next = arena->roots;
+    arena->roots = root;
+    return 1;
+}
@@ -247,9 +247,10 @@ int ASN1_STRING_copy(ASN1_STRING *dst, const ASN1_STRING *str)
     dst->type = str->type;
     if (!ASN1_STRING_set(dst, str->data, str->length))
         return 0;
-    /* Copy flags but preserve embed value */
+    /* Copy flags but preserve embed value, the copy owns its data */
     dst->flags &= ASN1_STRING_FLAG_EMBED;
-    dst->flags |= str->flags & ~ASN1_STRING_FLAG_EMBED;
+    dst->flags |= str->flags
+                  & ~(ASN1_STRING_FLAG_EMBED | ASN1_STRING_FLAG_BORROWED);
     return 1;
 }
 
@@ -279,7 +280,16 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
         else
             len = strlen(data);
     }
-    if ((str->length <= len) || (str->data == NULL)) {
+    if (str->flags & ASN1_STRING_FLAG_BORROWED) {
+        /* Never write to or reallocate the decoder's input */
+        c = OPENSSL_malloc(len + 1);
+        if (c == NULL) {
+            ASN1err(ASN1_F_ASN1_STRING_SET, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        str->data = c;
+        str->flags &= ~ASN1_STRING_FLAG_BORROWED;
+    } else if ((str->length <= len) || (str->data == NULL)) {
         c = str->data;
         str->data = OPENSSL_realloc(c, len + 1);
         if (str->data == NULL) {
@@ -299,11 +309,24 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
 
 void ASN1_STRING_set0(ASN1_STRING *str, void *data, int len)
 {
-    OPENSSL_free(str->data);
+    if (!(str->flags & ASN1_STRING_FLAG_BORROWED))
+        OPENSSL_free(str->data);
+    str->flags &= ~ASN1_STRING_FLAG_BORROWED;
     str->data = data;
     str->length = len;
 }
 
+/*
+ * Make |str| refer to |len| bytes at |data|, which belong to the caller and
+ * must outlive it.  Unlike after ASN1_STRING_set() the data is not followed
+ * by a NUL.
+ */
+void asn1_string_borrow(ASN1_STRING *str, const unsigned char *data, int len)
+{
+    ASN1_STRING_set0(str, (unsigned char *)data, len);
+    str->flags |= ASN1_STRING_FLAG_BORROWED;
+}
+
 ASN1_STRING *ASN1_STRING_new(void)
 {
     return ASN1_STRING_type_new(V_ASN1_OCTET_STRING);
@@ -326,7 +349,7 @@ void asn1_string_embed_free(ASN1_STRING *a, int embed)
 {
     if (a == NULL)
         return;
-    if (!(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (!(a->flags & (ASN1_STRING_FLAG_NDEF | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_free(a->data);
     if (embed == 0)
         OPENSSL_free(a);
@@ -343,7 +366,8 @@ void ASN1_STRING_clear_free(ASN1_STRING *a)
 {
     if (a == NULL)
         return;
-    if (a->data && !(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (a->data
+            && !(a->flags & (ASN1_STRING_FLAG_NDEF | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_cleanse(a->data, a->length);
     ASN1_STRING_free(a);
 }
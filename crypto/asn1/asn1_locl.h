@@ -11,6 +11,19 @@
 
 int asn1_utctime_to_tm(struct tm *tm, const ASN1_UTCTIME *d);
 int asn1_generalizedtime_to_tm(struct tm *tm, const ASN1_GENERALIZEDTIME *d);
+void asn1_string_borrow(ASN1_STRING *str, const unsigned char *data, int len);
+
+/* Memory from an ASN1_ARENA, see asn1_arena.c */
+void *asn1_arena_malloc(ASN1_ARENA *arena, size_t num);
+void *asn1_arena_zalloc(ASN1_ARENA *arena, size_t num);
+int asn1_arena_owns(const ASN1_ARENA *arena, const void *ptr);
+void asn1_arena_free(const ASN1_ARENA *arena, void *ptr);
+int asn1_arena_add_root(ASN1_ARENA *arena, ASN1_VALUE *val,
+                        const ASN1_ITEM *it);
+int asn1_item_arena_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                        ASN1_ARENA *arena);
+void asn1_item_arena_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                          const ASN1_ARENA *arena);
 
 /* ASN1 scan context structure */
 
@@ -59,14 +72,17 @@ const ASN1_TEMPLATE *asn1_do_adb(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt,
 int asn1_do_lock(ASN1_VALUE **pval, int op, const ASN1_ITEM *it);
 
 void asn1_enc_init(ASN1_VALUE **pval, const ASN1_ITEM *it);
-void asn1_enc_free(ASN1_VALUE **pval, const ASN1_ITEM *it);
+void asn1_enc_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                   const ASN1_ARENA *arena);
 int asn1_enc_restore(int *len, unsigned char **out, ASN1_VALUE **pval,
                      const ASN1_ITEM *it);
 int asn1_enc_save(ASN1_VALUE **pval, const unsigned char *in, int inlen,
-                  const ASN1_ITEM *it);
+                  const ASN1_ITEM *it, ASN1_ARENA *arena);
 
-void asn1_primitive_free(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed);
-void asn1_template_free(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt);
+void asn1_primitive_free(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed,
+                         const ASN1_ARENA *arena);
+void asn1_template_free(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt,
+                        const ASN1_ARENA *arena);
 
 ASN1_OBJECT *c2i_ASN1_OBJECT(ASN1_OBJECT **a, const unsigned char **pp,
                              long length);
@@ -86,9 +86,12 @@ EVP_PKEY *d2i_AutoPrivateKey(EVP_PKEY **a, const unsigned char **pp,
     /*
      * Dirty trick: read in the ASN1 data into a STACK_OF(ASN1_TYPE): by
      * analyzing it we can determine the passed structure: this assumes the
-     * input is surrounded by an ASN1 SEQUENCE.
+     * input is surrounded by an ASN1 SEQUENCE. A failure here is not an
+     * error, the real decode below reports any problem with the input.
      */
+    ERR_set_suppress_mark();
     inkey = d2i_ASN1_SEQUENCE_ANY(NULL, &p, length);
+    ERR_pop_suppress_mark();
     p = *pp;
     /*
      * Since we only need to discern "traditional format" RSA and DSA keys we
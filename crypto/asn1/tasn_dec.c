@@ -17,9 +17,24 @@
 #include "internal/numbers.h"
 #include "asn1_locl.h"
 
+/*
+ * Decoder state passed down along with the ASN1_TLC, which is public and so
+ * can't carry it.
+ */
+typedef struct {
+    int flags;
+    ASN1_ARENA *arena;          /* allocate structures here if not NULL */
+} ASN1_DCTX;
+
+/* The content of ASN1_STRING based values may refer to the input */
+#define ASN1_DFLAG_BORROW       0x1
+
+static const ASN1_DCTX default_dctx = { 0, NULL };
+
 static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
                                long len, const ASN1_ITEM *it,
-                               int tag, int aclass, char opt, ASN1_TLC *ctx);
+                               int tag, int aclass, char opt, ASN1_TLC *ctx,
+                               const ASN1_DCTX *dctx);
 
 static int asn1_check_eoc(const unsigned char **in, long len);
 static int asn1_find_end(const unsigned char **in, long len, char inf);
@@ -37,18 +52,19 @@ static int asn1_check_tlen(long *olen, int *otag, unsigned char *oclass,
 static int asn1_template_ex_d2i(ASN1_VALUE **pval,
                                 const unsigned char **in, long len,
                                 const ASN1_TEMPLATE *tt, char opt,
-                                ASN1_TLC *ctx);
+                                ASN1_TLC *ctx, const ASN1_DCTX *dctx);
 static int asn1_template_noexp_d2i(ASN1_VALUE **val,
                                    const unsigned char **in, long len,
                                    const ASN1_TEMPLATE *tt, char opt,
-                                   ASN1_TLC *ctx);
+                                   ASN1_TLC *ctx, const ASN1_DCTX *dctx);
 static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
                                  const unsigned char **in, long len,
                                  const ASN1_ITEM *it,
                                  int tag, int aclass, char opt,
-                                 ASN1_TLC *ctx);
+                                 ASN1_TLC *ctx, const ASN1_DCTX *dctx);
 static int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
-                       int utype, char *free_cont, const ASN1_ITEM *it);
+                       int utype, char *free_cont, const ASN1_ITEM *it,
+                       const ASN1_DCTX *dctx);
 
 /* Table to convert tags to bit values, used for MSTRING type */
 static const unsigned long tag2bit[32] = {
@@ -92,26 +108,76 @@ unsigned long ASN1_tag2bit(int tag)
  * this will simply be a special case.
  */
 
-ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **pval,
-                          const unsigned char **in, long len,
-                          const ASN1_ITEM *it)
+static ASN1_VALUE *asn1_item_d2i(ASN1_VALUE **pval,
+                                  const unsigned char **in, long len,
+                                  const ASN1_ITEM *it, const ASN1_DCTX *dctx)
 {
     ASN1_TLC c;
     ASN1_VALUE *ptmpval = NULL;
     if (!pval)
         pval = &ptmpval;
     asn1_tlc_clear_nc(&c);
-    if (ASN1_item_ex_d2i(pval, in, len, it, -1, 0, 0, &c) > 0)
+    if (asn1_item_embed_d2i(pval, in, len, it, -1, 0, 0, &c, dctx) > 0)
         return *pval;
+    asn1_item_arena_free(pval, it, dctx->arena);
     return NULL;
 }
 
+ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **pval,
+                          const unsigned char **in, long len,
+                          const ASN1_ITEM *it)
+{
+    return asn1_item_d2i(pval, in, len, it, &default_dctx);
+}
+
+/*
+ * As ASN1_item_d2i() but strings, bit strings and non-negative integers
+ * point into the input buffer wherever their encoding allows it.
+ */
+ASN1_VALUE *ASN1_item_d2i_borrow(ASN1_VALUE **pval,
+                                 const unsigned char **in, long len,
+                                 const ASN1_ITEM *it)
+{
+    ASN1_DCTX dctx = { ASN1_DFLAG_BORROW, NULL };
+
+    return asn1_item_d2i(pval, in, len, it, &dctx);
+}
+
+/*
+ * As ASN1_item_d2i() but the structure is allocated in |arena|, see
+ * asn1_arena.c.  It can't be decoded into an existing structure.
+ */
+ASN1_VALUE *ASN1_item_d2i_arena(ASN1_VALUE **pval,
+                                const unsigned char **in, long len,
+                                const ASN1_ITEM *it, ASN1_ARENA *arena)
+{
+    ASN1_DCTX dctx = { 0, NULL };
+    ASN1_VALUE *tmpval = NULL;
+
+    if (pval == NULL)
+        pval = &tmpval;
+    if (arena == NULL || *pval != NULL) {
+        ASN1err(ASN1_F_ASN1_ITEM_D2I_ARENA, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+    dctx.arena = arena;
+    if (asn1_item_d2i(pval, in, len, it, &dctx) == NULL)
+        return NULL;
+    if (!asn1_arena_add_root(arena, *pval, it)) {
+        ASN1err(ASN1_F_ASN1_ITEM_D2I_ARENA, ERR_R_MALLOC_FAILURE);
+        asn1_item_arena_free(pval, it, arena);
+        return NULL;
+    }
+    return *pval;
+}
+
 int ASN1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in, long len,
                      const ASN1_ITEM *it,
                      int tag, int aclass, char opt, ASN1_TLC *ctx)
 {
     int rv;
-    rv = asn1_item_embed_d2i(pval, in, len, it, tag, aclass, opt, ctx);
+    rv = asn1_item_embed_d2i(pval, in, len, it, tag, aclass, opt, ctx,
+                             &default_dctx);
     if (rv <= 0)
         ASN1_item_ex_free(pval, it);
     return rv;
@@ -124,7 +190,8 @@ int ASN1_item_ex_d2i(ASN1_VALUE **pval, const unsigned char **in, long len,
 
 static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
                                long len, const ASN1_ITEM *it,
-                               int tag, int aclass, char opt, ASN1_TLC *ctx)
+                               int tag, int aclass, char opt, ASN1_TLC *ctx,
+                               const ASN1_DCTX *dctx)
 {
     const ASN1_TEMPLATE *tt, *errtt = NULL;
     const ASN1_EXTERN_FUNCS *ef;
@@ -160,10 +227,10 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
                 goto err;
             }
             return asn1_template_ex_d2i(pval, in, len,
-                                        it->templates, opt, ctx);
+                                        it->templates, opt, ctx, dctx);
         }
         return asn1_d2i_ex_primitive(pval, in, len, it,
-                                     tag, aclass, opt, ctx);
+                                     tag, aclass, opt, ctx, dctx);
 
     case ASN1_ITYPE_MSTRING:
         p = *in;
@@ -191,7 +258,8 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ASN1_R_MSTRING_WRONG_TAG);
             goto err;
         }
-        return asn1_d2i_ex_primitive(pval, in, len, it, otag, 0, 0, ctx);
+        return asn1_d2i_ex_primitive(pval, in, len, it, otag, 0, 0, ctx,
+                                     dctx);
 
     case ASN1_ITYPE_EXTERN:
         /* Use new style d2i */
@@ -207,10 +275,10 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             if ((i >= 0) && (i < it->tcount)) {
                 tt = it->templates + i;
                 pchptr = asn1_get_field_ptr(pval, tt);
-                asn1_template_free(pchptr, tt);
+                asn1_template_free(pchptr, tt, dctx->arena);
                 asn1_set_choice_selector(pval, -1, it);
             }
-        } else if (!ASN1_item_ex_new(pval, it)) {
+        } else if (!asn1_item_arena_new(pval, it, dctx->arena)) {
             ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
         }
@@ -221,7 +289,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             /*
              * We mark field as OPTIONAL so its absence can be recognised.
              */
-            ret = asn1_template_ex_d2i(pchptr, &p, len, tt, 1, ctx);
+            ret = asn1_template_ex_d2i(pchptr, &p, len, tt, 1, ctx, dctx);
             /* If field not present, try the next one */
             if (ret == -1)
                 continue;
@@ -232,7 +300,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
              * Must be an ASN1 parsing error.
              * Free up any partial choice value
              */
-            asn1_template_free(pchptr, tt);
+            asn1_template_free(pchptr, tt, dctx->arena);
             errtt = tt;
             ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
@@ -243,7 +311,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             /* If OPTIONAL, this is OK */
             if (opt) {
                 /* Free and zero it */
-                ASN1_item_ex_free(pval, it);
+                asn1_item_arena_free(pval, it, dctx->arena);
                 return -1;
             }
             ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ASN1_R_NO_MATCHING_CHOICE_TYPE);
@@ -287,7 +355,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             goto err;
         }
 
-        if (!*pval && !ASN1_item_ex_new(pval, it)) {
+        if (!*pval && !asn1_item_arena_new(pval, it, dctx->arena)) {
             ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
         }
@@ -304,7 +372,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
                 if (seqtt == NULL)
                     continue;
                 pseqval = asn1_get_field_ptr(pval, seqtt);
-                asn1_template_free(pseqval, seqtt);
+                asn1_template_free(pseqval, seqtt, dctx->arena);
             }
         }
 
@@ -344,7 +412,8 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
              * attempt to read in field, allowing each to be OPTIONAL
              */
 
-            ret = asn1_template_ex_d2i(pseqval, &p, len, seqtt, isopt, ctx);
+            ret = asn1_template_ex_d2i(pseqval, &p, len, seqtt, isopt, ctx,
+                                       dctx);
             if (!ret) {
                 errtt = seqtt;
                 goto err;
@@ -352,7 +421,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
                 /*
                  * OPTIONAL component absent. Free and zero the field.
                  */
-                asn1_template_free(pseqval, seqtt);
+                asn1_template_free(pseqval, seqtt, dctx->arena);
                 continue;
             }
             /* Update length */
@@ -383,7 +452,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             if (seqtt->flags & ASN1_TFLG_OPTIONAL) {
                 ASN1_VALUE **pseqval;
                 pseqval = asn1_get_field_ptr(pval, seqtt);
-                asn1_template_free(pseqval, seqtt);
+                asn1_template_free(pseqval, seqtt, dctx->arena);
             } else {
                 errtt = seqtt;
                 ASN1err(ASN1_F_ASN1_ITEM_EMBED_D2I, ASN1_R_FIELD_MISSING);
@@ -391,7 +460,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
             }
         }
         /* Save encoding */
-        if (!asn1_enc_save(pval, *in, p - *in, it))
+        if (!asn1_enc_save(pval, *in, p - *in, it, dctx->arena))
             goto auxerr;
         if (asn1_cb && !asn1_cb(ASN1_OP_D2I_POST, pval, it, NULL))
             goto auxerr;
@@ -420,7 +489,7 @@ static int asn1_item_embed_d2i(ASN1_VALUE **pval, const unsigned char **in,
 static int asn1_template_ex_d2i(ASN1_VALUE **val,
                                 const unsigned char **in, long inlen,
                                 const ASN1_TEMPLATE *tt, char opt,
-                                ASN1_TLC *ctx)
+                                ASN1_TLC *ctx, const ASN1_DCTX *dctx)
 {
     int flags, aclass;
     int ret;
@@ -455,7 +524,7 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
             return 0;
         }
         /* We've found the field so it can't be OPTIONAL now */
-        ret = asn1_template_noexp_d2i(val, &p, len, tt, 0, ctx);
+        ret = asn1_template_noexp_d2i(val, &p, len, tt, 0, ctx, dctx);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_EX_D2I, ERR_R_NESTED_ASN1_ERROR);
             return 0;
@@ -479,7 +548,7 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
             }
         }
     } else
-        return asn1_template_noexp_d2i(val, in, inlen, tt, opt, ctx);
+        return asn1_template_noexp_d2i(val, in, inlen, tt, opt, ctx, dctx);
 
     *in = p;
     return 1;
@@ -491,7 +560,7 @@ static int asn1_template_ex_d2i(ASN1_VALUE **val,
 static int asn1_template_noexp_d2i(ASN1_VALUE **val,
                                    const unsigned char **in, long len,
                                    const ASN1_TEMPLATE *tt, char opt,
-                                   ASN1_TLC *ctx)
+                                   ASN1_TLC *ctx, const ASN1_DCTX *dctx)
 {
     int flags, aclass;
     int ret;
@@ -547,7 +616,8 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
             ASN1_VALUE *vtmp;
             while (sk_ASN1_VALUE_num(sktmp) > 0) {
                 vtmp = sk_ASN1_VALUE_pop(sktmp);
-                ASN1_item_ex_free(&vtmp, ASN1_ITEM_ptr(tt->item));
+                asn1_item_arena_free(&vtmp, ASN1_ITEM_ptr(tt->item),
+                                     dctx->arena);
             }
         }
 
@@ -573,17 +643,20 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
             }
             skfield = NULL;
             if (!asn1_item_embed_d2i(&skfield, &p, len,
-                                     ASN1_ITEM_ptr(tt->item), -1, 0, 0, ctx)) {
+                                     ASN1_ITEM_ptr(tt->item), -1, 0, 0, ctx,
+                                     dctx)) {
                 ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I,
                         ERR_R_NESTED_ASN1_ERROR);
                 /* |skfield| may be partially allocated despite failure. */
-                ASN1_item_free(skfield, ASN1_ITEM_ptr(tt->item));
+                asn1_item_arena_free(&skfield, ASN1_ITEM_ptr(tt->item),
+                                     dctx->arena);
                 goto err;
             }
             len -= p - q;
             if (!sk_ASN1_VALUE_push((STACK_OF(ASN1_VALUE) *)*val, skfield)) {
                 ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I, ERR_R_MALLOC_FAILURE);
-                ASN1_item_free(skfield, ASN1_ITEM_ptr(tt->item));
+                asn1_item_arena_free(&skfield, ASN1_ITEM_ptr(tt->item),
+                                     dctx->arena);
                 goto err;
             }
         }
@@ -595,7 +668,7 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
         /* IMPLICIT tagging */
         ret = asn1_item_embed_d2i(val, &p, len,
                                   ASN1_ITEM_ptr(tt->item), tt->tag, aclass, opt,
-                                  ctx);
+                                  ctx, dctx);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
@@ -604,7 +677,7 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
     } else {
         /* Nothing special */
         ret = asn1_item_embed_d2i(val, &p, len, ASN1_ITEM_ptr(tt->item),
-                                  -1, 0, opt, ctx);
+                                  -1, 0, opt, ctx, dctx);
         if (!ret) {
             ASN1err(ASN1_F_ASN1_TEMPLATE_NOEXP_D2I, ERR_R_NESTED_ASN1_ERROR);
             goto err;
@@ -622,7 +695,8 @@ static int asn1_template_noexp_d2i(ASN1_VALUE **val,
 static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
                                  const unsigned char **in, long inlen,
                                  const ASN1_ITEM *it,
-                                 int tag, int aclass, char opt, ASN1_TLC *ctx)
+                                 int tag, int aclass, char opt, ASN1_TLC *ctx,
+                                 const ASN1_DCTX *dctx)
 {
     int ret = 0, utype;
     long plen;
@@ -739,8 +813,8 @@ static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
     }
 
     /* We now have content length and type: translate into a structure */
-    /* asn1_ex_c2i may reuse allocated buffer, and so sets free_cont to 0 */
-    if (!asn1_ex_c2i(pval, cont, len, utype, &free_cont, it))
+    /* asn1_ex_c2i may reuse allocated buffer, and so sets free_cont to 0. */
+    if (!asn1_ex_c2i(pval, cont, len, utype, &free_cont, it, dctx))
         goto err;
 
     *in = p;
@@ -751,10 +825,98 @@ static int asn1_d2i_ex_primitive(ASN1_VALUE **pval,
     return ret;
 }
 
+/*
+ * Point an ASN1_STRING based value at its content octets instead of copying
+ * them, or at a copy of them in |arena| if it isn't NULL.  Returns 1 if it
+ * did, 0 on error or -1 if the content is not stored as it is encoded and so
+ * has to be converted as usual.
+ */
+static int asn1_ex_c2i_borrow(ASN1_VALUE **pval, const unsigned char *cont,
+                              int len, int utype, ASN1_ARENA *arena)
+{
+    ASN1_STRING *stmp;
+    unsigned char *data;
+    int bits = -1;
+
+    switch (utype) {
+    case V_ASN1_OBJECT:
+    case V_ASN1_NULL:
+    case V_ASN1_BOOLEAN:
+        return -1;
+
+    case V_ASN1_BIT_STRING:
+        /* Any unused bits must be zero already, as DER requires */
+        if (len < 2 || cont[0] > 7
+                || (cont[len - 1] & ((1 << cont[0]) - 1)) != 0)
+            return -1;
+        bits = cont[0];
+        cont++;
+        len--;
+        break;
+
+    case V_ASN1_INTEGER:
+    case V_ASN1_ENUMERATED:
+        /* Only non-negative values are kept in their encoded form */
+        if (len < 1 || (cont[0] & 0x80) != 0)
+            return -1;
+        if (len > 1 && cont[0] == 0) {
+            /* Leave illegal padding for c2i_ASN1_INTEGER() to report */
+            if ((cont[1] & 0x80) == 0)
+                return -1;
+            cont++;
+            len--;
+        }
+        break;
+
+    case V_ASN1_BMPSTRING:
+        if (len & 1)
+            return -1;
+        break;
+
+    case V_ASN1_UNIVERSALSTRING:
+        if (len & 3)
+            return -1;
+        break;
+    }
+
+    if (arena != NULL) {
+        /* Keep the content NUL terminated as ASN1_STRING_set() does */
+        if ((data = asn1_arena_malloc(arena, len + 1)) == NULL) {
+            ASN1err(ASN1_F_ASN1_EX_C2I_BORROW, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        memcpy(data, cont, len);
+        data[len] = '\0';
+        cont = data;
+    }
+    if (!*pval) {
+        if (arena != NULL)
+            stmp = asn1_arena_zalloc(arena, sizeof(*stmp));
+        else
+            stmp = ASN1_STRING_type_new(utype);
+        if (stmp == NULL) {
+            ASN1err(ASN1_F_ASN1_EX_C2I_BORROW, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        stmp->type = utype;
+        *pval = (ASN1_VALUE *)stmp;
+    } else {
+        stmp = (ASN1_STRING *)*pval;
+        stmp->type = utype;
+    }
+    if (bits >= 0) {
+        stmp->flags &= ~(ASN1_STRING_FLAG_BITS_LEFT | 0x07);
+        stmp->flags |= ASN1_STRING_FLAG_BITS_LEFT | bits;
+    }
+    asn1_string_borrow(stmp, cont, len);
+    return 1;
+}
+
 /* Translate ASN1 content octets into a structure */
 
 static int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
-                       int utype, char *free_cont, const ASN1_ITEM *it)
+                       int utype, char *free_cont, const ASN1_ITEM *it,
+                       const ASN1_DCTX *dctx)
 {
     ASN1_VALUE **opval = NULL;
     ASN1_STRING *stmp;
@@ -769,18 +931,31 @@ static int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
     /* If ANY type clear type and set pointer to internal value */
     if (it->utype == V_ASN1_ANY) {
         if (!*pval) {
-            typ = ASN1_TYPE_new();
-            if (typ == NULL)
+            if (!asn1_item_arena_new(pval, ASN1_ITEM_rptr(ASN1_ANY),
+                                     dctx->arena))
                 goto err;
-            *pval = (ASN1_VALUE *)typ;
-        } else
-            typ = (ASN1_TYPE *)*pval;
+        }
+        typ = (ASN1_TYPE *)*pval;
 
         if (utype != typ->type)
             ASN1_TYPE_set(typ, utype, NULL);
         opval = pval;
         pval = &typ->value.asn1_value;
     }
+    /*
+     * Strings in an arena always borrow their content, from the arena if
+     * not from the input.  Content collected from a constructed encoding is
+     * never borrowed from the input.
+     */
+    if (((dctx->flags & ASN1_DFLAG_BORROW) != 0 && !*free_cont)
+            || dctx->arena != NULL) {
+        ret = asn1_ex_c2i_borrow(pval, cont, len, utype, dctx->arena);
+        if (ret == 0)
+            goto err;
+        if (ret > 0)
+            goto done;
+        ret = 0;
+    }
     switch (utype) {
     case V_ASN1_OBJECT:
         if (!c2i_ASN1_OBJECT((ASN1_OBJECT **)pval, &cont, len))
@@ -861,9 +1036,8 @@ static int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
         }
         /* If we've already allocated a buffer use it */
         if (*free_cont) {
-            OPENSSL_free(stmp->data);
-            stmp->data = (unsigned char *)cont; /* UGLY CAST! RL */
-            stmp->length = len;
+            /* UGLY CAST! RL */
+            ASN1_STRING_set0(stmp, (unsigned char *)cont, len);
             *free_cont = 0;
         } else {
             if (!ASN1_STRING_set(stmp, cont, len)) {
@@ -879,10 +1053,12 @@ static int asn1_ex_c2i(ASN1_VALUE **pval, const unsigned char *cont, int len,
     if (typ && (utype == V_ASN1_NULL))
         typ->value.ptr = NULL;
 
+ done:
     ret = 1;
  err:
     if (!ret) {
-        ASN1_TYPE_free(typ);
+        asn1_item_arena_free((ASN1_VALUE **)&typ, ASN1_ITEM_rptr(ASN1_ANY),
+                             dctx->arena);
         if (opval)
             *opval = NULL;
     }
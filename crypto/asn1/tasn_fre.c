@@ -14,22 +14,32 @@
 #include "asn1_locl.h"
 
 static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
-                                 int embed);
+                                 int embed, const ASN1_ARENA *arena);
 
 /* Free up an ASN1 structure */
 
 void ASN1_item_free(ASN1_VALUE *val, const ASN1_ITEM *it)
 {
-    asn1_item_embed_free(&val, it, 0);
+    asn1_item_embed_free(&val, it, 0, NULL);
 }
 
 void ASN1_item_ex_free(ASN1_VALUE **pval, const ASN1_ITEM *it)
 {
-    asn1_item_embed_free(pval, it, 0);
+    asn1_item_embed_free(pval, it, 0, NULL);
+}
+
+/*
+ * Free a structure decoded into |arena|: memory that came from the arena is
+ * left for it to release, anything else is freed as usual.
+ */
+void asn1_item_arena_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                          const ASN1_ARENA *arena)
+{
+    asn1_item_embed_free(pval, it, 0, arena);
 }
 
 static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
-                                 int embed)
+                                 int embed, const ASN1_ARENA *arena)
 {
     const ASN1_TEMPLATE *tt = NULL, *seqtt;
     const ASN1_EXTERN_FUNCS *ef;
@@ -50,13 +60,13 @@ static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
 
     case ASN1_ITYPE_PRIMITIVE:
         if (it->templates)
-            asn1_template_free(pval, it->templates);
+            asn1_template_free(pval, it->templates, arena);
         else
-            asn1_primitive_free(pval, it, embed);
+            asn1_primitive_free(pval, it, embed, arena);
         break;
 
     case ASN1_ITYPE_MSTRING:
-        asn1_primitive_free(pval, it, embed);
+        asn1_primitive_free(pval, it, embed, arena);
         break;
 
     case ASN1_ITYPE_CHOICE:
@@ -71,12 +81,12 @@ static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
 
             tt = it->templates + i;
             pchval = asn1_get_field_ptr(pval, tt);
-            asn1_template_free(pchval, tt);
+            asn1_template_free(pchval, tt, arena);
         }
         if (asn1_cb)
             asn1_cb(ASN1_OP_FREE_POST, pval, it, NULL);
         if (embed == 0) {
-            OPENSSL_free(*pval);
+            asn1_arena_free(arena, *pval);
             *pval = NULL;
         }
         break;
@@ -96,7 +106,7 @@ static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
             if (i == 2)
                 return;
         }
-        asn1_enc_free(pval, it);
+        asn1_enc_free(pval, it, arena);
         /*
          * If we free up as normal we will invalidate any ANY DEFINED BY
          * field and we won't be able to determine the type of the field it
@@ -111,19 +121,20 @@ static void asn1_item_embed_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
             if (!seqtt)
                 continue;
             pseqval = asn1_get_field_ptr(pval, seqtt);
-            asn1_template_free(pseqval, seqtt);
+            asn1_template_free(pseqval, seqtt, arena);
         }
         if (asn1_cb)
             asn1_cb(ASN1_OP_FREE_POST, pval, it, NULL);
         if (embed == 0) {
-            OPENSSL_free(*pval);
+            asn1_arena_free(arena, *pval);
             *pval = NULL;
         }
         break;
     }
 }
 
-void asn1_template_free(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt)
+void asn1_template_free(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt,
+                        const ASN1_ARENA *arena)
 {
     int embed = tt->flags & ASN1_TFLG_EMBED;
     ASN1_VALUE *tval;
@@ -138,16 +149,18 @@ void asn1_template_free(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt)
         for (i = 0; i < sk_ASN1_VALUE_num(sk); i++) {
             ASN1_VALUE *vtmp = sk_ASN1_VALUE_value(sk, i);
 
-            asn1_item_embed_free(&vtmp, ASN1_ITEM_ptr(tt->item), embed);
+            asn1_item_embed_free(&vtmp, ASN1_ITEM_ptr(tt->item), embed,
+                                 arena);
         }
         sk_ASN1_VALUE_free(sk);
         *pval = NULL;
     } else {
-        asn1_item_embed_free(pval, ASN1_ITEM_ptr(tt->item), embed);
+        asn1_item_embed_free(pval, ASN1_ITEM_ptr(tt->item), embed, arena);
     }
 }
 
-void asn1_primitive_free(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
+void asn1_primitive_free(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed,
+                         const ASN1_ARENA *arena)
 {
     int utype;
 
@@ -200,12 +213,14 @@ void asn1_primitive_free(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
         break;
 
     case V_ASN1_ANY:
-        asn1_primitive_free(pval, NULL, 0);
-        OPENSSL_free(*pval);
+        asn1_primitive_free(pval, NULL, 0, arena);
+        asn1_arena_free(arena, *pval);
         break;
 
     default:
-        asn1_string_embed_free((ASN1_STRING *)*pval, embed);
+        /* A string in an arena is freed like an embedded one */
+        asn1_string_embed_free((ASN1_STRING *)*pval,
+                               embed || asn1_arena_owns(arena, *pval));
         break;
     }
     *pval = NULL;
@@ -16,11 +16,12 @@
 #include "asn1_locl.h"
 
 static int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
-                               int embed);
+                               int embed, ASN1_ARENA *arena);
 static int asn1_primitive_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
-                              int embed);
+                              int embed, ASN1_ARENA *arena);
 static void asn1_item_clear(ASN1_VALUE **pval, const ASN1_ITEM *it);
-static int asn1_template_new(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt);
+static int asn1_template_new(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt,
+                             ASN1_ARENA *arena);
 static void asn1_template_clear(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt);
 static void asn1_primitive_clear(ASN1_VALUE **pval, const ASN1_ITEM *it);
 
@@ -36,10 +37,22 @@ ASN1_VALUE *ASN1_item_new(const ASN1_ITEM *it)
 
 int ASN1_item_ex_new(ASN1_VALUE **pval, const ASN1_ITEM *it)
 {
-    return asn1_item_embed_new(pval, it, 0);
+    return asn1_item_embed_new(pval, it, 0, NULL);
 }
 
-int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
+/*
+ * As ASN1_item_ex_new() but the structure and its strings are allocated
+ * from |arena| if it isn't NULL.  It must then be freed with
+ * asn1_item_arena_free().
+ */
+int asn1_item_arena_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                        ASN1_ARENA *arena)
+{
+    return asn1_item_embed_new(pval, it, 0, arena);
+}
+
+int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed,
+                        ASN1_ARENA *arena)
 {
     const ASN1_TEMPLATE *tt = NULL;
     const ASN1_EXTERN_FUNCS *ef;
@@ -68,14 +81,14 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
 
     case ASN1_ITYPE_PRIMITIVE:
         if (it->templates) {
-            if (!asn1_template_new(pval, it->templates))
+            if (!asn1_template_new(pval, it->templates, arena))
                 goto memerr;
-        } else if (!asn1_primitive_new(pval, it, embed))
+        } else if (!asn1_primitive_new(pval, it, embed, arena))
             goto memerr;
         break;
 
     case ASN1_ITYPE_MSTRING:
-        if (!asn1_primitive_new(pval, it, embed))
+        if (!asn1_primitive_new(pval, it, embed, arena))
             goto memerr;
         break;
 
@@ -94,7 +107,7 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
         if (embed) {
             memset(*pval, 0, it->size);
         } else {
-            *pval = OPENSSL_zalloc(it->size);
+            *pval = asn1_arena_zalloc(arena, it->size);
             if (*pval == NULL)
                 goto memerr;
         }
@@ -119,7 +132,7 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
         if (embed) {
             memset(*pval, 0, it->size);
         } else {
-            *pval = OPENSSL_zalloc(it->size);
+            *pval = asn1_arena_zalloc(arena, it->size);
             if (*pval == NULL)
                 goto memerr;
         }
@@ -129,7 +142,7 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
         asn1_enc_init(pval, it);
         for (i = 0, tt = it->templates; i < it->tcount; tt++, i++) {
             pseqval = asn1_get_field_ptr(pval, tt);
-            if (!asn1_template_new(pseqval, tt))
+            if (!asn1_template_new(pseqval, tt, arena))
                 goto memerr2;
         }
         if (asn1_cb && !asn1_cb(ASN1_OP_NEW_POST, pval, it, NULL))
@@ -142,7 +155,7 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
     return 1;
 
  memerr2:
-    ASN1_item_ex_free(pval, it);
+    asn1_item_arena_free(pval, it, arena);
  memerr:
     ASN1err(ASN1_F_ASN1_ITEM_EMBED_NEW, ERR_R_MALLOC_FAILURE);
 #ifndef OPENSSL_NO_CRYPTO_MDEBUG
@@ -151,7 +164,7 @@ int asn1_item_embed_new(ASN1_VALUE **pval, const ASN1_ITEM *it, int embed)
     return 0;
 
  auxerr2:
-    ASN1_item_ex_free(pval, it);
+    asn1_item_arena_free(pval, it, arena);
  auxerr:
     ASN1err(ASN1_F_ASN1_ITEM_EMBED_NEW, ASN1_R_AUX_ERROR);
 #ifndef OPENSSL_NO_CRYPTO_MDEBUG
@@ -194,7 +207,8 @@ static void asn1_item_clear(ASN1_VALUE **pval, const ASN1_ITEM *it)
     }
 }
 
-static int asn1_template_new(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt)
+static int asn1_template_new(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt,
+                             ASN1_ARENA *arena)
 {
     const ASN1_ITEM *it = ASN1_ITEM_ptr(tt->item);
     int embed = tt->flags & ASN1_TFLG_EMBED;
@@ -232,7 +246,7 @@ static int asn1_template_new(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt)
         goto done;
     }
     /* Otherwise pass it back to the item routine */
-    ret = asn1_item_embed_new(pval, it, embed);
+    ret = asn1_item_embed_new(pval, it, embed, arena);
  done:
 #ifndef OPENSSL_NO_CRYPTO_MDEBUG
     OPENSSL_mem_debug_pop();
@@ -255,7 +269,7 @@ static void asn1_template_clear(ASN1_VALUE **pval, const ASN1_TEMPLATE *tt)
  */
 
 static int asn1_primitive_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
-                              int embed)
+                              int embed, ASN1_ARENA *arena)
 {
     ASN1_TYPE *typ;
     ASN1_STRING *str;
@@ -294,7 +308,7 @@ static int asn1_primitive_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
         return 1;
 
     case V_ASN1_ANY:
-        typ = OPENSSL_malloc(sizeof(*typ));
+        typ = asn1_arena_malloc(arena, sizeof(*typ));
         if (typ == NULL)
             return 0;
         typ->value.ptr = NULL;
@@ -308,6 +322,11 @@ static int asn1_primitive_new(ASN1_VALUE **pval, const ASN1_ITEM *it,
             memset(str, 0, sizeof(*str));
             str->type = utype;
             str->flags = ASN1_STRING_FLAG_EMBED;
+        } else if (arena != NULL) {
+            str = asn1_arena_zalloc(arena, sizeof(*str));
+            if (str != NULL)
+                str->type = utype;
+            *pval = (ASN1_VALUE *)str;
         } else {
             str = ASN1_STRING_type_new(utype);
             *pval = (ASN1_VALUE *)str;
@@ -111,12 +111,13 @@ void asn1_enc_init(ASN1_VALUE **pval, const ASN1_ITEM *it)
     }
 }
 
-void asn1_enc_free(ASN1_VALUE **pval, const ASN1_ITEM *it)
+void asn1_enc_free(ASN1_VALUE **pval, const ASN1_ITEM *it,
+                   const ASN1_ARENA *arena)
 {
     ASN1_ENCODING *enc;
     enc = asn1_get_enc_ptr(pval, it);
     if (enc) {
-        OPENSSL_free(enc->enc);
+        asn1_arena_free(arena, enc->enc);
         enc->enc = NULL;
         enc->len = 0;
         enc->modified = 1;
@@ -124,15 +125,15 @@ void asn1_enc_free(ASN1_VALUE **pval, const ASN1_ITEM *it)
 }
 
 int asn1_enc_save(ASN1_VALUE **pval, const unsigned char *in, int inlen,
-                  const ASN1_ITEM *it)
+                  const ASN1_ITEM *it, ASN1_ARENA *arena)
 {
     ASN1_ENCODING *enc;
     enc = asn1_get_enc_ptr(pval, it);
     if (!enc)
         return 1;
 
-    OPENSSL_free(enc->enc);
-    enc->enc = OPENSSL_malloc(inlen);
+    asn1_arena_free(arena, enc->enc);
+    enc->enc = asn1_arena_malloc(arena, inlen);
     if (enc->enc == NULL)
         return 0;
     memcpy(enc->enc, in, inlen);
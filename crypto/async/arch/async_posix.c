@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -13,10 +13,161 @@
 #ifdef ASYNC_POSIX
 
 # include <stddef.h>
+# include <string.h>
 # include <unistd.h>
 
 #define STACKSIZE       32768
 
+void async_local_cleanup(void)
+{
+}
+
+# ifdef ASYNC_POSIX_SWITCH
+
+/*
+ * async_fibre_switch(save_sp, sp) pushes the registers the ABI requires a
+ * function to preserve onto the current stack, stores the stack pointer in
+ * |*save_sp|, and then does the reverse from |sp|.  Unlike swapcontext() it
+ * leaves the signal mask alone, so a switch makes no system call.
+ *
+ * A new fibre's stack is set up by async_fibre_makecontext() to look as if
+ * it had been switched out just before calling async_start_func().
+ */
+#  if defined(__x86_64__)
+
+/* rbp, rbx, r12-r15, then MXCSR and the x87 control word */
+#   define SWITCH_FRAME_SIZE    (7 * 8)
+
+__asm__(
+    ".text\n"
+    ".globl async_fibre_switch\n"
+    ".hidden async_fibre_switch\n"
+    ".type async_fibre_switch,@function\n"
+    ".align 16\n"
+    "async_fibre_switch:\n"
+    "   pushq %rbp\n"
+    "   pushq %rbx\n"
+    "   pushq %r12\n"
+    "   pushq %r13\n"
+    "   pushq %r14\n"
+    "   pushq %r15\n"
+    "   subq $8, %rsp\n"
+    "   stmxcsr (%rsp)\n"
+    "   fnstcw 4(%rsp)\n"
+    "   movq %rsp, (%rdi)\n"
+    "   movq %rsi, %rsp\n"
+    "   ldmxcsr (%rsp)\n"
+    "   fldcw 4(%rsp)\n"
+    "   addq $8, %rsp\n"
+    "   popq %r15\n"
+    "   popq %r14\n"
+    "   popq %r13\n"
+    "   popq %r12\n"
+    "   popq %rbx\n"
+    "   popq %rbp\n"
+    "   ret\n"
+    ".size async_fibre_switch,.-async_fibre_switch\n"
+);
+
+static void *switch_frame_init(unsigned char *top)
+{
+    uint64_t *sp = (uint64_t *)top;
+    uint32_t *fpctl;
+
+    /*
+     * async_start_func() never returns, but is entered with the stack
+     * aligned as if called, with a zero return address above it.
+     */
+    *--sp = 0;
+    *--sp = (uint64_t)(uintptr_t)async_start_func;
+    sp -= SWITCH_FRAME_SIZE / 8;
+    memset(sp, 0, SWITCH_FRAME_SIZE);
+    fpctl = (uint32_t *)sp;
+    fpctl[0] = 0x1f80;          /* default MXCSR */
+    fpctl[1] = 0x037f;          /* default x87 control word */
+    return sp;
+}
+
+#  elif defined(__aarch64__)
+
+/* x19-x28, x29 (fp), x30 (lr) and d8-d15 */
+#   define SWITCH_FRAME_SIZE    (20 * 8)
+
+__asm__(
+    ".text\n"
+    ".globl async_fibre_switch\n"
+    ".hidden async_fibre_switch\n"
+    ".type async_fibre_switch,%function\n"
+    ".align 4\n"
+    "async_fibre_switch:\n"
+    "   sub sp, sp, #160\n"
+    "   stp x19, x20, [sp, #0]\n"
+    "   stp x21, x22, [sp, #16]\n"
+    "   stp x23, x24, [sp, #32]\n"
+    "   stp x25, x26, [sp, #48]\n"
+    "   stp x27, x28, [sp, #64]\n"
+    "   stp x29, x30, [sp, #80]\n"
+    "   stp d8, d9, [sp, #96]\n"
+    "   stp d10, d11, [sp, #112]\n"
+    "   stp d12, d13, [sp, #128]\n"
+    "   stp d14, d15, [sp, #144]\n"
+    "   mov x2, sp\n"
+    "   str x2, [x0]\n"
+    "   mov sp, x1\n"
+    "   ldp x19, x20, [sp, #0]\n"
+    "   ldp x21, x22, [sp, #16]\n"
+    "   ldp x23, x24, [sp, #32]\n"
+    "   ldp x25, x26, [sp, #48]\n"
+    "   ldp x27, x28, [sp, #64]\n"
+    "   ldp x29, x30, [sp, #80]\n"
+    "   ldp d8, d9, [sp, #96]\n"
+    "   ldp d10, d11, [sp, #112]\n"
+    "   ldp d12, d13, [sp, #128]\n"
+    "   ldp d14, d15, [sp, #144]\n"
+    "   add sp, sp, #160\n"
+    "   ret\n"
+    ".size async_fibre_switch,.-async_fibre_switch\n"
+);
+
+static void *switch_frame_init(unsigned char *top)
+{
+    uint64_t *sp = (uint64_t *)(top - SWITCH_FRAME_SIZE);
+
+    /* Return to async_start_func() with a zero frame pointer */
+    memset(sp, 0, SWITCH_FRAME_SIZE);
+    sp[11] = (uint64_t)(uintptr_t)async_start_func;
+    return sp;
+}
+
+#  endif
+
+int ASYNC_is_capable(void)
+{
+    return 1;
+}
+
+int async_fibre_makecontext(async_fibre *fibre)
+{
+    size_t size = async_stack_size != 0 ? async_stack_size : STACKSIZE;
+
+    fibre->sp = NULL;
+    fibre->stack = OPENSSL_malloc(size);
+    if (fibre->stack == NULL)
+        return 0;
+    /* Both ABIs want the stack 16 byte aligned */
+    fibre->sp = switch_frame_init((unsigned char *)
+                                  (((uintptr_t)fibre->stack + size) & ~15));
+    return 1;
+}
+
+void async_fibre_free(async_fibre *fibre)
+{
+    OPENSSL_free(fibre->stack);
+    fibre->stack = NULL;
+}
+
+# else
+
 int ASYNC_is_capable(void)
 {
     ucontext_t ctx;
@@ -28,17 +179,15 @@ int ASYNC_is_capable(void)
     return getcontext(&ctx) == 0;
 }
 
-void async_local_cleanup(void)
-{
-}
-
 int async_fibre_makecontext(async_fibre *fibre)
 {
+    size_t size = async_stack_size != 0 ? async_stack_size : STACKSIZE;
+
     fibre->env_init = 0;
     if (getcontext(&fibre->fibre) == 0) {
-        fibre->fibre.uc_stack.ss_sp = OPENSSL_malloc(STACKSIZE);
+        fibre->fibre.uc_stack.ss_sp = OPENSSL_malloc(size);
         if (fibre->fibre.uc_stack.ss_sp != NULL) {
-            fibre->fibre.uc_stack.ss_size = STACKSIZE;
+            fibre->fibre.uc_stack.ss_size = size;
             fibre->fibre.uc_link = NULL;
             makecontext(&fibre->fibre, async_start_func, 0);
             return 1;
@@ -55,4 +204,6 @@ void async_fibre_free(async_fibre *fibre)
     fibre->fibre.uc_stack.ss_sp = NULL;
 }
 
+# endif
+
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -24,10 +24,40 @@
 #  define ASYNC_POSIX
 #  define ASYNC_ARCH
 
-#  include <ucontext.h>
-#  include <setjmp.h>
+/*
+ * On x86_64 and aarch64 ELF platforms fibres are switched by saving and
+ * restoring the callee-saved registers on the stack, see async_posix.c.
+ * Elsewhere ucontext is used to create them and _setjmp/_longjmp to switch
+ * between them.
+ */
+#  if defined(__GNUC__) && defined(__ELF__) && !defined(__CET__) \
+      && (defined(__x86_64__) || defined(__aarch64__)) \
+      && !defined(OPENSSL_ASYNC_UCONTEXT)
+#   define ASYNC_POSIX_SWITCH
+#  endif
+
 #  include "e_os.h"
 
+#  ifdef ASYNC_POSIX_SWITCH
+
+typedef struct async_fibre_st {
+    void *sp;                   /* saved stack pointer while switched out */
+    unsigned char *stack;       /* NULL for the dispatcher */
+} async_fibre;
+
+void async_fibre_switch(void **save_sp, void *sp);
+
+static ossl_inline int async_fibre_swapcontext(async_fibre *o, async_fibre *n, int r)
+{
+    async_fibre_switch(&o->sp, n->sp);
+    return 1;
+}
+
+#  else
+
+#   include <ucontext.h>
+#   include <setjmp.h>
+
 typedef struct async_fibre_st {
     ucontext_t fibre;
     jmp_buf env;
@@ -48,6 +78,8 @@ static ossl_inline int async_fibre_swapcontext(async_fibre *o, async_fibre *n, i
     return 1;
 }
 
+#  endif
+
 #  define async_fibre_init_dispatcher(d)
 
 int async_fibre_makecontext(async_fibre *fibre);
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -30,6 +30,8 @@
 static CRYPTO_THREAD_LOCAL ctxkey;
 static CRYPTO_THREAD_LOCAL poolkey;
 
+size_t async_stack_size = 0;
+
 static void async_free_pool_internal(async_pool *pool);
 
 static async_ctx *async_ctx_new(void)
@@ -373,6 +375,16 @@ err:
     return 0;
 }
 
+int ASYNC_set_stack_size(size_t size)
+{
+    if (size != 0 && size < ASYNC_MIN_STACK_SIZE) {
+        ASYNCerr(ASYNC_F_ASYNC_SET_STACK_SIZE, ASYNC_R_INVALID_STACK_SIZE);
+        return 0;
+    }
+    async_stack_size = size;
+    return 1;
+}
+
 static void async_free_pool_internal(async_pool *pool)
 {
     if (pool == NULL)
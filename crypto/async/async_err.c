@@ -19,6 +19,8 @@ static const ERR_STRING_DATA ASYNC_str_functs[] = {
      "ASYNC_init_thread"},
     {ERR_PACK(ERR_LIB_ASYNC, ASYNC_F_ASYNC_JOB_NEW, 0), "async_job_new"},
     {ERR_PACK(ERR_LIB_ASYNC, ASYNC_F_ASYNC_PAUSE_JOB, 0), "ASYNC_pause_job"},
+    {ERR_PACK(ERR_LIB_ASYNC, ASYNC_F_ASYNC_SET_STACK_SIZE, 0),
+     "ASYNC_set_stack_size"},
     {ERR_PACK(ERR_LIB_ASYNC, ASYNC_F_ASYNC_START_FUNC, 0), "async_start_func"},
     {ERR_PACK(ERR_LIB_ASYNC, ASYNC_F_ASYNC_START_JOB, 0), "ASYNC_start_job"},
     {0, NULL}
@@ -32,6 +34,8 @@ static const ERR_STRING_DATA ASYNC_str_reasons[] = {
     {ERR_PACK(ERR_LIB_ASYNC, 0, ASYNC_R_INIT_FAILED), "init failed"},
     {ERR_PACK(ERR_LIB_ASYNC, 0, ASYNC_R_INVALID_POOL_SIZE),
     "invalid pool size"},
+    {ERR_PACK(ERR_LIB_ASYNC, 0, ASYNC_R_INVALID_STACK_SIZE),
+    "invalid stack size"},
     {0, NULL}
 };
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -59,6 +59,9 @@ struct async_wait_ctx_st {
     struct fd_lookup_st *fds;
     size_t numadd;
     size_t numdel;
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    int status;
 };
 
 DEFINE_STACK_OF(ASYNC_JOB)
@@ -69,6 +72,10 @@ struct async_pool_st {
     size_t max_size;
 };
 
+/* Stack size for new jobs, 0 for the platform's default */
+extern size_t async_stack_size;
+# define ASYNC_MIN_STACK_SIZE    16384
+
 void async_local_cleanup(void);
 void async_start_func(void);
 async_ctx *async_get_ctx(void);
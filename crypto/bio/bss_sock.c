@@ -16,6 +16,7 @@
 #ifndef OPENSSL_NO_SOCK
 
 # include <openssl/bio.h>
+# include "internal/ktls.h"
 
 # ifdef WATT32
 /* Watt-32 uses same names */
@@ -97,7 +98,10 @@ static int sock_read(BIO *b, char *out, int outl)
 
     if (out != NULL) {
         clear_socket_error();
-        ret = readsocket(b->num, out, outl);
+        if (BIO_test_flags(b, BIO_FLAGS_KTLS_RX))
+            ret = ktls_read_record(b->num, out, outl);
+        else
+            ret = readsocket(b->num, out, outl);
         BIO_clear_retry_flags(b);
         if (ret <= 0) {
             if (BIO_sock_should_retry(ret))
@@ -112,7 +116,17 @@ static int sock_write(BIO *b, const char *in, int inl)
     int ret;
 
     clear_socket_error();
-    ret = writesocket(b->num, in, inl);
+    if (BIO_test_flags(b, BIO_FLAGS_KTLS_TX_CTRL_MSG)) {
+        unsigned char record_type = (unsigned char)(size_t)b->ptr;
+
+        ret = ktls_send_ctrl_message(b->num, record_type, in, inl);
+        if (ret >= 0) {
+            ret = inl;
+            BIO_clear_flags(b, BIO_FLAGS_KTLS_TX_CTRL_MSG);
+        }
+    } else {
+        ret = writesocket(b->num, in, inl);
+    }
     BIO_clear_retry_flags(b);
     if (ret <= 0) {
         if (BIO_sock_should_retry(ret))
@@ -129,6 +143,8 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
     switch (cmd) {
     case BIO_C_SET_FD:
         sock_free(b);
+        BIO_clear_flags(b, BIO_FLAGS_KTLS_TX | BIO_FLAGS_KTLS_RX
+                           | BIO_FLAGS_KTLS_TX_CTRL_MSG);
         b->num = *((int *)ptr);
         b->shutdown = (int)num;
         b->init = 1;
@@ -152,6 +168,22 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
     case BIO_CTRL_FLUSH:
         ret = 1;
         break;
+    case BIO_CTRL_SET_KTLS:
+        ret = b->init && ktls_start(b->num, ptr, (int)num);
+        if (ret)
+            BIO_set_flags(b, num ? BIO_FLAGS_KTLS_TX : BIO_FLAGS_KTLS_RX);
+        break;
+    case BIO_CTRL_GET_KTLS_SEND:
+        ret = BIO_test_flags(b, BIO_FLAGS_KTLS_TX) != 0;
+        break;
+    case BIO_CTRL_GET_KTLS_RECV:
+        ret = BIO_test_flags(b, BIO_FLAGS_KTLS_RX) != 0;
+        break;
+    case BIO_CTRL_SET_KTLS_TX_CTRL_MSG:
+        BIO_set_flags(b, BIO_FLAGS_KTLS_TX_CTRL_MSG);
+        b->ptr = (void *)(size_t)num;
+        ret = 0;
+        break;
     default:
         ret = 0;
         break;
@@ -388,7 +388,7 @@ void ERR_put_error(int lib, int func, int reason, const char *file, int line)
     }
 #endif
     es = ERR_get_state();
-    if (es == NULL)
+    if (es == NULL || es->suppress > 0)
         return;
 
     es->top = (es->top + 1) % ERR_NUM_ERRORS;
@@ -727,6 +727,11 @@ void ERR_set_error_data(char *data, int flags)
     es = ERR_get_state();
     if (es == NULL)
         return;
+    if (es->suppress > 0) {
+        if (flags & ERR_TXT_MALLOCED)
+            OPENSSL_free(data);
+        return;
+    }
 
     i = es->top;
     if (i == 0)
@@ -749,6 +754,12 @@ void ERR_add_error_vdata(int num, va_list args)
 {
     int i, n, s;
     char *str, *p, *a;
+    ERR_STATE *es;
+
+    /* Don't bother building the string if it is going to be dropped */
+    es = ERR_get_state();
+    if (es == NULL || es->suppress > 0)
+        return;
 
     s = 80;
     str = OPENSSL_malloc(s + 1);
@@ -811,3 +822,27 @@ int ERR_pop_to_mark(void)
     es->err_flags[es->top] &= ~ERR_FLAG_MARK;
     return 1;
 }
+
+int ERR_set_suppress_mark(void)
+{
+    ERR_STATE *es;
+
+    es = ERR_get_state();
+    if (es == NULL)
+        return 0;
+
+    es->suppress++;
+    return 1;
+}
+
+int ERR_pop_suppress_mark(void)
+{
+    ERR_STATE *es;
+
+    es = ERR_get_state();
+    if (es == NULL || es->suppress == 0)
+        return 0;
+
+    es->suppress--;
+    return 1;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "internal/cryptlib.h"
+#include <openssl/evp.h>
+#include <openssl/engine.h>
+#include "internal/evp_int.h"
+
+#if     defined(SHA256_ASM) &&  ( \
+        defined(__x86_64)       || defined(__x86_64__)  || \
+        defined(_M_AMD64)       || defined(_M_X64)      )
+# define SHA_MULTI_BLOCK
+#endif
+
+#ifdef SHA_MULTI_BLOCK
+
+extern unsigned int OPENSSL_ia32cap_P[];
+# define SSSE3_CAPABLE   (1<<(41-32))
+
+/*
+ * The multi-block routines hash up to eight independent streams at once.
+ * Their context holds each chaining word for all eight lanes side by side,
+ * so SHA1_MB_CTX and SHA256_MB_CTX both fit in MB_CTX.
+ */
+typedef struct {
+    unsigned int A[8], B[8], C[8], D[8], E[8];
+} SHA1_MB_CTX;
+typedef struct {
+    unsigned int A[8], B[8], C[8], D[8], E[8], F[8], G[8], H[8];
+} SHA256_MB_CTX;
+typedef struct {
+    const unsigned char *ptr;
+    int blocks;
+} HASH_DESC;
+
+void sha1_multi_block(SHA1_MB_CTX *, const HASH_DESC *, int);
+void sha256_multi_block(SHA256_MB_CTX *, const HASH_DESC *, int);
+
+typedef struct {
+    unsigned int h[8][8];
+} MB_CTX;
+
+# define MB_LANES        8
+# define MB_CBLOCK       64
+/* Upper bound on the blocks handed to the assembler in one call */
+# define MB_MAX_STEP     (1 << 16)
+
+typedef struct {
+    int words;                  /* chaining words */
+    int md_words;               /* words in the digest */
+    unsigned int iv[8];
+    void (*block) (MB_CTX *ctx, const HASH_DESC *desc, int n4x);
+} MB_METHOD;
+
+static void sha1_mb_block(MB_CTX *ctx, const HASH_DESC *desc, int n4x)
+{
+    sha1_multi_block((SHA1_MB_CTX *)ctx, desc, n4x);
+}
+
+static void sha256_mb_block(MB_CTX *ctx, const HASH_DESC *desc, int n4x)
+{
+    sha256_multi_block((SHA256_MB_CTX *)ctx, desc, n4x);
+}
+
+static const MB_METHOD sha1_mb = {
+    5, 5,
+    {0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U, 0xc3d2e1f0U},
+    sha1_mb_block
+};
+
+static const MB_METHOD sha224_mb = {
+    8, 7,
+    {0xc1059ed8U, 0x367cd507U, 0x3070dd17U, 0xf70e5939U,
+     0xffc00b31U, 0x68581511U, 0x64f98fa7U, 0xbefa4fa4U},
+    sha256_mb_block
+};
+
+static const MB_METHOD sha256_mb = {
+    8, 8,
+    {0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+     0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U},
+    sha256_mb_block
+};
+
+/*
+ * One lane works through the whole blocks of its message straight from the
+ * caller's buffer and then through the padded tail, which is assembled in
+ * |tail|.
+ */
+typedef struct {
+    size_t msg;
+    const unsigned char *ptr;
+    size_t blocks;
+    size_t tail_blocks;
+    int in_tail;
+    unsigned char tail[2 * MB_CBLOCK];
+} MB_LANE;
+
+static void mb_lane_start(const MB_METHOD *meth, MB_CTX *ctx, MB_LANE *lane,
+                          int i, size_t msg, const unsigned char *in,
+                          size_t len)
+{
+    size_t full = len / MB_CBLOCK, rem = len % MB_CBLOCK;
+    size_t tlen = rem < MB_CBLOCK - 8 ? MB_CBLOCK : 2 * MB_CBLOCK;
+    uint64_t bits = (uint64_t)len << 3;
+    int w;
+
+    for (w = 0; w < meth->words; w++)
+        ctx->h[w][i] = meth->iv[w];
+
+    memcpy(lane->tail, in + full * MB_CBLOCK, rem);
+    lane->tail[rem] = 0x80;
+    memset(lane->tail + rem + 1, 0, tlen - rem - 1 - 8);
+    for (w = 1; w <= 8; w++, bits >>= 8)
+        lane->tail[tlen - w] = (unsigned char)bits;
+
+    lane->msg = msg;
+    lane->tail_blocks = tlen / MB_CBLOCK;
+    if (full > 0) {
+        lane->ptr = in;
+        lane->blocks = full;
+        lane->in_tail = 0;
+    } else {
+        lane->ptr = lane->tail;
+        lane->blocks = lane->tail_blocks;
+        lane->in_tail = 1;
+    }
+}
+
+static void mb_lane_move(const MB_METHOD *meth, MB_CTX *ctx, MB_LANE *lanes,
+                         int to, int from)
+{
+    MB_LANE *dst = &lanes[to], *src = &lanes[from];
+    int w;
+
+    for (w = 0; w < meth->words; w++)
+        ctx->h[w][to] = ctx->h[w][from];
+    *dst = *src;
+    if (src->in_tail)
+        dst->ptr = dst->tail + (src->ptr - src->tail);
+}
+
+static int digest_batch_mb(const MB_METHOD *meth, const void **in,
+                           const size_t *lens, size_t n, unsigned char *out,
+                           size_t mdsize)
+{
+    unsigned char storage[sizeof(MB_CTX) + 32];
+    MB_CTX *ctx;
+    MB_LANE lanes[MB_LANES];
+    HASH_DESC desc[MB_LANES];
+    size_t next = 0, step;
+    int i, w, nactive = 0;
+
+    /* align */
+    ctx = (MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+
+    for (; nactive < MB_LANES && next < n; nactive++, next++)
+        mb_lane_start(meth, ctx, &lanes[nactive], nactive, next, in[next],
+                      lens[next]);
+
+    /*
+     * Active lanes are kept at the bottom of the context: the assembler
+     * stops at the first group of four lanes that has nothing to do.
+     */
+    while (nactive > 0) {
+        step = MB_MAX_STEP;
+        for (i = 0; i < nactive; i++)
+            if (lanes[i].blocks < step)
+                step = lanes[i].blocks;
+        for (i = 0; i < MB_LANES; i++) {
+            desc[i].ptr = i < nactive ? lanes[i].ptr : NULL;
+            desc[i].blocks = i < nactive ? (int)step : 0;
+        }
+
+        meth->block(ctx, desc, nactive > 4 ? 2 : 1);
+
+        for (i = 0; i < nactive;) {
+            MB_LANE *lane = &lanes[i];
+            unsigned char *md;
+
+            lane->ptr += step * MB_CBLOCK;
+            lane->blocks -= step;
+            if (lane->blocks > 0) {
+                i++;
+                continue;
+            }
+            if (!lane->in_tail) {
+                lane->ptr = lane->tail;
+                lane->blocks = lane->tail_blocks;
+                lane->in_tail = 1;
+                i++;
+                continue;
+            }
+
+            md = out + lane->msg * mdsize;
+            for (w = 0; w < meth->md_words; w++, md += 4) {
+                unsigned int h = ctx->h[w][i];
+
+                md[0] = (unsigned char)(h >> 24);
+                md[1] = (unsigned char)(h >> 16);
+                md[2] = (unsigned char)(h >> 8);
+                md[3] = (unsigned char)h;
+            }
+
+            if (next < n) {
+                mb_lane_start(meth, ctx, lane, i, next, in[next], lens[next]);
+                next++;
+                i++;
+            } else if (i != --nactive) {
+                /* the moved lane has not been advanced yet, look at it now */
+                mb_lane_move(meth, ctx, lanes, i, nactive);
+            }
+        }
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(lanes, sizeof(lanes));
+    return 1;
+}
+
+static const MB_METHOD *digest_batch_method(const EVP_MD *type, size_t n)
+{
+    if (n < 2 || !(OPENSSL_ia32cap_P[1] & SSSE3_CAPABLE))
+        return NULL;
+# ifndef OPENSSL_NO_ENGINE
+    {
+        /* Leave digests taken over by an ENGINE to the ENGINE */
+        ENGINE *e = ENGINE_get_digest_engine(EVP_MD_type(type));
+
+        if (e != NULL) {
+            ENGINE_finish(e);
+            return NULL;
+        }
+    }
+# endif
+    if (type == EVP_sha1())
+        return &sha1_mb;
+    if (type == EVP_sha224())
+        return &sha224_mb;
+    if (type == EVP_sha256())
+        return &sha256_mb;
+    return NULL;
+}
+#endif
+
+int EVP_DigestBatch(const EVP_MD *type, const void **in, const size_t *lens,
+                    size_t n, unsigned char *out)
+{
+    EVP_MD_CTX *ctx;
+    size_t i, mdsize;
+    int ret = 0;
+
+    if (n == 0)
+        return 1;
+    mdsize = EVP_MD_size(type);
+
+#ifdef SHA_MULTI_BLOCK
+    {
+        const MB_METHOD *meth = digest_batch_method(type, n);
+
+        if (meth != NULL)
+            return digest_batch_mb(meth, in, lens, n, out, mdsize);
+    }
+#endif
+
+    if ((ctx = EVP_MD_CTX_new()) == NULL)
+        return 0;
+    for (i = 0; i < n; i++) {
+        if (!EVP_DigestInit_ex(ctx, type, NULL)
+                || !EVP_DigestUpdate(ctx, in[i], lens[i])
+                || !EVP_DigestFinal_ex(ctx, out + i * mdsize, NULL))
+            goto err;
+    }
+    ret = 1;
+ err:
+    EVP_MD_CTX_free(ctx);
+    return ret;
+}
@@ -84,6 +84,8 @@ struct X509_crl_info_st {
     ASN1_ENCODING enc;                      /* encoding of signed portion of CRL */
 };
 
+typedef struct x509_crl_index_st X509_CRL_INDEX;
+
 struct X509_crl_st {
     X509_CRL_INFO crl;          /* signed CRL data */
     X509_ALGOR sig_alg;         /* CRL signature algorithm */
@@ -109,6 +111,8 @@ struct X509_crl_st {
     const X509_CRL_METHOD *meth;
     void *meth_data;
     CRYPTO_RWLOCK *lock;
+    /* revoked entries left encoded by d2i_X509_CRL_indexed() */
+    X509_CRL_INDEX *index;
 };
 
 struct x509_revoked_st {
@@ -281,5 +285,6 @@ struct x509_object_st {
 
 int a2i_ipadd(unsigned char *ipout, const char *ipasc);
 int x509_set1_time(ASN1_TIME **ptm, const ASN1_TIME *tm);
+int x509_crl_unindex(X509_CRL *crl);
 
 void x509_init_sig_info(X509 *x);
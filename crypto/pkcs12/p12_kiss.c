@@ -85,12 +85,12 @@ int PKCS12_parse(PKCS12 *p12, const char *pass, EVP_PKEY **pkey, X509 **cert,
 
     while ((x = sk_X509_pop(ocerts))) {
         if (pkey && *pkey && cert && !*cert) {
-            ERR_set_mark();
+            ERR_set_suppress_mark();
             if (X509_check_private_key(x, *pkey)) {
                 *cert = x;
                 x = NULL;
             }
-            ERR_pop_to_mark();
+            ERR_pop_suppress_mark();
         }
 
         if (ca && x) {
@@ -0,0 +1,457 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include "internal/cryptlib.h"
+#include "internal/cryptlib_int.h"
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/async.h>
+#include "internal/thread_once.h"
+#include "internal/rand.h"
+#include "rand_lcl.h"
+
+#if !defined(OPENSSL_SYS_WINDOWS) && !defined(GETPID_IS_MEANINGLESS)
+# include <unistd.h>
+#endif
+
+#if defined(BN_DEBUG) || defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
+# define PREDICT 1
+extern int rand_predictable;
+#endif
+
+/*
+ * The DRBG hierarchy: a single master DRBG, seeded from the entropy pool
+ * in ossl_rand.c (which in turn is fed by RAND_poll() and RAND_add()), and
+ * one DRBG per thread that is seeded from the master.  Only the master is
+ * shared and needs locking; the per-thread DRBGs serve RAND_bytes() without
+ * taking any lock until they need to reseed.
+ */
+
+static const char ossl_pers_string[] = "OpenSSL NIST SP 800-90A DRBG";
+
+static RAND_DRBG *drbg_master = NULL;
+static CRYPTO_THREAD_LOCAL private_drbg_key;
+static CRYPTO_RWLOCK *rand_add_lock = NULL;
+static int drbg_inited = 0;
+static CRYPTO_ONCE rand_drbg_init = CRYPTO_ONCE_STATIC_INIT;
+
+/*
+ * Bumped by every RAND_add()/RAND_seed() that claims entropy, so that all
+ * DRBGs reseed and pick up the new input from the entropy pool on their
+ * next request.
+ */
+static int rand_add_count = 0;
+
+DEFINE_RUN_ONCE_STATIC(do_rand_drbg_init)
+{
+    int ret = 1;
+
+    OPENSSL_init_crypto(0, NULL);
+    rand_add_lock = CRYPTO_THREAD_lock_new();
+    ret &= rand_add_lock != NULL;
+    ret &= CRYPTO_THREAD_init_local(&private_drbg_key, NULL) == 1;
+    if (ret) {
+        drbg_master = rand_drbg_new(NULL);
+        ret &= drbg_master != NULL;
+    }
+    drbg_inited = ret;
+    return ret;
+}
+
+/*
+ * Allocate a new DRBG.  A DRBG without a parent is seeded from the entropy
+ * pool and gets a lock of its own since it is shared between threads.
+ */
+RAND_DRBG *rand_drbg_new(RAND_DRBG *parent)
+{
+    RAND_DRBG *drbg = OPENSSL_zalloc(sizeof(*drbg));
+
+    if (drbg == NULL) {
+        RANDerr(RAND_F_RAND_DRBG_NEW, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if (!ctr_init(drbg)) {
+        RANDerr(RAND_F_RAND_DRBG_NEW, ERR_R_EVP_LIB);
+        OPENSSL_free(drbg);
+        return NULL;
+    }
+    drbg->parent = parent;
+    drbg->state = DRBG_UNINITIALISED;
+    if (parent == NULL) {
+        drbg->reseed_interval = MASTER_RESEED_INTERVAL;
+        drbg->lock = CRYPTO_THREAD_lock_new();
+        if (drbg->lock == NULL) {
+            RANDerr(RAND_F_RAND_DRBG_NEW, ERR_R_MALLOC_FAILURE);
+            rand_drbg_free(drbg);
+            return NULL;
+        }
+    } else {
+        drbg->reseed_interval = SLAVE_RESEED_INTERVAL;
+    }
+    return drbg;
+}
+
+void rand_drbg_free(RAND_DRBG *drbg)
+{
+    if (drbg == NULL)
+        return;
+
+    ctr_uninstantiate(drbg);
+    CRYPTO_THREAD_lock_free(drbg->lock);
+    OPENSSL_clear_free(drbg, sizeof(*drbg));
+}
+
+/*
+ * Set the number of generate requests after which |drbg| reseeds itself.
+ * An interval of 0 means the DRBG is reseeded before every request.
+ */
+int rand_drbg_set_reseed_interval(RAND_DRBG *drbg, unsigned int interval)
+{
+    if (interval > MAX_RESEED_INTERVAL)
+        return 0;
+    drbg->reseed_interval = interval;
+    return 1;
+}
+
+/*
+ * Fill |out| with |outlen| bytes of seed material for |drbg|: from the
+ * entropy pool for the master, from the parent DRBG otherwise.
+ */
+static int drbg_get_entropy(RAND_DRBG *drbg, unsigned char *out,
+                            size_t outlen)
+{
+    RAND_DRBG *parent = drbg->parent;
+    int ret;
+
+    drbg->add_count = rand_add_count;
+    if (parent == NULL)
+        return openssl_rand_meth.bytes(out, (int)outlen) == 1;
+
+    if (parent->lock != NULL) {
+        CRYPTO_THREAD_write_lock(parent->lock);
+        /* Don't pause an ASYNC_JOB while the parent is locked */
+        ASYNC_block_pause();
+    }
+    ret = rand_drbg_generate(parent, out, outlen, NULL, 0);
+    drbg->parent_reseed_count = parent->reseed_count;
+    if (parent->lock != NULL) {
+        ASYNC_unblock_pause();
+        CRYPTO_THREAD_unlock(parent->lock);
+    }
+    return ret;
+}
+
+static void drbg_seeded(RAND_DRBG *drbg)
+{
+    drbg->state = DRBG_READY;
+    drbg->generate_counter = 0;
+    drbg->reseed_count++;
+#ifndef GETPID_IS_MEANINGLESS
+    drbg->pid = getpid();
+#endif
+}
+
+/*
+ * Instantiate |drbg| with fresh entropy and nonce, see SP 800-90A 9.1.
+ * The caller must hold drbg->lock if the DRBG is shared.
+ */
+int rand_drbg_instantiate(RAND_DRBG *drbg,
+                          const unsigned char *pers, size_t perslen)
+{
+    unsigned char seed[DRBG_ENTROPY_LEN + DRBG_NONCE_LEN];
+    int ret = 0;
+
+    if (perslen > DRBG_MAX_INPUT_LEN) {
+        RANDerr(RAND_F_RAND_DRBG_INSTANTIATE,
+                RAND_R_PERSONALISATION_STRING_TOO_LONG);
+        return 0;
+    }
+    if (drbg->state != DRBG_UNINITIALISED) {
+        RANDerr(RAND_F_RAND_DRBG_INSTANTIATE,
+                drbg->state == DRBG_ERROR ? RAND_R_IN_ERROR_STATE
+                                          : RAND_R_ALREADY_INSTANTIATED);
+        return 0;
+    }
+
+    if (!drbg_get_entropy(drbg, seed, sizeof(seed))) {
+        RANDerr(RAND_F_RAND_DRBG_INSTANTIATE, RAND_R_ERROR_RETRIEVING_ENTROPY);
+        goto end;
+    }
+    if (!ctr_instantiate(drbg, seed, DRBG_ENTROPY_LEN,
+                         seed + DRBG_ENTROPY_LEN, DRBG_NONCE_LEN,
+                         pers, perslen)) {
+        drbg->state = DRBG_ERROR;
+        RANDerr(RAND_F_RAND_DRBG_INSTANTIATE, RAND_R_ERROR_INSTANTIATING_DRBG);
+        goto end;
+    }
+    drbg_seeded(drbg);
+    ret = 1;
+
+ end:
+    OPENSSL_cleanse(seed, sizeof(seed));
+    return ret;
+}
+
+/*
+ * Reseed |drbg| with fresh entropy, see SP 800-90A 9.2.
+ * The caller must hold drbg->lock if the DRBG is shared.
+ */
+int rand_drbg_reseed(RAND_DRBG *drbg,
+                     const unsigned char *adin, size_t adinlen)
+{
+    unsigned char entropy[DRBG_ENTROPY_LEN];
+    int ret = 0;
+
+    if (drbg->state != DRBG_READY) {
+        RANDerr(RAND_F_RAND_DRBG_RESEED,
+                drbg->state == DRBG_ERROR ? RAND_R_IN_ERROR_STATE
+                                          : RAND_R_NOT_INSTANTIATED);
+        return 0;
+    }
+    if (adin == NULL)
+        adinlen = 0;
+    else if (adinlen > DRBG_MAX_INPUT_LEN) {
+        RANDerr(RAND_F_RAND_DRBG_RESEED, RAND_R_ADDITIONAL_INPUT_TOO_LONG);
+        return 0;
+    }
+
+    if (!drbg_get_entropy(drbg, entropy, sizeof(entropy))) {
+        RANDerr(RAND_F_RAND_DRBG_RESEED, RAND_R_ERROR_RETRIEVING_ENTROPY);
+        goto end;
+    }
+    if (!ctr_reseed(drbg, entropy, sizeof(entropy), adin, adinlen)) {
+        drbg->state = DRBG_ERROR;
+        RANDerr(RAND_F_RAND_DRBG_RESEED, RAND_R_RESEED_ERROR);
+        goto end;
+    }
+    drbg_seeded(drbg);
+    ret = 1;
+
+ end:
+    OPENSSL_cleanse(entropy, sizeof(entropy));
+    return ret;
+}
+
+/*
+ * Generate |outlen| random bytes into |out|, see SP 800-90A 9.3.
+ * Instantiates the DRBG on first use and reseeds it automatically once
+ * the reseed interval has passed, after a fork() or when the parent (or,
+ * for the master, the entropy pool) has been reseeded.
+ * The caller must hold drbg->lock if the DRBG is shared.
+ */
+int rand_drbg_generate(RAND_DRBG *drbg, unsigned char *out, size_t outlen,
+                       const unsigned char *adin, size_t adinlen)
+{
+    int reseed_required = 0;
+    int parent_reseed_count;
+
+    if (drbg->state == DRBG_ERROR) {
+        RANDerr(RAND_F_RAND_DRBG_GENERATE, RAND_R_IN_ERROR_STATE);
+        return 0;
+    }
+    if (drbg->state == DRBG_UNINITIALISED
+            && !rand_drbg_instantiate(drbg, (const unsigned char *)
+                                      ossl_pers_string,
+                                      sizeof(ossl_pers_string) - 1))
+        return 0;
+    if (outlen > DRBG_MAX_REQUEST) {
+        RANDerr(RAND_F_RAND_DRBG_GENERATE, RAND_R_REQUEST_TOO_LARGE_FOR_DRBG);
+        return 0;
+    }
+    if (adin == NULL)
+        adinlen = 0;
+    else if (adinlen > DRBG_MAX_INPUT_LEN) {
+        RANDerr(RAND_F_RAND_DRBG_GENERATE, RAND_R_ADDITIONAL_INPUT_TOO_LONG);
+        return 0;
+    }
+
+    if (drbg->generate_counter >= drbg->reseed_interval)
+        reseed_required = 1;
+#ifndef GETPID_IS_MEANINGLESS
+    /* Never let a parent and its child process share a DRBG state */
+    if (drbg->pid != getpid())
+        reseed_required = 1;
+#endif
+    if (drbg->add_count != rand_add_count)
+        reseed_required = 1;
+    /* The parent is shared, and we don't hold its lock */
+    if (drbg->parent != NULL
+            && (!CRYPTO_atomic_add(&drbg->parent->reseed_count, 0,
+                                   &parent_reseed_count, drbg->parent->lock)
+                || parent_reseed_count != drbg->parent_reseed_count))
+        reseed_required = 1;
+
+    if (reseed_required) {
+        if (!rand_drbg_reseed(drbg, adin, adinlen)) {
+            RANDerr(RAND_F_RAND_DRBG_GENERATE, RAND_R_RESEED_ERROR);
+            return 0;
+        }
+        /* The additional input has been consumed by the reseed */
+        adin = NULL;
+        adinlen = 0;
+    }
+
+    if (!ctr_generate(drbg, out, outlen, adin, adinlen)) {
+        drbg->state = DRBG_ERROR;
+        RANDerr(RAND_F_RAND_DRBG_GENERATE, RAND_R_GENERATE_ERROR);
+        return 0;
+    }
+    drbg->generate_counter++;
+    return 1;
+}
+
+RAND_DRBG *rand_drbg_get0_master(void)
+{
+    if (!RUN_ONCE(&rand_drbg_init, do_rand_drbg_init))
+        return NULL;
+    return drbg_master;
+}
+
+/*
+ * Return the calling thread's DRBG, creating it on first use.
+ */
+RAND_DRBG *rand_drbg_get0_thread(void)
+{
+    RAND_DRBG *drbg;
+
+    if (!RUN_ONCE(&rand_drbg_init, do_rand_drbg_init))
+        return NULL;
+
+    drbg = CRYPTO_THREAD_get_local(&private_drbg_key);
+    if (drbg == NULL) {
+        drbg = rand_drbg_new(drbg_master);
+        if (drbg == NULL)
+            return NULL;
+        if (!ossl_init_thread_start(OPENSSL_INIT_THREAD_RAND)
+                || !CRYPTO_THREAD_set_local(&private_drbg_key, drbg)) {
+            rand_drbg_free(drbg);
+            return NULL;
+        }
+    }
+    return drbg;
+}
+
+void rand_delete_thread_state(void)
+{
+    RAND_DRBG *drbg;
+
+    if (!drbg_inited)
+        return;
+
+    drbg = CRYPTO_THREAD_get_local(&private_drbg_key);
+    if (drbg == NULL)
+        return;
+
+    CRYPTO_THREAD_set_local(&private_drbg_key, NULL);
+    rand_drbg_free(drbg);
+}
+
+/*
+ * RAND_METHOD glue
+ */
+
+static int drbg_bytes(unsigned char *out, int count)
+{
+    RAND_DRBG *drbg;
+    size_t chunk;
+
+#ifdef PREDICT
+    if (rand_predictable)
+        return openssl_rand_meth.bytes(out, count);
+#endif
+
+    if (count <= 0)
+        return 1;
+
+    drbg = rand_drbg_get0_thread();
+    if (drbg == NULL)
+        return 0;
+
+    for ( ; count > 0; count -= chunk, out += chunk) {
+        chunk = count;
+        if (chunk > DRBG_MAX_REQUEST)
+            chunk = DRBG_MAX_REQUEST;
+        if (!rand_drbg_generate(drbg, out, chunk, NULL, 0))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Input that claims entropy goes to the entropy pool and makes every DRBG
+ * reseed.  Input without entropy (timestamps, digests, key material mixed
+ * in by the library) is only used as additional input to the calling
+ * thread's DRBG, which needs no locking.
+ */
+static int drbg_add(const void *buf, int num, double randomness)
+{
+    RAND_DRBG *drbg;
+    int dummy;
+
+    if (num <= 0)
+        return 1;
+
+    if (randomness > 0.0) {
+        if (!openssl_rand_meth.add(buf, num, randomness))
+            return 0;
+        if (!RUN_ONCE(&rand_drbg_init, do_rand_drbg_init))
+            return 0;
+        return CRYPTO_atomic_add(&rand_add_count, 1, &dummy, rand_add_lock);
+    }
+
+    drbg = rand_drbg_get0_thread();
+    if (drbg == NULL)
+        return 0;
+    /* Instantiation will take fresh entropy anyway */
+    if (drbg->state != DRBG_READY)
+        return 1;
+    if (num > DRBG_MAX_INPUT_LEN)
+        num = DRBG_MAX_INPUT_LEN;
+    return rand_drbg_generate(drbg, NULL, 0, buf, num);
+}
+
+static int drbg_seed(const void *buf, int num)
+{
+    return drbg_add(buf, num, (double)num);
+}
+
+static int drbg_status(void)
+{
+    return openssl_rand_meth.status();
+}
+
+RAND_METHOD *RAND_OpenSSL(void)
+{
+    return &rand_drbg_meth;
+}
+
+static void drbg_cleanup(void)
+{
+    if (drbg_inited) {
+        rand_delete_thread_state();
+        CRYPTO_THREAD_cleanup_local(&private_drbg_key);
+        rand_drbg_free(drbg_master);
+        drbg_master = NULL;
+        CRYPTO_THREAD_lock_free(rand_add_lock);
+        rand_add_lock = NULL;
+        drbg_inited = 0;
+    }
+    openssl_rand_meth.cleanup();
+}
+
+RAND_METHOD rand_drbg_meth = {
+    drbg_seed,
+    drbg_bytes,
+    drbg_cleanup,
+    drbg_add,
+    drbg_bytes,
+    drbg_status
+};
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * CTR_DRBG using AES-256 with a derivation function, as specified in
+ * NIST SP 800-90A Rev. 1, section 10.2.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include "internal/cryptlib.h"
+#include "rand_lcl.h"
+
+/* Number of counter blocks encrypted in one go by ctr_generate() */
+#define CTR_GEN_BLOCKS 16
+
+/*
+ * Increment the 128 bit big endian counter |V|.
+ */
+static void inc_128(DRBG_CTR_CTX *cctx)
+{
+    unsigned char *p = cctx->V + CTR_DRBG_BLOCKLEN;
+    unsigned int c = 1;
+
+    do {
+        --p;
+        c += *p;
+        *p = (unsigned char)c;
+        c >>= 8;
+    } while (p != cctx->V);
+}
+
+static int aes_ecb(EVP_CIPHER_CTX *ctx, unsigned char *out,
+                   const unsigned char *in, size_t inlen)
+{
+    int outl;
+
+    return EVP_EncryptUpdate(ctx, out, &outl, in, (int)inlen)
+           && (size_t)outl == inlen;
+}
+
+/*
+ * Process a complete block using the BCC algorithm of SP 800-90A 10.3.3.
+ * The chaining value lives in KX, one slot per output block of the
+ * derivation function.
+ */
+static int ctr_BCC_block(DRBG_CTR_CTX *cctx, unsigned char *out,
+                         const unsigned char *in)
+{
+    int i;
+
+    for (i = 0; i < CTR_DRBG_BLOCKLEN; i++)
+        out[i] ^= in[i];
+    return aes_ecb(cctx->ctx_df, out, out, CTR_DRBG_BLOCKLEN);
+}
+
+/*
+ * Handle several BCC operations for as much data as we need for K and X
+ */
+static int ctr_BCC_blocks(DRBG_CTR_CTX *cctx, const unsigned char *in)
+{
+    if (!ctr_BCC_block(cctx, cctx->KX, in)
+            || !ctr_BCC_block(cctx, cctx->KX + 16, in)
+            || !ctr_BCC_block(cctx, cctx->KX + 32, in))
+        return 0;
+    return 1;
+}
+
+/*
+ * Initialise BCC blocks: these have the value 0, 1, 2 in the first 4 bytes
+ * of the IV, see SP 800-90A 10.3.2 step 9.
+ */
+static int ctr_BCC_init(DRBG_CTR_CTX *cctx)
+{
+    memset(cctx->KX, 0, sizeof(cctx->KX));
+    memset(cctx->bltmp, 0, sizeof(cctx->bltmp));
+    if (!ctr_BCC_block(cctx, cctx->KX, cctx->bltmp))
+        return 0;
+    cctx->bltmp[3] = 1;
+    if (!ctr_BCC_block(cctx, cctx->KX + 16, cctx->bltmp))
+        return 0;
+    cctx->bltmp[3] = 2;
+    if (!ctr_BCC_block(cctx, cctx->KX + 32, cctx->bltmp))
+        return 0;
+    cctx->bltmp_pos = 0;
+    return 1;
+}
+
+/*
+ * Feed |in| through the BCC chains, buffering partial blocks in bltmp.
+ */
+static int ctr_BCC_update(DRBG_CTR_CTX *cctx,
+                          const unsigned char *in, size_t inlen)
+{
+    if (in == NULL || inlen == 0)
+        return 1;
+
+    /* If we have partial block handle it first */
+    if (cctx->bltmp_pos) {
+        size_t left = CTR_DRBG_BLOCKLEN - cctx->bltmp_pos;
+
+        /* If we now have a complete block process it */
+        if (inlen >= left) {
+            memcpy(cctx->bltmp + cctx->bltmp_pos, in, left);
+            if (!ctr_BCC_blocks(cctx, cctx->bltmp))
+                return 0;
+            cctx->bltmp_pos = 0;
+            inlen -= left;
+            in += left;
+        }
+    }
+
+    /* Process zero or more complete blocks */
+    for (; inlen >= CTR_DRBG_BLOCKLEN; in += 16, inlen -= 16) {
+        if (!ctr_BCC_blocks(cctx, in))
+            return 0;
+    }
+
+    /* Copy any remaining partial block to the temporary buffer */
+    if (inlen > 0) {
+        memcpy(cctx->bltmp + cctx->bltmp_pos, in, inlen);
+        cctx->bltmp_pos += inlen;
+    }
+    return 1;
+}
+
+static int ctr_BCC_final(DRBG_CTR_CTX *cctx)
+{
+    if (cctx->bltmp_pos) {
+        memset(cctx->bltmp + cctx->bltmp_pos, 0,
+               CTR_DRBG_BLOCKLEN - cctx->bltmp_pos);
+        if (!ctr_BCC_blocks(cctx, cctx->bltmp))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Block_Cipher_df of SP 800-90A 10.3.2, applied to the concatenation
+ * in1 || in2 || in3.  The 48 byte result is left in KX.
+ */
+static int ctr_df(DRBG_CTR_CTX *cctx,
+                  const unsigned char *in1, size_t in1len,
+                  const unsigned char *in2, size_t in2len,
+                  const unsigned char *in3, size_t in3len)
+{
+    static unsigned char c80 = 0x80;
+    size_t inlen;
+    unsigned char *p = cctx->bltmp;
+
+    if (!ctr_BCC_init(cctx))
+        return 0;
+    if (in1 == NULL)
+        in1len = 0;
+    if (in2 == NULL)
+        in2len = 0;
+    if (in3 == NULL)
+        in3len = 0;
+    inlen = in1len + in2len + in3len;
+    /* Initialise L||N in temporary block */
+    *p++ = (inlen >> 24) & 0xff;
+    *p++ = (inlen >> 16) & 0xff;
+    *p++ = (inlen >> 8) & 0xff;
+    *p++ = inlen & 0xff;
+
+    /* NB keylen is at most 32 bytes */
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    *p = (unsigned char)(CTR_DRBG_SEEDLEN & 0xff);
+    cctx->bltmp_pos = 8;
+    if (!ctr_BCC_update(cctx, in1, in1len)
+            || !ctr_BCC_update(cctx, in2, in2len)
+            || !ctr_BCC_update(cctx, in3, in3len)
+            || !ctr_BCC_update(cctx, &c80, 1)
+            || !ctr_BCC_final(cctx))
+        return 0;
+    /* Set up key K */
+    if (!EVP_EncryptInit_ex(cctx->ctx, NULL, NULL, cctx->KX, NULL))
+        return 0;
+    /* X follows key K */
+    if (!aes_ecb(cctx->ctx, cctx->KX, cctx->KX + CTR_DRBG_KEYLEN,
+                 CTR_DRBG_BLOCKLEN)
+            || !aes_ecb(cctx->ctx, cctx->KX + 16, cctx->KX, CTR_DRBG_BLOCKLEN)
+            || !aes_ecb(cctx->ctx, cctx->KX + 32, cctx->KX + 16,
+                        CTR_DRBG_BLOCKLEN))
+        return 0;
+    return 1;
+}
+
+/*
+ * CTR_DRBG_Update of SP 800-90A 10.2.1.2.  The provided data is the output
+ * of the derivation function applied to in1 || nonce || in2.  If all inputs
+ * are NULL but |in1len| is non-zero the derived value already in KX is
+ * reused, which is how generate applies its additional input a second time.
+ */
+static int ctr_update(RAND_DRBG *drbg,
+                      const unsigned char *in1, size_t in1len,
+                      const unsigned char *in2, size_t in2len,
+                      const unsigned char *nonce, size_t noncelen)
+{
+    DRBG_CTR_CTX *cctx = &drbg->ctr;
+    size_t i;
+
+    /* ctx is already keyed with K */
+    inc_128(cctx);
+    if (!aes_ecb(cctx->ctx, cctx->K, cctx->V, CTR_DRBG_BLOCKLEN))
+        return 0;
+    inc_128(cctx);
+    if (!aes_ecb(cctx->ctx, cctx->K + 16, cctx->V, CTR_DRBG_BLOCKLEN))
+        return 0;
+    inc_128(cctx);
+    if (!aes_ecb(cctx->ctx, cctx->V, cctx->V, CTR_DRBG_BLOCKLEN))
+        return 0;
+
+    /* If no input reuse existing derived value */
+    if (in1 != NULL || nonce != NULL || in2 != NULL)
+        if (!ctr_df(cctx, in1, in1len, nonce, noncelen, in2, in2len))
+            return 0;
+    /* If this a reuse input in1len != 0 */
+    if (in1len) {
+        for (i = 0; i < CTR_DRBG_KEYLEN; i++)
+            cctx->K[i] ^= cctx->KX[i];
+        for (i = 0; i < CTR_DRBG_BLOCKLEN; i++)
+            cctx->V[i] ^= cctx->KX[CTR_DRBG_KEYLEN + i];
+    }
+    return EVP_EncryptInit_ex(cctx->ctx, NULL, NULL, cctx->K, NULL);
+}
+
+int ctr_instantiate(RAND_DRBG *drbg,
+                    const unsigned char *ent, size_t entlen,
+                    const unsigned char *nonce, size_t noncelen,
+                    const unsigned char *pers, size_t perslen)
+{
+    DRBG_CTR_CTX *cctx = &drbg->ctr;
+
+    if (ent == NULL)
+        return 0;
+
+    memset(cctx->K, 0, sizeof(cctx->K));
+    memset(cctx->V, 0, sizeof(cctx->V));
+    if (!EVP_EncryptInit_ex(cctx->ctx, NULL, NULL, cctx->K, NULL))
+        return 0;
+    return ctr_update(drbg, ent, entlen, pers, perslen, nonce, noncelen);
+}
+
+int ctr_reseed(RAND_DRBG *drbg,
+               const unsigned char *ent, size_t entlen,
+               const unsigned char *adin, size_t adinlen)
+{
+    if (ent == NULL)
+        return 0;
+    return ctr_update(drbg, ent, entlen, adin, adinlen, NULL, 0);
+}
+
+int ctr_generate(RAND_DRBG *drbg,
+                 unsigned char *out, size_t outlen,
+                 const unsigned char *adin, size_t adinlen)
+{
+    DRBG_CTR_CTX *cctx = &drbg->ctr;
+    unsigned char ctrblk[CTR_GEN_BLOCKS * CTR_DRBG_BLOCKLEN];
+
+    if (adin != NULL && adinlen != 0) {
+        if (!ctr_update(drbg, adin, adinlen, NULL, 0, NULL, 0))
+            return 0;
+        /* This means we reuse the derived value below */
+        adin = NULL;
+        adinlen = 1;
+    } else {
+        adinlen = 0;
+    }
+
+    /*
+     * Encrypt the counter blocks in batches so that the cipher can
+     * pipeline them, rather than one block per call.
+     */
+    while (outlen > 0) {
+        size_t nblocks = (outlen + CTR_DRBG_BLOCKLEN - 1) / CTR_DRBG_BLOCKLEN;
+        size_t i, n;
+
+        if (nblocks > CTR_GEN_BLOCKS)
+            nblocks = CTR_GEN_BLOCKS;
+        for (i = 0; i < nblocks; i++) {
+            inc_128(cctx);
+            memcpy(ctrblk + i * CTR_DRBG_BLOCKLEN, cctx->V, CTR_DRBG_BLOCKLEN);
+        }
+        n = nblocks * CTR_DRBG_BLOCKLEN;
+        if (outlen >= n) {
+            if (!aes_ecb(cctx->ctx, out, ctrblk, n))
+                goto err;
+        } else {
+            if (!aes_ecb(cctx->ctx, ctrblk, ctrblk, n))
+                goto err;
+            memcpy(out, ctrblk, outlen);
+            n = outlen;
+        }
+        out += n;
+        outlen -= n;
+    }
+
+    OPENSSL_cleanse(ctrblk, sizeof(ctrblk));
+    return ctr_update(drbg, adin, adinlen, NULL, 0, NULL, 0);
+
+ err:
+    OPENSSL_cleanse(ctrblk, sizeof(ctrblk));
+    return 0;
+}
+
+void ctr_uninstantiate(RAND_DRBG *drbg)
+{
+    DRBG_CTR_CTX *cctx = &drbg->ctr;
+
+    EVP_CIPHER_CTX_free(cctx->ctx);
+    EVP_CIPHER_CTX_free(cctx->ctx_df);
+    OPENSSL_cleanse(cctx, sizeof(*cctx));
+}
+
+int ctr_init(RAND_DRBG *drbg)
+{
+    DRBG_CTR_CTX *cctx = &drbg->ctr;
+    /* Fixed key used by the derivation function, SP 800-90A 10.3.2 step 8 */
+    static const unsigned char df_key[CTR_DRBG_KEYLEN] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+        0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+    };
+
+    memset(cctx, 0, sizeof(*cctx));
+    cctx->ctx = EVP_CIPHER_CTX_new();
+    cctx->ctx_df = EVP_CIPHER_CTX_new();
+    if (cctx->ctx == NULL || cctx->ctx_df == NULL
+            || !EVP_EncryptInit_ex(cctx->ctx, EVP_aes_256_ecb(), NULL,
+                                   NULL, NULL)
+            || !EVP_EncryptInit_ex(cctx->ctx_df, EVP_aes_256_ecb(), NULL,
+                                   df_key, NULL)) {
+        ctr_uninstantiate(drbg);
+        return 0;
+    }
+    EVP_CIPHER_CTX_set_padding(cctx->ctx, 0);
+    EVP_CIPHER_CTX_set_padding(cctx->ctx_df, 0);
+    return 1;
+}
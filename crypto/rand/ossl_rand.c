@@ -85,11 +85,6 @@ DEFINE_RUN_ONCE_STATIC(do_ossl_rand_init)
     return ret;
 }
 
-RAND_METHOD *RAND_OpenSSL(void)
-{
-    return &openssl_rand_meth;
-}
-
 static void rand_cleanup(void)
 {
     OPENSSL_cleanse(&global_state, sizeof(global_state));
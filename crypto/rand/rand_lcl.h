@@ -1,5 +1,5 @@
 /*
- * Copyright 1995-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 1995-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -15,10 +15,109 @@
 
 # include <openssl/evp.h>
 # include <openssl/sha.h>
+# include <openssl/rand.h>
 
 # define RAND_DIGEST EVP_sha1()
 # define RAND_DIGEST_LENGTH        SHA_DIGEST_LENGTH
 
+/*
+ * CTR_DRBG parameters for AES-256 with derivation function, see
+ * NIST SP 800-90A Rev. 1, Table 3.
+ */
+# define CTR_DRBG_KEYLEN                 32
+# define CTR_DRBG_BLOCKLEN               16
+# define CTR_DRBG_SEEDLEN                (CTR_DRBG_KEYLEN + CTR_DRBG_BLOCKLEN)
+
+/* Amount of entropy and nonce input used for (re)seeding, in bytes */
+# define DRBG_ENTROPY_LEN                CTR_DRBG_KEYLEN
+# define DRBG_NONCE_LEN                  (CTR_DRBG_KEYLEN / 2)
+
+/* Largest request served by a single call to the generate function */
+# define DRBG_MAX_REQUEST                (1 << 16)
+/* Largest entropy, nonce, personalization or additional input accepted */
+# define DRBG_MAX_INPUT_LEN              (1 << 16)
+
+/* Default number of generate requests between automatic reseeds */
+# define MASTER_RESEED_INTERVAL          (1 << 8)
+# define SLAVE_RESEED_INTERVAL           (1 << 16)
+# define MAX_RESEED_INTERVAL             (1 << 24)
+
+/* DRBG states */
+typedef enum drbg_status_e {
+    DRBG_UNINITIALISED,
+    DRBG_READY,
+    DRBG_ERROR
+} DRBG_STATUS;
+
+/* State of a CTR_DRBG instance */
+typedef struct drbg_ctr_ctx_st {
+    EVP_CIPHER_CTX *ctx;
+    EVP_CIPHER_CTX *ctx_df;
+    unsigned char K[CTR_DRBG_KEYLEN];
+    unsigned char V[CTR_DRBG_BLOCKLEN];
+    /* Scratch space for the derivation function */
+    unsigned char bltmp[CTR_DRBG_BLOCKLEN];
+    size_t bltmp_pos;
+    unsigned char KX[CTR_DRBG_SEEDLEN];
+} DRBG_CTR_CTX;
+
+typedef struct rand_drbg_st RAND_DRBG;
+
+struct rand_drbg_st {
+    /* Only set for DRBGs shared between threads, i.e. the master DRBG */
+    CRYPTO_RWLOCK *lock;
+    /* The DRBG used to reseed this one, NULL for the master DRBG */
+    RAND_DRBG *parent;
+    DRBG_STATUS state;
+    /* Number of generate requests since the last (re)seed */
+    unsigned int generate_counter;
+    /* Number of generate requests after which a reseed is forced */
+    unsigned int reseed_interval;
+    /*
+     * Incremented on every successful (re)seed.  Children compare it with
+     * the value recorded when they were last seeded to notice that their
+     * parent has picked up fresh entropy.  It is only changed with
+     * drbg->lock held, children read it with CRYPTO_atomic_add().
+     */
+    int reseed_count;
+    int parent_reseed_count;
+    /* Value of rand_add_count when the DRBG was last seeded */
+    int add_count;
+# ifndef GETPID_IS_MEANINGLESS
+    /* Process the DRBG was seeded in, used to detect fork() */
+    pid_t pid;
+# endif
+    DRBG_CTR_CTX ctr;
+};
+
 extern RAND_METHOD openssl_rand_meth;
+extern RAND_METHOD rand_drbg_meth;
+
+/* CTR_DRBG mechanism, drbg_rand.c */
+int ctr_init(RAND_DRBG *drbg);
+int ctr_instantiate(RAND_DRBG *drbg,
+                    const unsigned char *ent, size_t entlen,
+                    const unsigned char *nonce, size_t noncelen,
+                    const unsigned char *pers, size_t perslen);
+int ctr_reseed(RAND_DRBG *drbg,
+               const unsigned char *ent, size_t entlen,
+               const unsigned char *adin, size_t adinlen);
+int ctr_generate(RAND_DRBG *drbg,
+                 unsigned char *out, size_t outlen,
+                 const unsigned char *adin, size_t adinlen);
+void ctr_uninstantiate(RAND_DRBG *drbg);
+
+/* DRBG life cycle, drbg_lib.c */
+RAND_DRBG *rand_drbg_new(RAND_DRBG *parent);
+int rand_drbg_instantiate(RAND_DRBG *drbg,
+                          const unsigned char *pers, size_t perslen);
+int rand_drbg_reseed(RAND_DRBG *drbg,
+                     const unsigned char *adin, size_t adinlen);
+int rand_drbg_generate(RAND_DRBG *drbg, unsigned char *out, size_t outlen,
+                       const unsigned char *adin, size_t adinlen);
+int rand_drbg_set_reseed_interval(RAND_DRBG *drbg, unsigned int interval);
+void rand_drbg_free(RAND_DRBG *drbg);
+RAND_DRBG *rand_drbg_get0_master(void);
+RAND_DRBG *rand_drbg_get0_thread(void);
 
 #endif
@@ -85,10 +85,10 @@ const RAND_METHOD *RAND_get_rand_method(void)
             default_RAND_meth = tmp_meth;
         } else {
             ENGINE_finish(e);
-            default_RAND_meth = &openssl_rand_meth;
+            default_RAND_meth = &rand_drbg_meth;
         }
 #else
-        default_RAND_meth = &openssl_rand_meth;
+        default_RAND_meth = &rand_drbg_meth;
 #endif
     }
     tmp_meth = default_RAND_meth;
@@ -18,29 +18,59 @@
 #endif
 #ifndef OPENSSL_NO_POSIX_IO
 # include <sys/stat.h>
+# ifdef _WIN32
+#  define stat _stat
+# endif
 #endif
 
 
 #include <openssl/lhash.h>
 #include <openssl/x509.h>
+#include "internal/o_dir.h"
 #include "internal/x509_int.h"
 #include "x509_lcl.h"
 
+/*
+ * Directories can be indexed wherever we can both read them and tell from
+ * their modification time that they have changed.
+ */
+#if !defined(OPENSSL_NO_POSIX_IO) && !defined(OPENSSL_SYS_VMS)
+# define BY_DIR_INDEX_SUPPORTED
+#endif
+
 struct lookup_dir_hashes_st {
     unsigned long hash;
     int suffix;
 };
 
+/*
+ * One hash value in a directory index: the number of certificates and CRLs
+ * with that hash that can be loaded, i.e. the sequence numbers before the
+ * first missing one.
+ */
+typedef struct {
+    unsigned long hash;
+    int certs;
+    int crls;
+} BY_DIR_INDEX;
+
 struct lookup_dir_entry_st {
     char *dir;
     int dir_type;
     STACK_OF(BY_DIR_HASH) *hashes;
+    /* Directory index, only used if BY_DIR index_interval >= 0 */
+    BY_DIR_INDEX *index;
+    size_t index_num;
+    int indexed;                /* index is valid */
+    time_t mtime;               /* of the directory when indexed */
+    time_t checked;             /* when mtime was last compared */
 };
 
 typedef struct lookup_dir_st {
     BUF_MEM *buffer;
     STACK_OF(BY_DIR_ENTRY) *dirs;
     CRYPTO_RWLOCK *lock;
+    long index_interval;        /* seconds between checks, < 0 to not index */
 } BY_DIR;
 
 static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
@@ -48,6 +78,9 @@ static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
 static int new_dir(X509_LOOKUP *lu);
 static void free_dir(X509_LOOKUP *lu);
 static int add_cert_dir(BY_DIR *ctx, const char *dir, int type);
+#ifdef BY_DIR_INDEX_SUPPORTED
+static void by_dir_index_clear(BY_DIR_ENTRY *ent);
+#endif
 static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
                                X509_NAME *name, X509_OBJECT *ret);
 static X509_LOOKUP_METHOD x509_dir_lookup = {
@@ -92,6 +125,21 @@ static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
         } else
             ret = add_cert_dir(ld, argp, (int)argl);
         break;
+    case X509_L_DIR_INDEX:
+#ifdef BY_DIR_INDEX_SUPPORTED
+        CRYPTO_THREAD_write_lock(ld->lock);
+        ld->index_interval = argl;
+        if (ld->dirs != NULL) {
+            int i;
+
+            /* Force a fresh scan, or drop the index */
+            for (i = 0; i < sk_BY_DIR_ENTRY_num(ld->dirs); i++)
+                by_dir_index_clear(sk_BY_DIR_ENTRY_value(ld->dirs, i));
+        }
+        CRYPTO_THREAD_unlock(ld->lock);
+        ret = 1;
+#endif
+        break;
     }
     return (ret);
 }
@@ -107,6 +155,7 @@ static int new_dir(X509_LOOKUP *lu)
         return 0;
     }
     a->dirs = NULL;
+    a->index_interval = -1;
     a->lock = CRYPTO_THREAD_lock_new();
     if (a->lock == NULL) {
         BUF_MEM_free(a->buffer);
@@ -134,6 +183,7 @@ static int by_dir_hash_cmp(const BY_DIR_HASH *const *a,
 
 static void by_dir_entry_free(BY_DIR_ENTRY *ent)
 {
+    OPENSSL_free(ent->index);
     OPENSSL_free(ent->dir);
     sk_BY_DIR_HASH_pop_free(ent->hashes, by_dir_hash_free);
     OPENSSL_free(ent);
@@ -150,6 +200,194 @@ static void free_dir(X509_LOOKUP *lu)
     OPENSSL_free(a);
 }
 
+#ifdef BY_DIR_INDEX_SUPPORTED
+static void by_dir_index_clear(BY_DIR_ENTRY *ent)
+{
+    OPENSSL_free(ent->index);
+    ent->index = NULL;
+    ent->index_num = 0;
+    ent->indexed = 0;
+    ent->checked = 0;
+}
+
+typedef struct {
+    unsigned long hash;
+    int crl;
+    int suffix;
+} BY_DIR_NAME;
+
+static int by_dir_name_cmp(const void *a, const void *b)
+{
+    const BY_DIR_NAME *na = a, *nb = b;
+
+    if (na->hash != nb->hash)
+        return na->hash > nb->hash ? 1 : -1;
+    if (na->crl != nb->crl)
+        return na->crl - nb->crl;
+    return na->suffix - nb->suffix;
+}
+
+/*
+ * Parse a file name of the form <hash>.<N> or <hash>.r<N>, where <hash> is
+ * eight hex digits and <N> at most six decimal digits, as in the names
+ * get_cert_by_subject() looks for.
+ */
+static int by_dir_parse_name(const char *name, BY_DIR_NAME *nm)
+{
+    int i, v;
+
+    nm->hash = 0;
+    for (i = 0; i < 8; i++) {
+        if ((v = OPENSSL_hexchar2int(name[i])) < 0)
+            return 0;
+        nm->hash = (nm->hash << 4) | v;
+    }
+    name += 8;
+    if (*name++ != '.')
+        return 0;
+    nm->crl = *name == 'r';
+    if (nm->crl)
+        name++;
+    nm->suffix = 0;
+    for (i = 0; name[i] != '\0'; i++) {
+        if (i == 6 || name[i] < '0' || name[i] > '9')
+            return 0;
+        nm->suffix = nm->suffix * 10 + (name[i] - '0');
+    }
+    return i > 0;
+}
+
+/*
+ * Scan the directory and replace the index of |ent|.  If that fails the
+ * entry is left without an index and lookups probe the filesystem.
+ */
+static void by_dir_index_build(BY_DIR_ENTRY *ent, time_t now)
+{
+    OPENSSL_DIR_CTX *d = NULL;
+    const char *fn;
+    BY_DIR_NAME *names = NULL, *tmp;
+    BY_DIR_INDEX *index = NULL;
+    size_t num = 0, max = 0, n = 0, i;
+    struct stat st;
+
+    by_dir_index_clear(ent);
+    ent->checked = now;
+    if (stat(ent->dir, &st) < 0)
+        return;
+
+    while ((fn = OPENSSL_DIR_read(&d, ent->dir)) != NULL) {
+        BY_DIR_NAME nm;
+
+        if (!by_dir_parse_name(fn, &nm))
+            continue;
+        if (num == max) {
+            max = max == 0 ? 64 : max * 2;
+            tmp = OPENSSL_realloc(names, max * sizeof(*names));
+            if (tmp == NULL)
+                goto err;
+            names = tmp;
+        }
+        names[num++] = nm;
+    }
+    if (errno != 0)
+        goto err;
+
+    if (num > 0) {
+        qsort(names, num, sizeof(*names), by_dir_name_cmp);
+        if ((index = OPENSSL_malloc(num * sizeof(*index))) == NULL)
+            goto err;
+    }
+    for (i = 0; i < num; i++) {
+        int *count;
+
+        if (n == 0 || index[n - 1].hash != names[i].hash) {
+            index[n].hash = names[i].hash;
+            index[n].certs = index[n].crls = 0;
+            n++;
+        }
+        /* Only count up to the first gap, as probing would */
+        count = names[i].crl ? &index[n - 1].crls : &index[n - 1].certs;
+        if (names[i].suffix == *count)
+            (*count)++;
+    }
+
+    ent->index = index;
+    ent->index_num = n;
+    ent->indexed = 1;
+    ent->mtime = st.st_mtime;
+    /*
+     * A file added later in the same second as the scan would not change
+     * the modification time we recorded, so rescan on the next lookup until
+     * the clock has moved on.
+     */
+    if (st.st_mtime >= now)
+        ent->checked = 0;
+    index = NULL;
+ err:
+    if (d != NULL)
+        OPENSSL_DIR_end(&d);
+    OPENSSL_free(names);
+    OPENSSL_free(index);
+}
+
+/*
+ * Returns how many certificates (or CRLs if |crl| is set) with hash |h| are
+ * in the directory of |ent| according to its index, or -1 if the directory
+ * is not indexed.  The directory's modification time is compared with that
+ * of the index at most once every |ctx->index_interval| seconds.
+ */
+static int by_dir_index_count(BY_DIR *ctx, BY_DIR_ENTRY *ent, unsigned long h,
+                              int crl)
+{
+    time_t now;
+    size_t lo, hi;
+    int ret = -1;
+
+    CRYPTO_THREAD_read_lock(ctx->lock);
+    if (ctx->index_interval < 0)
+        goto end;
+    now = time(NULL);
+    if (now - ent->checked >= ctx->index_interval) {
+        CRYPTO_THREAD_unlock(ctx->lock);
+        CRYPTO_THREAD_write_lock(ctx->lock);
+        /* Another thread may have got there first */
+        if (ctx->index_interval >= 0
+                && now - ent->checked >= ctx->index_interval) {
+            struct stat st;
+
+            if (!ent->indexed || ent->checked == 0
+                    || stat(ent->dir, &st) < 0
+                    || st.st_mtime != ent->mtime)
+                by_dir_index_build(ent, now);
+            else
+                ent->checked = now;
+        }
+    }
+    if (!ent->indexed)
+        goto end;
+
+    ret = 0;
+    lo = 0;
+    hi = ent->index_num;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const BY_DIR_INDEX *e = &ent->index[mid];
+
+        if (e->hash == h) {
+            ret = crl ? e->crls : e->certs;
+            break;
+        }
+        if (e->hash < h)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+ end:
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return ret;
+}
+#endif
+
 static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
 {
     const char *s, *p;
@@ -186,7 +424,7 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
                     return 0;
                 }
             }
-            ent = OPENSSL_malloc(sizeof(*ent));
+            ent = OPENSSL_zalloc(sizeof(*ent));
             if (ent == NULL)
                 return 0;
             ent->dir_type = type;
@@ -214,7 +452,7 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
         X509_CRL crl;
     } data;
     int ok = 0;
-    int i, j, k;
+    int i, j, k, limit;
     unsigned long h;
     BUF_MEM *b = NULL;
     X509_OBJECT stmp, *tmp;
@@ -271,8 +509,17 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
             k = 0;
             hent = NULL;
         }
+#ifdef BY_DIR_INDEX_SUPPORTED
+        limit = by_dir_index_count(ctx, ent, h, type == X509_LU_CRL);
+#else
+        limit = -1;
+#endif
         for (;;) {
             char c = '/';
+
+            /* If the directory is indexed we know when to stop */
+            if (limit >= 0 && k >= limit)
+                break;
 #ifdef OPENSSL_SYS_VMS
             c = ent->dir[strlen(ent->dir) - 1];
             if (c != ':' && c != '>' && c != ']') {
@@ -299,10 +546,7 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
                              "%s%c%08lx.%s%d", ent->dir, c, h, postfix, k);
             }
 #ifndef OPENSSL_NO_POSIX_IO
-# ifdef _WIN32
-#  define stat _stat
-# endif
-            {
+            if (limit < 0) {
                 struct stat st;
                 if (stat(b->data, &st) < 0)
                     break;
@@ -86,9 +86,9 @@ int X509_print_ex(BIO *bp, X509 *x, unsigned long nmflags,
 
         bs = X509_get_serialNumber(x);
         if (bs->length <= (int)sizeof(long)) {
-                ERR_set_mark();
+                ERR_set_suppress_mark();
                 l = ASN1_INTEGER_get(bs);
-                ERR_pop_to_mark();
+                ERR_pop_suppress_mark();
         } else {
             l = -1;
         }
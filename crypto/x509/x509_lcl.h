@@ -102,10 +102,22 @@ struct x509_lookup_st {
  * validation.  Once we have a certificate chain, the 'verify' function is
  * then called to actually check the cert chain.
  */
+typedef struct x509_store_index_st X509_STORE_INDEX;
+typedef struct x509_chain_cache_st X509_CHAIN_CACHE;
+typedef struct x509_chain_cache_entry_st X509_CHAIN_CACHE_ENTRY;
+
 struct x509_store_st {
     /* The following is a cache of trusted certs */
     int cache;                  /* if true, stash any hits */
     STACK_OF(X509_OBJECT) *objs; /* Cache of all objects */
+    /* Bumped whenever |objs| changes */
+    unsigned int generation;
+    /* Read-only snapshot of |objs| used for lookups, built on demand */
+    X509_STORE_INDEX *index;
+    /* Objects added since |index| was built, owned by |objs| */
+    STACK_OF(X509_OBJECT) *index_added;
+    /* Recently verified chains, if enabled */
+    X509_CHAIN_CACHE *chain_cache;
     /* These are external lookup methods */
     STACK_OF(X509_LOOKUP) *get_cert_methods;
     X509_VERIFY_PARAM *param;
@@ -145,3 +157,12 @@ DEFINE_STACK_OF(STACK_OF_X509_NAME_ENTRY)
 
 void x509_set_signature_info(X509_SIG_INFO *siginf, const X509_ALGOR *alg,
                              const ASN1_STRING *sig);
+
+/* Length of a verified chain cache key, a SHA-256 digest */
+#define X509_CHAIN_CACHE_KEYLEN 32
+
+X509_CHAIN_CACHE *x509_chain_cache_new(int max, long timeout);
+void x509_chain_cache_free(X509_CHAIN_CACHE *cache);
+void x509_chain_cache_flush(X509_CHAIN_CACHE *cache);
+int x509_chain_cache_get(X509_STORE_CTX *ctx, unsigned char *key);
+void x509_chain_cache_put(X509_STORE_CTX *ctx, const unsigned char *key);
@@ -40,6 +40,15 @@ void X509_LOOKUP_free(X509_LOOKUP *ctx)
     OPENSSL_free(ctx);
 }
 
+static void x509_store_index_free(X509_STORE_INDEX *index);
+
+/* Called with |store| locked for writing whenever |store->objs| changes */
+static void x509_store_changed(X509_STORE *store)
+{
+    store->generation++;
+    x509_chain_cache_flush(store->chain_cache);
+}
+
 int X509_STORE_lock(X509_STORE *s)
 {
     return CRYPTO_THREAD_write_lock(s->lock);
@@ -47,6 +56,15 @@ int X509_STORE_lock(X509_STORE *s)
 
 int X509_STORE_unlock(X509_STORE *s)
 {
+    /*
+     * The application may have changed |s->objs| directly while it held the
+     * lock, so rebuild the snapshot from scratch on the next lookup.
+     */
+    x509_store_index_free(s->index);
+    s->index = NULL;
+    sk_X509_OBJECT_free(s->index_added);
+    s->index_added = NULL;
+    x509_store_changed(s);
     return CRYPTO_THREAD_unlock(s->lock);
 }
 
@@ -139,6 +157,268 @@ static int x509_object_cmp(const X509_OBJECT *const *a,
     return ret;
 }
 
+/*
+ * Lookups go through an immutable snapshot of the object cache, sorted by
+ * type and a hash of the subject (or CRL issuer) name so that equal names
+ * are adjacent.  A reader takes a reference to the current snapshot under
+ * a read lock and searches it with no lock held, so concurrent chain builds
+ * don't serialise on the store.  Every change to the cache bumps the
+ * store's generation, and the next lookup replaces a snapshot built for an
+ * older generation.  When objects were only added, the new snapshot is the
+ * old one merged with the added objects, so existing entries are not hashed
+ * and sorted again.
+ */
+typedef struct {
+    X509_LOOKUP_TYPE type;
+    unsigned long hash;
+    X509_NAME *name;
+    int seq;                    /* position in |objs|, keeps the sort stable */
+    X509_OBJECT obj;
+} X509_STORE_INDEX_ENTRY;
+
+struct x509_store_index_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    unsigned int generation;    /* store generation the snapshot matches */
+    int seq;                    /* next sequence number for added entries */
+    int nentries;
+    X509_STORE_INDEX_ENTRY *entries;
+};
+
+static int x509_name_index_hash(X509_NAME *nm, unsigned long *hash)
+{
+    unsigned long h = 2166136261UL;
+    int i;
+
+    /* Make sure the canonical encoding is up to date */
+    if (nm->modified && i2d_X509_NAME(nm, NULL) < 0)
+        return 0;
+    for (i = 0; i < nm->canon_enclen; i++)
+        h = ((h ^ nm->canon_enc[i]) * 16777619UL) & 0xffffffffUL;
+    *hash = h;
+    return 1;
+}
+
+static int x509_store_entry_cmp(const X509_STORE_INDEX_ENTRY *a,
+                                const X509_STORE_INDEX_ENTRY *b)
+{
+    if (a->type != b->type)
+        return a->type < b->type ? -1 : 1;
+    if (a->hash != b->hash)
+        return a->hash < b->hash ? -1 : 1;
+    return X509_NAME_cmp(a->name, b->name);
+}
+
+static int x509_store_entry_sort_cmp(const void *a, const void *b)
+{
+    const X509_STORE_INDEX_ENTRY *ea = a, *eb = b;
+    int ret = x509_store_entry_cmp(ea, eb);
+
+    if (ret != 0)
+        return ret;
+    return ea->seq - eb->seq;
+}
+
+static void x509_store_index_free(X509_STORE_INDEX *index)
+{
+    int i;
+
+    if (index == NULL)
+        return;
+
+    CRYPTO_DOWN_REF(&index->references, &i, index->lock);
+    REF_PRINT_COUNT("X509_STORE_INDEX", index);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    for (i = 0; i < index->nentries; i++) {
+        X509_OBJECT *obj = &index->entries[i].obj;
+
+        if (obj->type == X509_LU_X509)
+            X509_free(obj->data.x509);
+        else
+            X509_CRL_free(obj->data.crl);
+    }
+    OPENSSL_free(index->entries);
+    CRYPTO_THREAD_lock_free(index->lock);
+    OPENSSL_free(index);
+}
+
+/*
+ * Fill in |ent| for |obj|.  Returns 0 if |obj| can't be indexed, in which
+ * case it is only found through the lookup methods.
+ */
+static int x509_store_entry_set(X509_STORE_INDEX_ENTRY *ent, X509_OBJECT *obj,
+                                int seq)
+{
+    switch (obj->type) {
+    case X509_LU_X509:
+        ent->name = X509_get_subject_name(obj->data.x509);
+        break;
+    case X509_LU_CRL:
+        ent->name = X509_CRL_get_issuer(obj->data.crl);
+        break;
+    default:
+        return 0;
+    }
+    if (!x509_name_index_hash(ent->name, &ent->hash))
+        return 0;
+    ent->type = obj->type;
+    ent->seq = seq;
+    ent->obj = *obj;
+    X509_OBJECT_up_ref_count(&ent->obj);
+    return 1;
+}
+
+static X509_STORE_INDEX *x509_store_index_alloc(int num)
+{
+    X509_STORE_INDEX *index;
+
+    if ((index = OPENSSL_zalloc(sizeof(*index))) == NULL)
+        return NULL;
+    index->references = 1;
+    if ((index->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || (num > 0
+                && (index->entries = OPENSSL_malloc(sizeof(*index->entries)
+                                                    * num)) == NULL)) {
+        x509_store_index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/* Build a snapshot of |objs|, called with the store locked for writing */
+static X509_STORE_INDEX *x509_store_index_new(STACK_OF(X509_OBJECT) *objs)
+{
+    X509_STORE_INDEX *index;
+    int i, num = sk_X509_OBJECT_num(objs);
+
+    if ((index = x509_store_index_alloc(num)) == NULL)
+        return NULL;
+    for (i = 0; i < num; i++) {
+        if (x509_store_entry_set(&index->entries[index->nentries],
+                                 sk_X509_OBJECT_value(objs, i), i))
+            index->nentries++;
+    }
+    index->seq = num;
+    qsort(index->entries, index->nentries, sizeof(*index->entries),
+          x509_store_entry_sort_cmp);
+    return index;
+}
+
+/*
+ * Build a snapshot holding the entries of |old| and the objects in |added|,
+ * called with the store locked for writing.  Only the added objects are
+ * sorted, and the result is merged with the entries of |old|.
+ */
+static X509_STORE_INDEX *x509_store_index_merge(const X509_STORE_INDEX *old,
+                                                STACK_OF(X509_OBJECT) *added)
+{
+    X509_STORE_INDEX *index;
+    X509_STORE_INDEX_ENTRY *ent, *tmp = NULL;
+    int i, j, n = 0, num = sk_X509_OBJECT_num(added);
+
+    if ((index = x509_store_index_alloc(old->nentries + num)) == NULL)
+        return NULL;
+    if (num > 0 && (tmp = OPENSSL_malloc(sizeof(*tmp) * num)) == NULL) {
+        x509_store_index_free(index);
+        return NULL;
+    }
+    for (i = 0; i < num; i++) {
+        if (x509_store_entry_set(&tmp[n], sk_X509_OBJECT_value(added, i),
+                                 old->seq + i))
+            n++;
+    }
+    index->seq = old->seq + num;
+    qsort(tmp, n, sizeof(*tmp), x509_store_entry_sort_cmp);
+
+    for (i = 0, j = 0; i < old->nentries || j < n; ) {
+        ent = &index->entries[index->nentries++];
+        if (j == n || (i < old->nentries
+                       && x509_store_entry_sort_cmp(&old->entries[i],
+                                                    &tmp[j]) < 0)) {
+            *ent = old->entries[i++];
+            X509_OBJECT_up_ref_count(&ent->obj);
+        } else {
+            /* Takes over the reference taken by x509_store_entry_set() */
+            *ent = tmp[j++];
+        }
+    }
+    OPENSSL_free(tmp);
+    return index;
+}
+
+/* Returns a reference to an up to date snapshot of the store's objects */
+static X509_STORE_INDEX *x509_store_index_get(X509_STORE *store)
+{
+    X509_STORE_INDEX *index, *old;
+    int i;
+
+    CRYPTO_THREAD_read_lock(store->lock);
+    index = store->index;
+    if (index != NULL && index->generation == store->generation) {
+        CRYPTO_UP_REF(&index->references, &i, index->lock);
+        CRYPTO_THREAD_unlock(store->lock);
+        return index;
+    }
+    CRYPTO_THREAD_unlock(store->lock);
+
+    CRYPTO_THREAD_write_lock(store->lock);
+    index = old = store->index;
+    if (index == NULL || index->generation != store->generation) {
+        if (index != NULL && store->index_added != NULL)
+            index = x509_store_index_merge(old, store->index_added);
+        else
+            index = x509_store_index_new(store->objs);
+        x509_store_index_free(old);
+        sk_X509_OBJECT_free(store->index_added);
+        store->index_added = NULL;
+        if (index != NULL)
+            index->generation = store->generation;
+        store->index = index;
+    }
+    if (index != NULL)
+        CRYPTO_UP_REF(&index->references, &i, index->lock);
+    CRYPTO_THREAD_unlock(store->lock);
+    return index;
+}
+
+/*
+ * Find the objects of |type| named |name| in |index|.  Returns the position
+ * of the first one and their number in |*pnmatch|, or -1 if there are none.
+ */
+static int x509_store_index_find(const X509_STORE_INDEX *index,
+                                 X509_LOOKUP_TYPE type, X509_NAME *name,
+                                 int *pnmatch)
+{
+    X509_STORE_INDEX_ENTRY key;
+    int lo = 0, hi, cnt = 0;
+
+    if (index == NULL || !x509_name_index_hash(name, &key.hash))
+        return -1;
+    key.type = type;
+    key.name = name;
+
+    hi = index->nentries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (x509_store_entry_cmp(&index->entries[mid], &key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    while (lo + cnt < index->nentries
+           && x509_store_entry_cmp(&index->entries[lo + cnt], &key) == 0)
+        cnt++;
+    if (cnt == 0)
+        return -1;
+    if (pnmatch != NULL)
+        *pnmatch = cnt;
+    return lo;
+}
+
 X509_STORE *X509_STORE_new(void)
 {
     X509_STORE *ret;
@@ -195,6 +475,9 @@ void X509_STORE_free(X509_STORE *vfy)
     }
     sk_X509_LOOKUP_free(sk);
     sk_X509_OBJECT_pop_free(vfy->objs, X509_OBJECT_free);
+    x509_store_index_free(vfy->index);
+    sk_X509_OBJECT_free(vfy->index_added);
+    x509_chain_cache_free(vfy->chain_cache);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
     X509_VERIFY_PARAM_free(vfy->param);
@@ -261,13 +544,15 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
                                   X509_NAME *name, X509_OBJECT *ret)
 {
     X509_STORE *ctx = vs->ctx;
+    X509_STORE_INDEX *index;
     X509_LOOKUP *lu;
-    X509_OBJECT stmp, *tmp;
+    X509_OBJECT stmp, *tmp = NULL;
     int i, j;
 
-    CRYPTO_THREAD_write_lock(ctx->lock);
-    tmp = X509_OBJECT_retrieve_by_subject(ctx->objs, type, name);
-    CRYPTO_THREAD_unlock(ctx->lock);
+    index = x509_store_index_get(ctx);
+    i = x509_store_index_find(index, type, name, NULL);
+    if (i >= 0)
+        tmp = &index->entries[i].obj;
 
     if (tmp == NULL || type == X509_LU_CRL) {
         for (i = 0; i < sk_X509_LOOKUP_num(ctx->get_cert_methods); i++) {
@@ -278,14 +563,17 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
                 break;
             }
         }
-        if (tmp == NULL)
+        if (tmp == NULL) {
+            x509_store_index_free(index);
             return 0;
+        }
     }
 
     ret->type = tmp->type;
     ret->data.ptr = tmp->data.ptr;
 
     X509_OBJECT_up_ref_count(ret);
+    x509_store_index_free(index);
 
     return 1;
 }
@@ -317,6 +605,17 @@ static int x509_store_add(X509_STORE *ctx, void *x, int crl) {
         added = sk_X509_OBJECT_push(ctx->objs, obj);
         ret = added != 0;
     }
+    if (added) {
+        x509_store_changed(ctx);
+        /* Remember |obj| so the next snapshot can be merged from the last */
+        if (ctx->index != NULL
+                && ((ctx->index_added == NULL
+                     && (ctx->index_added = sk_X509_OBJECT_new_null()) == NULL)
+                    || !sk_X509_OBJECT_push(ctx->index_added, obj))) {
+            x509_store_index_free(ctx->index);
+            ctx->index = NULL;
+        }
+    }
 
     CRYPTO_THREAD_unlock(ctx->lock);
 
@@ -472,10 +771,10 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
     int i, idx, cnt;
     STACK_OF(X509) *sk = NULL;
     X509 *x;
-    X509_OBJECT *obj;
+    X509_STORE_INDEX *index;
 
-    CRYPTO_THREAD_write_lock(ctx->ctx->lock);
-    idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_X509, nm, &cnt);
+    index = x509_store_index_get(ctx->ctx);
+    idx = x509_store_index_find(index, X509_LU_X509, nm, &cnt);
     if (idx < 0) {
         /*
          * Nothing found in cache: do lookup to possibly add new objects to
@@ -483,7 +782,7 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
          */
         X509_OBJECT *xobj = X509_OBJECT_new();
 
-        CRYPTO_THREAD_unlock(ctx->ctx->lock);
+        x509_store_index_free(index);
         if (xobj == NULL)
             return NULL;
         if (!X509_STORE_CTX_get_by_subject(ctx, X509_LU_X509, nm, xobj)) {
@@ -491,27 +790,29 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
             return NULL;
         }
         X509_OBJECT_free(xobj);
-        CRYPTO_THREAD_write_lock(ctx->ctx->lock);
-        idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_X509, nm, &cnt);
+        index = x509_store_index_get(ctx->ctx);
+        idx = x509_store_index_find(index, X509_LU_X509, nm, &cnt);
         if (idx < 0) {
-            CRYPTO_THREAD_unlock(ctx->ctx->lock);
+            x509_store_index_free(index);
             return NULL;
         }
     }
 
-    sk = sk_X509_new_null();
+    if ((sk = sk_X509_new_null()) == NULL) {
+        x509_store_index_free(index);
+        return NULL;
+    }
     for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
-        x = obj->data.x509;
+        x = index->entries[idx].obj.data.x509;
         X509_up_ref(x);
         if (!sk_X509_push(sk, x)) {
-            CRYPTO_THREAD_unlock(ctx->ctx->lock);
+            x509_store_index_free(index);
             X509_free(x);
             sk_X509_pop_free(sk, X509_free);
             return NULL;
         }
     }
-    CRYPTO_THREAD_unlock(ctx->ctx->lock);
+    x509_store_index_free(index);
     return sk;
 }
 
@@ -520,7 +821,8 @@ STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
     int i, idx, cnt;
     STACK_OF(X509_CRL) *sk = sk_X509_CRL_new_null();
     X509_CRL *x;
-    X509_OBJECT *obj, *xobj = X509_OBJECT_new();
+    X509_OBJECT *xobj = X509_OBJECT_new();
+    X509_STORE_INDEX *index;
 
     /* Always do lookup to possibly add new CRLs to cache */
     if (sk == NULL || xobj == NULL ||
@@ -530,26 +832,25 @@ STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
         return NULL;
     }
     X509_OBJECT_free(xobj);
-    CRYPTO_THREAD_write_lock(ctx->ctx->lock);
-    idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_CRL, nm, &cnt);
+    index = x509_store_index_get(ctx->ctx);
+    idx = x509_store_index_find(index, X509_LU_CRL, nm, &cnt);
     if (idx < 0) {
-        CRYPTO_THREAD_unlock(ctx->ctx->lock);
+        x509_store_index_free(index);
         sk_X509_CRL_free(sk);
         return NULL;
     }
 
     for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
-        x = obj->data.crl;
+        x = index->entries[idx].obj.data.crl;
         X509_CRL_up_ref(x);
         if (!sk_X509_CRL_push(sk, x)) {
-            CRYPTO_THREAD_unlock(ctx->ctx->lock);
+            x509_store_index_free(index);
             X509_CRL_free(x);
             sk_X509_CRL_pop_free(sk, X509_CRL_free);
             return NULL;
         }
     }
-    CRYPTO_THREAD_unlock(ctx->ctx->lock);
+    x509_store_index_free(index);
     return sk;
 }
 
@@ -595,8 +896,10 @@ X509_OBJECT *X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h,
 int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 {
     X509_NAME *xn;
-    X509_OBJECT *obj = X509_OBJECT_new(), *pobj = NULL;
-    int i, ok, idx, ret;
+    X509_OBJECT *obj = X509_OBJECT_new();
+    X509_STORE_INDEX *index;
+    X509 *candidate;
+    int i, ok, idx, cnt, ret;
 
     if (obj == NULL)
         return -1;
@@ -620,20 +923,15 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 
     /* Else find index of first cert accepted by 'check_issued' */
     ret = 0;
-    CRYPTO_THREAD_write_lock(ctx->ctx->lock);
-    idx = X509_OBJECT_idx_by_subject(ctx->ctx->objs, X509_LU_X509, xn);
+    index = x509_store_index_get(ctx->ctx);
+    idx = x509_store_index_find(index, X509_LU_X509, xn, &cnt);
     if (idx != -1) {            /* should be true as we've had at least one
                                  * match */
         /* Look through all matching certs for suitable issuer */
-        for (i = idx; i < sk_X509_OBJECT_num(ctx->ctx->objs); i++) {
-            pobj = sk_X509_OBJECT_value(ctx->ctx->objs, i);
-            /* See if we've run past the matches */
-            if (pobj->type != X509_LU_X509)
-                break;
-            if (X509_NAME_cmp(xn, X509_get_subject_name(pobj->data.x509)))
-                break;
-            if (ctx->check_issued(ctx, x, pobj->data.x509)) {
-                *issuer = pobj->data.x509;
+        for (i = idx; i < idx + cnt; i++) {
+            candidate = index->entries[i].obj.data.x509;
+            if (ctx->check_issued(ctx, x, candidate)) {
+                *issuer = candidate;
                 ret = 1;
                 /*
                  * If times check, exit with match,
@@ -647,9 +945,9 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->ctx->lock);
     if (*issuer)
         X509_up_ref(*issuer);
+    x509_store_index_free(index);
     return ret;
 }
 
@@ -658,6 +956,24 @@ int X509_STORE_set_flags(X509_STORE *ctx, unsigned long flags)
     return X509_VERIFY_PARAM_set_flags(ctx->param, flags);
 }
 
+int X509_STORE_set_chain_cache(X509_STORE *ctx, int max, long timeout)
+{
+    X509_CHAIN_CACHE *cache = NULL, *old;
+
+    if (max > 0 && timeout > 0
+            && (cache = x509_chain_cache_new(max, timeout)) == NULL) {
+        X509err(X509_F_X509_STORE_SET_CHAIN_CACHE, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    /* Verifications in progress keep their own reference to the old cache */
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    old = ctx->chain_cache;
+    ctx->chain_cache = cache;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    x509_chain_cache_free(old);
+    return 1;
+}
+
 int X509_STORE_set_depth(X509_STORE *ctx, int depth)
 {
     X509_VERIFY_PARAM_set_depth(ctx->param, depth);
@@ -0,0 +1,324 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include "internal/cryptlib.h"
+#include <openssl/lhash.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * Cache of successfully verified chains, keyed by a digest of the leaf
+ * certificate and of the verification parameters.  Entries are dropped in
+ * the order they were added once the cache is full, when they reach the
+ * configured timeout or when the first certificate in the chain expires,
+ * and all at once whenever an object is added to the store.  The cache is
+ * reference counted: a verification holds a reference taken under the
+ * store lock, so X509_STORE_set_chain_cache() can replace it at any time.
+ */
+
+struct x509_chain_cache_entry_st {
+    unsigned char key[X509_CHAIN_CACHE_KEYLEN];
+    time_t expires;
+    STACK_OF(X509) *chain;
+    int num_untrusted;
+    char *peername;
+    X509_CHAIN_CACHE_ENTRY *next; /* next newer entry */
+};
+
+DEFINE_LHASH_OF(X509_CHAIN_CACHE_ENTRY);
+
+struct x509_chain_cache_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(X509_CHAIN_CACHE_ENTRY) *entries;
+    X509_CHAIN_CACHE_ENTRY *oldest, *newest;
+    int max;
+    long timeout;
+};
+
+/* Parameters under which a chain is never taken from or put in the cache */
+#define CHAIN_CACHE_NOCACHE_FLAGS \
+        (X509_V_FLAG_USE_CHECK_TIME | X509_V_FLAG_POLICY_MASK)
+
+static unsigned long chain_cache_entry_hash(const X509_CHAIN_CACHE_ENTRY *e)
+{
+    return ((unsigned long)e->key[0] << 24) | ((unsigned long)e->key[1] << 16)
+        | ((unsigned long)e->key[2] << 8) | e->key[3];
+}
+
+static int chain_cache_entry_cmp(const X509_CHAIN_CACHE_ENTRY *a,
+                                 const X509_CHAIN_CACHE_ENTRY *b)
+{
+    return memcmp(a->key, b->key, sizeof(a->key));
+}
+
+static void chain_cache_entry_free(X509_CHAIN_CACHE_ENTRY *e)
+{
+    sk_X509_pop_free(e->chain, X509_free);
+    OPENSSL_free(e->peername);
+    OPENSSL_free(e);
+}
+
+/* Remove the oldest entry, called with the cache locked for writing */
+static void chain_cache_pop(X509_CHAIN_CACHE *cache)
+{
+    X509_CHAIN_CACHE_ENTRY *e = cache->oldest;
+
+    if (e == NULL)
+        return;
+    cache->oldest = e->next;
+    if (cache->oldest == NULL)
+        cache->newest = NULL;
+    lh_X509_CHAIN_CACHE_ENTRY_delete(cache->entries, e);
+    chain_cache_entry_free(e);
+}
+
+X509_CHAIN_CACHE *x509_chain_cache_new(int max, long timeout)
+{
+    X509_CHAIN_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache == NULL)
+        return NULL;
+    cache->references = 1;
+    cache->max = max;
+    cache->timeout = timeout;
+    cache->lock = CRYPTO_THREAD_lock_new();
+    cache->entries = lh_X509_CHAIN_CACHE_ENTRY_new(chain_cache_entry_hash,
+                                                   chain_cache_entry_cmp);
+    if (cache->lock == NULL || cache->entries == NULL) {
+        x509_chain_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void x509_chain_cache_flush(X509_CHAIN_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    CRYPTO_THREAD_write_lock(cache->lock);
+    while (cache->oldest != NULL)
+        chain_cache_pop(cache);
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+void x509_chain_cache_free(X509_CHAIN_CACHE *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+
+    CRYPTO_DOWN_REF(&cache->references, &i, cache->lock);
+    REF_PRINT_COUNT("X509_CHAIN_CACHE", cache);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    if (cache->entries != NULL) {
+        while (cache->oldest != NULL)
+            chain_cache_pop(cache);
+        lh_X509_CHAIN_CACHE_ENTRY_free(cache->entries);
+    }
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/* Returns a reference to the cache of |store|, or NULL if it has none */
+static X509_CHAIN_CACHE *chain_cache_get_ref(X509_STORE *store)
+{
+    X509_CHAIN_CACHE *cache;
+    int i;
+
+    if (store == NULL)
+        return NULL;
+    CRYPTO_THREAD_read_lock(store->lock);
+    cache = store->chain_cache;
+    if (cache != NULL)
+        CRYPTO_UP_REF(&cache->references, &i, cache->lock);
+    CRYPTO_THREAD_unlock(store->lock);
+    return cache;
+}
+
+static int digest_length(EVP_MD_CTX *mctx, size_t len)
+{
+    unsigned char l[4];
+
+    l[0] = (unsigned char)(len >> 24);
+    l[1] = (unsigned char)(len >> 16);
+    l[2] = (unsigned char)(len >> 8);
+    l[3] = (unsigned char)len;
+    return EVP_DigestUpdate(mctx, l, sizeof(l));
+}
+
+static int digest_string(EVP_MD_CTX *mctx, const void *s, size_t len)
+{
+    return digest_length(mctx, len)
+        && (len == 0 || EVP_DigestUpdate(mctx, s, len));
+}
+
+/*
+ * Work out the cache key for verifying ctx->cert with ctx->param.  The
+ * untrusted certificates are deliberately left out: any valid chain for
+ * the leaf will do.
+ */
+static int chain_cache_key(X509_STORE_CTX *ctx, unsigned char *key)
+{
+    X509_VERIFY_PARAM *vpm = ctx->param;
+    EVP_MD_CTX *mctx = NULL;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdlen;
+    long params[6];
+    int i, ret = 0;
+
+    params[0] = (long)vpm->flags;
+    params[1] = vpm->purpose;
+    params[2] = vpm->trust;
+    params[3] = vpm->depth;
+    params[4] = vpm->auth_level;
+    params[5] = (long)vpm->hostflags;
+
+    if (!X509_digest(ctx->cert, EVP_sha256(), md, &mdlen)
+            || (mctx = EVP_MD_CTX_new()) == NULL
+            || !EVP_DigestInit_ex(mctx, EVP_sha256(), NULL)
+            || !digest_string(mctx, md, mdlen)
+            || !EVP_DigestUpdate(mctx, params, sizeof(params))
+            || !digest_length(mctx, sk_OPENSSL_STRING_num(vpm->hosts)))
+        goto end;
+    for (i = 0; i < sk_OPENSSL_STRING_num(vpm->hosts); i++) {
+        const char *host = sk_OPENSSL_STRING_value(vpm->hosts, i);
+
+        if (!digest_string(mctx, host, strlen(host)))
+            goto end;
+    }
+    if (!digest_string(mctx, vpm->email, vpm->emaillen)
+            || !digest_string(mctx, vpm->ip, vpm->iplen)
+            || !EVP_DigestFinal_ex(mctx, key, NULL))
+        goto end;
+    ret = 1;
+ end:
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+int x509_chain_cache_get(X509_STORE_CTX *ctx, unsigned char *key)
+{
+    X509_CHAIN_CACHE *cache;
+    X509_CHAIN_CACHE_ENTRY tmp, *e;
+    int i, ret = 0;
+
+    if ((ctx->param->flags & CHAIN_CACHE_NOCACHE_FLAGS) != 0
+            || ctx->crls != NULL || ctx->other_ctx != NULL)
+        return -1;
+    if ((cache = chain_cache_get_ref(ctx->ctx)) == NULL)
+        return -1;
+    if (!chain_cache_key(ctx, key)) {
+        x509_chain_cache_free(cache);
+        return -1;
+    }
+
+    memcpy(tmp.key, key, sizeof(tmp.key));
+    CRYPTO_THREAD_read_lock(cache->lock);
+    e = lh_X509_CHAIN_CACHE_ENTRY_retrieve(cache->entries, &tmp);
+    if (e == NULL || e->expires <= time(NULL))
+        goto end;
+
+    /* The cached leaf is an identical copy of ctx->cert, already pushed */
+    for (i = 1; i < sk_X509_num(e->chain); i++) {
+        X509 *x = sk_X509_value(e->chain, i);
+
+        if (!sk_X509_push(ctx->chain, x))
+            goto end;
+        X509_up_ref(x);
+    }
+    if (e->peername != NULL) {
+        OPENSSL_free(ctx->param->peername);
+        ctx->param->peername = OPENSSL_strdup(e->peername);
+    }
+    ctx->num_untrusted = e->num_untrusted;
+    ret = 1;
+ end:
+    CRYPTO_THREAD_unlock(cache->lock);
+    x509_chain_cache_free(cache);
+    if (!ret) {
+        /* Undo any partial copy, leaving just the leaf */
+        while (sk_X509_num(ctx->chain) > 1)
+            X509_free(sk_X509_pop(ctx->chain));
+    }
+    return ret;
+}
+
+void x509_chain_cache_put(X509_STORE_CTX *ctx, const unsigned char *key)
+{
+    X509_CHAIN_CACHE *cache;
+    X509_CHAIN_CACHE_ENTRY *e, *old;
+    time_t now = time(NULL);
+    int i, day, sec;
+
+    /* The cache may have been disabled since x509_chain_cache_get() */
+    if ((cache = chain_cache_get_ref(ctx->ctx)) == NULL)
+        return;
+    if ((e = OPENSSL_zalloc(sizeof(*e))) == NULL) {
+        x509_chain_cache_free(cache);
+        return;
+    }
+    memcpy(e->key, key, sizeof(e->key));
+    e->expires = now + cache->timeout;
+    e->num_untrusted = ctx->num_untrusted;
+    if ((e->chain = X509_chain_up_ref(ctx->chain)) == NULL
+            || (ctx->param->peername != NULL
+                && (e->peername = OPENSSL_strdup(ctx->param->peername))
+                   == NULL)) {
+        chain_cache_entry_free(e);
+        x509_chain_cache_free(cache);
+        return;
+    }
+    /* Never outlive a certificate in the chain */
+    for (i = 0; i < sk_X509_num(e->chain); i++) {
+        const ASN1_TIME *na = X509_get0_notAfter(sk_X509_value(e->chain, i));
+
+        if (!ASN1_TIME_diff(&day, &sec, NULL, na)
+                || day < 0 || sec < 0) {
+            chain_cache_entry_free(e);
+            x509_chain_cache_free(cache);
+            return;
+        }
+        if ((long)day * 86400 + sec < e->expires - now)
+            e->expires = now + (long)day * 86400 + sec;
+    }
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    while (cache->oldest != NULL
+           && (lh_X509_CHAIN_CACHE_ENTRY_num_items(cache->entries)
+                   >= (unsigned long)cache->max
+               || cache->oldest->expires <= now))
+        chain_cache_pop(cache);
+    old = lh_X509_CHAIN_CACHE_ENTRY_retrieve(cache->entries, e);
+    if (old != NULL
+            || (lh_X509_CHAIN_CACHE_ENTRY_insert(cache->entries, e) == NULL
+                && lh_X509_CHAIN_CACHE_ENTRY_error(cache->entries))) {
+        /* Another thread got there first, or we ran out of memory */
+        CRYPTO_THREAD_unlock(cache->lock);
+        chain_cache_entry_free(e);
+        x509_chain_cache_free(cache);
+        return;
+    }
+    if (cache->newest != NULL)
+        cache->newest->next = e;
+    else
+        cache->oldest = e;
+    cache->newest = e;
+    CRYPTO_THREAD_unlock(cache->lock);
+    x509_chain_cache_free(cache);
+}
@@ -249,10 +249,34 @@ static int verify_chain(X509_STORE_CTX *ctx)
     return ok;
 }
 
+/*
+ * The chain was taken from the store's cache of chains verified earlier with
+ * the same parameters: report success at each depth as internal_verify()
+ * does.
+ */
+static int verify_cached_chain(X509_STORE_CTX *ctx)
+{
+    int n = sk_X509_num(ctx->chain) - 1;
+    X509 *xi = sk_X509_value(ctx->chain, n);
+    X509 *xs;
+
+    for (; n >= 0; n--) {
+        xs = sk_X509_value(ctx->chain, n);
+        ctx->current_issuer = xi;
+        ctx->current_cert = xs;
+        ctx->error_depth = n;
+        if (!ctx->verify_cb(1, ctx))
+            return 0;
+        xi = xs;
+    }
+    return 1;
+}
+
 int X509_verify_cert(X509_STORE_CTX *ctx)
 {
     SSL_DANE *dane = ctx->dane;
-    int ret;
+    unsigned char key[X509_CHAIN_CACHE_KEYLEN];
+    int ret, cached = -1;
 
     if (ctx->cert == NULL) {
         X509err(X509_F_X509_VERIFY_CERT, X509_R_NO_CERT_SET_FOR_US_TO_VERIFY);
@@ -288,10 +312,18 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
         !verify_cb_cert(ctx, ctx->cert, 0, X509_V_ERR_EE_KEY_TOO_SMALL))
         return 0;
 
-    if (DANETLS_ENABLED(dane))
+    if (!DANETLS_ENABLED(dane) && ctx->verify == internal_verify)
+        cached = x509_chain_cache_get(ctx, key);
+
+    if (cached > 0) {
+        ret = verify_cached_chain(ctx);
+    } else if (DANETLS_ENABLED(dane)) {
         ret = dane_verify(ctx);
-    else
+    } else {
         ret = verify_chain(ctx);
+        if (cached == 0 && ret > 0 && ctx->error == X509_V_OK)
+            x509_chain_cache_put(ctx, key);
+    }
 
     /*
      * Safety-net.  If we are returning an error, we must also set ctx->error,
@@ -1531,6 +1563,7 @@ static int check_crl(X509_STORE_CTX *ctx, X509_CRL *crl)
 static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x)
 {
     X509_REVOKED *rev;
+    int i;
 
     /*
      * The rules changed for this... previously if a CRL contained unhandled
@@ -1544,9 +1577,15 @@ static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x)
         return 0;
     /*
      * Look for serial number of certificate in CRL.  If found, make sure
-     * reason is not removeFromCRL.
+     * reason is not removeFromCRL.  If it can't be looked up, don't treat
+     * the certificate as not revoked.
      */
-    if (X509_CRL_get0_by_cert(crl, &rev, x)) {
+    i = X509_CRL_get0_by_cert(crl, &rev, x);
+    if (i < 0) {
+        ctx->error = X509_V_ERR_UNSPECIFIED;
+        return 0;
+    }
+    if (i > 0) {
         if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
             return 2;
         if (!verify_cb_crl(ctx, X509_V_ERR_CERT_REVOKED))
@@ -1888,7 +1927,7 @@ X509_CRL *X509_CRL_diff(X509_CRL *base, X509_CRL *newer,
                         EVP_PKEY *skey, const EVP_MD *md, unsigned int flags)
 {
     X509_CRL *crl = NULL;
-    int i;
+    int i, j;
     STACK_OF(X509_REVOKED) *revs = NULL;
     /* CRLs can't be delta already */
     if (base->base_crl_number || newer->base_crl_number) {
@@ -1966,7 +2005,10 @@ X509_CRL *X509_CRL_diff(X509_CRL *base, X509_CRL *newer,
          * Add only if not also in base. TODO: need something cleverer here
          * for some more complex CRLs covering multiple CAs.
          */
-        if (!X509_CRL_get0_by_serial(base, &rvtmp, &rvn->serialNumber)) {
+        j = X509_CRL_get0_by_serial(base, &rvtmp, &rvn->serialNumber);
+        if (j < 0)
+            goto memerr;
+        if (j == 0) {
             rvtmp = X509_REVOKED_dup(rvn);
             if (!rvtmp)
                 goto memerr;
@@ -51,6 +51,9 @@ int X509_CRL_sort(X509_CRL *c)
 {
     int i;
     X509_REVOKED *r;
+
+    if (!x509_crl_unindex(c))
+        return 0;
     /*
      * sort the data so it will be written in serial number order
      */
@@ -177,6 +180,8 @@ const STACK_OF(X509_EXTENSION) *X509_REVOKED_get0_extensions(const X509_REVOKED
 
 int i2d_re_X509_CRL_tbs(X509_CRL *crl, unsigned char **pp)
 {
+    if (!x509_crl_unindex(crl))
+        return -1;
     crl->crl.enc.modified = 1;
     return i2d_X509_CRL_INFO(&crl->crl, pp);
 }
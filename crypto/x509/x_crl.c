@@ -18,6 +18,9 @@
 static int X509_REVOKED_cmp(const X509_REVOKED *const *a,
                             const X509_REVOKED *const *b);
 static void setup_idp(X509_CRL *crl, ISSUING_DIST_POINT *idp);
+static void crl_index_free(X509_CRL_INDEX *index);
+static int crl_index_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                            ASN1_INTEGER *serial, X509_NAME *issuer);
 
 ASN1_SEQUENCE(X509_REVOKED) = {
         ASN1_EMBED(X509_REVOKED,serialNumber, ASN1_INTEGER),
@@ -169,6 +172,13 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         crl->issuers = NULL;
         crl->crl_number = NULL;
         crl->base_crl_number = NULL;
+        crl->index = NULL;
+        break;
+
+    case ASN1_OP_D2I_PRE:
+        /* The index refers to the encoding being replaced */
+        crl_index_free(crl->index);
+        crl->index = NULL;
         break;
 
     case ASN1_OP_D2I_POST:
@@ -240,6 +250,7 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ASN1_INTEGER_free(crl->crl_number);
         ASN1_INTEGER_free(crl->base_crl_number);
         sk_GENERAL_NAMES_pop_free(crl->issuers, GENERAL_NAMES_free);
+        crl_index_free(crl->index);
         break;
     }
     return 1;
@@ -310,6 +321,8 @@ int X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev)
 {
     X509_CRL_INFO *inf;
     inf = &crl->crl;
+    if (!x509_crl_unindex(crl))
+        return 0;
     if (inf->revoked == NULL)
         inf->revoked = sk_X509_REVOKED_new(X509_REVOKED_cmp);
     if (inf->revoked == NULL || !sk_X509_REVOKED_push(inf->revoked, rev)) {
@@ -383,6 +396,12 @@ static int def_crl_lookup(X509_CRL *crl,
 {
     X509_REVOKED rtmp, *rev;
     int idx;
+
+    if (crl->index != NULL) {
+        idx = crl_index_lookup(crl, ret, serial, issuer);
+        if (idx != 0 || crl->crl.revoked == NULL)
+            return idx;
+    }
     rtmp.serialNumber = *serial;
     /*
      * Sort revoked into serial number order if not already sorted. Do this
@@ -412,6 +431,489 @@ static int def_crl_lookup(X509_CRL *crl,
     return 0;
 }
 
+/*
+ * Index of the revoked entries of a CRL decoded by d2i_X509_CRL_indexed().
+ * The entries stay encoded in the cached encoding of the TBSCertList, which
+ * the index points into, and only their serial numbers and reason codes
+ * are extracted.  An entry is decoded
+ * into an X509_REVOKED structure when a lookup has to return it.
+ */
+
+typedef struct crl_index_entry_st {
+    const unsigned char *serial;    /* contents of the serialNumber */
+    const unsigned char *der;       /* whole entry */
+    int serial_len;
+    int der_len;
+    int reason;
+    X509_REVOKED *rev;              /* decoded on demand, under crl->lock */
+} CRL_INDEX_ENTRY;
+
+struct x509_crl_index_st {
+    CRL_INDEX_ENTRY *entries;
+    int num;
+    /* Open addressing hash table of entry numbers plus one, 0 if unused */
+    unsigned int *table;
+    unsigned int mask;
+};
+
+static void crl_index_free(X509_CRL_INDEX *index)
+{
+    int i;
+
+    if (index == NULL)
+        return;
+    for (i = 0; i < index->num; i++)
+        X509_REVOKED_free(index->entries[i].rev);
+    OPENSSL_free(index->entries);
+    OPENSSL_free(index->table);
+    OPENSSL_free(index);
+}
+
+static unsigned int crl_index_hash(const unsigned char *serial, int len)
+{
+    unsigned int h = 2166136261U;
+
+    while (len-- > 0)
+        h = (h ^ *serial++) * 16777619U;
+    return h;
+}
+
+/*
+ * Get the header of the next DER element in |*pp|, which must fit in |max|
+ * bytes and have a definite length.  Returns the constructed bit, or -1.
+ */
+static int crl_index_get(const unsigned char **pp, long *plen, int *ptag,
+                         int *pclass, long max)
+{
+    int ret = ASN1_get_object(pp, plen, ptag, pclass, max);
+
+    if (ret & 0x81)
+        return -1;
+    return ret & V_ASN1_CONSTRUCTED;
+}
+
+/* Check the contents of an OBJECT IDENTIFIER, as c2i_ASN1_OBJECT() does */
+static int crl_index_oid_ok(const unsigned char *p, long len)
+{
+    long i;
+
+    if (len <= 0 || (p[len - 1] & 0x80) != 0)
+        return 0;
+    for (i = 0; i < len; i++) {
+        if (p[i] == 0x80 && (i == 0 || (p[i - 1] & 0x80) == 0))
+            return 0;
+    }
+    return 1;
+}
+
+static int crl_index_oid_is(const unsigned char *p, long len,
+                            const ASN1_OBJECT *obj)
+{
+    return (size_t)len == OBJ_length(obj)
+           && memcmp(p, OBJ_get0_data(obj), len) == 0;
+}
+
+/*
+ * Index the entry of the revokedCertificates at |*pp|, which is no longer
+ * than |max| bytes.  Returns 0 if it is not an entry the index can handle,
+ * or is not valid.  An entry with a certificateIssuer extension, which
+ * applies to all the entries following it, is not handled.  Anything that
+ * d2i_X509_REVOKED() would reject must be rejected here, so that an entry
+ * can always be decoded when a lookup finds it.
+ */
+static int crl_index_entry(CRL_INDEX_ENTRY *ent, const unsigned char **pp,
+                           long max, int *flags)
+{
+    const ASN1_OBJECT *reason = OBJ_nid2obj(NID_crl_reason);
+    const ASN1_OBJECT *cissuer = OBJ_nid2obj(NID_certificate_issuer);
+    const unsigned char *p = *pp, *end, *extend, *ext, *oid;
+    ASN1_STRING tm;
+    long len, oidlen;
+    int tag, xclass, crit, seen_reason = 0;
+
+    /* SEQUENCE { serialNumber, revocationDate, crlEntryExtensions } */
+    if (crl_index_get(&p, &len, &tag, &xclass, max) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    end = p + len;
+    ent->der = *pp;
+    ent->der_len = end - *pp;
+    ent->reason = CRL_REASON_NONE;
+    ent->rev = NULL;
+
+    if (crl_index_get(&p, &len, &tag, &xclass, end - p) != 0
+            || tag != V_ASN1_INTEGER || xclass != V_ASN1_UNIVERSAL
+            || len == 0 || len > INT_MAX)
+        return 0;
+    /* Reject padding, as c2i_ASN1_INTEGER() does */
+    if (len > 1 && ((p[0] == 0 && (p[1] & 0x80) == 0)
+                    || (p[0] == 0xff && (p[1] & 0x80) != 0)))
+        return 0;
+    ent->serial = p;
+    ent->serial_len = (int)len;
+    p += len;
+
+    if (crl_index_get(&p, &len, &tag, &xclass, end - p) != 0
+            || (tag != V_ASN1_UTCTIME && tag != V_ASN1_GENERALIZEDTIME)
+            || xclass != V_ASN1_UNIVERSAL || len > INT_MAX)
+        return 0;
+    tm.type = tag;
+    tm.data = (unsigned char *)p;
+    tm.length = (int)len;
+    tm.flags = 0;
+    if (!ASN1_TIME_check(&tm))
+        return 0;
+    p += len;
+
+    if (p < end) {
+        if (crl_index_get(&p, &len, &tag, &xclass, end - p)
+                != V_ASN1_CONSTRUCTED
+                || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL
+                || p + len != end)
+            return 0;
+        while (p < end) {
+            /* SEQUENCE { extnID, critical DEFAULT FALSE, extnValue } */
+            if (crl_index_get(&p, &len, &tag, &xclass, end - p)
+                    != V_ASN1_CONSTRUCTED || tag != V_ASN1_SEQUENCE
+                    || xclass != V_ASN1_UNIVERSAL)
+                return 0;
+            extend = p + len;
+            if (crl_index_get(&p, &oidlen, &tag, &xclass, extend - p) != 0
+                    || tag != V_ASN1_OBJECT || xclass != V_ASN1_UNIVERSAL
+                    || !crl_index_oid_ok(p, oidlen))
+                return 0;
+            oid = p;
+            p += oidlen;
+            crit = 0;
+            if (crl_index_get(&p, &len, &tag, &xclass, extend - p) != 0)
+                return 0;
+            if (xclass != V_ASN1_UNIVERSAL)
+                return 0;
+            if (tag == V_ASN1_BOOLEAN) {
+                if (len != 1)
+                    return 0;
+                crit = *p != 0;
+                p += len;
+                if (crl_index_get(&p, &len, &tag, &xclass, extend - p) != 0
+                        || xclass != V_ASN1_UNIVERSAL)
+                    return 0;
+            }
+            if (tag != V_ASN1_OCTET_STRING || p + len != extend)
+                return 0;
+            ext = p;
+            p = extend;
+
+            if (crl_index_oid_is(oid, oidlen, cissuer))
+                return 0;
+            if (crit)
+                *flags |= EXFLAG_CRITICAL;
+            if (crl_index_oid_is(oid, oidlen, reason)) {
+                /*
+                 * A small ENUMERATED is all we need to handle.  A CRL with
+                 * two reasons in an entry is invalid, see crl_set_issuers().
+                 */
+                if (seen_reason++
+                        || crl_index_get(&ext, &len, &tag, &xclass,
+                                         extend - ext) != 0
+                        || tag != V_ASN1_ENUMERATED
+                        || xclass != V_ASN1_UNIVERSAL || len != 1
+                        || (*ext & 0x80) != 0 || ext + len != extend)
+                    return 0;
+                ent->reason = *ext;
+            }
+        }
+    }
+
+    *pp = end;
+    return 1;
+}
+
+/*
+ * Index the revokedCertificates, whose contents are the |len| bytes at |p|.
+ */
+static int crl_index_build(X509_CRL_INDEX *index, const unsigned char *p,
+                           long len, int *flags)
+{
+    const unsigned char *q, *end = p + len;
+    CRL_INDEX_ENTRY *ent;
+    unsigned int size, h;
+    long elen;
+    int tag, xclass, i;
+
+    /* Count the entries first, to allocate them all at once */
+    for (q = p, index->num = 0; q < end; q += elen, index->num++) {
+        if (crl_index_get(&q, &elen, &tag, &xclass, end - q)
+                != V_ASN1_CONSTRUCTED || index->num == INT_MAX / 2)
+            return 0;
+    }
+    if (index->num == 0)
+        return 1;
+    for (size = 16; size < (unsigned int)index->num * 2; size <<= 1)
+        continue;
+    index->mask = size - 1;
+    index->entries = OPENSSL_malloc(sizeof(*index->entries) * index->num);
+    index->table = OPENSSL_zalloc(sizeof(*index->table) * size);
+    if (index->entries == NULL || index->table == NULL)
+        return -1;
+
+    for (i = 0, ent = index->entries; i < index->num; i++, ent++) {
+        if (!crl_index_entry(ent, &p, end - p, flags)) {
+            /* Nothing to free in the entries decoded so far */
+            index->num = 0;
+            return 0;
+        }
+        h = crl_index_hash(ent->serial, ent->serial_len);
+        while (index->table[h & index->mask] != 0)
+            h++;
+        index->table[h & index->mask] = i + 1;
+    }
+    return 1;
+}
+
+static int crl_index_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                            ASN1_INTEGER *serial, X509_NAME *issuer)
+{
+    X509_CRL_INDEX *index = crl->index;
+    CRL_INDEX_ENTRY *ent = NULL;
+    unsigned char buf[32], *der = buf, *p;
+    const unsigned char *q;
+    unsigned int h, i;
+    long clen;
+    int len, tag, xclass;
+
+    if (index->num == 0)
+        return 0;
+    /*
+     * Encode the serial number as it is in the CRL.  If that can't be done
+     * we can't tell whether it is there, so fail rather than say it isn't.
+     */
+    len = i2d_ASN1_INTEGER(serial, NULL);
+    if (len <= 0)
+        return -1;
+    if ((size_t)len > sizeof(buf) && (der = OPENSSL_malloc(len)) == NULL) {
+        X509err(X509_F_CRL_INDEX_LOOKUP, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    p = der;
+    i2d_ASN1_INTEGER(serial, &p);
+    q = der;
+    if (crl_index_get(&q, &clen, &tag, &xclass, len) != 0) {
+        if (der != buf)
+            OPENSSL_free(der);
+        return -1;
+    }
+
+    for (h = crl_index_hash(q, clen); (i = index->table[h & index->mask]);
+         h++) {
+        ent = &index->entries[i - 1];
+        if (ent->serial_len == clen && memcmp(ent->serial, q, clen) == 0)
+            break;
+        ent = NULL;
+    }
+    if (der != buf)
+        OPENSSL_free(der);
+    /* All entries have the CRL issuer, none has a certificateIssuer */
+    if (ent == NULL
+            || (issuer != NULL
+                && X509_NAME_cmp(issuer, X509_CRL_get_issuer(crl)) != 0))
+        return 0;
+
+    if (ret != NULL) {
+        CRYPTO_THREAD_write_lock(crl->lock);
+        if (ent->rev == NULL) {
+            const unsigned char *in = ent->der;
+
+            ent->rev = d2i_X509_REVOKED(NULL, &in, ent->der_len);
+            if (ent->rev != NULL) {
+                ent->rev->reason = ent->reason;
+                ent->rev->sequence = (int)(ent - index->entries);
+            }
+        }
+        *ret = ent->rev;
+        CRYPTO_THREAD_unlock(crl->lock);
+        /* The entry is there, so it mustn't be reported as missing */
+        if (*ret == NULL)
+            return -1;
+    }
+    return ent->reason == CRL_REASON_REMOVE_FROM_CRL ? 2 : 1;
+}
+
+/*
+ * Decode all the entries of an indexed CRL into crl->crl.revoked, ahead of
+ * any added since, and drop the index.  Anything that makes the CRL be
+ * re-encoded has to call this first, or the indexed entries would be lost.
+ */
+int x509_crl_unindex(X509_CRL *crl)
+{
+    X509_CRL_INDEX *index = crl->index;
+    STACK_OF(X509_REVOKED) *revoked;
+    CRL_INDEX_ENTRY *ent;
+    int i;
+
+    if (index == NULL)
+        return 1;
+
+    for (i = 0; i < index->num; i++) {
+        ent = &index->entries[i];
+        if (ent->rev == NULL) {
+            const unsigned char *in = ent->der;
+
+            ent->rev = d2i_X509_REVOKED(NULL, &in, ent->der_len);
+            if (ent->rev == NULL) {
+                X509err(X509_F_X509_CRL_UNINDEX, ERR_R_NESTED_ASN1_ERROR);
+                return 0;
+            }
+            ent->rev->reason = ent->reason;
+            ent->rev->sequence = i;
+        }
+    }
+
+    revoked = sk_X509_REVOKED_new(X509_REVOKED_cmp);
+    if (revoked == NULL)
+        goto err;
+    for (i = 0; i < index->num; i++)
+        if (!sk_X509_REVOKED_push(revoked, index->entries[i].rev))
+            goto err;
+    for (i = 0; i < sk_X509_REVOKED_num(crl->crl.revoked); i++)
+        if (!sk_X509_REVOKED_push(revoked,
+                                  sk_X509_REVOKED_value(crl->crl.revoked, i)))
+            goto err;
+
+    /* The entries now belong to the stack */
+    for (i = 0; i < index->num; i++)
+        index->entries[i].rev = NULL;
+    crl_index_free(index);
+    crl->index = NULL;
+    sk_X509_REVOKED_free(crl->crl.revoked);
+    crl->crl.revoked = revoked;
+    return 1;
+
+ err:
+    sk_X509_REVOKED_free(revoked);
+    X509err(X509_F_X509_CRL_UNINDEX, ERR_R_MALLOC_FAILURE);
+    return 0;
+}
+
+/*
+ * Decode a CRL, leaving the revoked entries in their encoded form and
+ * indexing their serial numbers.  CRLs that can't be indexed are decoded in
+ * full.
+ */
+X509_CRL *d2i_X509_CRL_indexed(X509_CRL **a, const unsigned char **pp,
+                               long length)
+{
+    const unsigned char *p = *pp, *q, *crl_end, *tbs, *tbs_end, *rev = NULL;
+    unsigned char *enc = NULL, *stripped = NULL, *s;
+    X509_CRL_INDEX *index = NULL;
+    X509_CRL *ret = NULL;
+    long len, rev_len = 0, tbs_len, outer_len;
+    int tag, xclass, seen_time = 0, flags = 0, i, total;
+
+    /* CertificateList: SEQUENCE { tbsCertList, signatureAlgorithm, sig } */
+    if (crl_index_get(&p, &len, &tag, &xclass, length) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE)
+        goto full;
+    crl_end = p + len;
+    tbs = p;
+    if (crl_index_get(&p, &len, &tag, &xclass, crl_end - p)
+            != V_ASN1_CONSTRUCTED || tag != V_ASN1_SEQUENCE)
+        goto full;
+    tbs_end = p + len;
+
+    /* The revokedCertificates are the first SEQUENCE after thisUpdate */
+    while (p < tbs_end) {
+        q = p;
+        i = crl_index_get(&p, &len, &tag, &xclass, tbs_end - p);
+        if (i < 0)
+            goto full;
+        if (xclass == V_ASN1_UNIVERSAL) {
+            if (tag == V_ASN1_UTCTIME || tag == V_ASN1_GENERALIZEDTIME) {
+                seen_time = 1;
+            } else if (seen_time && tag == V_ASN1_SEQUENCE) {
+                rev = q;
+                rev_len = p + len - q;
+                break;
+            }
+        }
+        p += len;
+    }
+    if (rev == NULL)
+        goto full;
+
+    /* The index points into the encoding that the CRL will keep */
+    index = OPENSSL_zalloc(sizeof(*index));
+    if (index == NULL || (enc = OPENSSL_memdup(tbs, tbs_end - tbs)) == NULL)
+        goto err;
+    i = crl_index_build(index, enc + (p - tbs), len, &flags);
+    if (i < 0)
+        goto err;
+    if (i == 0)
+        goto full;
+
+    /* Decode a copy of the CRL without the revokedCertificates */
+    q = tbs;
+    crl_index_get(&q, &len, &tag, &xclass, tbs_end - tbs);
+    tbs_len = len - rev_len;
+    outer_len = ASN1_object_size(1, tbs_len, V_ASN1_SEQUENCE)
+                + (crl_end - tbs_end);
+    total = ASN1_object_size(1, outer_len, V_ASN1_SEQUENCE);
+    if (total <= 0 || (stripped = OPENSSL_malloc(total)) == NULL)
+        goto err;
+    s = stripped;
+    ASN1_put_object(&s, 1, outer_len, V_ASN1_SEQUENCE, V_ASN1_UNIVERSAL);
+    ASN1_put_object(&s, 1, tbs_len, V_ASN1_SEQUENCE, V_ASN1_UNIVERSAL);
+    memcpy(s, q, rev - q);
+    s += rev - q;
+    memcpy(s, rev + rev_len, crl_end - (rev + rev_len));
+    s += crl_end - (rev + rev_len);
+
+    /*
+     * Let the full decoder report any errors.  Other methods may expect to
+     * see all the entries, so they get them.
+     */
+    q = stripped;
+    ret = d2i_X509_CRL(NULL, &q, total);
+    if (ret == NULL || q != s || ret->meth != &int_crl_meth) {
+        X509_CRL_free(ret);
+        ret = NULL;
+        goto full;
+    }
+    OPENSSL_free(stripped);
+
+    /*
+     * Restore the original encoding, to verify the signature with, and
+     * recompute the hash of the CRL from it.
+     */
+    OPENSSL_free(ret->crl.enc.enc);
+    ret->crl.enc.enc = enc;
+    ret->crl.enc.len = tbs_end - tbs;
+    ret->crl.enc.modified = 0;
+    ASN1_item_digest(ASN1_ITEM_rptr(X509_CRL), EVP_sha1(), ret,
+                     ret->sha1_hash, NULL);
+    ret->flags |= flags;
+    ret->index = index;
+
+    *pp = crl_end;
+    if (a != NULL) {
+        X509_CRL_free(*a);
+        *a = ret;
+    }
+    return ret;
+
+ err:
+    ASN1err(ASN1_F_D2I_X509_CRL_INDEXED, ERR_R_MALLOC_FAILURE);
+    crl_index_free(index);
+    OPENSSL_free(enc);
+    OPENSSL_free(stripped);
+    return NULL;
+
+ full:
+    crl_index_free(index);
+    OPENSSL_free(enc);
+    OPENSSL_free(stripped);
+    return d2i_X509_CRL(a, pp, length);
+}
+
 void X509_CRL_set_default_method(const X509_CRL_METHOD *meth)
 {
     if (meth == NULL)
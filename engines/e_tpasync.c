@@ -0,0 +1,512 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A software offload engine: RSA private key operations, ECDSA signatures
+ * and ECDH key derivation are run by a pool of worker threads.  When called
+ * from within an ASYNC_JOB the job is paused until the worker is done.  The
+ * worker then calls the callback of the job's ASYNC_WAIT_CTX if it has one,
+ * or else makes its wait fd readable.  Outside of a job the operation is
+ * done on the calling thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/engine.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/async.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+
+#if defined(OPENSSL_SYS_UNIX) && defined(OPENSSL_THREADS)
+# define TPASYNC_IMPLEMENTED
+# include <unistd.h>
+# include <fcntl.h>
+# include <pthread.h>
+#endif
+
+#include "e_tpasync_err.c"
+
+static const char *engine_tpasync_id = "tpasync";
+static const char *engine_tpasync_name = "Thread pool async offload engine";
+
+#ifdef TPASYNC_IMPLEMENTED
+
+#define TPASYNC_CMD_THREADS     ENGINE_CMD_BASE
+
+static const ENGINE_CMD_DEFN tpasync_cmd_defns[] = {
+    {TPASYNC_CMD_THREADS,
+     "THREADS",
+     "Number of worker threads, 0 for one per CPU (default)",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {0, NULL, NULL, 0}
+};
+
+/* Errors raised by a worker, handed back to the caller */
+# define TPASYNC_MAX_ERRORS     4
+
+typedef struct tpasync_req_st TPASYNC_REQ;
+struct tpasync_req_st {
+    TPASYNC_REQ *next;
+    /* The operation, run by a worker thread */
+    void (*run)(TPASYNC_REQ *req);
+    union {
+        struct {
+            int (*fn)(int flen, const unsigned char *from, unsigned char *to,
+                      RSA *rsa, int padding);
+            int flen;
+            const unsigned char *from;
+            unsigned char *to;
+            RSA *rsa;
+            int padding;
+        } rsa;
+        struct {
+            ECDSA_SIG *(*fn)(const unsigned char *dgst, int dgst_len,
+                             const BIGNUM *in_kinv, const BIGNUM *in_r,
+                             EC_KEY *eckey);
+            const unsigned char *dgst;
+            int dgst_len;
+            const BIGNUM *kinv;
+            const BIGNUM *r;
+            EC_KEY *eckey;
+            ECDSA_SIG *sig;
+        } ecdsa;
+        struct {
+            int (*fn)(unsigned char **psec, size_t *pseclen,
+                      const EC_POINT *pub_key, const EC_KEY *ecdh);
+            unsigned char **psec;
+            size_t *pseclen;
+            const EC_POINT *pub_key;
+            const EC_KEY *ecdh;
+        } ecdh;
+    } u;
+    int ret;
+    /* How to wake the job: its callback if it has one, or else a pipe */
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    int writefd;
+    int done;
+    size_t numerrs;
+    struct {
+        unsigned long code;
+        const char *file;
+        int line;
+    } errs[TPASYNC_MAX_ERRORS];
+};
+
+static pthread_mutex_t tp_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tp_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t tp_done_cond = PTHREAD_COND_INITIALIZER;
+static TPASYNC_REQ *tp_head = NULL, *tp_tail = NULL;
+static pthread_t *tp_threads = NULL;
+static size_t tp_num_threads = 0;
+static int tp_stopping = 0;
+static long tp_cfg_threads = 0;
+
+static void *tpasync_worker(void *arg)
+{
+    TPASYNC_REQ *req;
+    unsigned long err;
+    const char *file;
+    int line;
+    char buf = 'X';
+
+    for (;;) {
+        pthread_mutex_lock(&tp_lock);
+        while (tp_head == NULL && !tp_stopping)
+            pthread_cond_wait(&tp_cond, &tp_lock);
+        if (tp_head == NULL) {
+            pthread_mutex_unlock(&tp_lock);
+            break;
+        }
+        req = tp_head;
+        if ((tp_head = req->next) == NULL)
+            tp_tail = NULL;
+        pthread_mutex_unlock(&tp_lock);
+
+        req->run(req);
+        req->numerrs = 0;
+        while ((err = ERR_get_error_line(&file, &line)) != 0) {
+            if (req->numerrs < TPASYNC_MAX_ERRORS) {
+                req->errs[req->numerrs].code = err;
+                req->errs[req->numerrs].file = file;
+                req->errs[req->numerrs].line = line;
+                req->numerrs++;
+            }
+        }
+
+        /*
+         * Wake the job before marking the request as done: the request is
+         * gone as soon as the job sees it done.
+         */
+        if (req->callback != NULL) {
+            req->callback(req->callback_arg);
+        } else if (write(req->writefd, &buf, 1) < 0) {
+            /* Nothing to do, the job finds out when it next runs */
+        }
+        pthread_mutex_lock(&tp_lock);
+        req->done = 1;
+        pthread_cond_broadcast(&tp_done_cond);
+        pthread_mutex_unlock(&tp_lock);
+    }
+    OPENSSL_thread_stop();
+    return NULL;
+}
+
+static void tpasync_stop_threads(void)
+{
+    size_t i;
+
+    pthread_mutex_lock(&tp_lock);
+    tp_stopping = 1;
+    pthread_cond_broadcast(&tp_cond);
+    pthread_mutex_unlock(&tp_lock);
+    for (i = 0; i < tp_num_threads; i++)
+        pthread_join(tp_threads[i], NULL);
+    OPENSSL_free(tp_threads);
+    tp_threads = NULL;
+    tp_num_threads = 0;
+    tp_stopping = 0;
+}
+
+static int tpasync_init(ENGINE *e)
+{
+    long num = tp_cfg_threads;
+
+    if (num == 0)
+        num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num <= 0)
+        num = 1;
+
+    tp_threads = OPENSSL_malloc(num * sizeof(*tp_threads));
+    if (tp_threads == NULL) {
+        TPASYNCerr(TPASYNC_F_TPASYNC_INIT, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (tp_num_threads = 0; tp_num_threads < (size_t)num; tp_num_threads++) {
+        if (pthread_create(&tp_threads[tp_num_threads], NULL,
+                           tpasync_worker, NULL) != 0) {
+            TPASYNCerr(TPASYNC_F_TPASYNC_INIT,
+                       TPASYNC_R_THREAD_CREATE_FAILED);
+            tpasync_stop_threads();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int tpasync_finish(ENGINE *e)
+{
+    tpasync_stop_threads();
+    return 1;
+}
+
+static void wait_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
+                         OSSL_ASYNC_FD readfd, void *pvwritefd)
+{
+    OSSL_ASYNC_FD *pwritefd = (OSSL_ASYNC_FD *)pvwritefd;
+
+    close(readfd);
+    close(*pwritefd);
+    OPENSSL_free(pwritefd);
+}
+
+/* Get the pipe that wakes |waitctx|, creating it if needed */
+static int tpasync_get_pipe(ASYNC_WAIT_CTX *waitctx, int *readfd,
+                            int *writefd)
+{
+    OSSL_ASYNC_FD pipefds[2], *pwritefd;
+
+    if (ASYNC_WAIT_CTX_get_fd(waitctx, engine_tpasync_id, readfd,
+                              (void **)&pwritefd)) {
+        *writefd = *pwritefd;
+        return 1;
+    }
+
+    if ((pwritefd = OPENSSL_malloc(sizeof(*pwritefd))) == NULL)
+        return 0;
+    if (pipe(pipefds) != 0) {
+        OPENSSL_free(pwritefd);
+        return 0;
+    }
+    *pwritefd = pipefds[1];
+    if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, engine_tpasync_id, pipefds[0],
+                                    pwritefd, wait_cleanup)) {
+        wait_cleanup(waitctx, engine_tpasync_id, pipefds[0], pwritefd);
+        return 0;
+    }
+    *readfd = pipefds[0];
+    *writefd = pipefds[1];
+    return 1;
+}
+
+/*
+ * Run |req|, on a worker thread if called from within a job, and return
+ * its result.
+ */
+static int tpasync_submit(TPASYNC_REQ *req)
+{
+    ASYNC_JOB *job = ASYNC_get_current_job();
+    ASYNC_WAIT_CTX *waitctx;
+    int readfd = -1;
+    size_t i;
+    char buf;
+
+    /* Nothing to gain unless the caller can get on with something else */
+    if (job == NULL || tp_num_threads == 0)
+        goto direct;
+    waitctx = ASYNC_get_wait_ctx(job);
+    req->callback = NULL;
+    if (ASYNC_WAIT_CTX_get_callback(waitctx, &req->callback,
+                                    &req->callback_arg))
+        ASYNC_WAIT_CTX_set_status(waitctx, ASYNC_STATUS_OK);
+    else if (!tpasync_get_pipe(waitctx, &readfd, &req->writefd))
+        goto direct;
+
+    req->next = NULL;
+    req->done = 0;
+    pthread_mutex_lock(&tp_lock);
+    if (tp_tail != NULL)
+        tp_tail->next = req;
+    else
+        tp_head = req;
+    tp_tail = req;
+    pthread_cond_signal(&tp_cond);
+    pthread_mutex_unlock(&tp_lock);
+
+    /*
+     * Always pause, even if a worker got there first: the application
+     * has been woken and has other jobs to get on with.  We may be resumed
+     * early by an application that polls its jobs, or not have paused at
+     * all if pausing is blocked: just wait.
+     */
+    ASYNC_pause_job();
+    pthread_mutex_lock(&tp_lock);
+    while (!req->done)
+        pthread_cond_wait(&tp_done_cond, &tp_lock);
+    pthread_mutex_unlock(&tp_lock);
+    /* Clear the wake signal */
+    if (readfd != -1 && read(readfd, &buf, 1) < 0)
+        return 0;
+
+    for (i = 0; i < req->numerrs; i++)
+        ERR_PUT_error(ERR_GET_LIB(req->errs[i].code),
+                      ERR_GET_FUNC(req->errs[i].code),
+                      ERR_GET_REASON(req->errs[i].code),
+                      req->errs[i].file, req->errs[i].line);
+    return req->ret;
+
+ direct:
+    req->run(req);
+    return req->ret;
+}
+
+/* RSA */
+
+static RSA_METHOD *tpasync_rsa_method = NULL;
+
+static void tpasync_rsa_run(TPASYNC_REQ *req)
+{
+    req->ret = req->u.rsa.fn(req->u.rsa.flen, req->u.rsa.from, req->u.rsa.to,
+                             req->u.rsa.rsa, req->u.rsa.padding);
+}
+
+static int tpasync_rsa_priv(int (*fn)(int flen, const unsigned char *from,
+                                      unsigned char *to, RSA *rsa,
+                                      int padding),
+                            int flen, const unsigned char *from,
+                            unsigned char *to, RSA *rsa, int padding)
+{
+    TPASYNC_REQ req;
+
+    req.run = tpasync_rsa_run;
+    req.u.rsa.fn = fn;
+    req.u.rsa.flen = flen;
+    req.u.rsa.from = from;
+    req.u.rsa.to = to;
+    req.u.rsa.rsa = rsa;
+    req.u.rsa.padding = padding;
+    return tpasync_submit(&req);
+}
+
+static int tpasync_rsa_priv_enc(int flen, const unsigned char *from,
+                                unsigned char *to, RSA *rsa, int padding)
+{
+    return tpasync_rsa_priv(RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL()),
+                            flen, from, to, rsa, padding);
+}
+
+static int tpasync_rsa_priv_dec(int flen, const unsigned char *from,
+                                unsigned char *to, RSA *rsa, int padding)
+{
+    return tpasync_rsa_priv(RSA_meth_get_priv_dec(RSA_PKCS1_OpenSSL()),
+                            flen, from, to, rsa, padding);
+}
+
+/* EC */
+
+static EC_KEY_METHOD *tpasync_ec_method = NULL;
+
+static void tpasync_ecdsa_run(TPASYNC_REQ *req)
+{
+    req->u.ecdsa.sig = req->u.ecdsa.fn(req->u.ecdsa.dgst,
+                                       req->u.ecdsa.dgst_len,
+                                       req->u.ecdsa.kinv, req->u.ecdsa.r,
+                                       req->u.ecdsa.eckey);
+    req->ret = req->u.ecdsa.sig != NULL;
+}
+
+/*
+ * ECDSA_sign() and ECDSA_do_sign() both end up here, so this is the only
+ * signing function that needs to be offloaded.
+ */
+static ECDSA_SIG *tpasync_ecdsa_sign_sig(const unsigned char *dgst,
+                                         int dgst_len, const BIGNUM *in_kinv,
+                                         const BIGNUM *in_r, EC_KEY *eckey)
+{
+    TPASYNC_REQ req;
+
+    EC_KEY_METHOD_get_sign((EC_KEY_METHOD *)EC_KEY_OpenSSL(), NULL, NULL,
+                           &req.u.ecdsa.fn);
+    req.run = tpasync_ecdsa_run;
+    req.u.ecdsa.dgst = dgst;
+    req.u.ecdsa.dgst_len = dgst_len;
+    req.u.ecdsa.kinv = in_kinv;
+    req.u.ecdsa.r = in_r;
+    req.u.ecdsa.eckey = eckey;
+    req.u.ecdsa.sig = NULL;
+    if (!tpasync_submit(&req))
+        return NULL;
+    return req.u.ecdsa.sig;
+}
+
+static void tpasync_ecdh_run(TPASYNC_REQ *req)
+{
+    req->ret = req->u.ecdh.fn(req->u.ecdh.psec, req->u.ecdh.pseclen,
+                              req->u.ecdh.pub_key, req->u.ecdh.ecdh);
+}
+
+static int tpasync_ecdh_compute_key(unsigned char **psec, size_t *pseclen,
+                                    const EC_POINT *pub_key,
+                                    const EC_KEY *ecdh)
+{
+    TPASYNC_REQ req;
+
+    EC_KEY_METHOD_get_compute_key((EC_KEY_METHOD *)EC_KEY_OpenSSL(),
+                                  &req.u.ecdh.fn);
+    req.run = tpasync_ecdh_run;
+    req.u.ecdh.psec = psec;
+    req.u.ecdh.pseclen = pseclen;
+    req.u.ecdh.pub_key = pub_key;
+    req.u.ecdh.ecdh = ecdh;
+    return tpasync_submit(&req);
+}
+
+static int tpasync_ctrl(ENGINE *e, int cmd, long i, void *p, void (*f) (void))
+{
+    switch (cmd) {
+    case TPASYNC_CMD_THREADS:
+        if (tp_threads != NULL) {
+            TPASYNCerr(TPASYNC_F_TPASYNC_CTRL, TPASYNC_R_ALREADY_INITIALISED);
+            return 0;
+        }
+        if (i < 0) {
+            TPASYNCerr(TPASYNC_F_TPASYNC_CTRL,
+                       TPASYNC_R_INVALID_THREAD_COUNT);
+            return 0;
+        }
+        tp_cfg_threads = i;
+        return 1;
+    }
+    TPASYNCerr(TPASYNC_F_TPASYNC_CTRL, TPASYNC_R_CTRL_COMMAND_NOT_IMPLEMENTED);
+    return 0;
+}
+
+static int tpasync_destroy(ENGINE *e)
+{
+    RSA_meth_free(tpasync_rsa_method);
+    tpasync_rsa_method = NULL;
+    EC_KEY_METHOD_free(tpasync_ec_method);
+    tpasync_ec_method = NULL;
+    ERR_unload_TPASYNC_strings();
+    return 1;
+}
+
+static int bind_tpasync(ENGINE *e)
+{
+    /* Ensure the tpasync error handling is set up */
+    ERR_load_TPASYNC_strings();
+
+    /* Public key operations are cheap enough to stay on the calling thread */
+    if ((tpasync_rsa_method = RSA_meth_dup(RSA_PKCS1_OpenSSL())) == NULL
+        || !RSA_meth_set1_name(tpasync_rsa_method,
+                               "Thread pool async RSA method")
+        || !RSA_meth_set_priv_enc(tpasync_rsa_method, tpasync_rsa_priv_enc)
+        || !RSA_meth_set_priv_dec(tpasync_rsa_method, tpasync_rsa_priv_dec)
+        || (tpasync_ec_method = EC_KEY_METHOD_new(EC_KEY_OpenSSL())) == NULL) {
+        TPASYNCerr(TPASYNC_F_BIND_TPASYNC, TPASYNC_R_INIT_FAILED);
+        return 0;
+    }
+    EC_KEY_METHOD_set_compute_key(tpasync_ec_method,
+                                  tpasync_ecdh_compute_key);
+    {
+        int (*sign)(int type, const unsigned char *dgst, int dlen,
+                    unsigned char *sig, unsigned int *siglen,
+                    const BIGNUM *kinv, const BIGNUM *r, EC_KEY *eckey);
+        int (*sign_setup)(EC_KEY *eckey, BN_CTX *ctx_in, BIGNUM **kinvp,
+                          BIGNUM **rp);
+
+        EC_KEY_METHOD_get_sign(tpasync_ec_method, &sign, &sign_setup, NULL);
+        EC_KEY_METHOD_set_sign(tpasync_ec_method, sign, sign_setup,
+                               tpasync_ecdsa_sign_sig);
+    }
+
+    if (!ENGINE_set_id(e, engine_tpasync_id)
+        || !ENGINE_set_name(e, engine_tpasync_name)
+        || !ENGINE_set_RSA(e, tpasync_rsa_method)
+        || !ENGINE_set_EC(e, tpasync_ec_method)
+        || !ENGINE_set_cmd_defns(e, tpasync_cmd_defns)
+        || !ENGINE_set_ctrl_function(e, tpasync_ctrl)
+        || !ENGINE_set_destroy_function(e, tpasync_destroy)
+        || !ENGINE_set_init_function(e, tpasync_init)
+        || !ENGINE_set_finish_function(e, tpasync_finish)) {
+        TPASYNCerr(TPASYNC_F_BIND_TPASYNC, TPASYNC_R_INIT_FAILED);
+        return 0;
+    }
+
+    return 1;
+}
+
+#else
+
+static int bind_tpasync(ENGINE *e)
+{
+    ERR_load_TPASYNC_strings();
+    TPASYNCerr(TPASYNC_F_BIND_TPASYNC, TPASYNC_R_NOT_SUPPORTED);
+    ERR_unload_TPASYNC_strings();
+    return 0;
+}
+
+#endif /* TPASYNC_IMPLEMENTED */
+
+#ifndef OPENSSL_NO_DYNAMIC_ENGINE
+static int bind_helper(ENGINE *e, const char *id)
+{
+    if (id && (strcmp(id, engine_tpasync_id) != 0))
+        return 0;
+    if (!bind_tpasync(e))
+        return 0;
+    return 1;
+}
+
+IMPLEMENT_DYNAMIC_CHECK_FN()
+    IMPLEMENT_DYNAMIC_BIND_FN(bind_helper)
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Generated by util/mkerr.pl DO NOT EDIT
+ * Copyright 1995-2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/err.h>
+#include "e_tpasync_err.h"
+
+#ifndef OPENSSL_NO_ERR
+
+static ERR_STRING_DATA TPASYNC_str_functs[] = {
+    {ERR_PACK(0, TPASYNC_F_BIND_TPASYNC, 0), "bind_tpasync"},
+    {ERR_PACK(0, TPASYNC_F_TPASYNC_CTRL, 0), "tpasync_ctrl"},
+    {ERR_PACK(0, TPASYNC_F_TPASYNC_INIT, 0), "tpasync_init"},
+    {0, NULL}
+};
+
+static ERR_STRING_DATA TPASYNC_str_reasons[] = {
+    {ERR_PACK(0, 0, TPASYNC_R_ALREADY_INITIALISED), "already initialised"},
+    {ERR_PACK(0, 0, TPASYNC_R_CTRL_COMMAND_NOT_IMPLEMENTED),
+    "ctrl command not implemented"},
+    {ERR_PACK(0, 0, TPASYNC_R_INIT_FAILED), "init failed"},
+    {ERR_PACK(0, 0, TPASYNC_R_INVALID_THREAD_COUNT), "invalid thread count"},
+    {ERR_PACK(0, 0, TPASYNC_R_NOT_SUPPORTED), "not supported"},
+    {ERR_PACK(0, 0, TPASYNC_R_THREAD_CREATE_FAILED), "thread create failed"},
+    {0, NULL}
+};
+
+#endif
+
+static int lib_code = 0;
+static int error_loaded = 0;
+
+static int ERR_load_TPASYNC_strings(void)
+{
+    if (lib_code == 0)
+        lib_code = ERR_get_next_error_library();
+
+    if (!error_loaded) {
+#ifndef OPENSSL_NO_ERR
+        ERR_load_strings(lib_code, TPASYNC_str_functs);
+        ERR_load_strings(lib_code, TPASYNC_str_reasons);
+#endif
+        error_loaded = 1;
+    }
+    return 1;
+}
+
+static void ERR_unload_TPASYNC_strings(void)
+{
+    if (error_loaded) {
+#ifndef OPENSSL_NO_ERR
+        ERR_unload_strings(lib_code, TPASYNC_str_functs);
+        ERR_unload_strings(lib_code, TPASYNC_str_reasons);
+#endif
+        error_loaded = 0;
+    }
+}
+
+static void ERR_TPASYNC_error(int function, int reason, char *file, int line)
+{
+    if (lib_code == 0)
+        lib_code = ERR_get_next_error_library();
+    ERR_PUT_error(lib_code, function, reason, file, line);
+}
@@ -0,0 +1,34 @@
+/*
+ * Generated by util/mkerr.pl DO NOT EDIT
+ * Copyright 1995-2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef HEADER_TPASYNCERR_H
+# define HEADER_TPASYNCERR_H
+
+# define TPASYNCerr(f, r) ERR_TPASYNC_error((f), (r), OPENSSL_FILE, OPENSSL_LINE)
+
+
+/*
+ * TPASYNC function codes.
+ */
+# define TPASYNC_F_BIND_TPASYNC                           100
+# define TPASYNC_F_TPASYNC_CTRL                           101
+# define TPASYNC_F_TPASYNC_INIT                           102
+
+/*
+ * TPASYNC reason codes.
+ */
+# define TPASYNC_R_ALREADY_INITIALISED                    100
+# define TPASYNC_R_CTRL_COMMAND_NOT_IMPLEMENTED           101
+# define TPASYNC_R_INIT_FAILED                            102
+# define TPASYNC_R_INVALID_THREAD_COUNT                   103
+# define TPASYNC_R_NOT_SUPPORTED                          104
+# define TPASYNC_R_THREAD_CREATE_FAILED                   105
+
+#endif
@@ -31,3 +31,22 @@ void bio_cleanup(void);
 /* Old style to new style BIO_METHOD conversion functions */
 int bwrite_conv(BIO *bio, const char *data, size_t datal, size_t *written);
 int bread_conv(BIO *bio, char *data, size_t datal, size_t *read);
+
+/* Kernel TLS offload, see internal/ktls.h */
+# define BIO_CTRL_SET_KTLS                 72
+# define BIO_CTRL_SET_KTLS_TX_CTRL_MSG     75
+
+/*
+ * Used by socket BIOs: record protection has been handed to the kernel for
+ * sending/receiving, and the next write must go out as a record of the type
+ * stored in the BIO's ptr field instead of as application data.
+ */
+# define BIO_FLAGS_KTLS_TX           0x800
+# define BIO_FLAGS_KTLS_RX           0x1000
+# define BIO_FLAGS_KTLS_TX_CTRL_MSG  0x2000
+
+/* |ci| is a KTLS_CRYPTO_INFO */
+# define BIO_set_ktls(b, ci, is_tx) \
+         BIO_ctrl(b, BIO_CTRL_SET_KTLS, is_tx, ci)
+# define BIO_set_ktls_ctrl_msg(b, record_type) \
+         BIO_ctrl(b, BIO_CTRL_SET_KTLS_TX_CTRL_MSG, record_type, NULL)
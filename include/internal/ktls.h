@@ -0,0 +1,311 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Kernel TLS (kTLS) support. Once a handshake has completed the record
+ * protection keys can be handed to the kernel, after which plaintext
+ * written to (and read from) the socket is framed and encrypted (or
+ * decrypted) by the kernel. Only TLSv1.2 with AES-GCM and, if the kernel
+ * headers have it, ChaCha20-Poly1305 is supported.
+ *
+ * On platforms without kTLS the functions below are stubs which always
+ * fail, so that callers fall back to the user-space record layer.
+ */
+
+#ifndef HEADER_INTERNAL_KTLS_H
+# define HEADER_INTERNAL_KTLS_H
+
+# include <openssl/e_os2.h>
+# include <openssl/obj_mac.h>
+# include <openssl/ssl3.h>
+# include <openssl/tls1.h>
+# include <string.h>
+# include <errno.h>
+# if !defined(NO_SYS_TYPES_H)
+#  include <sys/types.h>
+# endif
+
+# if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_SYS_LINUX)
+#  include <linux/version.h>
+#  if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+#   define KTLS_LINUX
+#  endif
+# endif
+
+# ifdef KTLS_LINUX
+#  include <sys/socket.h>
+#  include <sys/sendfile.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <linux/tls.h>
+
+#  ifndef TCP_ULP
+#   define TCP_ULP 31
+#  endif
+#  ifndef SOL_TLS
+#   define SOL_TLS 282
+#  endif
+# endif
+
+/* Key material for one direction of an offloaded connection */
+typedef struct ktls_crypto_info_st {
+# ifdef KTLS_LINUX
+    union {
+        struct tls_crypto_info info;
+        struct tls12_crypto_info_aes_gcm_128 gcm128;
+#  ifdef TLS_CIPHER_AES_GCM_256
+        struct tls12_crypto_info_aes_gcm_256 gcm256;
+#  endif
+#  ifdef TLS_CIPHER_CHACHA20_POLY1305
+        struct tls12_crypto_info_chacha20_poly1305 chacha20poly1305;
+#  endif
+    } u;
+# endif
+    size_t len;
+} KTLS_CRYPTO_INFO;
+
+# ifdef KTLS_LINUX
+
+/*
+ * Fill in |ci| for a TLSv1.2 connection using the cipher |nid|. |iv| is the
+ * implicit part of the nonce from the key block and |seq| is the big-endian
+ * sequence number of the next record. Returns 1 on success or 0 if the
+ * kernel does not support the cipher.
+ */
+static ossl_inline int ktls_init_crypto_info(KTLS_CRYPTO_INFO *ci, int nid,
+                                             const unsigned char *key,
+                                             size_t keylen,
+                                             const unsigned char *iv,
+                                             size_t ivlen,
+                                             const unsigned char *seq)
+{
+    memset(ci, 0, sizeof(*ci));
+
+    switch (nid) {
+    case NID_aes_128_gcm:
+        if (keylen != TLS_CIPHER_AES_GCM_128_KEY_SIZE
+                || ivlen != TLS_CIPHER_AES_GCM_128_SALT_SIZE)
+            return 0;
+        ci->u.gcm128.info.version = TLS_1_2_VERSION;
+        ci->u.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(ci->u.gcm128.key, key, keylen);
+        memcpy(ci->u.gcm128.salt, iv, ivlen);
+        /* The explicit nonce starts at, and counts with, the sequence number */
+        memcpy(ci->u.gcm128.iv, seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(ci->u.gcm128.rec_seq, seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+        ci->len = sizeof(ci->u.gcm128);
+        return 1;
+#  ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+        if (keylen != TLS_CIPHER_AES_GCM_256_KEY_SIZE
+                || ivlen != TLS_CIPHER_AES_GCM_256_SALT_SIZE)
+            return 0;
+        ci->u.gcm256.info.version = TLS_1_2_VERSION;
+        ci->u.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(ci->u.gcm256.key, key, keylen);
+        memcpy(ci->u.gcm256.salt, iv, ivlen);
+        memcpy(ci->u.gcm256.iv, seq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy(ci->u.gcm256.rec_seq, seq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+        ci->len = sizeof(ci->u.gcm256);
+        return 1;
+#  endif
+#  ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+        if (keylen != TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE
+                || ivlen != TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE)
+            return 0;
+        ci->u.chacha20poly1305.info.version = TLS_1_2_VERSION;
+        ci->u.chacha20poly1305.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(ci->u.chacha20poly1305.key, key, keylen);
+        memcpy(ci->u.chacha20poly1305.iv, iv, ivlen);
+        memcpy(ci->u.chacha20poly1305.rec_seq, seq,
+               TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+        ci->len = sizeof(ci->u.chacha20poly1305);
+        return 1;
+#  endif
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Attach the "tls" upper layer protocol to socket |fd| and install |ci| for
+ * sending (|is_tx| != 0) or receiving. Returns 1 on success, 0 otherwise.
+ */
+static ossl_inline int ktls_start(int fd, const KTLS_CRYPTO_INFO *ci,
+                                  int is_tx)
+{
+#  ifndef TLS_RX
+    if (!is_tx)
+        return 0;
+#  endif
+    /* The ULP can only be set once, so EEXIST means the other direction */
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0
+            && errno != EEXIST)
+        return 0;
+#  ifdef TLS_RX
+    return setsockopt(fd, SOL_TLS, is_tx ? TLS_TX : TLS_RX,
+                      &ci->u, (socklen_t)ci->len) == 0;
+#  else
+    return setsockopt(fd, SOL_TLS, TLS_TX, &ci->u, (socklen_t)ci->len) == 0;
+#  endif
+}
+
+/*
+ * Send |length| bytes of |data| as a single record of type |record_type|
+ * (anything other than application data) on an offloaded socket.
+ */
+static ossl_inline int ktls_send_ctrl_message(int fd, unsigned char record_type,
+                                              const void *data, size_t length)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(unsigned char))];
+    } cmsgbuf;
+    struct iovec msg_iov;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = cmsgbuf.buf;
+    msg.msg_controllen = sizeof(cmsgbuf.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *((unsigned char *)CMSG_DATA(cmsg)) = record_type;
+    msg.msg_controllen = cmsg->cmsg_len;
+
+    msg_iov.iov_base = (void *)data;
+    msg_iov.iov_len = length;
+    msg.msg_iov = &msg_iov;
+    msg.msg_iovlen = 1;
+
+    return sendmsg(fd, &msg, 0);
+}
+
+#  ifdef TLS_RX
+/*
+ * Receive a single record from an offloaded socket into |data|. The kernel
+ * only hands us the plaintext and the record type, so a TLSv1.2 record
+ * header is reconstructed in front of it for the benefit of the record
+ * layer. Returns the number of bytes written to |data| (header included),
+ * 0 on EOF or -1 on error.
+ */
+static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(unsigned char))];
+    } cmsgbuf;
+    struct iovec msg_iov;
+    unsigned char *p = data;
+    int ret;
+
+    if (length <= SSL3_RT_HEADER_LENGTH) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = cmsgbuf.buf;
+    msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+    /*
+     * The kernel may coalesce consecutive application data records, so make
+     * sure we never get more than fits in a single record.
+     */
+    msg_iov.iov_base = p + SSL3_RT_HEADER_LENGTH;
+    msg_iov.iov_len = length - SSL3_RT_HEADER_LENGTH;
+    if (msg_iov.iov_len > SSL3_RT_MAX_PLAIN_LENGTH)
+        msg_iov.iov_len = SSL3_RT_MAX_PLAIN_LENGTH;
+    msg.msg_iov = &msg_iov;
+    msg.msg_iovlen = 1;
+
+    ret = recvmsg(fd, &msg, 0);
+    if (ret <= 0)
+        return ret;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_TLS
+            || cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    p[0] = *((unsigned char *)CMSG_DATA(cmsg));
+    p[1] = TLS1_2_VERSION_MAJOR;
+    p[2] = TLS1_2_VERSION_MINOR;
+    p[3] = (ret >> 8) & 0xff;
+    p[4] = ret & 0xff;
+
+    return ret + SSL3_RT_HEADER_LENGTH;
+}
+#  else
+static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
+{
+    errno = ENOSYS;
+    return -1;
+}
+#  endif
+
+/*
+ * Send |size| bytes of file |fd| from |off| on offloaded socket |s|. Linux
+ * sendfile(2) has no flags, so none are accepted.
+ */
+static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
+                                              size_t size, int flags)
+{
+    if (flags != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return sendfile(s, fd, &off, size);
+}
+
+# else                          /* KTLS_LINUX */
+
+static ossl_inline int ktls_init_crypto_info(KTLS_CRYPTO_INFO *ci, int nid,
+                                             const unsigned char *key,
+                                             size_t keylen,
+                                             const unsigned char *iv,
+                                             size_t ivlen,
+                                             const unsigned char *seq)
+{
+    return 0;
+}
+
+static ossl_inline int ktls_start(int fd, const KTLS_CRYPTO_INFO *ci,
+                                  int is_tx)
+{
+    return 0;
+}
+
+static ossl_inline int ktls_send_ctrl_message(int fd, unsigned char record_type,
+                                              const void *data, size_t length)
+{
+    return -1;
+}
+
+static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
+{
+    return -1;
+}
+
+static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
+                                              size_t size, int flags)
+{
+    return -1;
+}
+
+# endif                         /* KTLS_LINUX */
+
+#endif
@@ -143,6 +143,8 @@ DEFINE_STACK_OF(X509_ALGOR)
 # define ASN1_STRING_FLAG_EMBED 0x080
 /* String should be parsed in RFC 5280's time format */
 # define ASN1_STRING_FLAG_X509_TIME 0x100
+/* String data is part of a buffer that is owned by the application */
+# define ASN1_STRING_FLAG_BORROWED 0x200
 /* This is the base type that holds just about everything :-) */
 struct asn1_string_st {
     int length;
@@ -212,6 +214,7 @@ typedef struct ASN1_TEMPLATE_st ASN1_TEMPLATE;
 typedef struct ASN1_TLC_st ASN1_TLC;
 /* This is just an opaque pointer */
 typedef struct ASN1_VALUE_st ASN1_VALUE;
+typedef struct asn1_arena_st ASN1_ARENA;
 
 /* Declare ASN1 functions: the implement macro in in asn1t.h */
 
@@ -804,10 +807,19 @@ ASN1_VALUE *ASN1_item_new(const ASN1_ITEM *it);
 void ASN1_item_free(ASN1_VALUE *val, const ASN1_ITEM *it);
 ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **val, const unsigned char **in,
                           long len, const ASN1_ITEM *it);
+ASN1_VALUE *ASN1_item_d2i_borrow(ASN1_VALUE **val, const unsigned char **in,
+                                 long len, const ASN1_ITEM *it);
 int ASN1_item_i2d(ASN1_VALUE *val, unsigned char **out, const ASN1_ITEM *it);
 int ASN1_item_ndef_i2d(ASN1_VALUE *val, unsigned char **out,
                        const ASN1_ITEM *it);
 
+ASN1_ARENA *ASN1_ARENA_new(void);
+void ASN1_ARENA_free(ASN1_ARENA *arena);
+void ASN1_ARENA_reset(ASN1_ARENA *arena);
+ASN1_VALUE *ASN1_item_d2i_arena(ASN1_VALUE **val, const unsigned char **in,
+                                long len, const ASN1_ITEM *it,
+                                ASN1_ARENA *arena);
+
 void ASN1_add_oid_module(void);
 void ASN1_add_stable_module(void);
 
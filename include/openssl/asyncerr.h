@@ -26,6 +26,7 @@ int ERR_load_ASYNC_strings(void);
 # define ASYNC_F_ASYNC_INIT_THREAD                        101
 # define ASYNC_F_ASYNC_JOB_NEW                            102
 # define ASYNC_F_ASYNC_PAUSE_JOB                          103
+# define ASYNC_F_ASYNC_SET_STACK_SIZE                     106
 # define ASYNC_F_ASYNC_START_FUNC                         104
 # define ASYNC_F_ASYNC_START_JOB                          105
 
@@ -36,5 +37,6 @@ int ERR_load_ASYNC_strings(void);
 # define ASYNC_R_FAILED_TO_SWAP_CONTEXT                   102
 # define ASYNC_R_INIT_FAILED                              105
 # define ASYNC_R_INVALID_POOL_SIZE                        103
+# define ASYNC_R_INVALID_STACK_SIZE                       104
 
 #endif
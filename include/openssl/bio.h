@@ -145,6 +145,9 @@ extern "C" {
 
 # define BIO_CTRL_DGRAM_SET_PEEK_MODE      71
 
+# define BIO_CTRL_GET_KTLS_SEND            73
+# define BIO_CTRL_GET_KTLS_RECV            74
+
 /* modifiers */
 # define BIO_FP_READ             0x02
 # define BIO_FP_WRITE            0x04
@@ -414,6 +417,10 @@ struct bio_dgram_sctp_prinfo {
 # define BIO_set_fd(b,fd,c)      BIO_int_ctrl(b,BIO_C_SET_FD,c,fd)
 # define BIO_get_fd(b,c)         BIO_ctrl(b,BIO_C_GET_FD,0,(char *)(c))
 
+/* Are records sent/received through this BIO protected by the kernel? */
+# define BIO_get_ktls_send(b)    BIO_ctrl(b,BIO_CTRL_GET_KTLS_SEND,0,NULL)
+# define BIO_get_ktls_recv(b)    BIO_ctrl(b,BIO_CTRL_GET_KTLS_RECV,0,NULL)
+
 /* BIO_s_file() */
 # define BIO_set_fp(b,fp,c)      BIO_ctrl(b,BIO_C_SET_FILE_PTR,c,(char *)(fp))
 # define BIO_get_fp(b,fpp)       BIO_ctrl(b,BIO_C_GET_FILE_PTR,0,(char *)(fpp))
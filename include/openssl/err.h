@@ -47,6 +47,7 @@ typedef struct err_state_st {
     const char *err_file[ERR_NUM_ERRORS];
     int err_line[ERR_NUM_ERRORS];
     int top, bottom;
+    int suppress;
 } ERR_STATE;
 
 /* library */
@@ -261,6 +262,8 @@ int ERR_get_next_error_library(void);
 
 int ERR_set_mark(void);
 int ERR_pop_to_mark(void);
+int ERR_set_suppress_mark(void);
+int ERR_pop_suppress_mark(void);
 
 #ifdef  __cplusplus
 }
@@ -14,7 +14,7 @@
 
 # include <openssl/evp.h>
 
-# define HMAC_MAX_MD_CBLOCK      128/* largest known is SHA512 */
+# define HMAC_MAX_MD_CBLOCK      168/* largest known is SHAKE128 */
 
 #ifdef  __cplusplus
 extern "C" {
@@ -23,16 +23,30 @@ int ERR_load_RAND_strings(void);
  * RAND function codes.
  */
 # define RAND_F_RAND_BYTES                                100
+# define RAND_F_RAND_DRBG_GENERATE                        103
+# define RAND_F_RAND_DRBG_INSTANTIATE                     104
+# define RAND_F_RAND_DRBG_NEW                             105
+# define RAND_F_RAND_DRBG_RESEED                          106
 # define RAND_F_RAND_LOAD_FILE                            101
 # define RAND_F_RAND_WRITE_FILE                           102
 
 /*
  * RAND reason codes.
  */
+# define RAND_R_ADDITIONAL_INPUT_TOO_LONG                 105
+# define RAND_R_ALREADY_INSTANTIATED                      106
 # define RAND_R_CANNOT_OPEN_FILE                          102
+# define RAND_R_ERROR_INSTANTIATING_DRBG                  107
+# define RAND_R_ERROR_RETRIEVING_ENTROPY                  108
 # define RAND_R_FUNC_NOT_IMPLEMENTED                      101
 # define RAND_R_FWRITE_ERROR                              103
+# define RAND_R_GENERATE_ERROR                            109
+# define RAND_R_IN_ERROR_STATE                            110
 # define RAND_R_NOT_A_REGULAR_FILE                        104
+# define RAND_R_NOT_INSTANTIATED                          111
+# define RAND_R_PERSONALISATION_STRING_TOO_LONG           112
 # define RAND_R_PRNG_NOT_SEEDED                           100
+# define RAND_R_REQUEST_TOO_LARGE_FOR_DRBG                113
+# define RAND_R_RESEED_ERROR                              114
 
 #endif
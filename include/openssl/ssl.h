@@ -14,6 +14,12 @@
 
 # include <openssl/e_os2.h>
 # include <openssl/opensslconf.h>
+# if !defined(NO_SYS_TYPES_H)
+#  include <sys/types.h>
+# endif
+# ifdef OPENSSL_SYS_UNIX
+#  include <sys/uio.h>
+# endif
 # include <openssl/comp.h>
 # include <openssl/bio.h>
 # if OPENSSL_API_COMPAT < 0x10100000L
@@ -205,6 +211,16 @@ typedef struct ssl_comp_st SSL_COMP;
 STACK_OF(SSL_CIPHER);
 STACK_OF(SSL_COMP);
 
+/* One element of the gather list passed to SSL_writev_ex() */
+# ifdef OPENSSL_SYS_UNIX
+typedef struct iovec SSL_IOVEC;
+# else
+typedef struct ssl_iovec_st {
+    void *iov_base;
+    size_t iov_len;
+} SSL_IOVEC;
+# endif
+
 /* SRTP protection profiles for use with the use_srtp extension (RFC 5764)*/
 typedef struct srtp_protection_profile_st {
     const char *name;
@@ -334,6 +350,11 @@ typedef int (*SSL_verify_cb)(int preverify_ok, X509_STORE_CTX *x509_ctx);
 # define SSL_OP_ALLOW_UNSAFE_LEGACY_RENEGOTIATION        0x00040000U
 /* Disable encrypt-then-mac */
 # define SSL_OP_NO_ENCRYPT_THEN_MAC                      0x00080000U
+/*
+ * Offload TLSv1.2 record protection to the kernel once the handshake is
+ * complete, where supported. See SSL_CTX_set_options(3)
+ */
+# define SSL_OP_ENABLE_KTLS                              0x00200000U
 /*
  * Set on servers to choose the cipher according to the server's preferences
  */
@@ -466,6 +487,11 @@ typedef int (*SSL_verify_cb)(int preverify_ok, X509_STORE_CTX *x509_ctx);
  * Support Asynchronous operation
  */
 # define SSL_MODE_ASYNC 0x00000100U
+/*
+ * Record where the time goes in each handshake, see
+ * SSL_get0_handshake_timings()
+ */
+# define SSL_MODE_HANDSHAKE_TIMINGS 0x00000200U
 
 /* Cert related flags */
 /*
@@ -636,6 +662,7 @@ typedef int (*GEN_SESSION_CB) (const SSL *ssl, unsigned char *id,
 # define SSL_SESS_CACHE_NO_INTERNAL_STORE        0x0200
 # define SSL_SESS_CACHE_NO_INTERNAL \
         (SSL_SESS_CACHE_NO_INTERNAL_LOOKUP|SSL_SESS_CACHE_NO_INTERNAL_STORE)
+# define SSL_SESS_CACHE_SHARDED                  0x0400
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx);
 # define SSL_CTX_sess_number(ctx) \
@@ -1244,6 +1271,12 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 # define SSL_CTRL_GET_TLSEXT_STATUS_REQ_TYPE     127
 # define SSL_CTRL_GET_TLSEXT_STATUS_REQ_CB       128
 # define SSL_CTRL_GET_TLSEXT_STATUS_REQ_CB_ARG   129
+# define SSL_CTRL_ROTATE_TLSEXT_TICKET_KEYS      130
+# define SSL_CTRL_SET_MAX_TLSEXT_TICKET_KEYS     131
+# define SSL_CTRL_SET_BUFFER_POOL_SIZE           132
+# define SSL_CTRL_GET_BUFFER_POOL_SIZE           133
+# define SSL_CTRL_BUFFER_POOL_HITS               134
+# define SSL_CTRL_BUFFER_POOL_MISSES             135
 # define SSL_CERT_SET_FIRST                      1
 # define SSL_CERT_SET_NEXT                       2
 # define SSL_CERT_SET_SERVER                     3
@@ -1560,6 +1593,9 @@ __owur int i2d_SSL_SESSION(SSL_SESSION *in, unsigned char **pp);
 __owur int SSL_set_session(SSL *to, SSL_SESSION *session);
 __owur int SSL_CTX_add_session(SSL_CTX *s, SSL_SESSION *c);
 int SSL_CTX_remove_session(SSL_CTX *, SSL_SESSION *c);
+__owur int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, size_t num);
+__owur int SSL_CTX_set_keyshare_pool_size(SSL_CTX *ctx, size_t num);
+int SSL_CTX_fill_keyshare_pool(SSL_CTX *ctx, size_t max);
 __owur int SSL_CTX_set_generate_session_id(SSL_CTX *, GEN_SESSION_CB);
 __owur int SSL_set_generate_session_id(SSL *, GEN_SESSION_CB);
 __owur int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
@@ -1696,6 +1732,7 @@ int SSL_early_get0_ext(SSL *s, unsigned int type, const unsigned char **out,
 
 void SSL_certs_clear(SSL *s);
 void SSL_free(SSL *ssl);
+typedef int (*SSL_async_callback_fn)(SSL *s, void *arg);
 # ifdef OSSL_ASYNC_FD
 /*
  * Windows application developer has to include windows.h to use these.
@@ -1705,6 +1742,11 @@ __owur int SSL_get_all_async_fds(SSL *s, OSSL_ASYNC_FD *fds, size_t *numfds);
 __owur int SSL_get_changed_async_fds(SSL *s, OSSL_ASYNC_FD *addfd,
                                      size_t *numaddfds, OSSL_ASYNC_FD *delfd,
                                      size_t *numdelfds);
+void SSL_CTX_set_async_callback(SSL_CTX *ctx, SSL_async_callback_fn callback);
+void SSL_CTX_set_async_callback_arg(SSL_CTX *ctx, void *arg);
+void SSL_set_async_callback(SSL *s, SSL_async_callback_fn callback);
+void SSL_set_async_callback_arg(SSL *s, void *arg);
+__owur int SSL_get_async_status(SSL *s, int *status);
 # endif
 __owur int SSL_accept(SSL *ssl);
 __owur int SSL_connect(SSL *ssl);
@@ -1721,6 +1763,10 @@ __owur int SSL_peek(SSL *ssl, void *buf, int num);
 __owur int SSL_peek_ex(SSL *ssl, void *buf, size_t num, size_t *readbytes);
 __owur int SSL_write(SSL *ssl, const void *buf, int num);
 __owur int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written);
+__owur int SSL_writev_ex(SSL *s, const SSL_IOVEC *iov, int iovcnt,
+                         size_t *written);
+__owur ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size,
+                                 int flags);
 __owur int SSL_write_early_data(SSL *s, const void *buf, size_t num,
                                 size_t *written);
 long SSL_ctrl(SSL *ssl, int cmd, long larg, void *parg);
@@ -1873,6 +1919,23 @@ void (*SSL_get_info_callback(const SSL *ssl)) (const SSL *ssl, int type,
                                                int val);
 __owur OSSL_HANDSHAKE_STATE SSL_get_state(const SSL *ssl);
 
+/* Where handshake time goes, see SSL_get_handshake_time() */
+# define SSL_HS_TIME_TOTAL           0
+# define SSL_HS_TIME_KEY_EXCHANGE    1
+# define SSL_HS_TIME_SIGN            2
+# define SSL_HS_TIME_CERT_VERIFY     3
+# define SSL_HS_TIME_IO_WAIT         4
+# define SSL_HS_TIME_NUM             5
+
+# define SSL_HS_HISTOGRAM_BUCKETS    32
+
+size_t SSL_get0_handshake_timings(const SSL *s,
+                                  const OSSL_HANDSHAKE_STATE **states,
+                                  const uint64_t **times);
+uint64_t SSL_get_handshake_time(const SSL *s, int which);
+size_t SSL_CTX_get_handshake_histogram(SSL_CTX *ctx, int which,
+                                       uint64_t *counts, size_t numcounts);
+
 void SSL_set_verify_result(SSL *ssl, long v);
 __owur long SSL_get_verify_result(const SSL *ssl);
 __owur STACK_OF(X509) *SSL_get0_verified_chain(const SSL *s);
@@ -1937,6 +2000,14 @@ __owur int SSL_get_ex_data_X509_STORE_CTX_idx(void);
         SSL_CTX_ctrl(ctx,SSL_CTRL_SET_MAX_PIPELINES,m,NULL)
 # define SSL_set_max_pipelines(ssl,m) \
         SSL_ctrl(ssl,SSL_CTRL_SET_MAX_PIPELINES,m,NULL)
+# define SSL_CTX_set_buffer_pool_size(ctx,m) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SET_BUFFER_POOL_SIZE,m,NULL)
+# define SSL_CTX_get_buffer_pool_size(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_GET_BUFFER_POOL_SIZE,0,NULL)
+# define SSL_CTX_buffer_pool_hits(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_HITS,0,NULL)
+# define SSL_CTX_buffer_pool_misses(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_MISSES,0,NULL)
 
 void SSL_CTX_set_default_read_buffer_len(SSL_CTX *ctx, size_t len);
 void SSL_set_default_read_buffer_len(SSL *s, size_t len);
@@ -205,6 +205,9 @@ extern "C" {
 
 # define TLSEXT_MAXLEN_host_name 255
 
+/* Maximum number of session ticket keys an SSL_CTX can hold */
+# define TLSEXT_MAX_TICKET_KEYS 16
+
 __owur const char *SSL_get_servername(const SSL *s, const int type);
 __owur int SSL_get_servername_type(const SSL *s);
 /*
@@ -281,6 +284,10 @@ SSL_CTX_ctrl(ctx,SSL_CTRL_SET_TLSEXT_SERVERNAME_ARG,0, (void *)(arg))
         SSL_CTX_ctrl((ctx),SSL_CTRL_GET_TLSEXT_TICKET_KEYS,(keylen),(keys))
 # define SSL_CTX_set_tlsext_ticket_keys(ctx, keys, keylen) \
         SSL_CTX_ctrl((ctx),SSL_CTRL_SET_TLSEXT_TICKET_KEYS,(keylen),(keys))
+# define SSL_CTX_rotate_tlsext_ticket_keys(ctx, keys, keylen) \
+        SSL_CTX_ctrl((ctx),SSL_CTRL_ROTATE_TLSEXT_TICKET_KEYS,(keylen),(keys))
+# define SSL_CTX_set_max_tlsext_ticket_keys(ctx, m) \
+        SSL_CTX_ctrl((ctx),SSL_CTRL_SET_MAX_TLSEXT_TICKET_KEYS,(m),NULL)
 
 # define SSL_CTX_get_tlsext_status_cb(ssl, cb) \
 SSL_CTX_ctrl(ssl,SSL_CTRL_GET_TLSEXT_STATUS_REQ_CB,0, (void (**)(void))(cb))
@@ -850,6 +850,12 @@ int do_dtls1_write(SSL *s, int type, const unsigned char *buf,
             SSLerr(SSL_F_DO_DTLS1_WRITE, SSL_R_COMPRESSION_FAILURE);
             goto err;
         }
+    } else if (buf == NULL) {
+        /* Gather the data straight into the record for SSL_writev_ex() */
+        if (!ssl3_write_gather(&s->rlayer, SSL3_RECORD_get_data(&wr),
+                               SSL3_RECORD_get_length(&wr)))
+            goto err;
+        SSL3_RECORD_reset_input(&wr);
     } else {
         memcpy(SSL3_RECORD_get_data(&wr), SSL3_RECORD_get_input(&wr),
                SSL3_RECORD_get_length(&wr));
@@ -15,6 +15,7 @@
 #include <openssl/evp.h>
 #include <openssl/buffer.h>
 #include <openssl/rand.h>
+#include "internal/bio.h"
 #include "record_locl.h"
 #include "../packet_locl.h"
 
@@ -27,6 +28,13 @@
 # define EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK 0
 #endif
 
+/*
+ * Minimum and maximum number of full TLSv1.3 records that are encrypted and
+ * written together, see tls13_write_records()
+ */
+#define TLS13_MULTIREC_MIN  4
+#define TLS13_MULTIREC_MAX  8
+
 void RECORD_LAYER_init(RECORD_LAYER *rl, SSL *s)
 {
     rl->s = s;
@@ -119,7 +127,7 @@ size_t ssl3_pending(const SSL *s)
     for (i = 0; i < RECORD_LAYER_get_numrpipes(&s->rlayer); i++) {
         if (SSL3_RECORD_get_type(&s->rlayer.rrec[i])
             != SSL3_RT_APPLICATION_DATA)
-            return 0;
+            break;
         num += SSL3_RECORD_get_length(&s->rlayer.rrec[i]);
     }
 
@@ -201,10 +209,11 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         /* start with empty packet ... */
         if (left == 0)
             rb->offset = align;
-        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH) {
+        else if (align != 0 && clearold && left >= SSL3_RT_HEADER_LENGTH) {
             /*
              * check if next packet length is large enough to justify payload
-             * alignment...
+             * alignment... but not if earlier packets in the buffer are still
+             * in use (!clearold), which the move could overwrite
              */
             pkt = rb->buf + rb->offset;
             if (pkt[0] == SSL3_RT_APPLICATION_DATA
@@ -265,8 +274,12 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         return -1;
     }
 
-    /* We always act like read_ahead is set for DTLS */
-    if (!s->rlayer.read_ahead && !SSL_IS_DTLS(s))
+    /*
+     * We always act like read_ahead is set for DTLS, and for kTLS which must
+     * always be able to read a complete record
+     */
+    if (!s->rlayer.read_ahead && !SSL_IS_DTLS(s)
+            && !BIO_get_ktls_recv(s->rbio))
         /* ignore max parameter */
         max = n;
     else {
@@ -330,6 +343,249 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
  * Call this to write data in records of type 'type' It will return <= 0 if
  * not all data has been sent or non-blocking IO.
  */
+#ifndef OPENSSL_SMALL_FOOTPRINT
+/*
+ * Can tls13_write_records() be used to write |n| bytes of application data?
+ * It only handles the plain case: no early data, padding or message callback,
+ * and an AEAD with a fixed 16 byte tag.
+ */
+static int tls13_multirec_ok(SSL *s, int type, size_t n)
+{
+    return type == SSL3_RT_APPLICATION_DATA
+        && SSL_IS_TLS13(s)
+        && !SSL_in_init(s)
+        && s->enc_write_ctx != NULL
+        && s->s3->tmp.new_cipher != NULL
+        && (s->s3->tmp.new_cipher->algorithm_enc
+            & (SSL_AESGCM | SSL_CHACHA20)) != 0
+        && s->msg_callback == NULL
+        && s->record_padding_cb == NULL
+        && s->block_padding == 0
+        && n >= TLS13_MULTIREC_MIN * s->max_send_fragment;
+}
+
+/* GCM and Poly1305 both have 16 byte tags */
+# define TLS13_MULTIREC_TAGLEN  EVP_GCM_TLS_TAG_LEN
+
+/* Size of the jumbo write buffer used by tls13_write_records() */
+static size_t tls13_multirec_buflen(SSL *s)
+{
+    return TLS13_MULTIREC_MAX * (SSL3_RT_HEADER_LENGTH + s->max_send_fragment
+                                 + 1 + TLS13_MULTIREC_TAGLEN);
+}
+
+/*
+ * Give the jumbo write buffer back once everything in it has been written,
+ * rather than keep it for the lifetime of the connection. The normal sized
+ * buffer is set up again when it is next needed.
+ */
+static void tls13_release_multirec_buffer(SSL *s)
+{
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+
+    if (wb->buf != NULL && wb->left == 0
+            && wb->len == tls13_multirec_buflen(s))
+        ssl3_release_write_buffer(s);
+}
+
+/*
+ * Write between TLS13_MULTIREC_MIN and TLS13_MULTIREC_MAX full records from
+ * the |n| bytes at |buf|. The records are laid out back to back in a single
+ * jumbo write buffer, encrypted in one tls13_enc() call and then go out with
+ * a single write, rather than a write per record. Return values are as for
+ * ssl3_write_pending().
+ */
+static int tls13_write_records(SSL *s, const unsigned char *buf, size_t n,
+                               size_t *written)
+{
+    SSL3_RECORD wr[TLS13_MULTIREC_MAX];
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+    size_t frag = s->max_send_fragment;
+    size_t reclen = frag + 1 + TLS13_MULTIREC_TAGLEN;
+    size_t nrecs, totlen, j;
+    unsigned char *p;
+    int i;
+
+    nrecs = n / frag;
+    if (nrecs > TLS13_MULTIREC_MAX)
+        nrecs = TLS13_MULTIREC_MAX;
+    totlen = nrecs * frag;
+
+    /*
+     * Allocate a jumbo buffer, kept until this write has been completed, see
+     * tls13_release_multirec_buffer()
+     */
+    if (wb->buf == NULL || wb->len < tls13_multirec_buflen(s)) {
+        ssl3_release_write_buffer(s);
+        if (!ssl3_setup_write_buffer(s, 1, tls13_multirec_buflen(s)))
+            return -1;
+    }
+
+    if (s->s3->alert_dispatch) {
+        i = s->method->ssl_dispatch_alert(s);
+        if (i <= 0)
+            return i;
+    }
+
+    memset(wr, 0, sizeof(wr));
+    for (j = 0, p = wb->buf; j < nrecs;
+         j++, p += SSL3_RT_HEADER_LENGTH + reclen) {
+        /* The header is the same for every record */
+        p[0] = SSL3_RT_APPLICATION_DATA;
+        p[1] = TLS1_VERSION_MAJOR;
+        p[2] = TLS1_VERSION_MINOR;
+        p[3] = (unsigned char)(reclen >> 8);
+        p[4] = (unsigned char)reclen;
+
+        /* Payload followed by the real content type, encrypted in place */
+        if (buf == NULL) {
+            if (!ssl3_write_gather(&s->rlayer, p + SSL3_RT_HEADER_LENGTH,
+                                   frag))
+                return -1;
+        } else {
+            memcpy(p + SSL3_RT_HEADER_LENGTH, buf + j * frag, frag);
+        }
+        p[SSL3_RT_HEADER_LENGTH + frag] = SSL3_RT_APPLICATION_DATA;
+        SSL3_RECORD_set_type(&wr[j], SSL3_RT_APPLICATION_DATA);
+        SSL3_RECORD_set_data(&wr[j], p + SSL3_RT_HEADER_LENGTH);
+        SSL3_RECORD_set_input(&wr[j], p + SSL3_RT_HEADER_LENGTH);
+        SSL3_RECORD_set_length(&wr[j], frag + 1);
+    }
+
+    if (tls13_enc(s, wr, nrecs, 1) < 1)
+        return -1;
+    for (j = 0; j < nrecs; j++) {
+        if (SSL3_RECORD_get_length(&wr[j]) != reclen) {
+            SSLerr(SSL_F_TLS13_WRITE_RECORDS, ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+    }
+
+    SSL3_BUFFER_set_offset(wb, 0);
+    SSL3_BUFFER_set_left(wb, nrecs * (SSL3_RT_HEADER_LENGTH + reclen));
+
+    s->rlayer.wpend_tot = totlen;
+    s->rlayer.wpend_buf = buf;
+    s->rlayer.wpend_type = SSL3_RT_APPLICATION_DATA;
+    s->rlayer.wpend_ret = totlen;
+
+    return ssl3_write_pending(s, SSL3_RT_APPLICATION_DATA, buf, totlen,
+                              written);
+}
+#endif
+
+/* Move the gather cursor of SSL_writev_ex() on by |len| bytes */
+static void write_gather_skip(RECORD_LAYER *rl, size_t len)
+{
+    while (len > 0 && rl->wiov_idx < rl->wiovcnt) {
+        size_t n = rl->wiov[rl->wiov_idx].iov_len - rl->wiov_pos;
+
+        if (n > len) {
+            rl->wiov_pos += len;
+            rl->wiov_off += len;
+            return;
+        }
+        len -= n;
+        rl->wiov_off += n;
+        rl->wiov_idx++;
+        rl->wiov_pos = 0;
+    }
+}
+
+/*
+ * Move the gather cursor to offset |off| of the data. While records are
+ * built it only moves forwards, from where the last record left off. A write
+ * that is started again from an earlier offset goes back to the first iovec.
+ */
+static void write_gather_seek(RECORD_LAYER *rl, size_t off)
+{
+    if (off < rl->wiov_off) {
+        rl->wiov_idx = 0;
+        rl->wiov_pos = 0;
+        rl->wiov_off = 0;
+    }
+    write_gather_skip(rl, off - rl->wiov_off);
+}
+
+/*
+ * Copy the next |len| bytes of the gather list being written by
+ * SSL_writev_ex() to |out|. Returns 1 on success or 0 if the list runs out.
+ */
+int ssl3_write_gather(RECORD_LAYER *rl, unsigned char *out, size_t len)
+{
+    while (len > 0 && rl->wiov_idx < rl->wiovcnt) {
+        const unsigned char *base = rl->wiov[rl->wiov_idx].iov_base;
+        size_t n = rl->wiov[rl->wiov_idx].iov_len - rl->wiov_pos;
+
+        if (n > len)
+            n = len;
+        if (n > 0) {
+            memcpy(out, base + rl->wiov_pos, n);
+            out += n;
+            len -= n;
+        }
+        write_gather_skip(rl, n);
+        /* Step over an empty iovec */
+        if (n == 0) {
+            rl->wiov_idx++;
+            rl->wiov_pos = 0;
+        }
+    }
+    if (len > 0) {
+        SSLerr(SSL_F_SSL3_WRITE_GATHER, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Return the next |len| bytes of the gather list as a contiguous block,
+ * for compression. If they all lie in one iovec they're used in place,
+ * otherwise they are copied into a buffer that is kept until the end of the
+ * SSL_writev_ex() call. Returns NULL on error.
+ */
+const unsigned char *ssl3_write_gather_contig(RECORD_LAYER *rl, size_t len)
+{
+    const unsigned char *p;
+
+    if (rl->wiov_idx < rl->wiovcnt
+            && rl->wiov[rl->wiov_idx].iov_len - rl->wiov_pos >= len) {
+        p = (const unsigned char *)rl->wiov[rl->wiov_idx].iov_base
+            + rl->wiov_pos;
+        write_gather_skip(rl, len);
+        return p;
+    }
+
+    if (len > SSL3_RT_MAX_PLAIN_LENGTH) {
+        SSLerr(SSL_F_SSL3_WRITE_GATHER, ERR_R_INTERNAL_ERROR);
+        return NULL;
+    }
+    if (rl->wiov_buf == NULL
+            && (rl->wiov_buf = OPENSSL_malloc(SSL3_RT_MAX_PLAIN_LENGTH))
+               == NULL) {
+        SSLerr(SSL_F_SSL3_WRITE_GATHER, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if (!ssl3_write_gather(rl, rl->wiov_buf, len))
+        return NULL;
+    return rl->wiov_buf;
+}
+
+/*
+ * Return the data at offset |off| of a write. During SSL_writev_ex() there is
+ * no contiguous buffer, |buf| is NULL and the data is instead gathered from
+ * the iovecs from |off| onwards as the records are built.
+ */
+static const unsigned char *write_buf_at(RECORD_LAYER *rl,
+                                         const unsigned char *buf, size_t off)
+{
+    if (buf == NULL) {
+        write_gather_seek(rl, off);
+        return NULL;
+    }
+    return buf + off;
+}
+
 int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
                      size_t *written)
 {
@@ -387,8 +643,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * will happen with non blocking IO
      */
     if (wb->left != 0) {
-        i = ssl3_write_pending(s, type, &buf[tot], s->rlayer.wpend_tot,
-                               &tmpwrit);
+        i = ssl3_write_pending(s, type, write_buf_at(&s->rlayer, buf, tot),
+                               s->rlayer.wpend_tot, &tmpwrit);
         if (i <= 0) {
             /* XXX should we ssl3_release_write_buffer if i<0? */
             s->rlayer.wnum = tot;
@@ -396,14 +652,36 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         }
         tot += tmpwrit;               /* this might be last fragment */
     }
+#ifndef OPENSSL_SMALL_FOOTPRINT
+    /*
+     * In TLSv1.3 write bulk data several full records at a time. Anything
+     * left over goes out through the normal path below.
+     */
+    while (tls13_multirec_ok(s, type, len - tot)) {
+        i = tls13_write_records(s, write_buf_at(&s->rlayer, buf, tot),
+                                len - tot, &tmpwrit);
+        if (i <= 0) {
+            s->rlayer.wnum = tot;
+            return i;
+        }
+        tot += tmpwrit;
+        if (s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE) {
+            tls13_release_multirec_buffer(s);
+            *written = tot;
+            return 1;
+        }
+    }
+    tls13_release_multirec_buffer(s);
+#endif
 #if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
     /*
      * Depending on platform multi-block can deliver several *times*
      * better performance. Downside is that it has to allocate
      * jumbo buffer to accommodate up to 8 records, but the
-     * compromise is considered worthy.
+     * compromise is considered worthy. It needs the data to be contiguous
+     * though, so isn't used for SSL_writev_ex().
      */
-    if (type == SSL3_RT_APPLICATION_DATA &&
+    if (type == SSL3_RT_APPLICATION_DATA && buf != NULL &&
         len >= 4 * (max_send_fragment = s->max_send_fragment) &&
         s->compress == NULL && s->msg_callback == NULL &&
         !SSL_WRITE_ETM(s) && SSL_USE_EXPLICIT_IV(s) &&
@@ -597,8 +875,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
             }
         }
 
-        i = do_ssl3_write(s, type, &(buf[tot]), pipelens, numpipes, 0,
-                          &tmpwrit);
+        i = do_ssl3_write(s, type, write_buf_at(&s->rlayer, buf, tot),
+                          pipelens, numpipes, 0, &tmpwrit);
         if (i <= 0) {
             /* XXX should we ssl3_release_write_buffer if i<0? */
             s->rlayer.wnum = tot;
@@ -614,8 +892,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
              */
             s->s3->empty_fragment_done = 0;
 
-            if ((i == (int)n) && s->mode & SSL_MODE_RELEASE_BUFFERS &&
-                !SSL_IS_DTLS(s))
+            if (s->mode & SSL_MODE_RELEASE_BUFFERS && !SSL_IS_DTLS(s))
                 ssl3_release_write_buffer(s);
 
             *written = tot + tmpwrit;
@@ -669,6 +946,28 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     if (totlen == 0 && !create_empty_fragment)
         return 0;
 
+    if (BIO_get_ktls_send(s->wbio)) {
+        /*
+         * The kernel does all of the record framing and protection, so the
+         * plaintext just needs queueing up to be written
+         */
+        wb = &s->rlayer.wbuf[0];
+        if (numpipes != 1 || create_empty_fragment
+                || totlen > SSL3_BUFFER_get_len(wb)) {
+            SSLerr(SSL_F_DO_SSL3_WRITE, ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+        if (buf == NULL) {
+            if (!ssl3_write_gather(&s->rlayer, SSL3_BUFFER_get_buf(wb), totlen))
+                return -1;
+        } else {
+            memcpy(SSL3_BUFFER_get_buf(wb), buf, totlen);
+        }
+        SSL3_BUFFER_set_offset(wb, 0);
+        SSL3_BUFFER_set_left(wb, totlen);
+        goto write_pending;
+    }
+
     sess = s->session;
 
     if ((sess == NULL) ||
@@ -831,7 +1130,12 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* lets setup the record stuff. */
         SSL3_RECORD_set_data(thiswr, compressdata);
         SSL3_RECORD_set_length(thiswr, pipelens[j]);
-        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
+        /*
+         * A NULL input means the data is gathered for SSL_writev_ex(), which
+         * ssl3_do_compress() relies on
+         */
+        SSL3_RECORD_set_input(thiswr, buf != NULL
+                                      ? (unsigned char *)&buf[totlen] : NULL);
         totlen += pipelens[j];
 
         /*
@@ -846,6 +1150,15 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                 SSLerr(SSL_F_DO_SSL3_WRITE, SSL_R_COMPRESSION_FAILURE);
                 goto err;
             }
+        } else if (buf == NULL) {
+            unsigned char *data;
+
+            if (!WPACKET_allocate_bytes(thispkt, thiswr->length, &data)
+                    || !ssl3_write_gather(&s->rlayer, data, thiswr->length)) {
+                SSLerr(SSL_F_DO_SSL3_WRITE, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            SSL3_RECORD_reset_input(&wr[j]);
         } else {
             if (!WPACKET_memcpy(thispkt, thiswr->input, thiswr->length)) {
                 SSLerr(SSL_F_DO_SSL3_WRITE, ERR_R_INTERNAL_ERROR);
@@ -1035,6 +1348,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
      * memorize arguments so that ssl3_write_pending can detect bad write
      * retries later
      */
+ write_pending:
     s->rlayer.wpend_tot = totlen;
     s->rlayer.wpend_buf = buf;
     s->rlayer.wpend_type = type;
@@ -1078,6 +1392,13 @@ int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t len,
         clear_sys_error();
         if (s->wbio != NULL) {
             s->rwstate = SSL_WRITING;
+            /*
+             * With kTLS anything other than application data has to be
+             * flagged so that the kernel sends it with the right record type
+             */
+            if (type != SSL3_RT_APPLICATION_DATA
+                    && BIO_get_ktls_send(s->wbio))
+                BIO_set_ktls_ctrl_msg(s->wbio, type);
             /* TODO(size_t): Convert this call */
             i = BIO_write(s->wbio, (char *)
                           &(SSL3_BUFFER_get_buf(&wb[currbuf])
@@ -1336,7 +1657,7 @@ int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
             }
             totalbytes += n;
         } while (type == SSL3_RT_APPLICATION_DATA && curr_rec < num_recs
-                 && totalbytes < len);
+                 && SSL3_RECORD_get_type(rr) == type && totalbytes < len);
         if (totalbytes == 0) {
             /* We must have read empty records. Get more data */
             goto start;
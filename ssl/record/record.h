@@ -160,6 +160,18 @@ typedef struct record_layer_st {
     /* number of bytes submitted */
     size_t wpend_ret;
     const unsigned char *wpend_buf;
+    /*
+     * The gather list being written by SSL_writev_ex(), if any. The next
+     * byte to go into a record is at offset |wiov_off| of the data, which is
+     * offset |wiov_pos| of iovec |wiov_idx|. |wiov_buf| holds records that
+     * have to be contiguous for compression.
+     */
+    const SSL_IOVEC *wiov;
+    size_t wiovcnt;
+    size_t wiov_off;
+    size_t wiov_idx;
+    size_t wiov_pos;
+    unsigned char *wiov_buf;
     unsigned char read_sequence[SEQ_NUM_SIZE];
     unsigned char write_sequence[SEQ_NUM_SIZE];
     /* Set to true if this is the first record in a connection */
@@ -213,6 +225,9 @@ __owur int ssl3_enc(SSL *s, SSL3_RECORD *inrecs, size_t n_recs, int send);
 __owur int n_ssl3_mac(SSL *ssl, SSL3_RECORD *rec, unsigned char *md, int send);
 __owur int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t len,
                               size_t *written);
+__owur int ssl3_write_gather(RECORD_LAYER *rl, unsigned char *out, size_t len);
+__owur const unsigned char *ssl3_write_gather_contig(RECORD_LAYER *rl,
+                                                     size_t len);
 __owur int tls1_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int send);
 __owur int tls1_mac(SSL *ssl, SSL3_RECORD *rec, unsigned char *md, int send);
 __owur int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int send);
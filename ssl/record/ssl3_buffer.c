@@ -10,6 +10,120 @@
 #include "../ssl_locl.h"
 #include "record_locl.h"
 
+/*
+ * Take a buffer of |sz| bytes from the pool of |ctx| if it has one, or
+ * allocate a new one.
+ */
+static unsigned char *freelist_extract(SSL_CTX *ctx, int for_read, size_t sz)
+{
+    SSL3_BUF_FREELIST *list;
+    SSL3_BUF_FREELIST_ENTRY *ent = NULL;
+
+    /* Don't touch the lock at all if there is no pool */
+    if (ctx == NULL || ctx->buf_pool.freelist_max_len == 0)
+        return OPENSSL_malloc(sz);
+
+    CRYPTO_THREAD_write_lock(ctx->buf_pool.lock);
+    list = for_read ? &ctx->buf_pool.rbuf_freelist
+                    : &ctx->buf_pool.wbuf_freelist;
+    if (sz == list->chunklen)
+        ent = list->head;
+    if (ent != NULL) {
+        list->head = ent->next;
+        if (--list->len == 0)
+            list->chunklen = 0;
+        ctx->buf_pool.hits++;
+    } else {
+        ctx->buf_pool.misses++;
+    }
+    CRYPTO_THREAD_unlock(ctx->buf_pool.lock);
+
+    if (ent == NULL)
+        return OPENSSL_malloc(sz);
+    return (unsigned char *)ent;
+}
+
+/*
+ * Give the |sz| byte buffer |mem| back to the pool of |ctx|. It is freed if
+ * the pool is full or holds buffers of a different size.
+ */
+static void freelist_insert(SSL_CTX *ctx, int for_read, size_t sz,
+                            unsigned char *mem)
+{
+    SSL3_BUF_FREELIST *list;
+    SSL3_BUF_FREELIST_ENTRY *ent;
+
+    if (mem == NULL)
+        return;
+    if (ctx == NULL || ctx->buf_pool.freelist_max_len == 0
+            || sz < sizeof(*ent)) {
+        OPENSSL_free(mem);
+        return;
+    }
+
+    CRYPTO_THREAD_write_lock(ctx->buf_pool.lock);
+    list = for_read ? &ctx->buf_pool.rbuf_freelist
+                    : &ctx->buf_pool.wbuf_freelist;
+    if ((sz == list->chunklen || list->chunklen == 0)
+            && list->len < ctx->buf_pool.freelist_max_len) {
+        list->chunklen = sz;
+        ent = (SSL3_BUF_FREELIST_ENTRY *)mem;
+        ent->next = list->head;
+        list->head = ent;
+        list->len++;
+        mem = NULL;
+    }
+    CRYPTO_THREAD_unlock(ctx->buf_pool.lock);
+
+    OPENSSL_free(mem);
+}
+
+/* Free buffers until at most |max| are left on |list| */
+static void freelist_trim(SSL3_BUF_FREELIST *list, size_t max)
+{
+    SSL3_BUF_FREELIST_ENTRY *ent;
+
+    while (list->len > max) {
+        ent = list->head;
+        list->head = ent->next;
+        OPENSSL_free(ent);
+        if (--list->len == 0)
+            list->chunklen = 0;
+    }
+}
+
+int ssl_ctx_buffer_pool_init(SSL_CTX *ctx)
+{
+    ctx->buf_pool.lock = CRYPTO_THREAD_lock_new();
+    return ctx->buf_pool.lock != NULL;
+}
+
+void ssl_ctx_buffer_pool_free(SSL_CTX *ctx)
+{
+    freelist_trim(&ctx->buf_pool.rbuf_freelist, 0);
+    freelist_trim(&ctx->buf_pool.wbuf_freelist, 0);
+    CRYPTO_THREAD_lock_free(ctx->buf_pool.lock);
+    ctx->buf_pool.lock = NULL;
+}
+
+/*
+ * Set the number of free buffers of each kind the pool of |ctx| may hold,
+ * freeing any above the new limit. Returns the previous limit.
+ */
+size_t ssl_ctx_set_buffer_pool_size(SSL_CTX *ctx, size_t max)
+{
+    size_t old;
+
+    CRYPTO_THREAD_write_lock(ctx->buf_pool.lock);
+    old = ctx->buf_pool.freelist_max_len;
+    ctx->buf_pool.freelist_max_len = max;
+    freelist_trim(&ctx->buf_pool.rbuf_freelist, max);
+    freelist_trim(&ctx->buf_pool.wbuf_freelist, max);
+    CRYPTO_THREAD_unlock(ctx->buf_pool.lock);
+
+    return old;
+}
+
 void SSL3_BUFFER_set_data(SSL3_BUFFER *b, const unsigned char *d, size_t n)
 {
     if (d != NULL)
@@ -60,7 +174,7 @@ int ssl3_setup_read_buffer(SSL *s)
 #endif
         if (b->default_len > len)
             len = b->default_len;
-        if ((p = OPENSSL_malloc(len)) == NULL)
+        if ((p = freelist_extract(s->ctx, 1, len)) == NULL)
             goto err;
         b->buf = p;
         b->len = len;
@@ -108,7 +222,7 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
         SSL3_BUFFER *thiswb = &wb[currpipe];
 
         if (thiswb->buf == NULL) {
-            p = OPENSSL_malloc(len);
+            p = freelist_extract(s->ctx, 0, len);
             if (p == NULL) {
                 s->rlayer.numwpipes = currpipe;
                 goto err;
@@ -144,7 +258,7 @@ int ssl3_release_write_buffer(SSL *s)
     while (pipes > 0) {
         wb = &RECORD_LAYER_get_wbuf(&s->rlayer)[pipes - 1];
 
-        OPENSSL_free(wb->buf);
+        freelist_insert(s->ctx, 0, wb->len, wb->buf);
         wb->buf = NULL;
         pipes--;
     }
@@ -157,7 +271,7 @@ int ssl3_release_read_buffer(SSL *s)
     SSL3_BUFFER *b;
 
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
-    OPENSSL_free(b->buf);
+    freelist_insert(s->ctx, 1, b->len, b->buf);
     b->buf = NULL;
     return 1;
 }
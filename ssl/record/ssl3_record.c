@@ -100,6 +100,75 @@ static int ssl3_record_app_data_waiting(SSL *s)
     return 1;
 }
 
+/* Can the read cipher decrypt several records in one go? */
+static int ssl3_read_pipeline_ok(SSL *s)
+{
+    return SSL_USE_EXPLICIT_IV(s)
+        && (EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_read_ctx))
+            & EVP_CIPH_FLAG_PIPELINE) != 0;
+}
+
+/*
+ * Can several application data records be read in one go without pipelining
+ * support in the cipher? They are then decrypted one after another by
+ * ssl3_enc_batch(), still saving the trips back to the BIO in between.
+ */
+static int ssl3_read_batch_ok(SSL *s)
+{
+    return !SSL_in_init(s)
+        && s->msg_callback == NULL
+        && !BIO_get_ktls_recv(s->rbio);
+}
+
+/* Is a decrypted TLSv1.3 record application data? */
+static int tls13_record_is_app_data(const SSL3_RECORD *rec)
+{
+    size_t end = rec->length;
+
+    while (end > 0 && rec->data[end - 1] == 0)
+        end--;
+
+    return end > 0 && rec->data[end - 1] == SSL3_RT_APPLICATION_DATA;
+}
+
+/*
+ * Decrypt the |*n_recs| records in |recs| one at a time. In TLSv1.3 the real
+ * record type is only known after decryption, and anything other than
+ * application data (a KeyUpdate for example) has to be dealt with before the
+ * records after it can be decrypted. So it ends the batch: the records after
+ * it are put back in the read buffer and |*n_recs| is reduced. Return values
+ * are as for the enc() method.
+ */
+static int ssl3_enc_batch(SSL *s, SSL3_RECORD *recs, size_t *n_recs)
+{
+    SSL3_BUFFER *rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
+    size_t j, k, unread;
+    int i, ret = 1;
+
+    for (j = 0; j < *n_recs; j++) {
+        i = s->method->ssl3_enc->enc(s, &recs[j], 1, 0);
+        if (i == 0)
+            return 0;
+        if (i < 0) {
+            if (SSL_IS_TLS13(s))
+                return -1;
+            ret = -1;
+            continue;
+        }
+        if (SSL_IS_TLS13(s) && j + 1 < *n_recs
+                && !tls13_record_is_app_data(&recs[j])) {
+            for (k = j + 1, unread = 0; k < *n_recs; k++)
+                unread += SSL3_RT_HEADER_LENGTH + recs[k].orig_len;
+            SSL3_BUFFER_set_offset(rbuf, SSL3_BUFFER_get_offset(rbuf) - unread);
+            SSL3_BUFFER_set_left(rbuf, SSL3_BUFFER_get_left(rbuf) + unread);
+            *n_recs = j + 1;
+            break;
+        }
+    }
+
+    return ret;
+}
+
 int early_data_count_ok(SSL *s, size_t length, size_t overhead, int *al)
 {
     uint32_t max_early_data = s->max_early_data;
@@ -152,8 +221,9 @@ int early_data_count_ok(SSL *s, size_t length, size_t overhead, int *al)
  * rr[i].data,   - data
  * rr[i].length, - number of bytes
  * Multiple records will only be returned if the record types are all
- * SSL3_RT_APPLICATION_DATA. The number of records returned will always be <=
- * |max_pipelines|
+ * SSL3_RT_APPLICATION_DATA, except that in TLSv1.3 the last one may turn out
+ * to be of another type once decrypted. The number of records returned will
+ * always be <= |max_pipelines|
  */
 /* used only by ssl3_read_bytes */
 int ssl3_get_record(SSL *s)
@@ -421,12 +491,17 @@ int ssl3_get_record(SSL *s)
         RECORD_LAYER_clear_first_record(&s->rlayer);
     } while (num_recs < max_recs
              && thisrr->type == SSL3_RT_APPLICATION_DATA
-             && SSL_USE_EXPLICIT_IV(s)
              && s->enc_read_ctx != NULL
-             && (EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_read_ctx))
-                 & EVP_CIPH_FLAG_PIPELINE)
+             && (ssl3_read_pipeline_ok(s) || ssl3_read_batch_ok(s))
              && ssl3_record_app_data_waiting(s));
 
+    /*
+     * If the kernel is decrypting records for us (kTLS) then what we have
+     * read is already plaintext
+     */
+    if (BIO_get_ktls_recv(s->rbio))
+        goto skip_decryption;
+
     /*
      * If in encrypt-then-mac mode calculate mac from encrypted record. All
      * the details below are public so no timing details can leak.
@@ -463,7 +538,10 @@ int ssl3_get_record(SSL *s)
 
     first_rec_len = rr[0].length;
 
-    enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0);
+    if (num_recs > 1 && !ssl3_read_pipeline_ok(s))
+        enc_err = ssl3_enc_batch(s, rr, &num_recs);
+    else
+        enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0);
 
     /*-
      * enc_err is:
@@ -604,6 +682,8 @@ int ssl3_get_record(SSL *s)
         goto f_err;
     }
 
+ skip_decryption:
+
     for (j = 0; j < num_recs; j++) {
         thisrr = &rr[j];
 
@@ -737,6 +817,14 @@ int ssl3_do_compress(SSL *ssl, SSL3_RECORD *wr)
 #ifndef OPENSSL_NO_COMP
     int i;
 
+    /* Data from SSL_writev_ex() has to be made contiguous first */
+    if (wr->input == NULL && wr->length > 0) {
+        wr->input = (unsigned char *)ssl3_write_gather_contig(&ssl->rlayer,
+                                                              wr->length);
+        if (wr->input == NULL)
+            return 0;
+    }
+
     /* TODO(size_t): Convert this call */
     i = COMP_compress_block(ssl->compress, wr->data,
                             (int)(wr->length + SSL3_RT_MAX_COMPRESSED_OVERHEAD),
@@ -24,16 +24,16 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
 {
     EVP_CIPHER_CTX *ctx;
     unsigned char iv[EVP_MAX_IV_LENGTH];
-    size_t ivlen, taglen, offset, loop;
+    size_t ivlen, taglen, offset, loop, j;
     unsigned char *staticiv;
     unsigned char *seq;
     int lenu, lenf;
-    SSL3_RECORD *rec = &recs[0];
+    SSL3_RECORD *rec;
     uint32_t alg_enc;
 
-    if (n_recs != 1) {
+    if (n_recs == 0 || (!sending && n_recs != 1)) {
         /* Should not happen */
-        /* TODO(TLS1.3): Support pipelining */
+        /* TODO(TLS1.3): Support read pipelining */
         return -1;
     }
 
@@ -48,8 +48,11 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
     }
 
     if (ctx == NULL) {
-        memmove(rec->data, rec->input, rec->length);
-        rec->input = rec->data;
+        for (j = 0; j < n_recs; j++) {
+            rec = &recs[j];
+            memmove(rec->data, rec->input, rec->length);
+            rec->input = rec->data;
+        }
         return 1;
     }
 
@@ -73,9 +76,6 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
             taglen = EVP_CCM8_TLS_TAG_LEN;
          else
             taglen = EVP_CCM_TLS_TAG_LEN;
-         if (sending && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, taglen,
-                                         NULL) <= 0)
-            return -1;
     } else if (alg_enc & SSL_AESGCM) {
         taglen = EVP_GCM_TLS_TAG_LEN;
     } else if (alg_enc & SSL_CHACHA20) {
@@ -84,16 +84,6 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
         return -1;
     }
 
-    if (!sending) {
-        /*
-         * Take off tag. There must be at least one byte of content type as
-         * well as the tag
-         */
-        if (rec->length < taglen + 1)
-            return 0;
-        rec->length -= taglen;
-    }
-
     /* Set up IV */
     if (ivlen < SEQ_NUM_SIZE) {
         /* Should not happen */
@@ -101,37 +91,64 @@ int tls13_enc(SSL *s, SSL3_RECORD *recs, size_t n_recs, int sending)
     }
     offset = ivlen - SEQ_NUM_SIZE;
     memcpy(iv, staticiv, offset);
-    for (loop = 0; loop < SEQ_NUM_SIZE; loop++)
-        iv[offset + loop] = staticiv[offset + loop] ^ seq[loop];
-
-    /* Increment the sequence counter */
-    for (loop = SEQ_NUM_SIZE; loop > 0; loop--) {
-        ++seq[loop - 1];
-        if (seq[loop - 1] != 0)
-            break;
-    }
-    if (loop == 0) {
-        /* Sequence has wrapped */
-        return -1;
-    }
 
-    /* TODO(size_t): lenu/lenf should be a size_t but EVP doesn't support it */
-    if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, sending) <= 0
-            || (!sending && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
-                                             taglen,
-                                             rec->data + rec->length) <= 0)
-            || EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
-                                (unsigned int)rec->length) <= 0
-            || EVP_CipherFinal_ex(ctx, rec->data + lenu, &lenf) <= 0
-            || (size_t)(lenu + lenf) != rec->length) {
-        return -1;
-    }
-    if (sending) {
-        /* Add the tag */
-        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, taglen,
-                                rec->data + rec->length) <= 0)
+    /*
+     * When sending several records (see tls13_write_records()) they're all
+     * done here in one pass. The key schedule was set up when the keys were
+     * installed, and the tag length and cipher checks above are done once per
+     * batch. Each record still needs its own nonce, and so its own
+     * EVP_CipherInit_ex() call.
+     */
+    for (j = 0; j < n_recs; j++) {
+        rec = &recs[j];
+
+        if (!sending) {
+            /*
+             * Take off tag. There must be at least one byte of content type as
+             * well as the tag
+             */
+            if (rec->length < taglen + 1)
+                return 0;
+            rec->length -= taglen;
+        }
+
+        for (loop = 0; loop < SEQ_NUM_SIZE; loop++)
+            iv[offset + loop] = staticiv[offset + loop] ^ seq[loop];
+
+        /* Increment the sequence counter */
+        for (loop = SEQ_NUM_SIZE; loop > 0; loop--) {
+            ++seq[loop - 1];
+            if (seq[loop - 1] != 0)
+                break;
+        }
+        if (loop == 0) {
+            /* Sequence has wrapped */
+            return -1;
+        }
+
+        if (sending && (alg_enc & SSL_AESCCM) != 0
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, taglen,
+                                       NULL) <= 0)
+            return -1;
+
+        /* TODO(size_t): lenu/lenf should be a size_t but EVP doesn't support it */
+        if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, sending) <= 0
+                || (!sending && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                                 taglen,
+                                                 rec->data + rec->length) <= 0)
+                || EVP_CipherUpdate(ctx, rec->data, &lenu, rec->input,
+                                    (unsigned int)rec->length) <= 0
+                || EVP_CipherFinal_ex(ctx, rec->data + lenu, &lenf) <= 0
+                || (size_t)(lenu + lenf) != rec->length) {
             return -1;
-        rec->length += taglen;
+        }
+        if (sending) {
+            /* Add the tag */
+            if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, taglen,
+                                    rec->data + rec->length) <= 0)
+                return -1;
+            rec->length += taglen;
+        }
     }
 
     return 1;
@@ -3362,41 +3362,29 @@ long ssl3_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         break;
     case SSL_CTRL_SET_TLSEXT_TICKET_KEYS:
     case SSL_CTRL_GET_TLSEXT_TICKET_KEYS:
+    case SSL_CTRL_ROTATE_TLSEXT_TICKET_KEYS:
         {
             unsigned char *keys = parg;
-            long tick_keylen = (sizeof(ctx->ext.tick_key_name) +
-                                sizeof(ctx->ext.tick_hmac_key) +
-                                sizeof(ctx->ext.tick_aes_key));
-            if (keys == NULL)
+            long tick_keylen = sizeof(SSL_TICKET_KEY);
+            int rotate = cmd == SSL_CTRL_ROTATE_TLSEXT_TICKET_KEYS;
+
+            /* Rotating in a NULL key generates a random one */
+            if (keys == NULL && !rotate)
                 return tick_keylen;
-            if (larg != tick_keylen) {
+            if (keys != NULL && larg != tick_keylen) {
                 SSLerr(SSL_F_SSL3_CTX_CTRL, SSL_R_INVALID_TICKET_KEYS_LENGTH);
                 return 0;
             }
-            if (cmd == SSL_CTRL_SET_TLSEXT_TICKET_KEYS) {
-                memcpy(ctx->ext.tick_key_name, keys,
-                       sizeof(ctx->ext.tick_key_name));
-                memcpy(ctx->ext.tick_hmac_key,
-                       keys + sizeof(ctx->ext.tick_key_name),
-                       sizeof(ctx->ext.tick_hmac_key));
-                memcpy(ctx->ext.tick_aes_key,
-                       keys + sizeof(ctx->ext.tick_key_name) +
-                       sizeof(ctx->ext.tick_hmac_key),
-                       sizeof(ctx->ext.tick_aes_key));
-            } else {
-                memcpy(keys, ctx->ext.tick_key_name,
-                       sizeof(ctx->ext.tick_key_name));
-                memcpy(keys + sizeof(ctx->ext.tick_key_name),
-                       ctx->ext.tick_hmac_key,
-                       sizeof(ctx->ext.tick_hmac_key));
-                memcpy(keys + sizeof(ctx->ext.tick_key_name) +
-                       sizeof(ctx->ext.tick_hmac_key),
-                       ctx->ext.tick_aes_key,
-                       sizeof(ctx->ext.tick_aes_key));
-            }
-            return 1;
+            if (cmd == SSL_CTRL_GET_TLSEXT_TICKET_KEYS)
+                return ssl_ctx_get_ticket_keys(ctx, keys);
+            return ssl_ctx_set_ticket_keys(ctx, keys, rotate);
         }
 
+    case SSL_CTRL_SET_MAX_TLSEXT_TICKET_KEYS:
+        if (larg < 0)
+            return 0;
+        return ssl_ctx_set_max_ticket_keys(ctx, (size_t)larg);
+
     case SSL_CTRL_GET_TLSEXT_STATUS_REQ_TYPE:
         return ctx->ext.status_type;
 
@@ -4092,14 +4080,20 @@ int ssl_generate_master_secret(SSL *s, unsigned char *pms, size_t pmslen,
     return ret;
 }
 
-/* Generate a private key from parameters */
-EVP_PKEY *ssl_generate_pkey(EVP_PKEY *pm)
+/* Generate a private key from parameters, or take one from the pool */
+EVP_PKEY *ssl_generate_pkey(SSL *s, EVP_PKEY *pm)
 {
     EVP_PKEY_CTX *pctx = NULL;
     EVP_PKEY *pkey = NULL;
+    uint64_t t = ssl_timing_begin(s);
 
     if (pm == NULL)
         return NULL;
+#ifndef OPENSSL_NO_EC
+    if (s->ctx->keypool != NULL
+            && (pkey = ssl_keypool_get_for(s->ctx->keypool, pm)) != NULL)
+        goto err;
+#endif
     pctx = EVP_PKEY_CTX_new(pm, NULL);
     if (pctx == NULL)
         goto err;
@@ -4112,19 +4106,27 @@ EVP_PKEY *ssl_generate_pkey(EVP_PKEY *pm)
 
     err:
     EVP_PKEY_CTX_free(pctx);
+    ssl_timing_end(s, SSL_HS_TIME_KEY_EXCHANGE, t);
     return pkey;
 }
 #ifndef OPENSSL_NO_EC
-/* Generate a private key a curve ID */
-EVP_PKEY *ssl_generate_pkey_curve(int id)
+/*
+ * Generate a private key a curve ID, or take one from the pool.  With a NULL
+ * |s| a new key is always generated.
+ */
+EVP_PKEY *ssl_generate_pkey_curve(SSL *s, int id)
 {
     EVP_PKEY_CTX *pctx = NULL;
     EVP_PKEY *pkey = NULL;
     unsigned int curve_flags;
     int nid = tls1_ec_curve_id2nid(id, &curve_flags);
+    uint64_t t = s != NULL ? ssl_timing_begin(s) : 0;
 
     if (nid == 0)
         goto err;
+    if (s != NULL && s->ctx->keypool != NULL
+            && (pkey = ssl_keypool_get(s->ctx->keypool, id)) != NULL)
+        goto err;
     if ((curve_flags & TLS_CURVE_TYPE) == TLS_CURVE_CUSTOM) {
         pctx = EVP_PKEY_CTX_new_id(nid, NULL);
         nid = 0;
@@ -4144,6 +4146,8 @@ EVP_PKEY *ssl_generate_pkey_curve(int id)
 
  err:
     EVP_PKEY_CTX_free(pctx);
+    if (s != NULL)
+        ssl_timing_end(s, SSL_HS_TIME_KEY_EXCHANGE, t);
     return pkey;
 }
 #endif
@@ -4155,10 +4159,13 @@ int ssl_derive(SSL *s, EVP_PKEY *privkey, EVP_PKEY *pubkey, int gensecret)
     unsigned char *pms = NULL;
     size_t pmslen = 0;
     EVP_PKEY_CTX *pctx;
+    uint64_t t;
 
     if (privkey == NULL || pubkey == NULL)
         return 0;
 
+    t = ssl_timing_begin(s);
+
     pctx = EVP_PKEY_CTX_new(privkey, NULL);
 
     if (EVP_PKEY_derive_init(pctx) <= 0
@@ -4202,6 +4209,7 @@ int ssl_derive(SSL *s, EVP_PKEY *privkey, EVP_PKEY *pubkey, int gensecret)
  err:
     OPENSSL_clear_free(pms, pmslen);
     EVP_PKEY_CTX_free(pctx);
+    ssl_timing_end(s, SSL_HS_TIME_KEY_EXCHANGE, t);
     return rv;
 }
 
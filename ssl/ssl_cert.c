@@ -374,6 +374,7 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
     X509_STORE *verify_store;
     X509_STORE_CTX *ctx = NULL;
     X509_VERIFY_PARAM *param;
+    uint64_t t;
 
     if ((sk == NULL) || (sk_X509_num(sk) == 0))
         return 0;
@@ -428,10 +429,12 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
     if (s->verify_callback)
         X509_STORE_CTX_set_verify_cb(ctx, s->verify_callback);
 
+    t = ssl_timing_begin(s);
     if (s->ctx->app_verify_callback != NULL)
         i = s->ctx->app_verify_callback(ctx, s->ctx->app_verify_arg);
     else
         i = X509_verify_cert(ctx);
+    ssl_timing_end(s, SSL_HS_TIME_CERT_VERIFY, t);
 
     s->verify_result = X509_STORE_CTX_get_error(ctx);
     sk_X509_pop_free(s->verified_chain, X509_free);
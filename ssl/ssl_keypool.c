@@ -0,0 +1,230 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A pool of ephemeral ECDHE keys generated ahead of time, so that handshakes
+ * only have to derive the shared secret.  The application fills the pool
+ * when it has time to spare, with SSL_CTX_fill_keyshare_pool(); handshakes
+ * take keys out of it and fall back to generating them if it is empty.
+ * Each key is handed out once only.
+ */
+
+#include <string.h>
+#include "ssl_locl.h"
+
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/types.h>
+# include <unistd.h>
+#endif
+
+#ifndef OPENSSL_NO_EC
+
+/* The groups we keep keys for: X25519, P-256 and P-384 */
+static const uint16_t keypool_groups[] = { 29, 23, 24 };
+
+# define KEYPOOL_NUM_GROUPS OSSL_NELEM(keypool_groups)
+
+struct ssl_keypool_st {
+    CRYPTO_RWLOCK *lock;
+    size_t size;
+# ifdef OPENSSL_SYS_UNIX
+    /* Keys generated before a fork() must not be used by both processes */
+    pid_t pid;
+# endif
+    size_t num[KEYPOOL_NUM_GROUPS];
+    EVP_PKEY **keys[KEYPOOL_NUM_GROUPS];
+};
+
+static void keypool_flush(SSL_KEYPOOL *pool)
+{
+    size_t i, j;
+
+    for (i = 0; i < KEYPOOL_NUM_GROUPS; i++) {
+        for (j = 0; j < pool->num[i]; j++)
+            EVP_PKEY_free(pool->keys[i][j]);
+        pool->num[i] = 0;
+    }
+}
+
+/* Must be called with the pool locked */
+static void keypool_check_fork(SSL_KEYPOOL *pool)
+{
+# ifdef OPENSSL_SYS_UNIX
+    pid_t pid = getpid();
+
+    if (pool->pid != pid) {
+        keypool_flush(pool);
+        pool->pid = pid;
+    }
+# endif
+}
+
+void ssl_keypool_free(SSL_KEYPOOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL)
+        return;
+    keypool_flush(pool);
+    for (i = 0; i < KEYPOOL_NUM_GROUPS; i++)
+        OPENSSL_free(pool->keys[i]);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+EVP_PKEY *ssl_keypool_get(SSL_KEYPOOL *pool, int id)
+{
+    EVP_PKEY *pkey = NULL;
+    size_t i;
+
+    for (i = 0; i < KEYPOOL_NUM_GROUPS; i++)
+        if (keypool_groups[i] == id)
+            break;
+    if (i == KEYPOOL_NUM_GROUPS)
+        return NULL;
+
+    CRYPTO_THREAD_write_lock(pool->lock);
+    keypool_check_fork(pool);
+    if (pool->num[i] > 0)
+        pkey = pool->keys[i][--pool->num[i]];
+    CRYPTO_THREAD_unlock(pool->lock);
+    return pkey;
+}
+
+/* Take a key with the same parameters as |pm| out of the pool */
+EVP_PKEY *ssl_keypool_get_for(SSL_KEYPOOL *pool, EVP_PKEY *pm)
+{
+    int nid = EVP_PKEY_id(pm);
+
+    if (nid == EVP_PKEY_EC) {
+        const EC_GROUP *group = EC_KEY_get0_group(EVP_PKEY_get0_EC_KEY(pm));
+
+        if (group == NULL)
+            return NULL;
+        nid = EC_GROUP_get_curve_name(group);
+    }
+    return ssl_keypool_get(pool, tls1_ec_nid2curve_id(nid));
+}
+
+int SSL_CTX_set_keyshare_pool_size(SSL_CTX *ctx, size_t num)
+{
+    SSL_KEYPOOL *pool = ctx->keypool;
+    EVP_PKEY **keys[KEYPOOL_NUM_GROUPS];
+    size_t i, j;
+
+    if (num == 0) {
+        ssl_keypool_free(pool);
+        ctx->keypool = NULL;
+        return 1;
+    }
+
+    if (pool == NULL) {
+        if ((pool = OPENSSL_zalloc(sizeof(*pool))) == NULL
+                || (pool->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            OPENSSL_free(pool);
+            SSLerr(SSL_F_SSL_CTX_SET_KEYSHARE_POOL_SIZE, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+# ifdef OPENSSL_SYS_UNIX
+        pool->pid = getpid();
+# endif
+        ctx->keypool = pool;
+    }
+
+    for (i = 0; i < KEYPOOL_NUM_GROUPS; i++) {
+        if ((keys[i] = OPENSSL_zalloc(num * sizeof(*keys[i]))) == NULL) {
+            while (i-- > 0)
+                OPENSSL_free(keys[i]);
+            SSLerr(SSL_F_SSL_CTX_SET_KEYSHARE_POOL_SIZE, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+    }
+
+    /* Keep the keys that still fit */
+    CRYPTO_THREAD_write_lock(pool->lock);
+    for (i = 0; i < KEYPOOL_NUM_GROUPS; i++) {
+        for (j = num; j < pool->num[i]; j++)
+            EVP_PKEY_free(pool->keys[i][j]);
+        if (pool->num[i] > num)
+            pool->num[i] = num;
+        if (pool->num[i] > 0)
+            memcpy(keys[i], pool->keys[i], pool->num[i] * sizeof(*keys[i]));
+        OPENSSL_free(pool->keys[i]);
+        pool->keys[i] = keys[i];
+    }
+    pool->size = num;
+    CRYPTO_THREAD_unlock(pool->lock);
+    return 1;
+}
+
+int SSL_CTX_fill_keyshare_pool(SSL_CTX *ctx, size_t max)
+{
+    SSL_KEYPOOL *pool = ctx->keypool;
+    EVP_PKEY *pkey;
+    size_t i;
+    int added = 0, more = 1;
+
+    if (pool == NULL)
+        return 0;
+
+    /* Fill the groups in turn, so that all of them have some keys */
+    while (more && (max == 0 || (size_t)added < max)) {
+        more = 0;
+        for (i = 0; i < KEYPOOL_NUM_GROUPS; i++) {
+            if (max != 0 && (size_t)added == max)
+                break;
+
+            CRYPTO_THREAD_write_lock(pool->lock);
+            keypool_check_fork(pool);
+            if (pool->num[i] == pool->size) {
+                CRYPTO_THREAD_unlock(pool->lock);
+                continue;
+            }
+            CRYPTO_THREAD_unlock(pool->lock);
+
+            /* Don't hold the lock while generating */
+            if ((pkey = ssl_generate_pkey_curve(NULL, keypool_groups[i]))
+                    == NULL)
+                continue;
+
+            CRYPTO_THREAD_write_lock(pool->lock);
+            keypool_check_fork(pool);
+            if (pool->num[i] < pool->size) {
+                pool->keys[i][pool->num[i]++] = pkey;
+                pkey = NULL;
+                added++;
+                more = 1;
+            }
+            CRYPTO_THREAD_unlock(pool->lock);
+            EVP_PKEY_free(pkey);
+        }
+    }
+    return added;
+}
+
+#else
+
+void ssl_keypool_free(SSL_KEYPOOL *pool)
+{
+}
+
+int SSL_CTX_set_keyshare_pool_size(SSL_CTX *ctx, size_t num)
+{
+    if (num == 0)
+        return 1;
+    SSLerr(SSL_F_SSL_CTX_SET_KEYSHARE_POOL_SIZE, ERR_R_DISABLED);
+    return 0;
+}
+
+int SSL_CTX_fill_keyshare_pool(SSL_CTX *ctx, size_t max)
+{
+    return 0;
+}
+
+#endif /* OPENSSL_NO_EC */
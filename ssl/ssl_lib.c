@@ -20,6 +20,7 @@
 #include <openssl/engine.h>
 #include <openssl/async.h>
 #include <openssl/ct.h>
+#include "internal/ktls.h"
 
 const char SSL_version_str[] = OPENSSL_VERSION_TEXT;
 
@@ -657,6 +658,8 @@ SSL *SSL_new(SSL_CTX *ctx)
     s->record_padding_cb = ctx->record_padding_cb;
     s->record_padding_arg = ctx->record_padding_arg;
     s->block_padding = ctx->block_padding;
+    s->async_cb = ctx->async_cb;
+    s->async_cb_arg = ctx->async_cb_arg;
     s->sid_ctx_length = ctx->sid_ctx_length;
     if (!ossl_assert(s->sid_ctx_length <= sizeof s->sid_ctx))
         goto err;
@@ -844,9 +847,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
-    CRYPTO_THREAD_read_lock(ssl->session_ctx->lock);
-    p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
-    CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
+    p = ssl_sess_cache_lookup(ssl->session_ctx, &r, 0);
     return (p != NULL);
 }
 
@@ -1122,6 +1123,8 @@ void SSL_free(SSL *s)
 
     ASYNC_WAIT_CTX_free(s->waitctx);
 
+    OPENSSL_free(s->hs_timings);
+
 #if !defined(OPENSSL_NO_NEXTPROTONEG)
     OPENSSL_free(s->ext.npn);
 #endif
@@ -1546,6 +1549,36 @@ int SSL_get_changed_async_fds(SSL *s, OSSL_ASYNC_FD *addfd, size_t *numaddfds,
                                           numdelfds);
 }
 
+void SSL_CTX_set_async_callback(SSL_CTX *ctx, SSL_async_callback_fn callback)
+{
+    ctx->async_cb = callback;
+}
+
+void SSL_CTX_set_async_callback_arg(SSL_CTX *ctx, void *arg)
+{
+    ctx->async_cb_arg = arg;
+}
+
+void SSL_set_async_callback(SSL *s, SSL_async_callback_fn callback)
+{
+    s->async_cb = callback;
+}
+
+void SSL_set_async_callback_arg(SSL *s, void *arg)
+{
+    s->async_cb_arg = arg;
+}
+
+int SSL_get_async_status(SSL *s, int *status)
+{
+    ASYNC_WAIT_CTX *ctx = s->waitctx;
+
+    if (ctx == NULL)
+        return 0;
+    *status = ASYNC_WAIT_CTX_get_status(ctx);
+    return 1;
+}
+
 int SSL_accept(SSL *s)
 {
     if (s->handshake_func == NULL) {
@@ -1571,6 +1604,17 @@ long SSL_get_default_timeout(const SSL *s)
     return (s->method->get_timeout());
 }
 
+static int ssl_async_wait_ctx_cb(void *arg)
+{
+    SSL *s = (SSL *)arg;
+    SSL_async_callback_fn cb = s->async_cb;
+
+    /* The callback may have been unset since the operation was started */
+    if (cb == NULL)
+        return 0;
+    return cb(s, s->async_cb_arg);
+}
+
 static int ssl_start_async_job(SSL *s, struct ssl_async_args *args,
                                int (*func) (void *))
 {
@@ -1580,10 +1624,17 @@ static int ssl_start_async_job(SSL *s, struct ssl_async_args *args,
         if (s->waitctx == NULL)
             return -1;
     }
+    /* Pick up any change to the callback since the last operation */
+    if (!ASYNC_WAIT_CTX_set_callback(s->waitctx,
+                                     s->async_cb != NULL
+                                     ? ssl_async_wait_ctx_cb : NULL,
+                                     s))
+        return -1;
     switch (ASYNC_start_job(&s->job, s->waitctx, &ret, func, args,
                             sizeof(struct ssl_async_args))) {
     case ASYNC_ERR:
         s->rwstate = SSL_NOTHING;
+        ASYNC_WAIT_CTX_set_status(s->waitctx, ASYNC_STATUS_UNSUPPORTED);
         SSLerr(SSL_F_SSL_START_ASYNC_JOB, SSL_R_FAILED_TO_INIT_ASYNC);
         return -1;
     case ASYNC_PAUSE:
@@ -1594,6 +1645,8 @@ static int ssl_start_async_job(SSL *s, struct ssl_async_args *args,
         return -1;
     case ASYNC_FINISH:
         s->job = NULL;
+        /* The status only describes the operation that just finished */
+        ASYNC_WAIT_CTX_set_status(s->waitctx, ASYNC_STATUS_UNSUPPORTED);
         return ret;
     default:
         s->rwstate = SSL_NOTHING;
@@ -1888,6 +1941,172 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+int SSL_writev_ex(SSL *s, const SSL_IOVEC *iov, int iovcnt, size_t *written)
+{
+    size_t num = 0;
+    int i, ret;
+
+    if (iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
+        SSLerr(SSL_F_SSL_WRITEV_EX, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > SIZE_MAX - num) {
+            SSLerr(SSL_F_SSL_WRITEV_EX, SSL_R_BAD_LENGTH);
+            return 0;
+        }
+        num += iov[i].iov_len;
+    }
+
+    /* Nothing to gather */
+    if (iovcnt == 1)
+        return SSL_write_ex(s, iov[0].iov_base, iov[0].iov_len, written);
+
+    /*
+     * The record layer copies the data straight from |iov| into the records
+     * it builds, for which it is told to expect a NULL buffer
+     */
+    s->rlayer.wiov = iov;
+    s->rlayer.wiovcnt = iovcnt;
+    s->rlayer.wiov_off = 0;
+    s->rlayer.wiov_idx = 0;
+    s->rlayer.wiov_pos = 0;
+    ret = ssl_write_internal(s, NULL, num, written);
+    s->rlayer.wiov = NULL;
+    s->rlayer.wiovcnt = 0;
+    OPENSSL_free(s->rlayer.wiov_buf);
+    s->rlayer.wiov_buf = NULL;
+
+    if (ret < 0)
+        ret = 0;
+    return ret;
+}
+
+/*
+ * SSL_sendfile() without kTLS: read the file in record sized chunks and
+ * write them with SSL_write_ex()
+ */
+static ossl_ssize_t ssl_sendfile_copy(SSL *s, int fd, off_t offset,
+                                      size_t size)
+{
+#ifdef OPENSSL_NO_POSIX_IO
+    SSLerr(SSL_F_SSL_SENDFILE_COPY, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+    return -1;
+#else
+    size_t chunk = size < s->max_send_fragment ? size : s->max_send_fragment;
+    uint32_t moving = s->mode & SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+    unsigned char *buf;
+    ossl_ssize_t sent = 0;
+
+    if (size == 0)
+        return 0;
+    if ((buf = OPENSSL_malloc(chunk)) == NULL) {
+        SSLerr(SSL_F_SSL_SENDFILE_COPY, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+
+    /*
+     * If a write has to be retried the chunk will be read again, into a
+     * fresh buffer
+     */
+    s->mode |= SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+
+    while ((size_t)sent < size) {
+        size_t len = size - sent, written;
+        ossl_ssize_t n;
+
+        if (len > chunk)
+            len = chunk;
+# if defined(OPENSSL_SYS_WINDOWS) || defined(OPENSSL_SYS_MSDOS) \
+     || defined(OPENSSL_SYS_VMS)
+        if (lseek(fd, offset + sent, SEEK_SET) != offset + sent)
+            n = -1;
+        else
+            n = read(fd, buf, len);
+# else
+        n = pread(fd, buf, len, offset + sent);
+# endif
+        if (n < 0) {
+            SSLerr(SSL_F_SSL_SENDFILE_COPY, ERR_R_SYS_LIB);
+            if (sent == 0)
+                sent = -1;
+            break;
+        }
+        if (n == 0)
+            break;
+        if (!SSL_write_ex(s, buf, (size_t)n, &written)) {
+            if (sent == 0)
+                sent = -1;
+            break;
+        }
+        sent += written;
+    }
+
+    s->mode = (s->mode & ~SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER) | moving;
+    OPENSSL_clear_free(buf, chunk);
+    return sent;
+#endif
+}
+
+ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size, int flags)
+{
+    ossl_ssize_t ret;
+
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_UNINITIALIZED);
+        return -1;
+    }
+
+    if (s->shutdown & SSL_SENT_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_PROTOCOL_IS_SHUTDOWN);
+        return -1;
+    }
+
+    /* No flags are defined yet */
+    if (flags != 0) {
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_PASSED_INVALID_ARGUMENT);
+        return -1;
+    }
+
+    if (!BIO_get_ktls_send(s->wbio))
+        return ssl_sendfile_copy(s, fd, offset, size);
+
+    /* A write that is still pending must be completed with SSL_write() */
+    if (RECORD_LAYER_write_pending(&s->rlayer)) {
+        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_BAD_WRITE_RETRY);
+        return -1;
+    }
+
+    /* If we have an alert to send, lets send it */
+    if (s->s3->alert_dispatch) {
+        ret = (ossl_ssize_t)s->method->ssl_dispatch_alert(s);
+        if (ret <= 0)
+            return ret;
+    }
+
+    s->rwstate = SSL_WRITING;
+    if (BIO_flush(s->wbio) <= 0) {
+        if (!BIO_should_retry(s->wbio))
+            s->rwstate = SSL_NOTHING;
+        return -1;
+    }
+
+    clear_sys_error();
+    ret = ktls_sendfile(SSL_get_wfd(s), fd, offset, size, flags);
+    if (ret < 0) {
+        if (BIO_sock_should_retry((int)ret)) {
+            BIO_set_retry_write(s->wbio);
+        } else {
+            s->rwstate = SSL_NOTHING;
+            SSLerr(SSL_F_SSL_SENDFILE, ERR_R_SYS_LIB);
+        }
+        return -1;
+    }
+    s->rwstate = SSL_NOTHING;
+    return ret;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -2148,7 +2367,7 @@ long SSL_callback_ctrl(SSL *s, int cmd, void (*fp) (void))
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
 {
-    return ctx->sessions;
+    return ctx->sess_cache[0].sessions;
 }
 
 long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
@@ -2200,13 +2419,19 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return (long)(ctx->session_cache_size);
     case SSL_CTRL_SET_SESS_CACHE_MODE:
         l = ctx->session_cache_mode;
+        if (((l ^ larg) & SSL_SESS_CACHE_SHARDED) != 0
+                && !ssl_sess_cache_set_sharded(ctx,
+                                    (larg & SSL_SESS_CACHE_SHARDED) != 0)) {
+            /* Keep the existing cache layout */
+            larg ^= SSL_SESS_CACHE_SHARDED;
+        }
         ctx->session_cache_mode = larg;
         return (l);
     case SSL_CTRL_GET_SESS_CACHE_MODE:
         return (ctx->session_cache_mode);
 
     case SSL_CTRL_SESS_NUMBER:
-        return (lh_SSL_SESSION_num_items(ctx->sessions));
+        return (long)ssl_sess_cache_num_items(ctx);
     case SSL_CTRL_SESS_CONNECT:
         return (ctx->stats.sess_connect);
     case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -2228,7 +2453,7 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
     case SSL_CTRL_SESS_TIMEOUTS:
         return (ctx->stats.sess_timeout);
     case SSL_CTRL_SESS_CACHE_FULL:
-        return (ctx->stats.sess_cache_full);
+        return ssl_sess_cache_full(ctx);
     case SSL_CTRL_MODE:
         return (ctx->mode |= larg);
     case SSL_CTRL_CLEAR_MODE:
@@ -2250,6 +2475,16 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
             return 0;
         ctx->max_pipelines = larg;
         return 1;
+    case SSL_CTRL_SET_BUFFER_POOL_SIZE:
+        if (larg < 0)
+            return 0;
+        return (long)ssl_ctx_set_buffer_pool_size(ctx, (size_t)larg);
+    case SSL_CTRL_GET_BUFFER_POOL_SIZE:
+        return (long)ctx->buf_pool.freelist_max_len;
+    case SSL_CTRL_BUFFER_POOL_HITS:
+        return (long)ctx->buf_pool.hits;
+    case SSL_CTRL_BUFFER_POOL_MISSES:
+        return (long)ctx->buf_pool.misses;
     case SSL_CTRL_CERT_FLAGS:
         return (ctx->cert->cert_flags |= larg);
     case SSL_CTRL_CLEAR_CERT_FLAGS:
@@ -2681,49 +2916,6 @@ int SSL_export_keying_material(SSL *s, unsigned char *out, size_t olen,
                                                        contextlen, use_context);
 }
 
-static unsigned long ssl_session_hash(const SSL_SESSION *a)
-{
-    const unsigned char *session_id = a->session_id;
-    unsigned long l;
-    unsigned char tmp_storage[4];
-
-    if (a->session_id_length < sizeof(tmp_storage)) {
-        memset(tmp_storage, 0, sizeof(tmp_storage));
-        memcpy(tmp_storage, a->session_id, a->session_id_length);
-        session_id = tmp_storage;
-    }
-
-    l = (unsigned long)
-        ((unsigned long)session_id[0]) |
-        ((unsigned long)session_id[1] << 8L) |
-        ((unsigned long)session_id[2] << 16L) |
-        ((unsigned long)session_id[3] << 24L);
-    return (l);
-}
-
-/*
- * NB: If this function (or indeed the hash function which uses a sort of
- * coarser function than this one) is changed, ensure
- * SSL_CTX_has_matching_session_id() is checked accordingly. It relies on
- * being able to construct an SSL_SESSION that will collide with any existing
- * session with a matching session ID.
- */
-static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
-{
-    if (a->ssl_version != b->ssl_version)
-        return (1);
-    if (a->session_id_length != b->session_id_length)
-        return (1);
-    return (memcmp(a->session_id, b->session_id, a->session_id_length));
-}
-
-/*
- * These wrapper functions should remain rather than redeclaring
- * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
- * variable. The reason is that the functions aren't static, they're exposed
- * via ssl.h.
- */
-
 SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
 {
     SSL_CTX *ret = NULL;
@@ -2763,8 +2955,7 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     if ((ret->cert = ssl_cert_new()) == NULL)
         goto err;
 
-    ret->sessions = lh_SSL_SESSION_new(ssl_session_hash, ssl_session_cmp);
-    if (ret->sessions == NULL)
+    if (!ssl_sess_cache_init(ret))
         goto err;
     ret->cert_store = X509_STORE_new();
     if (ret->cert_store == NULL)
@@ -2809,13 +3000,11 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     ret->split_send_fragment = SSL3_RT_MAX_PLAIN_LENGTH;
 
     /* Setup RFC5077 ticket keys */
-    if ((RAND_bytes(ret->ext.tick_key_name,
-                    sizeof(ret->ext.tick_key_name)) <= 0)
-        || (RAND_bytes(ret->ext.tick_hmac_key,
-                       sizeof(ret->ext.tick_hmac_key)) <= 0)
-        || (RAND_bytes(ret->ext.tick_aes_key,
-                       sizeof(ret->ext.tick_aes_key)) <= 0))
-        ret->options |= SSL_OP_NO_TICKET;
+    if (!ssl_ctx_ticket_keys_init(ret))
+        goto err;
+
+    if (!ssl_ctx_buffer_pool_init(ret))
+        goto err;
 
 #ifndef OPENSSL_NO_SRP
     if (!SSL_CTX_SRP_CTX_init(ret))
@@ -2905,11 +3094,13 @@ void SSL_CTX_free(SSL_CTX *a)
      * free ex_data, then finally free the cache.
      * (See ticket [openssl.org #212].)
      */
-    if (a->sessions != NULL)
+    if (a->sess_cache != NULL)
         SSL_CTX_flush_sessions(a, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
-    lh_SSL_SESSION_free(a->sessions);
+    ssl_sess_cache_free(a);
+    ssl_shcache_free(a->shared_cache);
+    ssl_keypool_free(a->keypool);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -2935,6 +3126,8 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->ext.supportedgroups);
 #endif
     OPENSSL_free(a->ext.alpn);
+    ssl_ctx_ticket_keys_free(a);
+    ssl_ctx_buffer_pool_free(a);
 
     CRYPTO_THREAD_lock_free(a->lock);
 
@@ -3157,6 +3350,8 @@ void ssl_update_cache(SSL *s, int mode)
         return;
 
     i = s->session_ctx->session_cache_mode;
+    if ((i & mode) && !s->hit && s->session_ctx->shared_cache != NULL)
+        ssl_shcache_add(s->session_ctx->shared_cache, s->session);
     if ((i & mode) && (!s->hit)
         && ((i & SSL_SESS_CACHE_NO_INTERNAL_STORE)
             || SSL_CTX_add_session(s->session_ctx, s->session))
@@ -704,20 +704,103 @@ DEFINE_LHASH_OF(X509_NAME);
 
 # define TLSEXT_KEYNAME_LENGTH 16
 
+/* Number of shards used by the internal cache with SSL_SESS_CACHE_SHARDED */
+# define SSL_SESS_CACHE_NUM_SHARDS 16
+
+/*
+ * One partition of the internal session cache: a hash table for lookups and
+ * a doubly linked list, most recently added first, for expiry and eviction.
+ * Both are protected by |lock|.
+ */
+typedef struct ssl_sess_cache_shard_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    struct ssl_session_st *head;
+    struct ssl_session_st *tail;
+    /* Sessions evicted because the shard was full */
+    int cache_full;
+} SSL_SESS_CACHE_SHARD;
+
+typedef struct ssl_shcache_st SSL_SHCACHE;
+typedef struct ssl_keypool_st SSL_KEYPOOL;
+
+/* Most handshake state transitions recorded, see ssl_timing.c */
+# define SSL_HS_TIMINGS_MAX_STATES      32
+
+typedef struct ssl_hs_timings_st {
+    /* Set while a handshake is being timed */
+    int active;
+    uint64_t start;
+    /* When we last returned to the application to wait for I/O, or 0 */
+    uint64_t wait_start;
+    /* Time spent, by SSL_HS_TIME_* */
+    uint64_t time[SSL_HS_TIME_NUM];
+    size_t num_states;
+    OSSL_HANDSHAKE_STATE states[SSL_HS_TIMINGS_MAX_STATES];
+    uint64_t state_times[SSL_HS_TIMINGS_MAX_STATES];
+} SSL_HS_TIMINGS;
+
+/* Default number of session ticket keys kept for decryption, see t1_lib.c */
+# define SSL_DEFAULT_TICKET_KEYS    4
+/* Size of the key name index, at least twice TLSEXT_MAX_TICKET_KEYS */
+# define SSL_TICKET_KEY_INDEX_SIZE  32
+
+typedef struct ssl_ticket_key_st {
+    unsigned char name[TLSEXT_KEYNAME_LENGTH];
+    unsigned char hmac_key[32];
+    unsigned char aes_key[32];
+} SSL_TICKET_KEY;
+
+/*
+ * The set of session ticket keys in use by an SSL_CTX. It is never modified
+ * once published: changing the keys means building and publishing a new
+ * ring. keys[0] is used to encrypt new tickets, all of them are accepted for
+ * decryption. |index| is an open addressed hash table of key names, holding
+ * one plus the position in |keys| (0 is an empty slot).
+ */
+typedef struct ssl_ticket_key_ring_st {
+    size_t num;
+    SSL_TICKET_KEY keys[TLSEXT_MAX_TICKET_KEYS];
+    unsigned char index[SSL_TICKET_KEY_INDEX_SIZE];
+} SSL_TICKET_KEY_RING;
+
+/*
+ * A list of free record buffers, all |chunklen| bytes long. The list is
+ * threaded through the first bytes of the buffers themselves.
+ */
+typedef struct ssl3_buf_freelist_entry_st {
+    struct ssl3_buf_freelist_entry_st *next;
+} SSL3_BUF_FREELIST_ENTRY;
+
+typedef struct ssl3_buf_freelist_st {
+    size_t chunklen;
+    size_t len;
+    SSL3_BUF_FREELIST_ENTRY *head;
+} SSL3_BUF_FREELIST;
+
 struct ssl_ctx_st {
     const SSL_METHOD *method;
     STACK_OF(SSL_CIPHER) *cipher_list;
     /* same as above but sorted for lookup */
     STACK_OF(SSL_CIPHER) *cipher_list_by_id;
     struct x509_store_st /* X509_STORE */ *cert_store;
-    LHASH_OF(SSL_SESSION) *sessions;
+    /*
+     * The internal session cache. This is normally a single shard using the
+     * SSL_CTX lock. With SSL_SESS_CACHE_SHARDED it is split into
+     * SSL_SESS_CACHE_NUM_SHARDS shards, each with its own lock, selected by
+     * a hash of the session ID.
+     */
+    SSL_SESS_CACHE_SHARD *sess_cache;
+    size_t sess_cache_shards;
+    /* Session cache shared with forked processes, see ssl_shcache.c */
+    SSL_SHCACHE *shared_cache;
+    /* Ephemeral keys generated ahead of time, see ssl_keypool.c */
+    SSL_KEYPOOL *keypool;
     /*
      * Most session-ids that will be cached, default is
      * SSL_SESSION_CACHE_MAX_SIZE_DEFAULT. 0 is unlimited.
      */
     size_t session_cache_size;
-    struct ssl_session_st *session_cache_head;
-    struct ssl_session_st *session_cache_tail;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -868,6 +951,19 @@ struct ssl_ctx_st {
     /* The default read buffer length to use (0 means not set) */
     size_t default_read_buf_len;
 
+    /*
+     * Free read and write buffers kept for reuse by the SSL objects using
+     * this SSL_CTX, at most |freelist_max_len| of each (0 disables the pool).
+     */
+    struct {
+        size_t freelist_max_len;
+        SSL3_BUF_FREELIST rbuf_freelist;
+        SSL3_BUF_FREELIST wbuf_freelist;
+        size_t hits;
+        size_t misses;
+        CRYPTO_RWLOCK *lock;
+    } buf_pool;
+
 # ifndef OPENSSL_NO_ENGINE
     /*
      * Engine to pass requests for client certs to
@@ -885,9 +981,9 @@ struct ssl_ctx_st {
         int (*servername_cb) (SSL *, int *, void *);
         void *servername_arg;
         /* RFC 4507 session ticket keys */
-        unsigned char tick_key_name[TLSEXT_KEYNAME_LENGTH];
-        unsigned char tick_hmac_key[32];
-        unsigned char tick_aes_key[32];
+        SSL_TICKET_KEY_RING *tick_keys;
+        CRYPTO_RWLOCK *tick_keys_lock;
+        size_t max_tick_keys;
         /* Callback to support customisation of ticket key setting */
         int (*ticket_key_cb) (SSL *ssl,
                               unsigned char *name, unsigned char *iv,
@@ -992,6 +1088,16 @@ struct ssl_ctx_st {
     size_t (*record_padding_cb)(SSL *s, int type, size_t len, void *arg);
     void *record_padding_arg;
     size_t block_padding;
+
+    /* Callback to notify the application that an async job can resume */
+    SSL_async_callback_fn async_cb;
+    void *async_cb_arg;
+
+    /*
+     * Handshake times by SSL_HS_TIME_* and log2 of microseconds, counted
+     * for connections with SSL_MODE_HANDSHAKE_TIMINGS, under |lock|
+     */
+    uint64_t hs_histogram[SSL_HS_TIME_NUM][SSL_HS_HISTOGRAM_BUCKETS];
 };
 
 struct ssl_st {
@@ -1320,6 +1426,13 @@ struct ssl_st {
     void *record_padding_arg;
     size_t block_padding;
 
+    /* Callback to notify the application that an async job can resume */
+    SSL_async_callback_fn async_cb;
+    void *async_cb_arg;
+
+    /* Only allocated with SSL_MODE_HANDSHAKE_TIMINGS */
+    SSL_HS_TIMINGS *hs_timings;
+
     CRYPTO_RWLOCK *lock;
 };
 
@@ -2080,6 +2193,28 @@ void ssl_cert_free(CERT *c);
 __owur int ssl_get_new_session(SSL *s, int session);
 __owur int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello, int *al);
 __owur SSL_SESSION *ssl_session_dup(SSL_SESSION *src, int ticket);
+__owur int ssl_sess_cache_init(SSL_CTX *ctx);
+__owur int ssl_sess_cache_set_sharded(SSL_CTX *ctx, int sharded);
+void ssl_sess_cache_free(SSL_CTX *ctx);
+size_t ssl_sess_cache_num_items(SSL_CTX *ctx);
+int ssl_sess_cache_full(SSL_CTX *ctx);
+SSL_SESSION *ssl_sess_cache_lookup(SSL_CTX *ctx, const SSL_SESSION *key,
+                                   int up_ref);
+SSL_SESSION *ssl_shcache_get(SSL_SHCACHE *cache, int version,
+                             const unsigned char *id, size_t id_len);
+void ssl_shcache_add(SSL_SHCACHE *cache, SSL_SESSION *sess);
+void ssl_shcache_remove(SSL_SHCACHE *cache, const SSL_SESSION *sess);
+void ssl_shcache_free(SSL_SHCACHE *cache);
+EVP_PKEY *ssl_keypool_get(SSL_KEYPOOL *pool, int id);
+EVP_PKEY *ssl_keypool_get_for(SSL_KEYPOOL *pool, EVP_PKEY *pm);
+void ssl_keypool_free(SSL_KEYPOOL *pool);
+void ssl_timing_handshake_start(SSL *s);
+void ssl_timing_handshake_done(SSL *s);
+void ssl_timing_transition(SSL *s);
+void ssl_timing_wait_start(SSL *s);
+void ssl_timing_wait_end(SSL *s);
+uint64_t ssl_timing_begin(const SSL *s);
+void ssl_timing_end(SSL *s, int which, uint64_t begin);
 __owur int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b);
 DECLARE_OBJ_BSEARCH_GLOBAL_CMP_FN(SSL_CIPHER, SSL_CIPHER, ssl_cipher_id);
 __owur int ssl_cipher_ptr_id_cmp(const SSL_CIPHER *const *ap,
@@ -2145,7 +2280,7 @@ __owur int ssl_fill_hello_random(SSL *s, int server, unsigned char *field,
                                  size_t len, DOWNGRADE dgrd);
 __owur int ssl_generate_master_secret(SSL *s, unsigned char *pms, size_t pmslen,
                                       int free_pms);
-__owur EVP_PKEY *ssl_generate_pkey(EVP_PKEY *pm);
+__owur EVP_PKEY *ssl_generate_pkey(SSL *s, EVP_PKEY *pm);
 __owur int ssl_derive(SSL *s, EVP_PKEY *privkey, EVP_PKEY *pubkey,
                       int genmaster);
 __owur EVP_PKEY *ssl_dh_to_pkey(DH *dh);
@@ -2341,7 +2476,7 @@ __owur int tls1_set_groups_list(unsigned char **pext, size_t *pextlen,
 void tls1_get_formatlist(SSL *s, const unsigned char **pformats,
                          size_t *num_formats);
 __owur int tls1_check_ec_tmp_key(SSL *s, unsigned long id);
-__owur EVP_PKEY *ssl_generate_pkey_curve(int id);
+__owur EVP_PKEY *ssl_generate_pkey_curve(SSL *s, int id);
 #  endif                        /* OPENSSL_NO_EC */
 
 __owur int tls1_shared_list(SSL *s,
@@ -2381,6 +2516,20 @@ __owur TICKET_RETURN tls_decrypt_ticket(SSL *s, const unsigned char *etick,
 
 __owur int tls_use_ticket(SSL *s);
 
+__owur int ssl_ctx_ticket_keys_init(SSL_CTX *ctx);
+void ssl_ctx_ticket_keys_free(SSL_CTX *ctx);
+__owur int ssl_ctx_set_ticket_keys(SSL_CTX *ctx, const unsigned char *keys,
+                                   int rotate);
+__owur int ssl_ctx_get_ticket_keys(SSL_CTX *ctx, unsigned char *keys);
+__owur int ssl_ctx_set_max_ticket_keys(SSL_CTX *ctx, size_t max);
+__owur int tls_ticket_key_init(SSL_CTX *tctx, unsigned char *key_name,
+                               const unsigned char *iv, EVP_CIPHER_CTX *ctx,
+                               HMAC_CTX *hctx, int enc);
+
+__owur int ssl_ctx_buffer_pool_init(SSL_CTX *ctx);
+void ssl_ctx_buffer_pool_free(SSL_CTX *ctx);
+size_t ssl_ctx_set_buffer_pool_size(SSL_CTX *ctx, size_t max);
+
 void ssl_set_sig_mask(uint32_t *pmask_a, SSL *s, int op);
 
 __owur int tls1_set_sigalgs_list(CERT *c, const char *str, int client);
@@ -15,8 +15,9 @@
 #include "ssl_locl.h"
 #include "statem/statem_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+static void SSL_SESSION_list_remove(SSL_SESS_CACHE_SHARD *shard,
+                                    SSL_SESSION *s);
+static void SSL_SESSION_list_add(SSL_SESS_CACHE_SHARD *shard, SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
 
 /*
@@ -505,13 +506,21 @@ int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello, int *al)
         memcpy(data.session_id, hello->session_id, hello->session_id_len);
         data.session_id_length = hello->session_id_len;
 
-        CRYPTO_THREAD_read_lock(s->session_ctx->lock);
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
-        if (ret != NULL) {
-            /* don't allow other threads to steal it: */
-            SSL_SESSION_up_ref(ret);
+        /* take a reference so other threads can't steal it */
+        ret = ssl_sess_cache_lookup(s->session_ctx, &data, 1);
+        if (ret == NULL && s->session_ctx->shared_cache != NULL) {
+            /* The session may have been established by another process */
+            ret = ssl_shcache_get(s->session_ctx->shared_cache, s->version,
+                                  hello->session_id, hello->session_id_len);
+            if (ret != NULL
+                    && !(s->session_ctx->session_cache_mode
+                         & SSL_SESS_CACHE_NO_INTERNAL_STORE)
+                    && !SSL_CTX_add_session(s->session_ctx, ret)) {
+                /* Out of memory: do a full handshake instead */
+                SSL_SESSION_free(ret);
+                ret = NULL;
+            }
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
         if (ret == NULL)
             s->session_ctx->stats.sess_miss++;
     }
@@ -645,10 +654,238 @@ int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello, int *al)
     return 0;
 }
 
+static unsigned long ssl_session_hash(const SSL_SESSION *a)
+{
+    const unsigned char *session_id = a->session_id;
+    unsigned long l;
+    unsigned char tmp_storage[4];
+
+    if (a->session_id_length < sizeof(tmp_storage)) {
+        memset(tmp_storage, 0, sizeof(tmp_storage));
+        memcpy(tmp_storage, a->session_id, a->session_id_length);
+        session_id = tmp_storage;
+    }
+
+    l = (unsigned long)
+        ((unsigned long)session_id[0]) |
+        ((unsigned long)session_id[1] << 8L) |
+        ((unsigned long)session_id[2] << 16L) |
+        ((unsigned long)session_id[3] << 24L);
+    return (l);
+}
+
+/*
+ * NB: If this function (or indeed the hash function which uses a sort of
+ * coarser function than this one) is changed, ensure
+ * SSL_CTX_has_matching_session_id() is checked accordingly. It relies on
+ * being able to construct an SSL_SESSION that will collide with any existing
+ * session with a matching session ID.
+ */
+static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
+{
+    if (a->ssl_version != b->ssl_version)
+        return (1);
+    if (a->session_id_length != b->session_id_length)
+        return (1);
+    return (memcmp(a->session_id, b->session_id, a->session_id_length));
+}
+
+/*
+ * These wrapper functions should remain rather than redeclaring
+ * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
+ * variable. The reason is that the functions aren't static, they're exposed
+ * via ssl.h.
+ */
+
+/*
+ * Pick the shard of the internal cache that holds sessions with the ID of
+ * |s|. This deliberately hashes the whole ID with a different function from
+ * ssl_session_hash() so that the shards and the hash buckets within each
+ * shard are not correlated.
+ */
+static SSL_SESS_CACHE_SHARD *ssl_sess_cache_shard(SSL_CTX *ctx,
+                                                  const SSL_SESSION *s)
+{
+    uint32_t h = 2166136261U;
+    size_t i;
+
+    if (ctx->sess_cache_shards == 1)
+        return ctx->sess_cache;
+
+    /* FNV-1a */
+    for (i = 0; i < s->session_id_length; i++)
+        h = (h ^ s->session_id[i]) * 16777619U;
+
+    return &ctx->sess_cache[h % ctx->sess_cache_shards];
+}
+
+/*
+ * Maximum number of sessions in each shard. The cache size is split evenly
+ * between the shards, rounding up.
+ */
+static size_t ssl_sess_cache_shard_limit(SSL_CTX *ctx)
+{
+    size_t n = ctx->sess_cache_shards;
+
+    return (SSL_CTX_sess_get_cache_size(ctx) + n - 1) / n;
+}
+
+static void sess_cache_free(SSL_CTX *ctx, SSL_SESS_CACHE_SHARD *cache,
+                            size_t num)
+{
+    size_t i;
+
+    if (cache == NULL)
+        return;
+
+    for (i = 0; i < num; i++) {
+        lh_SSL_SESSION_free(cache[i].sessions);
+        if (cache[i].lock != ctx->lock)
+            CRYPTO_THREAD_lock_free(cache[i].lock);
+    }
+    OPENSSL_free(cache);
+}
+
+static SSL_SESS_CACHE_SHARD *sess_cache_new(SSL_CTX *ctx, size_t num)
+{
+    SSL_SESS_CACHE_SHARD *cache;
+    size_t i;
+
+    cache = OPENSSL_zalloc(sizeof(*cache) * num);
+    if (cache == NULL)
+        return NULL;
+
+    for (i = 0; i < num; i++) {
+        /* A single shard uses the SSL_CTX lock, as it always has */
+        if (num == 1)
+            cache[i].lock = ctx->lock;
+        else
+            cache[i].lock = CRYPTO_THREAD_lock_new();
+        cache[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                               ssl_session_cmp);
+        if (cache[i].lock == NULL || cache[i].sessions == NULL) {
+            sess_cache_free(ctx, cache, num);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+int ssl_sess_cache_init(SSL_CTX *ctx)
+{
+    ctx->sess_cache = sess_cache_new(ctx, 1);
+    if (ctx->sess_cache == NULL) {
+        SSLerr(SSL_F_SSL_SESS_CACHE_INIT, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    ctx->sess_cache_shards = 1;
+    return 1;
+}
+
+/*
+ * Switch the internal cache between a single shard and
+ * SSL_SESS_CACHE_NUM_SHARDS shards. Other threads may look at the cache
+ * without holding any lock but that of a shard, so this is refused once
+ * |ctx| has been used: when an SSL object or another reference to it
+ * exists, or when sessions have been added. On failure the existing cache
+ * is left untouched.
+ */
+int ssl_sess_cache_set_sharded(SSL_CTX *ctx, int sharded)
+{
+    size_t num = sharded ? SSL_SESS_CACHE_NUM_SHARDS : 1;
+    SSL_SESS_CACHE_SHARD *cache;
+
+    if (num == ctx->sess_cache_shards)
+        return 1;
+
+    if (ctx->references > 1 || ssl_sess_cache_num_items(ctx) != 0) {
+        SSLerr(SSL_F_SSL_SESS_CACHE_SET_SHARDED, SSL_R_SESSION_CACHE_IN_USE);
+        return 0;
+    }
+
+    cache = sess_cache_new(ctx, num);
+    if (cache == NULL) {
+        SSLerr(SSL_F_SSL_SESS_CACHE_SET_SHARDED, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    ctx->stats.sess_cache_full = ssl_sess_cache_full(ctx);
+    sess_cache_free(ctx, ctx->sess_cache, ctx->sess_cache_shards);
+    ctx->sess_cache = cache;
+    ctx->sess_cache_shards = num;
+    return 1;
+}
+
+void ssl_sess_cache_free(SSL_CTX *ctx)
+{
+    sess_cache_free(ctx, ctx->sess_cache, ctx->sess_cache_shards);
+    ctx->sess_cache = NULL;
+    ctx->sess_cache_shards = 0;
+}
+
+size_t ssl_sess_cache_num_items(SSL_CTX *ctx)
+{
+    size_t i, num = 0;
+
+    for (i = 0; i < ctx->sess_cache_shards; i++) {
+        SSL_SESS_CACHE_SHARD *shard = &ctx->sess_cache[i];
+
+        CRYPTO_THREAD_read_lock(shard->lock);
+        num += lh_SSL_SESSION_num_items(shard->sessions);
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+
+    return num;
+}
+
+/*
+ * Number of sessions evicted because the cache was full. Each shard counts
+ * its own under its lock, ctx->stats.sess_cache_full holds those of any
+ * previous cache layout.
+ */
+int ssl_sess_cache_full(SSL_CTX *ctx)
+{
+    size_t i;
+    int num = ctx->stats.sess_cache_full;
+
+    for (i = 0; i < ctx->sess_cache_shards; i++) {
+        SSL_SESS_CACHE_SHARD *shard = &ctx->sess_cache[i];
+
+        CRYPTO_THREAD_read_lock(shard->lock);
+        num += shard->cache_full;
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+
+    return num;
+}
+
+/*
+ * Look up the session matching the version and ID of |key| in the internal
+ * cache. If |up_ref| is set, a reference to the returned session is taken
+ * before the shard is unlocked so that other threads cannot free it.
+ */
+SSL_SESSION *ssl_sess_cache_lookup(SSL_CTX *ctx, const SSL_SESSION *key,
+                                   int up_ref)
+{
+    SSL_SESS_CACHE_SHARD *shard = ssl_sess_cache_shard(ctx, key);
+    SSL_SESSION *ret;
+
+    CRYPTO_THREAD_read_lock(shard->lock);
+    ret = lh_SSL_SESSION_retrieve(shard->sessions, key);
+    if (ret != NULL && up_ref)
+        SSL_SESSION_up_ref(ret);
+    CRYPTO_THREAD_unlock(shard->lock);
+
+    return ret;
+}
+
 int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SSL_SESS_CACHE_SHARD *shard = ssl_sess_cache_shard(ctx, c);
+    size_t limit;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -660,17 +897,17 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    CRYPTO_THREAD_write_lock(ctx->lock);
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    CRYPTO_THREAD_write_lock(shard->lock);
+    s = lh_SSL_SESSION_insert(shard->sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
      * case, s == c should hold (then we did not really modify
-     * ctx->sessions), or we're in trouble.
+     * shard->sessions), or we're in trouble.
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(shard, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -680,7 +917,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(shard->sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -692,7 +929,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
     /* Put at the head of the queue unless it is already in the cache */
     if (s == NULL)
-        SSL_SESSION_list_add(ctx, c);
+        SSL_SESSION_list_add(shard, c);
 
     if (s != NULL) {
         /*
@@ -709,41 +946,50 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
         ret = 1;
 
-        if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+        limit = ssl_sess_cache_shard_limit(ctx);
+        if (limit > 0) {
+            while (lh_SSL_SESSION_num_items(shard->sessions) > limit) {
+                if (!remove_session_lock(ctx, shard->tail, 0))
                     break;
                 else
-                    ctx->stats.sess_cache_full++;
+                    shard->cache_full++;
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+    CRYPTO_THREAD_unlock(shard->lock);
     return ret;
 }
 
 int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
+    /*
+     * Sessions evicted from a full internal cache stay in the shared one,
+     * but those removed explicitly must not be resumed by other processes.
+     */
+    if (c != NULL && ctx->shared_cache != NULL)
+        ssl_shcache_remove(ctx->shared_cache, c);
     return remove_session_lock(ctx, c, 1);
 }
 
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
+    SSL_SESS_CACHE_SHARD *shard;
     SSL_SESSION *r;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        shard = ssl_sess_cache_shard(ctx, c);
         if (lck)
-            CRYPTO_THREAD_write_lock(ctx->lock);
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) == c) {
+            CRYPTO_THREAD_write_lock(shard->lock);
+        if ((r = lh_SSL_SESSION_retrieve(shard->sessions, c)) == c) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, c);
-            SSL_SESSION_list_remove(ctx, c);
+            r = lh_SSL_SESSION_delete(shard->sessions, c);
+            SSL_SESSION_list_remove(shard, c);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(shard->lock);
 
         if (ret)
             SSL_SESSION_free(r);
@@ -1019,24 +1265,33 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
 
 typedef struct timeout_param_st {
     SSL_CTX *ctx;
+    SSL_SESS_CACHE_SHARD *shard;
     long time;
-    LHASH_OF(SSL_SESSION) *cache;
 } TIMEOUT_PARAM;
 
+static int session_expired(const SSL_SESSION *s, const TIMEOUT_PARAM *p)
+{
+    return (p->time == 0) || (p->time > (s->time + s->timeout));
+}
+
+static void flush_one_session(SSL_SESSION *s, TIMEOUT_PARAM *p)
+{
+    /*
+     * The reason we don't call SSL_CTX_remove_session() is to save on
+     * locking overhead
+     */
+    (void)lh_SSL_SESSION_delete(p->shard->sessions, s);
+    SSL_SESSION_list_remove(p->shard, s);
+    s->not_resumable = 1;
+    if (p->ctx->remove_session_cb != NULL)
+        p->ctx->remove_session_cb(p->ctx, s);
+    SSL_SESSION_free(s);
+}
+
 static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
 {
-    if ((p->time == 0) || (p->time > (s->time + s->timeout))) { /* timeout */
-        /*
-         * The reason we don't call SSL_CTX_remove_session() is to save on
-         * locking overhead
-         */
-        (void)lh_SSL_SESSION_delete(p->cache, s);
-        SSL_SESSION_list_remove(p->ctx, s);
-        s->not_resumable = 1;
-        if (p->ctx->remove_session_cb != NULL)
-            p->ctx->remove_session_cb(p->ctx, s);
-        SSL_SESSION_free(s);
-    }
+    if (session_expired(s, p))
+        flush_one_session(s, p);
 }
 
 IMPLEMENT_LHASH_DOALL_ARG(SSL_SESSION, TIMEOUT_PARAM);
@@ -1044,19 +1299,35 @@ IMPLEMENT_LHASH_DOALL_ARG(SSL_SESSION, TIMEOUT_PARAM);
 void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
 {
     unsigned long i;
+    size_t n;
     TIMEOUT_PARAM tp;
 
-    tp.ctx = s;
-    tp.cache = s->sessions;
-    if (tp.cache == NULL)
+    if (s->sess_cache == NULL)
         return;
+    tp.ctx = s;
     tp.time = t;
-    CRYPTO_THREAD_write_lock(s->lock);
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
-    lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.cache, timeout_cb, &tp);
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    for (n = 0; n < s->sess_cache_shards; n++) {
+        tp.shard = &s->sess_cache[n];
+        CRYPTO_THREAD_write_lock(tp.shard->lock);
+        if (s->sess_cache_shards == 1) {
+            i = lh_SSL_SESSION_get_down_load(tp.shard->sessions);
+            lh_SSL_SESSION_set_down_load(tp.shard->sessions, 0);
+            lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.shard->sessions, timeout_cb,
+                                               &tp);
+            lh_SSL_SESSION_set_down_load(tp.shard->sessions, i);
+        } else {
+            /*
+             * Only walk the shard from its oldest end, stopping at the first
+             * session that is still live, so that a flush holds each shard
+             * lock for time proportional to the number of expired sessions
+             * rather than the size of the cache.
+             */
+            while (tp.shard->tail != NULL
+                   && session_expired(tp.shard->tail, &tp))
+                flush_one_session(tp.shard->tail, &tp);
+        }
+        CRYPTO_THREAD_unlock(tp.shard->lock);
+    }
 }
 
 int ssl_clear_bad_session(SSL *s)
@@ -1070,27 +1341,28 @@ int ssl_clear_bad_session(SSL *s)
         return (0);
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the shard in the calling function */
+static void SSL_SESSION_list_remove(SSL_SESS_CACHE_SHARD *shard,
+                                    SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)&(shard->tail)) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(shard->head)) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            shard->head = NULL;
+            shard->tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            shard->tail = s->prev;
+            s->prev->next = (SSL_SESSION *)&(shard->tail);
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(shard->head)) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            shard->head = s->next;
+            s->next->prev = (SSL_SESSION *)&(shard->head);
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1100,21 +1372,21 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->prev = s->next = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(SSL_SESS_CACHE_SHARD *shard, SSL_SESSION *s)
 {
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(shard, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (shard->head == NULL) {
+        shard->head = s;
+        shard->tail = s;
+        s->prev = (SSL_SESSION *)&(shard->head);
+        s->next = (SSL_SESSION *)&(shard->tail);
     } else {
-        s->next = ctx->session_cache_head;
+        s->next = shard->head;
         s->next->prev = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        ctx->session_cache_head = s;
+        s->prev = (SSL_SESSION *)&(shard->head);
+        shard->head = s;
     }
 }
 
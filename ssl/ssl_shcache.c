@@ -0,0 +1,290 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A session cache in shared memory, for servers that fork worker processes
+ * after setting up their SSL_CTX: a session established by any of them can
+ * be resumed by all of them.
+ *
+ * The cache is an array of fixed size slots holding encoded sessions, in
+ * sets of SSL_SHCACHE_WAYS selected by a hash of the session ID.  Each slot
+ * is protected by a sequence number, which is odd while the slot is being
+ * written.  Writers take a slot by incrementing its sequence number from
+ * even to odd and give up if someone else has it: the cache is only a
+ * cache.  Readers copy a slot and check that its sequence number didn't
+ * change meanwhile, so lookups take no lock and need no allocation apart
+ * from decoding the session found.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#if (defined(OPENSSL_SYS_LINUX) || defined(OPENSSL_SYS_UNIX)) \
+    && defined(__GNUC__) && defined(__ATOMIC_ACQ_REL)
+# define IMPLEMENTED
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+#endif
+
+#define SSL_SHCACHE_WAYS        4
+/* Room for the encoding of a session, including a certificate or ticket */
+#define SSL_SHCACHE_DATA_SIZE   (2048 - 64)
+
+typedef struct ssl_shcache_slot_st {
+    uint32_t seq;               /* odd while the slot is being written */
+    uint32_t len;               /* length of |data|, 0 if the slot is free */
+    int64_t expires;            /* time after which the session is stale */
+    int32_t version;
+    uint32_t id_len;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    unsigned char data[SSL_SHCACHE_DATA_SIZE];
+} SSL_SHCACHE_SLOT;
+
+struct ssl_shcache_st {
+    SSL_SHCACHE_SLOT *slots;
+    size_t map_size;
+    size_t sets;
+};
+
+#ifdef IMPLEMENTED
+
+static SSL_SHCACHE_SLOT *shcache_set(SSL_SHCACHE *cache,
+                                     const unsigned char *id, size_t id_len)
+{
+    uint32_t h = 2166136261U;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < id_len; i++)
+        h = (h ^ id[i]) * 16777619U;
+
+    return &cache->slots[(h % cache->sets) * SSL_SHCACHE_WAYS];
+}
+
+static int shcache_slot_lock(SSL_SHCACHE_SLOT *slot)
+{
+    uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+    if ((seq & 1) != 0
+            || !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED))
+        return 0;
+    /* Readers must see the odd sequence number before any new data */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return 1;
+}
+
+static void shcache_slot_unlock(SSL_SHCACHE_SLOT *slot)
+{
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_RELEASE);
+}
+
+static int shcache_slot_match(const SSL_SHCACHE_SLOT *slot, int version,
+                              const unsigned char *id, size_t id_len)
+{
+    return slot->len != 0 && slot->version == version
+           && slot->id_len == id_len && memcmp(slot->id, id, id_len) == 0;
+}
+
+SSL_SESSION *ssl_shcache_get(SSL_SHCACHE *cache, int version,
+                             const unsigned char *id, size_t id_len)
+{
+    SSL_SHCACHE_SLOT *slot;
+    SSL_SESSION *ret = NULL;
+    unsigned char data[SSL_SHCACHE_DATA_SIZE];
+    const unsigned char *p;
+    uint32_t seq, len;
+    int64_t now = (int64_t)time(NULL);
+    int i;
+
+    if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return NULL;
+
+    slot = shcache_set(cache, id, id_len);
+    for (i = 0; i < SSL_SHCACHE_WAYS; i++, slot++) {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) != 0 || !shcache_slot_match(slot, version, id, id_len))
+            continue;
+        len = slot->len;
+        if (slot->expires < now || len > sizeof(data))
+            return NULL;
+        memcpy(data, slot->data, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+            p = data;
+            ret = d2i_SSL_SESSION(NULL, &p, len);
+        }
+        /* The session includes the master key */
+        OPENSSL_cleanse(data, len);
+        return ret;
+    }
+    return NULL;
+}
+
+void ssl_shcache_add(SSL_SHCACHE *cache, SSL_SESSION *sess)
+{
+    SSL_SHCACHE_SLOT *set, *slot, *victim = NULL;
+    unsigned char data[SSL_SHCACHE_DATA_SIZE], *p;
+    int i, len;
+
+    if (sess->session_id_length == 0
+            || (len = i2d_SSL_SESSION(sess, NULL)) <= 0
+            || (size_t)len > sizeof(data))
+        return;
+    p = data;
+    if (i2d_SSL_SESSION(sess, &p) != len)
+        goto end;
+
+    /*
+     * Replace the same session if it is there, else a free slot, else the
+     * one closest to expiry (or furthest past it).
+     */
+    set = shcache_set(cache, sess->session_id, sess->session_id_length);
+    for (i = 0, slot = set; i < SSL_SHCACHE_WAYS; i++, slot++) {
+        if (shcache_slot_match(slot, sess->ssl_version, sess->session_id,
+                               sess->session_id_length)) {
+            victim = slot;
+            break;
+        }
+        if (victim == NULL
+                || (victim->len != 0
+                    && (slot->len == 0 || slot->expires < victim->expires)))
+            victim = slot;
+    }
+
+    if (!shcache_slot_lock(victim))
+        goto end;
+    if (victim->len > (uint32_t)len)
+        OPENSSL_cleanse(victim->data + len, victim->len - len);
+    victim->len = len;
+    victim->expires = (int64_t)sess->time + sess->timeout;
+    victim->version = sess->ssl_version;
+    victim->id_len = sess->session_id_length;
+    memcpy(victim->id, sess->session_id, sess->session_id_length);
+    memcpy(victim->data, data, len);
+    shcache_slot_unlock(victim);
+ end:
+    OPENSSL_cleanse(data, len);
+}
+
+void ssl_shcache_remove(SSL_SHCACHE *cache, const SSL_SESSION *sess)
+{
+    SSL_SHCACHE_SLOT *slot;
+    int i;
+
+    if (sess->session_id_length == 0)
+        return;
+
+    slot = shcache_set(cache, sess->session_id, sess->session_id_length);
+    for (i = 0; i < SSL_SHCACHE_WAYS; i++, slot++) {
+        if (!shcache_slot_match(slot, sess->ssl_version, sess->session_id,
+                                sess->session_id_length)
+                || !shcache_slot_lock(slot))
+            continue;
+        /* Check again now that we have it */
+        if (shcache_slot_match(slot, sess->ssl_version, sess->session_id,
+                               sess->session_id_length)) {
+            OPENSSL_cleanse(slot->data, slot->len);
+            slot->len = 0;
+        }
+        shcache_slot_unlock(slot);
+    }
+}
+
+void ssl_shcache_free(SSL_SHCACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    munmap((void *)cache->slots, cache->map_size);
+    OPENSSL_free(cache);
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, size_t num)
+{
+    SSL_SHCACHE *cache = NULL;
+    void *map = MAP_FAILED;
+    size_t sets = (num + SSL_SHCACHE_WAYS - 1) / SSL_SHCACHE_WAYS;
+    size_t size;
+
+    if (sets > SIZE_MAX / SSL_SHCACHE_WAYS / sizeof(SSL_SHCACHE_SLOT)) {
+        SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+               ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    size = sets * SSL_SHCACHE_WAYS * sizeof(SSL_SHCACHE_SLOT);
+
+    if (num != 0) {
+        if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE,
+                   ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        /* The mapping is zero filled, so all the slots are free */
+# ifdef MAP_ANON
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED,
+                   -1, 0);
+# else
+        {
+            int fd;
+
+            if ((fd = open("/dev/zero", O_RDWR)) >= 0) {
+                map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           fd, 0);
+                close(fd);
+            }
+        }
+# endif
+        if (map == MAP_FAILED) {
+            SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_SYS_LIB);
+            OPENSSL_free(cache);
+            return 0;
+        }
+        cache->slots = map;
+        cache->map_size = size;
+        cache->sets = sets;
+    }
+
+    ssl_shcache_free(ctx->shared_cache);
+    ctx->shared_cache = cache;
+    return 1;
+}
+
+#else
+
+SSL_SESSION *ssl_shcache_get(SSL_SHCACHE *cache, int version,
+                             const unsigned char *id, size_t id_len)
+{
+    return NULL;
+}
+
+void ssl_shcache_add(SSL_SHCACHE *cache, SSL_SESSION *sess)
+{
+}
+
+void ssl_shcache_remove(SSL_SHCACHE *cache, const SSL_SESSION *sess)
+{
+}
+
+void ssl_shcache_free(SSL_SHCACHE *cache)
+{
+}
+
+int SSL_CTX_set_shared_session_cache(SSL_CTX *ctx, size_t num)
+{
+    if (num == 0)
+        return 1;
+    SSLerr(SSL_F_SSL_CTX_SET_SHARED_SESSION_CACHE, ERR_R_DISABLED);
+    return 0;
+}
+
+#endif /* IMPLEMENTED */
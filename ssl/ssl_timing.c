@@ -0,0 +1,173 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Handshake timings, for connections with SSL_MODE_HANDSHAKE_TIMINGS.  The
+ * state machine records when each state is entered, and the time spent in
+ * expensive operations is added up by wrapping them in ssl_timing_begin()
+ * and ssl_timing_end().  Completed handshakes are counted in the histograms
+ * of the SSL_CTX.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "ssl_locl.h"
+
+#if defined(OPENSSL_SYS_WINDOWS)
+# include <windows.h>
+#elif !defined(OPENSSL_SYS_VXWORKS)
+# include <sys/time.h>
+#endif
+
+/* Monotonic time in nanoseconds, never 0 */
+static uint64_t ssl_timing_now(void)
+{
+#if defined(OPENSSL_SYS_WINDOWS)
+    LARGE_INTEGER count, freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000
+           + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000
+             / freq.QuadPart + 1;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + 1;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000 + 1;
+#endif
+}
+
+void ssl_timing_handshake_start(SSL *s)
+{
+    SSL_HS_TIMINGS *t = s->hs_timings;
+
+    if ((s->mode & SSL_MODE_HANDSHAKE_TIMINGS) == 0)
+        return;
+    if (t == NULL && (t = s->hs_timings = OPENSSL_malloc(sizeof(*t))) == NULL)
+        return;
+
+    memset(t, 0, sizeof(*t));
+    t->active = 1;
+    t->start = ssl_timing_now();
+}
+
+void ssl_timing_handshake_done(SSL *s)
+{
+    SSL_HS_TIMINGS *t = s->hs_timings;
+    uint64_t us;
+    int i, bucket[SSL_HS_TIME_NUM];
+
+    if (t == NULL || !t->active)
+        return;
+    t->active = 0;
+    t->time[SSL_HS_TIME_TOTAL] = ssl_timing_now() - t->start;
+
+    for (i = 0; i < SSL_HS_TIME_NUM; i++) {
+        /* Bucket n counts times of 2^n to 2^(n+1) microseconds */
+        us = t->time[i] / 1000;
+        for (bucket[i] = 0;
+             bucket[i] < SSL_HS_HISTOGRAM_BUCKETS - 1 && us > 1; bucket[i]++)
+            us >>= 1;
+    }
+
+    /* The counts are 64 bits wide, too wide for CRYPTO_atomic_add() */
+    CRYPTO_THREAD_write_lock(s->ctx->lock);
+    for (i = 0; i < SSL_HS_TIME_NUM; i++)
+        s->ctx->hs_histogram[i][bucket[i]]++;
+    CRYPTO_THREAD_unlock(s->ctx->lock);
+}
+
+void ssl_timing_transition(SSL *s)
+{
+    SSL_HS_TIMINGS *t = s->hs_timings;
+
+    if (t == NULL || !t->active || t->num_states == SSL_HS_TIMINGS_MAX_STATES)
+        return;
+    t->states[t->num_states] = s->statem.hand_state;
+    t->state_times[t->num_states] = ssl_timing_now() - t->start;
+    t->num_states++;
+}
+
+void ssl_timing_wait_start(SSL *s)
+{
+    SSL_HS_TIMINGS *t = s->hs_timings;
+
+    if (t != NULL && t->active)
+        t->wait_start = ssl_timing_now();
+}
+
+void ssl_timing_wait_end(SSL *s)
+{
+    SSL_HS_TIMINGS *t = s->hs_timings;
+
+    if (t == NULL || !t->active || t->wait_start == 0)
+        return;
+    t->time[SSL_HS_TIME_IO_WAIT] += ssl_timing_now() - t->wait_start;
+    t->wait_start = 0;
+}
+
+/* Returns the time to pass to ssl_timing_end(), or 0 if not timing */
+uint64_t ssl_timing_begin(const SSL *s)
+{
+    if (s->hs_timings == NULL || !s->hs_timings->active)
+        return 0;
+    return ssl_timing_now();
+}
+
+void ssl_timing_end(SSL *s, int which, uint64_t begin)
+{
+    if (begin == 0 || s->hs_timings == NULL || !s->hs_timings->active)
+        return;
+    s->hs_timings->time[which] += ssl_timing_now() - begin;
+}
+
+size_t SSL_get0_handshake_timings(const SSL *s,
+                                  const OSSL_HANDSHAKE_STATE **states,
+                                  const uint64_t **times)
+{
+    if (s->hs_timings == NULL)
+        return 0;
+    if (states != NULL)
+        *states = s->hs_timings->states;
+    if (times != NULL)
+        *times = s->hs_timings->state_times;
+    return s->hs_timings->num_states;
+}
+
+uint64_t SSL_get_handshake_time(const SSL *s, int which)
+{
+    if (s->hs_timings == NULL || which < 0 || which >= SSL_HS_TIME_NUM)
+        return 0;
+    return s->hs_timings->time[which];
+}
+
+size_t SSL_CTX_get_handshake_histogram(SSL_CTX *ctx, int which,
+                                       uint64_t *counts, size_t numcounts)
+{
+    size_t i;
+
+    if (which < 0 || which >= SSL_HS_TIME_NUM)
+        return 0;
+    if (counts == NULL)
+        return SSL_HS_HISTOGRAM_BUCKETS;
+    if (numcounts > SSL_HS_HISTOGRAM_BUCKETS)
+        numcounts = SSL_HS_HISTOGRAM_BUCKETS;
+
+    CRYPTO_THREAD_read_lock(ctx->lock);
+    for (i = 0; i < numcounts; i++)
+        counts[i] = ctx->hs_histogram[which][i];
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return numcounts;
+}
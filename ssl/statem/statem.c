@@ -374,6 +374,7 @@ static int state_machine(SSL *s, int server)
 
         if ((SSL_in_before(s))
                 || s->renegotiate) {
+            ssl_timing_handshake_start(s);
             if (!tls_setup_handshake(s)) {
                 ossl_statem_set_error(s);
                 goto end;
@@ -387,6 +388,7 @@ static int state_machine(SSL *s, int server)
         init_write_state_machine(s);
     }
 
+    ssl_timing_wait_end(s);
     while (st->state != MSG_FLOW_FINISHED) {
         if (st->state == MSG_FLOW_READING) {
             ssret = read_state_machine(s);
@@ -415,6 +417,7 @@ static int state_machine(SSL *s, int server)
         }
     }
 
+    ssl_timing_handshake_done(s);
     ret = 1;
 
  end:
@@ -432,6 +435,8 @@ static int state_machine(SSL *s, int server)
 #endif
 
     BUF_MEM_free(buf);
+    if (ret <= 0 && (s->rwstate == SSL_READING || s->rwstate == SSL_WRITING))
+        ssl_timing_wait_start(s);
     if (cb != NULL) {
         if (server)
             cb(s, SSL_CB_ACCEPT_EXIT, ret);
@@ -556,6 +561,7 @@ static SUB_STATE_RETURN read_state_machine(SSL *s)
                 ossl_statem_set_error(s);
                 return SUB_STATE_ERROR;
             }
+            ssl_timing_transition(s);
 
             if (s->s3->tmp.message_size > max_message_size(s)) {
                 ssl3_send_alert(s, SSL3_AL_FATAL, SSL_AD_ILLEGAL_PARAMETER);
@@ -749,6 +755,7 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
             }
             switch (transition(s)) {
             case WRITE_TRAN_CONTINUE:
+                ssl_timing_transition(s);
                 st->write_state = WRITE_STATE_PRE_WORK;
                 st->write_state_work = WORK_MORE_A;
                 break;
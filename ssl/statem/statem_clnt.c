@@ -2169,6 +2169,7 @@ MSG_PROCESS_RETURN tls_process_key_exchange(SSL *s, PACKET *pkt)
         unsigned char *tbs;
         size_t tbslen;
         int rv;
+        uint64_t t;
 
         /*
          * |pkt| now points to the beginning of the signature, so the difference
@@ -2264,8 +2265,10 @@ MSG_PROCESS_RETURN tls_process_key_exchange(SSL *s, PACKET *pkt)
             goto err;
         }
 
+        t = ssl_timing_begin(s);
         rv = EVP_DigestVerify(md_ctx, PACKET_data(&signature),
                               PACKET_remaining(&signature), tbs, tbslen);
+        ssl_timing_end(s, SSL_HS_TIME_CERT_VERIFY, t);
         OPENSSL_free(tbs);
         if (rv <= 0) {
             al = SSL_AD_DECRYPT_ERROR;
@@ -2871,7 +2874,7 @@ static int tls_construct_cke_dhe(SSL *s, WPACKET *pkt, int *al)
     if (skey == NULL)
         goto err;
 
-    ckey = ssl_generate_pkey(skey);
+    ckey = ssl_generate_pkey(s, skey);
     if (ckey == NULL)
         goto err;
 
@@ -2911,7 +2914,7 @@ static int tls_construct_cke_ecdhe(SSL *s, WPACKET *pkt, int *al)
         return 0;
     }
 
-    ckey = ssl_generate_pkey(skey);
+    ckey = ssl_generate_pkey(s, skey);
     if (ckey == NULL) {
         SSLerr(SSL_F_TLS_CONSTRUCT_CKE_ECDHE, ERR_R_MALLOC_FAILURE);
         goto err;
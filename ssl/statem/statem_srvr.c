@@ -2163,6 +2163,7 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
     EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
     EVP_PKEY_CTX *pctx = NULL;
     size_t paramlen, paramoffset;
+    uint64_t t;
 
     if (!WPACKET_get_total_written(pkt, &paramoffset)) {
         SSLerr(SSL_F_TLS_CONSTRUCT_SERVER_KEY_EXCHANGE, ERR_R_INTERNAL_ERROR);
@@ -2232,7 +2233,7 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             goto err;
         }
 
-        s->s3->tmp.pkey = ssl_generate_pkey(pkdhp);
+        s->s3->tmp.pkey = ssl_generate_pkey(s, pkdhp);
 
         if (s->s3->tmp.pkey == NULL) {
             SSLerr(SSL_F_TLS_CONSTRUCT_SERVER_KEY_EXCHANGE, ERR_R_EVP_LIB);
@@ -2266,7 +2267,7 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
                    SSL_R_UNSUPPORTED_ELLIPTIC_CURVE);
             goto err;
         }
-        s->s3->tmp.pkey = ssl_generate_pkey_curve(curve_id);
+        s->s3->tmp.pkey = ssl_generate_pkey_curve(s, curve_id);
         /* Generate a new key for this curve */
         if (s->s3->tmp.pkey == NULL) {
             SSLerr(SSL_F_TLS_CONSTRUCT_SERVER_KEY_EXCHANGE, ERR_R_EVP_LIB);
@@ -2465,7 +2466,9 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
                    ERR_R_MALLOC_FAILURE);
             goto f_err;
         }
+        t = ssl_timing_begin(s);
         rv = EVP_DigestSign(md_ctx, sigbytes1, &siglen, tbs, tbslen);
+        ssl_timing_end(s, SSL_HS_TIME_SIGN, t);
         OPENSSL_free(tbs);
         if (rv <= 0 || !WPACKET_sub_allocate_bytes_u16(pkt, siglen, &sigbytes2)
             || sigbytes1 != sigbytes2) {
@@ -2624,6 +2627,7 @@ static int tls_process_cke_rsa(SSL *s, PACKET *pkt, int *al)
     RSA *rsa = NULL;
     unsigned char *rsa_decrypt = NULL;
     int ret = 0;
+    uint64_t t;
 
     rsa = EVP_PKEY_get0_RSA(s->cert->pkeys[SSL_PKEY_RSA].privatekey);
     if (rsa == NULL) {
@@ -2679,9 +2683,11 @@ static int tls_process_cke_rsa(SSL *s, PACKET *pkt, int *al)
      * the timing-sensitive code below.
      */
      /* TODO(size_t): Convert this function */
+    t = ssl_timing_begin(s);
     decrypt_len = (int)RSA_private_decrypt((int)PACKET_remaining(&enc_premaster),
                                            PACKET_data(&enc_premaster),
                                            rsa_decrypt, rsa, RSA_NO_PADDING);
+    ssl_timing_end(s, SSL_HS_TIME_KEY_EXCHANGE, t);
     if (decrypt_len < 0)
         goto err;
 
@@ -3489,15 +3495,8 @@ int tls_construct_new_session_ticket(SSL *s, WPACKET *pkt)
         iv_len = EVP_CIPHER_iv_length(cipher);
         if (RAND_bytes(iv, iv_len) <= 0)
             goto err;
-        if (!EVP_EncryptInit_ex(ctx, cipher, NULL,
-                                tctx->ext.tick_aes_key, iv))
+        if (tls_ticket_key_init(tctx, key_name, iv, ctx, hctx, 1) <= 0)
             goto err;
-        if (!HMAC_Init_ex(hctx, tctx->ext.tick_hmac_key,
-                          sizeof(tctx->ext.tick_hmac_key),
-                          EVP_sha256(), NULL))
-            goto err;
-        memcpy(key_name, tctx->ext.tick_key_name,
-               sizeof(tctx->ext.tick_key_name));
     }
 
     /*
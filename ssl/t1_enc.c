@@ -14,6 +14,8 @@
 #include <openssl/evp.h>
 #include <openssl/kdf.h>
 #include <openssl/rand.h>
+#include "internal/bio.h"
+#include "internal/ktls.h"
 
 /* seed1 through seed5 are concatenated */
 static int tls1_PRF(SSL *s,
@@ -74,6 +76,59 @@ static int tls1_generate_key_block(SSL *s, unsigned char *km, size_t num)
     return ret;
 }
 
+/*
+ * Try to hand record protection for the direction given by |which| over to
+ * the kernel (kTLS). This is best effort: if the connection, cipher, BIO or
+ * kernel does not support it the user-space record layer simply carries on.
+ * Returns 0 only on a fatal error.
+ */
+static int tls1_ktls_offload(SSL *s, int which, const EVP_CIPHER *c,
+                             const unsigned char *key, size_t keylen,
+                             const unsigned char *iv, size_t ivlen)
+{
+    KTLS_CRYPTO_INFO ci;
+    int is_tx = (which & SSL3_CC_WRITE) != 0;
+    BIO *bio = is_tx ? s->wbio : s->rbio;
+    int ret;
+
+    if ((s->options & SSL_OP_ENABLE_KTLS) == 0
+            || SSL_IS_DTLS(s)
+            || s->version != TLS1_2_VERSION
+            || bio == NULL)
+        return 1;
+#ifndef OPENSSL_NO_COMP
+    if ((is_tx ? s->compress : s->expand) != NULL)
+        return 1;
+#endif
+
+    /* The kernel can't be given new keys, so renegotiation is impossible */
+    if (is_tx ? BIO_get_ktls_send(bio) : BIO_get_ktls_recv(bio)) {
+        SSLerr(SSL_F_TLS1_KTLS_OFFLOAD, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    if (is_tx) {
+        /* Anything already queued has to go out under the old keys */
+        if (BIO_flush(bio) <= 0)
+            return 1;
+    } else if (RECORD_LAYER_read_pending(&s->rlayer)) {
+        /* We've already read records that the kernel would need to decrypt */
+        return 1;
+    }
+
+    if (!ktls_init_crypto_info(&ci, EVP_CIPHER_nid(c), key, keylen, iv, ivlen,
+                               is_tx ? s->rlayer.write_sequence
+                                     : s->rlayer.read_sequence))
+        return 1;
+
+    ret = BIO_set_ktls(bio, &ci, is_tx);
+    OPENSSL_cleanse(&ci, sizeof(ci));
+    if (ret > 0)
+        s->options |= SSL_OP_NO_RENEGOTIATION;
+
+    return 1;
+}
+
 int tls1_change_cipher_state(SSL *s, int which)
 {
     unsigned char *p, *mac_secret;
@@ -290,6 +345,9 @@ int tls1_change_cipher_state(SSL *s, int which)
         goto err2;
     }
 
+    if (!tls1_ktls_offload(s, which, c, key, cl, iv, k))
+        goto err2;
+
 #ifdef SSL_DEBUG
     printf("which = %04X\nkey=", which);
     {
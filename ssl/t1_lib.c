@@ -12,6 +12,7 @@
 #include <openssl/objects.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <openssl/ocsp.h>
 #include <openssl/conf.h>
 #include <openssl/x509v3.h>
@@ -1274,6 +1275,238 @@ TICKET_RETURN tls_get_ticket_from_client(SSL *s, CLIENTHELLO_MSG *hello,
     }
 }
 
+/*
+ * Session ticket keys. An SSL_CTX holds a ring of up to max_tick_keys keys:
+ * the newest encrypts new tickets and all of them decrypt. The ring itself
+ * is immutable: changing the keys builds a new ring which is swapped in
+ * under the write lock. Ticket encryption and decryption only hold the read
+ * lock for as long as it takes to find a key and load it into the cipher and
+ * HMAC contexts, so they never wait for each other and only wait for a key
+ * change for the time it takes to swap a pointer.
+ */
+
+/* FNV-1a over the key name, for the index */
+static size_t tick_key_hash(const unsigned char *name)
+{
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    for (i = 0; i < TLSEXT_KEYNAME_LENGTH; i++)
+        h = (h ^ name[i]) * 0x01000193;
+    return h & (SSL_TICKET_KEY_INDEX_SIZE - 1);
+}
+
+static const SSL_TICKET_KEY *tick_key_lookup(const SSL_TICKET_KEY_RING *ring,
+                                             const unsigned char *name)
+{
+    size_t h = tick_key_hash(name);
+    unsigned char i;
+
+    /* The index is never more than half full, so this always terminates */
+    while ((i = ring->index[h]) != 0) {
+        if (memcmp(ring->keys[i - 1].name, name, TLSEXT_KEYNAME_LENGTH) == 0)
+            return &ring->keys[i - 1];
+        h = (h + 1) & (SSL_TICKET_KEY_INDEX_SIZE - 1);
+    }
+    return NULL;
+}
+
+/*
+ * Build a new ring from |newkey| (if not NULL) followed by up to |max| keys
+ * in total from |old| (if not NULL).
+ */
+static SSL_TICKET_KEY_RING *tick_key_ring_new(const SSL_TICKET_KEY *newkey,
+                                              const SSL_TICKET_KEY_RING *old,
+                                              size_t max)
+{
+    SSL_TICKET_KEY_RING *ring = OPENSSL_zalloc(sizeof(*ring));
+    size_t i, h, num = old != NULL ? old->num : 0;
+
+    if (ring == NULL) {
+        SSLerr(SSL_F_TICK_KEY_RING_NEW, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+
+    for (i = newkey != NULL ? 0 : 1; i <= num && ring->num < max; i++) {
+        const SSL_TICKET_KEY *key = i == 0 ? newkey : &old->keys[i - 1];
+
+        /* Keys with the same name can't be told apart: keep the newest */
+        if (tick_key_lookup(ring, key->name) != NULL)
+            continue;
+        ring->keys[ring->num] = *key;
+        for (h = tick_key_hash(key->name); ring->index[h] != 0;
+             h = (h + 1) & (SSL_TICKET_KEY_INDEX_SIZE - 1))
+            continue;
+        ring->index[h] = (unsigned char)++ring->num;
+    }
+
+    return ring;
+}
+
+static void tick_key_ring_free(SSL_TICKET_KEY_RING *ring)
+{
+    OPENSSL_clear_free(ring, sizeof(*ring));
+}
+
+/* Publish |ring| in |ctx| and free the one it replaces */
+static void tick_key_ring_publish(SSL_CTX *ctx, SSL_TICKET_KEY_RING *ring)
+{
+    SSL_TICKET_KEY_RING *old;
+
+    CRYPTO_THREAD_write_lock(ctx->ext.tick_keys_lock);
+    old = ctx->ext.tick_keys;
+    ctx->ext.tick_keys = ring;
+    CRYPTO_THREAD_unlock(ctx->ext.tick_keys_lock);
+
+    tick_key_ring_free(old);
+}
+
+int ssl_ctx_ticket_keys_init(SSL_CTX *ctx)
+{
+    SSL_TICKET_KEY key;
+
+    ctx->ext.max_tick_keys = SSL_DEFAULT_TICKET_KEYS;
+    ctx->ext.tick_keys_lock = CRYPTO_THREAD_lock_new();
+    if (ctx->ext.tick_keys_lock == NULL) {
+        SSLerr(SSL_F_SSL_CTX_TICKET_KEYS_INIT, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    /* Without random keys we just don't issue tickets */
+    if (RAND_bytes((unsigned char *)&key, sizeof(key)) <= 0) {
+        ctx->options |= SSL_OP_NO_TICKET;
+        return 1;
+    }
+    ctx->ext.tick_keys = tick_key_ring_new(&key, NULL, 1);
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return ctx->ext.tick_keys != NULL;
+}
+
+void ssl_ctx_ticket_keys_free(SSL_CTX *ctx)
+{
+    tick_key_ring_free(ctx->ext.tick_keys);
+    ctx->ext.tick_keys = NULL;
+    CRYPTO_THREAD_lock_free(ctx->ext.tick_keys_lock);
+    ctx->ext.tick_keys_lock = NULL;
+}
+
+/*
+ * Install the key name, HMAC key and AES key in |keys| for encrypting new
+ * tickets. If |rotate| is set the keys in use so far are kept for decryption,
+ * up to the limit set with SSL_CTX_set_max_tlsext_ticket_keys(), otherwise
+ * they're discarded. With |rotate| a NULL |keys| means a random new key.
+ */
+int ssl_ctx_set_ticket_keys(SSL_CTX *ctx, const unsigned char *keys,
+                            int rotate)
+{
+    SSL_TICKET_KEY key;
+    SSL_TICKET_KEY_RING *ring;
+
+    if (keys != NULL) {
+        memcpy(&key, keys, sizeof(key));
+    } else if (RAND_bytes((unsigned char *)&key, sizeof(key)) <= 0) {
+        return 0;
+    }
+
+    /*
+     * Only one writer can replace the current ring at a time, otherwise a
+     * rotation could build on keys that are being replaced and publish them
+     * again, or concurrent rotations could lose each other's keys
+     */
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    if (rotate) {
+        CRYPTO_THREAD_read_lock(ctx->ext.tick_keys_lock);
+        ring = tick_key_ring_new(&key, ctx->ext.tick_keys,
+                                 ctx->ext.max_tick_keys);
+        CRYPTO_THREAD_unlock(ctx->ext.tick_keys_lock);
+    } else {
+        ring = tick_key_ring_new(&key, NULL, 1);
+    }
+    if (ring != NULL)
+        tick_key_ring_publish(ctx, ring);
+    CRYPTO_THREAD_unlock(ctx->lock);
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return ring != NULL;
+}
+
+/* Copy out the key currently used to encrypt tickets */
+int ssl_ctx_get_ticket_keys(SSL_CTX *ctx, unsigned char *keys)
+{
+    int ret = 0;
+
+    CRYPTO_THREAD_read_lock(ctx->ext.tick_keys_lock);
+    if (ctx->ext.tick_keys != NULL && ctx->ext.tick_keys->num > 0) {
+        memcpy(keys, &ctx->ext.tick_keys->keys[0], sizeof(SSL_TICKET_KEY));
+        ret = 1;
+    }
+    CRYPTO_THREAD_unlock(ctx->ext.tick_keys_lock);
+
+    return ret;
+}
+
+/* Set the number of ticket keys to keep, dropping the oldest if need be */
+int ssl_ctx_set_max_ticket_keys(SSL_CTX *ctx, size_t max)
+{
+    SSL_TICKET_KEY_RING *ring = NULL;
+
+    if (max < 1 || max > TLSEXT_MAX_TICKET_KEYS)
+        return 0;
+
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    ctx->ext.max_tick_keys = max;
+    CRYPTO_THREAD_read_lock(ctx->ext.tick_keys_lock);
+    if (ctx->ext.tick_keys != NULL && ctx->ext.tick_keys->num > max)
+        ring = tick_key_ring_new(NULL, ctx->ext.tick_keys, max);
+    CRYPTO_THREAD_unlock(ctx->ext.tick_keys_lock);
+    if (ring != NULL)
+        tick_key_ring_publish(ctx, ring);
+    CRYPTO_THREAD_unlock(ctx->lock);
+
+    return 1;
+}
+
+/*
+ * Set up |ctx| and |hctx| for a session ticket using the built in keys of
+ * |tctx|, with the same semantics as the ticket_key_cb callback. When
+ * encrypting |key_name| receives the name of the current key. When
+ * decrypting the key is looked up by |key_name| and, if it is no longer the
+ * current key, 2 is returned to ask for the ticket to be renewed.
+ */
+int tls_ticket_key_init(SSL_CTX *tctx, unsigned char *key_name,
+                        const unsigned char *iv, EVP_CIPHER_CTX *ctx,
+                        HMAC_CTX *hctx, int enc)
+{
+    const SSL_TICKET_KEY_RING *ring;
+    const SSL_TICKET_KEY *key = NULL;
+    int ret = 0;
+
+    CRYPTO_THREAD_read_lock(tctx->ext.tick_keys_lock);
+    ring = tctx->ext.tick_keys;
+    if (ring != NULL && ring->num > 0) {
+        if (enc)
+            key = &ring->keys[0];
+        else
+            key = tick_key_lookup(ring, key_name);
+    }
+    if (key != NULL) {
+        if (HMAC_Init_ex(hctx, key->hmac_key, sizeof(key->hmac_key),
+                         EVP_sha256(), NULL) <= 0
+                || EVP_CipherInit_ex(ctx, EVP_aes_256_cbc(), NULL,
+                                     key->aes_key, iv, enc) <= 0) {
+            ret = -1;
+        } else {
+            if (enc)
+                memcpy(key_name, key->name, sizeof(key->name));
+            ret = key == &ring->keys[0] ? 1 : 2;
+        }
+    }
+    CRYPTO_THREAD_unlock(tctx->ext.tick_keys_lock);
+
+    return ret;
+}
+
 /*-
  * tls_decrypt_ticket attempts to decrypt a session ticket.
  *
@@ -1321,21 +1554,19 @@ TICKET_RETURN tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         if (rv == 2)
             renew_ticket = 1;
     } else {
-        /* Check key name matches */
-        if (memcmp(etick, tctx->ext.tick_key_name,
-                   sizeof(tctx->ext.tick_key_name)) != 0) {
-            ret = TICKET_NO_DECRYPT;
+        /* Look up the key by name */
+        int rv = tls_ticket_key_init(tctx, (unsigned char *)etick,
+                                     etick + TLSEXT_KEYNAME_LENGTH, ctx, hctx,
+                                     0);
+
+        if (rv < 0)
             goto err;
-        }
-        if (HMAC_Init_ex(hctx, tctx->ext.tick_hmac_key,
-                         sizeof(tctx->ext.tick_hmac_key),
-                         EVP_sha256(), NULL) <= 0
-            || EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                                  tctx->ext.tick_aes_key,
-                                  etick
-                                  + sizeof(tctx->ext.tick_key_name)) <= 0) {
+        if (rv == 0) {
+            ret = TICKET_NO_DECRYPT;
             goto err;
         }
+        if (rv == 2)
+            renew_ticket = 1;
     }
     /*
      * Attempt to process session ticket, first conduct sanity and integrity
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/asn1.h>
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#ifndef OPENSSL_NO_OCSP
+# include <openssl/ocsp.h>
+#endif
+
+#include "testutil.h"
+#include "e_os.h"
+
+/*
+ * We use a proper main function here instead of the custom main from the
+ * test framework: the allocation functions have to be replaced before
+ * anything is allocated, and the framework allocates while setting up.
+ */
+
+static size_t allocations = 0;
+static size_t frees = 0;
+
+static void *count_malloc(size_t num, const char *file, int line)
+{
+    allocations++;
+    return malloc(num);
+}
+
+static void *count_realloc(void *ptr, size_t num, const char *file, int line)
+{
+    if (ptr == NULL)
+        allocations++;
+    return realloc(ptr, num);
+}
+
+static void count_free(void *ptr, const char *file, int line)
+{
+    if (ptr != NULL)
+        frees++;
+    free(ptr);
+}
+
+static const char *cert_file = NULL;
+static unsigned char *der = NULL;
+static int derlen = 0;
+
+/* The structures decoded into an arena, and their encodings */
+static struct {
+    const char *name;
+    ASN1_ITEM_EXP *it;
+    int base64;                 /* base64 DER rather than PEM */
+    const char *file;
+    unsigned char *der;
+    long derlen;
+} arena_tests[] = {
+    { "certificate", ASN1_ITEM_ref(X509), 0, NULL, NULL, 0 },
+    { "CRL", ASN1_ITEM_ref(X509_CRL), 0, NULL, NULL, 0 },
+#ifndef OPENSSL_NO_OCSP
+    { "OCSP response", ASN1_ITEM_ref(OCSP_RESPONSE), 1, NULL, NULL, 0 },
+#endif
+};
+
+#define ARENA_DECODES   8
+
+static X509 *decode_cert(const unsigned char *in, int borrow, size_t *count)
+{
+    const unsigned char *p = in;
+    size_t before = allocations;
+    X509 *x;
+
+    if (borrow)
+        x = (X509 *)ASN1_item_d2i_borrow(NULL, &p, derlen,
+                                         ASN1_ITEM_rptr(X509));
+    else
+        x = d2i_X509(NULL, &p, derlen);
+    *count = allocations - before;
+    return x;
+}
+
+static int test_borrow_allocations(void)
+{
+    X509 *copied = NULL, *borrowed = NULL;
+    unsigned char *enc = NULL;
+    size_t ncopied, nborrowed;
+    int enclen, ret = 0;
+
+    if (!TEST_ptr(copied = decode_cert(der, 0, &ncopied))
+            || !TEST_ptr(borrowed = decode_cert(der, 1, &nborrowed)))
+        goto err;
+    TEST_info("allocations per certificate: %d copied, %d borrowed",
+              (int)ncopied, (int)nborrowed);
+    if (!TEST_size_t_lt(nborrowed, ncopied))
+        goto err;
+
+    /* Both must be the same certificate */
+    if (!TEST_int_eq(X509_cmp(copied, borrowed), 0)
+            || !TEST_int_eq(ASN1_INTEGER_cmp(X509_get_serialNumber(copied),
+                                             X509_get_serialNumber(borrowed)),
+                            0)
+            || !TEST_int_eq(X509_NAME_cmp(X509_get_issuer_name(copied),
+                                          X509_get_issuer_name(borrowed)), 0)
+            || !TEST_int_gt(enclen = i2d_X509(borrowed, &enc), 0)
+            || !TEST_mem_eq(enc, enclen, der, derlen))
+        goto err;
+    ret = 1;
+
+ err:
+    OPENSSL_free(enc);
+    X509_free(copied);
+    X509_free(borrowed);
+    return ret;
+}
+
+/* Changing a borrowed value must leave the input alone */
+static int test_borrow_modify(void)
+{
+    unsigned char *in = NULL, *enc = NULL;
+    const unsigned char *p;
+    const ASN1_BIT_STRING *csig;
+    ASN1_BIT_STRING *sig;
+    ASN1_OCTET_STRING *extdata;
+    X509_EXTENSION *ext;
+    X509 *x = NULL;
+    size_t count;
+    int enclen, ret = 0;
+
+    if (!TEST_ptr(in = OPENSSL_memdup(der, derlen))
+            || !TEST_ptr(x = decode_cert(in, 1, &count))
+            || !TEST_true(ASN1_INTEGER_set(X509_get_serialNumber(x), 42))
+            || !TEST_long_eq(ASN1_INTEGER_get(X509_get_serialNumber(x)), 42)
+            || !TEST_mem_eq(in, derlen, der, derlen))
+        goto err;
+
+    /* UTCTime, then GeneralizedTime once past 2049 */
+    if (!TEST_ptr(X509_gmtime_adj(X509_getm_notBefore(x), 0))
+            || !TEST_ptr(X509_time_adj_ex(X509_getm_notAfter(x), 36500, 0,
+                                          NULL))
+            || !TEST_mem_eq(in, derlen, der, derlen))
+        goto err;
+
+    X509_get0_signature(&csig, NULL, x);
+    sig = (ASN1_BIT_STRING *)csig;
+    if (!TEST_true(ASN1_BIT_STRING_set_bit(sig, 0,
+                                           !ASN1_BIT_STRING_get_bit(sig, 0)))
+            || !TEST_mem_eq(in, derlen, der, derlen))
+        goto err;
+
+    if (!TEST_ptr(ext = X509_get_ext(x, 0))
+            || !TEST_ptr(extdata = X509_EXTENSION_get_data(ext))
+            || !TEST_ptr(ASN1_item_pack(X509_get_serialNumber(x),
+                                        ASN1_ITEM_rptr(ASN1_INTEGER),
+                                        &extdata))
+            || !TEST_mem_eq(in, derlen, der, derlen)
+            || !TEST_int_gt(enclen = i2d_X509(x, &enc), 0))
+        goto err;
+    OPENSSL_free(enc);
+    enc = NULL;
+
+    /* Decoding into it again leaves nothing pointing at the old input */
+    p = der;
+    if (!TEST_ptr(ASN1_item_d2i_borrow((ASN1_VALUE **)&x, &p, derlen,
+                                       ASN1_ITEM_rptr(X509))))
+        goto err;
+    OPENSSL_free(in);
+    in = NULL;
+    if (!TEST_int_gt(enclen = i2d_X509(x, &enc), 0)
+            || !TEST_mem_eq(enc, enclen, der, derlen))
+        goto err;
+    ret = 1;
+
+ err:
+    OPENSSL_free(enc);
+    X509_free(x);
+    OPENSSL_free(in);
+    return ret;
+}
+
+/*
+ * Decode the same structure repeatedly, on the heap and into an arena, and
+ * count the calls to the allocator it takes, including those needed to
+ * free it all again.
+ */
+static int test_arena_allocations(int idx)
+{
+    const ASN1_ITEM *it = ASN1_ITEM_ptr(arena_tests[idx].it);
+    const unsigned char *in = arena_tests[idx].der, *p;
+    long inlen = arena_tests[idx].derlen;
+    ASN1_VALUE *val[ARENA_DECODES];
+    ASN1_ARENA *arena = NULL;
+    unsigned char *enc = NULL;
+    size_t heap, arena_first = 0, arena_reset = 0, before;
+    int i, round, enclen, ret = 0;
+
+    before = allocations + frees;
+    for (i = 0; i < ARENA_DECODES; i++) {
+        p = in;
+        if (!TEST_ptr(val[i] = ASN1_item_d2i(NULL, &p, inlen, it)))
+            goto err;
+    }
+    for (i = 0; i < ARENA_DECODES; i++)
+        ASN1_item_free(val[i], it);
+    heap = allocations + frees - before;
+
+    if (!TEST_ptr(arena = ASN1_ARENA_new()))
+        goto err;
+    for (round = 0; round < 2; round++) {
+        before = allocations + frees;
+        for (i = 0; i < ARENA_DECODES; i++) {
+            p = in;
+            if (!TEST_ptr(val[i] = ASN1_item_d2i_arena(NULL, &p, inlen, it,
+                                                       arena))
+                    || !TEST_ptr_eq(p, in + inlen))
+                goto err;
+        }
+        /* What was decoded must encode back to the input */
+        for (i = 0; i < ARENA_DECODES; i++) {
+            if (!TEST_int_gt(enclen = ASN1_item_i2d(val[i], &enc, it), 0)
+                    || !TEST_mem_eq(enc, enclen, in, inlen))
+                goto err;
+            OPENSSL_free(enc);
+            enc = NULL;
+        }
+        ASN1_ARENA_reset(arena);
+        if (round == 0)
+            arena_first = allocations + frees - before;
+        else
+            arena_reset = allocations + frees - before;
+    }
+    TEST_info("allocator calls for %d of %s: %d on the heap, %d in a new "
+              "arena, %d in a reset arena", ARENA_DECODES,
+              arena_tests[idx].name, (int)heap, (int)arena_first,
+              (int)arena_reset);
+    if (!TEST_size_t_lt(arena_first, heap)
+            || !TEST_size_t_le(arena_reset, arena_first))
+        goto err;
+    ret = 1;
+
+ err:
+    OPENSSL_free(enc);
+    ASN1_ARENA_free(arena);
+    return ret;
+}
+
+/* Failed decodes and lazily computed data don't upset the arena */
+static int test_arena_use(void)
+{
+    const unsigned char *p;
+    ASN1_ARENA *arena = NULL;
+    X509 *x = NULL, *heapx = NULL;
+    EVP_PKEY *pkey = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(arena = ASN1_ARENA_new()))
+        goto err;
+
+    p = der;
+    if (!TEST_ptr_null(ASN1_item_d2i_arena(NULL, &p, derlen - 1,
+                                           ASN1_ITEM_rptr(X509), arena)))
+        goto err;
+
+    p = der;
+    if (!TEST_ptr(x = (X509 *)ASN1_item_d2i_arena(NULL, &p, derlen,
+                                                  ASN1_ITEM_rptr(X509),
+                                                  arena)))
+        goto err;
+    p = der;
+    if (!TEST_ptr(heapx = d2i_X509(NULL, &p, derlen)))
+        goto err;
+
+    /* Cached extension data and keys come from the heap */
+    if (!TEST_int_eq(X509_check_purpose(x, -1, 0), 1)
+            || !TEST_ptr(pkey = X509_get_pubkey(x))
+            || !TEST_int_eq(X509_cmp(x, heapx), 0))
+        goto err;
+    ret = 1;
+
+ err:
+    EVP_PKEY_free(pkey);
+    X509_free(heapx);
+    ASN1_ARENA_free(arena);
+    return ret;
+}
+
+static int load_der(int idx)
+{
+    BIO *bio = BIO_new_file(arena_tests[idx].file, "r"), *b64 = NULL;
+    char *name = NULL, *header = NULL;
+    unsigned char buf[4096];
+    int len, ret = 0;
+
+    if (!TEST_ptr(bio))
+        return 0;
+    if (!arena_tests[idx].base64) {
+        ret = TEST_true(PEM_read_bio(bio, &name, &header,
+                                     &arena_tests[idx].der,
+                                     &arena_tests[idx].derlen));
+    } else if (TEST_ptr(b64 = BIO_new(BIO_f_base64()))) {
+        BIO_push(b64, bio);
+        len = BIO_read(b64, buf, sizeof(buf));
+        ret = TEST_int_gt(len, 0)
+              && TEST_ptr(arena_tests[idx].der = OPENSSL_memdup(buf, len));
+        arena_tests[idx].derlen = len;
+        BIO_pop(b64);
+    }
+    OPENSSL_free(name);
+    OPENSSL_free(header);
+    BIO_free(b64);
+    BIO_free(bio);
+    return ret;
+}
+
+static int load_cert(void)
+{
+    BIO *bio = BIO_new_file(cert_file, "r");
+    X509 *x = NULL;
+    int ret;
+
+    ret = TEST_ptr(bio)
+          && TEST_ptr(x = PEM_read_bio_X509(bio, NULL, NULL, NULL))
+          && TEST_int_gt(derlen = i2d_X509(x, &der), 0);
+    BIO_free(bio);
+    X509_free(x);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (!CRYPTO_set_mem_functions(count_malloc, count_realloc, count_free))
+        return EXIT_FAILURE;
+
+    setup_test();
+
+    if (argc != (int)OSSL_NELEM(arena_tests) + 1) {
+        TEST_error("usage: asn1_alloc_test cert.pem crl.pem [ocsp.ors]\n");
+        goto end;
+    }
+    cert_file = argv[1];
+    if (!load_cert())
+        goto end;
+    for (i = 0; i < OSSL_NELEM(arena_tests); i++) {
+        arena_tests[i].file = argv[i + 1];
+        if (!load_der(i))
+            goto end;
+    }
+
+    ADD_TEST(test_borrow_allocations);
+    ADD_TEST(test_borrow_modify);
+    ADD_ALL_TESTS(test_arena_allocations, OSSL_NELEM(arena_tests));
+    ADD_TEST(test_arena_use);
+    ret = run_tests(argv[0]);
+
+ end:
+    OPENSSL_free(der);
+    for (i = 0; i < OSSL_NELEM(arena_tests); i++)
+        OPENSSL_free(arena_tests[i].der);
+    return finish_test(ret);
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2017 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the OpenSSL license (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -269,6 +269,122 @@ static int test_ASYNC_block_pause()
     return 1;
 }
 
+static int callbacks = 0;
+static int count_callback(void *arg)
+{
+    callbacks += *(int *)arg;
+    return 1;
+}
+
+/* Do what an engine would: say how the job is to be resumed, then do so */
+static int callback_wait(void *args)
+{
+    ASYNC_WAIT_CTX *waitctx = ASYNC_get_wait_ctx(ASYNC_get_current_job());
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+
+    if (!ASYNC_WAIT_CTX_get_callback(waitctx, &callback, &callback_arg)
+            || !ASYNC_WAIT_CTX_set_status(waitctx, ASYNC_STATUS_OK)
+            || !callback(callback_arg))
+        return 0;
+    ASYNC_pause_job();
+
+    return 1;
+}
+
+static int test_ASYNC_WAIT_CTX_set_callback()
+{
+    ASYNC_JOB *job = NULL;
+    int funcret, one = 1;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    size_t numfds;
+
+    if (       !ASYNC_init_thread(1, 0)
+            || (waitctx = ASYNC_WAIT_CTX_new()) == NULL
+            || ASYNC_WAIT_CTX_get_callback(waitctx, &callback, &callback_arg)
+            || ASYNC_WAIT_CTX_get_status(waitctx) != ASYNC_STATUS_UNSUPPORTED
+            || !ASYNC_WAIT_CTX_set_callback(waitctx, count_callback, &one)
+            || !ASYNC_WAIT_CTX_get_callback(waitctx, &callback, &callback_arg)
+            || callback != count_callback
+            || callback_arg != &one
+            || ASYNC_start_job(&job, waitctx, &funcret, callback_wait, NULL, 0)
+                != ASYNC_PAUSE
+            || callbacks != 1
+            || ASYNC_WAIT_CTX_get_status(waitctx) != ASYNC_STATUS_OK
+            || !ASYNC_WAIT_CTX_get_all_fds(waitctx, NULL, &numfds)
+            || numfds != 0
+            || ASYNC_start_job(&job, waitctx, &funcret, callback_wait, NULL, 0)
+                != ASYNC_FINISH
+            || funcret != 1
+            || callbacks != 1) {
+        fprintf(stderr, "test_ASYNC_WAIT_CTX_set_callback() failed\n");
+        ASYNC_WAIT_CTX_free(waitctx);
+        ASYNC_cleanup_thread();
+        return 0;
+    }
+
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    return 1;
+}
+
+#define BIG_STACK_SIZE  (256 * 1024)
+#define BIG_BUF_SIZE    (128 * 1024)
+static int bigstack(void *args)
+{
+    unsigned char buf[BIG_BUF_SIZE];
+    volatile double d = *(int *)args;
+    size_t i;
+
+    /* Two jobs run interleaved, each must see its own stack and registers */
+    memset(buf, *(int *)args, sizeof(buf));
+    for (i = 0; i < 10; i++) {
+        d *= 1.5;
+        ASYNC_pause_job();
+    }
+    for (i = 0; i < sizeof(buf); i++)
+        if (buf[i] != *(int *)args)
+            return 0;
+    return d == *(int *)args * 57.6650390625;
+}
+
+static int test_ASYNC_set_stack_size()
+{
+    ASYNC_JOB *job1 = NULL, *job2 = NULL;
+    int funcret1, funcret2, arg1 = 1, arg2 = 2, r1, r2;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+
+    if (       ASYNC_set_stack_size(1)
+            || !ASYNC_set_stack_size(BIG_STACK_SIZE)
+            || !ASYNC_init_thread(2, 0)
+            || (waitctx = ASYNC_WAIT_CTX_new()) == NULL)
+        goto err;
+
+    do {
+        r1 = ASYNC_start_job(&job1, waitctx, &funcret1, bigstack, &arg1,
+                             sizeof(arg1));
+        r2 = ASYNC_start_job(&job2, waitctx, &funcret2, bigstack, &arg2,
+                             sizeof(arg2));
+    } while (r1 == ASYNC_PAUSE && r2 == ASYNC_PAUSE);
+    if (r1 != ASYNC_FINISH || r2 != ASYNC_FINISH
+            || funcret1 != 1 || funcret2 != 1)
+        goto err;
+
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    ASYNC_set_stack_size(0);
+    return 1;
+
+ err:
+    fprintf(stderr, "test_ASYNC_set_stack_size() failed\n");
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    ASYNC_set_stack_size(0);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     if (!ASYNC_is_capable()) {
@@ -282,7 +398,9 @@ int main(int argc, char **argv)
                 || !test_ASYNC_start_job()
                 || !test_ASYNC_get_current_job()
                 || !test_ASYNC_WAIT_CTX_get_all_fds()
-                || !test_ASYNC_block_pause()) {
+                || !test_ASYNC_block_pause()
+                || !test_ASYNC_WAIT_CTX_set_callback()
+                || !test_ASYNC_set_stack_size()) {
             return 1;
         }
     }
@@ -14,6 +14,8 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <openssl/ec.h>
 
 #include "testutil.h"
 
@@ -364,6 +366,245 @@ static int test_unknown_critical_crl(int n)
     return r;
 }
 
+/*
+ * Decode |crl| again with d2i_X509_CRL_indexed(), checking that the
+ * encoding is all used and re-encodes the same.
+ */
+static X509_CRL *reload_indexed(X509_CRL *crl)
+{
+    unsigned char *der = NULL, *enc = NULL;
+    const unsigned char *p;
+    X509_CRL *ret = NULL;
+    int len, enclen;
+
+    if (!TEST_int_gt(len = i2d_X509_CRL(crl, &der), 0))
+        goto err;
+    p = der;
+    if (!TEST_ptr(ret = d2i_X509_CRL_indexed(NULL, &p, len))
+            || !TEST_ptr_eq(p, der + len)
+            || !TEST_int_gt(enclen = i2d_X509_CRL(ret, &enc), 0)
+            || !TEST_mem_eq(enc, enclen, der, len)) {
+        X509_CRL_free(ret);
+        ret = NULL;
+    }
+ err:
+    OPENSSL_free(der);
+    OPENSSL_free(enc);
+    return ret;
+}
+
+static int test_indexed_crl(void)
+{
+    X509_CRL *basic_crl = CRL_from_strings(kBasicCRL);
+    X509_CRL *revoked_crl = CRL_from_strings(kRevokedCRL);
+    X509_CRL *indexed = NULL;
+    X509_REVOKED *rev = NULL;
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    int r = 0;
+
+    if (!TEST_ptr(basic_crl)
+            || !TEST_ptr(revoked_crl)
+            || !TEST_ptr(serial)
+            || !TEST_ptr(indexed = reload_indexed(revoked_crl))
+            || !TEST_ptr_null(X509_CRL_get_REVOKED(indexed))
+            || !TEST_int_eq(X509_CRL_match(indexed, revoked_crl), 0))
+        goto err;
+
+    if (!TEST_true(ASN1_INTEGER_set(serial, 0x1001))
+            || !TEST_int_eq(X509_CRL_get0_by_serial(indexed, &rev, serial), 0)
+            || !TEST_true(ASN1_INTEGER_set(serial, 0x1000))
+            || !TEST_int_eq(X509_CRL_get0_by_serial(indexed, &rev, serial), 1)
+            || !TEST_ptr(rev)
+            || !TEST_int_eq(ASN1_INTEGER_cmp(serial,
+                                X509_REVOKED_get0_serialNumber(rev)), 0))
+        goto err;
+
+    r = TEST_int_eq(verify(test_leaf, test_root,
+                           make_CRL_stack(basic_crl, indexed),
+                           X509_V_FLAG_CRL_CHECK), X509_V_ERR_CERT_REVOKED);
+ err:
+    ASN1_INTEGER_free(serial);
+    X509_CRL_free(basic_crl);
+    X509_CRL_free(revoked_crl);
+    X509_CRL_free(indexed);
+    return r;
+}
+
+/*
+ * An entry that d2i_X509_REVOKED() can't be relied on to decode the same
+ * way, here one with a malformed revocationDate, is not indexed.
+ */
+static int test_indexed_crl_fallback(void)
+{
+    X509_CRL *crl = CRL_from_strings(kRevokedCRL);
+    X509_CRL *indexed = NULL;
+    X509_REVOKED *rev;
+    ASN1_TIME *tm;
+    int r = 0;
+
+    if (!TEST_ptr(crl)
+            || !TEST_ptr(rev = sk_X509_REVOKED_value(
+                                   X509_CRL_get_REVOKED(crl), 0))
+            || !TEST_ptr(tm = (ASN1_TIME *)
+                                  X509_REVOKED_get0_revocationDate(rev))
+            || !TEST_true(ASN1_STRING_set(tm, "1613010000", -1))
+            || !TEST_true(X509_CRL_sort(crl))
+            || !TEST_ptr(indexed = reload_indexed(crl))
+            || !TEST_int_eq(sk_X509_REVOKED_num(X509_CRL_get_REVOKED(indexed)),
+                            1))
+        goto err;
+    r = 1;
+ err:
+    X509_CRL_free(crl);
+    X509_CRL_free(indexed);
+    return r;
+}
+
+/*
+ * Modifying an indexed CRL must keep its indexed entries, including one a
+ * lookup has already decoded, in what is encoded afterwards.
+ */
+static int test_indexed_crl_modify(void)
+{
+    X509_CRL *crl = CRL_from_strings(kRevokedCRL);
+    X509_CRL *indexed = NULL, *full = NULL;
+    X509_REVOKED *rev = NULL;
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    ASN1_TIME *tm = ASN1_TIME_set(NULL, PARAM_TIME);
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int len, r = 0;
+
+    if (!TEST_ptr(crl)
+            || !TEST_ptr(serial)
+            || !TEST_ptr(tm)
+            || !TEST_ptr(indexed = reload_indexed(crl))
+            || !TEST_true(ASN1_INTEGER_set(serial, 0x1000))
+            || !TEST_int_eq(X509_CRL_get0_by_serial(indexed, &rev, serial), 1))
+        goto err;
+
+    if (!TEST_ptr(rev = X509_REVOKED_new())
+            || !TEST_true(X509_CRL_add0_revoked(indexed, rev))
+            || !TEST_true(ASN1_INTEGER_set(serial, 0x2000))
+            || !TEST_true(X509_REVOKED_set_serialNumber(rev, serial))
+            || !TEST_true(X509_REVOKED_set_revocationDate(rev, tm))
+            || !TEST_true(X509_CRL_sort(indexed))
+            || !TEST_int_eq(sk_X509_REVOKED_num(X509_CRL_get_REVOKED(indexed)),
+                            2))
+        goto err;
+
+    if (!TEST_int_gt(len = i2d_X509_CRL(indexed, &der), 0))
+        goto err;
+    p = der;
+    if (!TEST_ptr(full = d2i_X509_CRL(NULL, &p, len))
+            || !TEST_int_eq(sk_X509_REVOKED_num(X509_CRL_get_REVOKED(full)), 2)
+            || !TEST_int_eq(X509_CRL_get0_by_serial(full, &rev, serial), 1)
+            || !TEST_true(ASN1_INTEGER_set(serial, 0x1000))
+            || !TEST_int_eq(X509_CRL_get0_by_serial(full, &rev, serial), 1))
+        goto err;
+    r = 1;
+ err:
+    OPENSSL_free(der);
+    ASN1_INTEGER_free(serial);
+    ASN1_TIME_free(tm);
+    X509_CRL_free(crl);
+    X509_CRL_free(indexed);
+    X509_CRL_free(full);
+    return r;
+}
+
+#ifndef OPENSSL_NO_EC
+# define INDEXED_CRL_ENTRIES 1000
+
+static int set_serial(ASN1_INTEGER *serial, int i)
+{
+    /* Spread them over 64 bits, so many need a leading zero byte */
+    return ASN1_INTEGER_set_uint64(serial, (uint64_t)i * 0x9E3779B97F4A7C15U);
+}
+
+/*
+ * Lookups in a large CRL with a variety of reasons must give the same
+ * answers whether it was indexed or decoded in full.
+ */
+static int test_indexed_crl_lookup(void)
+{
+    X509_CRL *crl = X509_CRL_new(), *full = NULL, *indexed = NULL;
+    X509_REVOKED *rev, *rev2;
+    ASN1_INTEGER *serial = ASN1_INTEGER_new();
+    ASN1_ENUMERATED *reason = ASN1_ENUMERATED_new();
+    ASN1_TIME *tm = ASN1_TIME_set(NULL, PARAM_TIME);
+    EC_KEY *eckey = NULL;
+    EVP_PKEY *pkey = EVP_PKEY_new();
+    int i, r = 0;
+
+    if (!TEST_ptr(crl) || !TEST_ptr(serial) || !TEST_ptr(reason)
+            || !TEST_ptr(tm) || !TEST_ptr(pkey)
+            || !TEST_ptr(eckey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1))
+            || !TEST_true(EC_KEY_generate_key(eckey))
+            || !TEST_true(EVP_PKEY_assign_EC_KEY(pkey, eckey)))
+        goto err;
+    if (!TEST_true(X509_CRL_set_version(crl, 1))
+            || !TEST_true(X509_CRL_set_issuer_name(crl,
+                                  X509_get_subject_name(test_root)))
+            || !TEST_true(X509_CRL_set1_lastUpdate(crl, tm)))
+        goto err;
+    for (i = 0; i < INDEXED_CRL_ENTRIES; i++) {
+        if (!TEST_ptr(rev = X509_REVOKED_new())
+                || !TEST_true(X509_CRL_add0_revoked(crl, rev))
+                || !TEST_true(set_serial(serial, i))
+                || !TEST_true(X509_REVOKED_set_serialNumber(rev, serial))
+                || !TEST_true(X509_REVOKED_set_revocationDate(rev, tm)))
+            goto err;
+        if (i % 3 != 0)
+            continue;
+        /* Including removeFromCRL, and reasons out of range */
+        if (!TEST_true(ASN1_ENUMERATED_set(reason, i % 16))
+                || !TEST_true(X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason,
+                                                        reason, i % 2, 0)))
+            goto err;
+    }
+    if (!TEST_true(X509_CRL_sort(crl))
+            || !TEST_true(X509_CRL_sign(crl, pkey, EVP_sha256())))
+        goto err;
+
+    if (!TEST_ptr(full = X509_CRL_dup(crl))
+            || !TEST_ptr(indexed = reload_indexed(crl))
+            || !TEST_int_eq(X509_CRL_verify(indexed, pkey), 1)
+            || !TEST_int_eq(X509_CRL_match(indexed, full), 0))
+        goto err;
+    for (i = 0; i < INDEXED_CRL_ENTRIES * 2; i++) {
+        int found, found2;
+
+        rev = rev2 = NULL;
+        if (!TEST_true(set_serial(serial, i)))
+            goto err;
+        found = X509_CRL_get0_by_serial(indexed, &rev, serial);
+        found2 = X509_CRL_get0_by_serial(full, &rev2, serial);
+        if (!TEST_int_eq(found, found2))
+            goto err;
+        if (found && (!TEST_ptr(rev)
+                      || !TEST_int_eq(ASN1_INTEGER_cmp(serial,
+                                         X509_REVOKED_get0_serialNumber(rev)),
+                                      0)))
+            goto err;
+        /* Without asking for the entry too */
+        if (!TEST_int_eq(X509_CRL_get0_by_serial(indexed, NULL, serial),
+                         found))
+            goto err;
+    }
+    r = 1;
+ err:
+    ASN1_INTEGER_free(serial);
+    ASN1_ENUMERATED_free(reason);
+    ASN1_TIME_free(tm);
+    EVP_PKEY_free(pkey);
+    X509_CRL_free(crl);
+    X509_CRL_free(full);
+    X509_CRL_free(indexed);
+    return r;
+}
+#endif
+
 int test_main(int argc, char *argv[])
 {
     int status = EXIT_FAILURE;
@@ -377,6 +618,12 @@ int test_main(int argc, char *argv[])
     ADD_TEST(test_bad_issuer_crl);
     ADD_TEST(test_known_critical_crl);
     ADD_ALL_TESTS(test_unknown_critical_crl, OSSL_NELEM(unknown_critical_crls));
+    ADD_TEST(test_indexed_crl);
+    ADD_TEST(test_indexed_crl_fallback);
+    ADD_TEST(test_indexed_crl_modify);
+#ifndef OPENSSL_NO_EC
+    ADD_TEST(test_indexed_crl_lookup);
+#endif
 
     status = run_tests(argv[0]);
 err:
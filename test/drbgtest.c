@@ -0,0 +1,244 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* Internal tests for the CTR_DRBG and the per-thread DRBG hierarchy */
+
+#include <string.h>
+#include "e_os.h"
+#include <openssl/rand.h>
+#include "../crypto/rand/rand_lcl.h"
+#include "testutil.h"
+
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+/*
+ * Known answers for AES-256 CTR_DRBG with derivation function.  The inputs
+ * are generated by fill() below; each answer is the output of the second
+ * of two 64 byte generate requests following instantiation.
+ */
+static const unsigned char kat0_out[] = {
+    0x41, 0x35, 0xe3, 0x34, 0x4c, 0x29, 0xc1, 0x3f,
+    0x7e, 0x97, 0xbf, 0x64, 0xe5, 0x77, 0x85, 0x54,
+    0xc4, 0x04, 0xa4, 0x4e, 0x76, 0x4a, 0xbf, 0xf2,
+    0x9e, 0xbb, 0xea, 0x94, 0xc9, 0x9b, 0x54, 0x6b,
+    0x2d, 0x44, 0x2b, 0x81, 0xb1, 0x69, 0xe2, 0x3f,
+    0x99, 0x88, 0x48, 0x0c, 0x27, 0x36, 0x6b, 0x05,
+    0x87, 0x66, 0xe8, 0x1f, 0x3b, 0x68, 0x37, 0xeb,
+    0x63, 0xfd, 0x39, 0x32, 0x0c, 0x8b, 0x6f, 0x28
+};
+
+static const unsigned char kat1_out[] = {
+    0x0e, 0x69, 0x73, 0x9b, 0x4f, 0x3f, 0xb2, 0x08,
+    0x80, 0x81, 0x70, 0xcf, 0xf6, 0x1e, 0x3d, 0xd4,
+    0x10, 0x0f, 0xbb, 0xc3, 0x44, 0x05, 0xbf, 0x58,
+    0x4d, 0xa4, 0x6c, 0xc7, 0x7e, 0xfc, 0x61, 0xfb,
+    0x95, 0x85, 0x13, 0xeb, 0xbb, 0x73, 0x91, 0x8f,
+    0x51, 0xdf, 0x32, 0x23, 0x0a, 0x59, 0xb8, 0xe7,
+    0xf5, 0xb9, 0x81, 0xe3, 0x0d, 0x58, 0x51, 0xdf,
+    0x66, 0x6d, 0xa4, 0x05, 0xf3, 0x63, 0x55, 0xa7
+};
+
+static const unsigned char kat2_out[] = {
+    0xc3, 0x95, 0xad, 0xbc, 0x1b, 0x80, 0xd7, 0x46,
+    0xeb, 0xbb, 0xa3, 0x6a, 0xc6, 0xdd, 0x73, 0xef,
+    0x38, 0x66, 0x17, 0xaa, 0x34, 0x9d, 0x70, 0x3b,
+    0x83, 0xe7, 0x75, 0x6c, 0xbc, 0xa2, 0x5e, 0x19,
+    0xa7, 0xe4, 0xf7, 0x4a, 0xc0, 0xf1, 0x68, 0x0c,
+    0xab, 0xb2, 0x65, 0x9d, 0xae, 0xb6, 0x12, 0x1e,
+    0x80, 0x32, 0x60, 0x81, 0x2c, 0x83, 0xc1, 0xe0,
+    0x78, 0xa3, 0x2c, 0xee, 0x36, 0xa1, 0xb4, 0xc9
+};
+
+static const unsigned char *kat_out[] = { kat0_out, kat1_out, kat2_out };
+
+static void fill(unsigned char *buf, size_t len, int start, int step)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (unsigned char)(start + step * i);
+}
+
+/*
+ * Test 0: no personalization string and no additional input.
+ * Test 1: personalization string and additional input.
+ * Test 2: as test 1 with an explicit reseed before generating.
+ */
+static int test_kats(int n)
+{
+    unsigned char ent[2 * DRBG_ENTROPY_LEN], nonce[DRBG_NONCE_LEN];
+    unsigned char pers[32], adin1[32], adin2[32], adinr[32], out[64];
+    const unsigned char *p = n > 0 ? pers : NULL;
+    const unsigned char *a1 = n > 0 ? adin1 : NULL;
+    const unsigned char *a2 = n > 0 ? adin2 : NULL;
+    size_t len = n > 0 ? 32 : 0;
+    RAND_DRBG *drbg;
+    int ret = 0;
+
+    fill(ent, sizeof(ent), 3, 7);
+    fill(nonce, sizeof(nonce), 0xa0, 1);
+    fill(pers, sizeof(pers), 0x40, 1);
+    fill(adin1, sizeof(adin1), 0x80, 1);
+    fill(adin2, sizeof(adin2), 0xc0, 1);
+    fill(adinr, sizeof(adinr), 0x10, 1);
+
+    if (!TEST_ptr(drbg = rand_drbg_new(NULL))
+            || !TEST_true(ctr_instantiate(drbg, ent, DRBG_ENTROPY_LEN,
+                                          nonce, sizeof(nonce), p, len)))
+        goto err;
+    if (n == 2
+            && !TEST_true(ctr_reseed(drbg, ent + DRBG_ENTROPY_LEN,
+                                     DRBG_ENTROPY_LEN, adinr, sizeof(adinr))))
+        goto err;
+    if (!TEST_true(ctr_generate(drbg, out, sizeof(out), a1, len))
+            || !TEST_true(ctr_generate(drbg, out, sizeof(out), a2, len))
+            || !TEST_mem_eq(out, sizeof(out), kat_out[n], sizeof(out)))
+        goto err;
+    ret = 1;
+
+ err:
+    rand_drbg_free(drbg);
+    return ret;
+}
+
+/*
+ * A child DRBG must reseed once its reseed interval is reached and
+ * whenever its parent has been reseeded.
+ */
+static int test_reseed(void)
+{
+    RAND_DRBG *master, *child = NULL;
+    unsigned char buf[32];
+    unsigned int count;
+    int ret = 0;
+
+    if (!TEST_ptr(master = rand_drbg_get0_master())
+            || !TEST_ptr(child = rand_drbg_new(master))
+            || !TEST_true(rand_drbg_set_reseed_interval(child, 2))
+            || !TEST_true(rand_drbg_generate(child, buf, sizeof(buf), NULL, 0)))
+        goto err;
+    count = child->reseed_count;
+    if (!TEST_true(rand_drbg_generate(child, buf, sizeof(buf), NULL, 0))
+            || !TEST_uint_eq(child->reseed_count, count)
+            || !TEST_true(rand_drbg_generate(child, buf, sizeof(buf), NULL, 0))
+            || !TEST_uint_eq(child->reseed_count, count + 1))
+        goto err;
+
+    CRYPTO_THREAD_write_lock(master->lock);
+    ret = rand_drbg_reseed(master, NULL, 0);
+    CRYPTO_THREAD_unlock(master->lock);
+    if (!TEST_true(ret))
+        goto err;
+    ret = 0;
+    if (!TEST_true(rand_drbg_generate(child, buf, sizeof(buf), NULL, 0))
+            || !TEST_uint_eq(child->reseed_count, count + 2))
+        goto err;
+
+    if (!TEST_false(rand_drbg_generate(child, buf, DRBG_MAX_REQUEST + 1,
+                                       NULL, 0)))
+        goto err;
+    ret = 1;
+
+ err:
+    rand_drbg_free(child);
+    return ret;
+}
+
+/*
+ * RAND_bytes() must be served from a per-thread DRBG and RAND_add() must
+ * reach the master.
+ */
+static int test_rand_method(void)
+{
+    RAND_DRBG *drbg, *master;
+    unsigned char buf[1024], *big;
+    unsigned int count;
+    int ret;
+
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+            || !TEST_ptr(drbg = rand_drbg_get0_thread())
+            || !TEST_ptr(master = rand_drbg_get0_master())
+            || !TEST_ptr_eq(drbg->parent, master)
+            || !TEST_int_eq(drbg->state, DRBG_READY))
+        return 0;
+
+    /* Input without entropy stays in the calling thread's DRBG */
+    count = master->reseed_count;
+    RAND_add(buf, sizeof(buf), 0.0);
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+            || !TEST_uint_eq(master->reseed_count, count))
+        return 0;
+
+    /* Seeding with entropy reseeds the whole hierarchy */
+    RAND_seed(buf, sizeof(buf));
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+            || !TEST_uint_eq(master->reseed_count, count + 1)
+            || !TEST_uint_eq(drbg->parent_reseed_count, count + 1))
+        return 0;
+
+    /* Requests larger than the DRBG maximum are split up */
+    if (!TEST_ptr(big = OPENSSL_malloc(DRBG_MAX_REQUEST * 2 + 1)))
+        return 0;
+    ret = TEST_int_eq(RAND_bytes(big, DRBG_MAX_REQUEST * 2 + 1), 1);
+    OPENSSL_free(big);
+    return ret;
+}
+
+#if defined(OPENSSL_SYS_UNIX)
+/*
+ * After fork() parent and child must not produce the same output.
+ */
+static int test_fork(void)
+{
+    unsigned char parent_buf[32], child_buf[32];
+    int fds[2], status;
+    pid_t pid;
+
+    if (!TEST_int_eq(RAND_bytes(parent_buf, sizeof(parent_buf)), 1)
+            || !TEST_int_eq(pipe(fds), 0))
+        return 0;
+
+    if ((pid = fork()) == 0) {
+        close(fds[0]);
+        if (RAND_bytes(child_buf, sizeof(child_buf)) != 1
+                || write(fds[1], child_buf, sizeof(child_buf))
+                   != (ssize_t)sizeof(child_buf))
+            _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (!TEST_int_gt(pid, 0)
+            || !TEST_int_eq(read(fds[0], child_buf, sizeof(child_buf)),
+                            (int)sizeof(child_buf))
+            || !TEST_int_eq(waitpid(pid, &status, 0), pid)
+            || !TEST_true(WIFEXITED(status))
+            || !TEST_int_eq(WEXITSTATUS(status), 0)
+            || !TEST_int_eq(RAND_bytes(parent_buf, sizeof(parent_buf)), 1)) {
+        close(fds[0]);
+        return 0;
+    }
+    close(fds[0]);
+    return TEST_mem_ne(parent_buf, sizeof(parent_buf),
+                       child_buf, sizeof(child_buf));
+}
+#endif
+
+void register_tests(void)
+{
+    ADD_ALL_TESTS(test_kats, OSSL_NELEM(kat_out));
+    ADD_TEST(test_reseed);
+    ADD_TEST(test_rand_method);
+#if defined(OPENSSL_SYS_UNIX)
+    ADD_TEST(test_fork);
+#endif
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <openssl/err.h>
+
+#include "testutil.h"
+
+static int test_suppress_mark(void)
+{
+    unsigned long first = ERR_PACK(ERR_LIB_USER, 0, 1);
+    const char *data;
+    int flags;
+
+    ERR_clear_error();
+    ERR_put_error(ERR_LIB_USER, 0, 1, __FILE__, __LINE__);
+
+    if (!TEST_true(ERR_set_suppress_mark())
+            || !TEST_true(ERR_set_suppress_mark()))
+        goto err;
+    ERR_put_error(ERR_LIB_USER, 0, 2, __FILE__, __LINE__);
+    ERR_add_error_data(1, "dropped");
+    if (!TEST_true(ERR_pop_suppress_mark()))
+        goto err;
+    ERR_put_error(ERR_LIB_USER, 0, 3, __FILE__, __LINE__);
+    if (!TEST_true(ERR_pop_suppress_mark())
+            || !TEST_ulong_eq(ERR_peek_last_error_line_data(NULL, NULL, &data,
+                                                            &flags), first)
+            || !TEST_int_eq(flags, 0)
+            || !TEST_false(ERR_pop_suppress_mark()))
+        goto err;
+
+    ERR_put_error(ERR_LIB_USER, 0, 4, __FILE__, __LINE__);
+    ERR_add_error_data(1, "kept");
+    if (!TEST_ulong_eq(ERR_peek_last_error_line_data(NULL, NULL, &data, NULL),
+                       ERR_PACK(ERR_LIB_USER, 0, 4))
+            || !TEST_str_eq(data, "kept")
+            || !TEST_ulong_eq(ERR_get_error(), first)
+            || !TEST_ulong_eq(ERR_get_error(), ERR_PACK(ERR_LIB_USER, 0, 4))
+            || !TEST_ulong_eq(ERR_get_error(), 0))
+        goto err;
+    return 1;
+
+ err:
+    while (ERR_pop_suppress_mark())
+        continue;
+    ERR_clear_error();
+    return 0;
+}
+
+/* ERR_set_mark() and ERR_pop_to_mark() still pair up inside a suppression */
+static int test_suppress_with_mark(void)
+{
+    int ret = 0;
+
+    ERR_clear_error();
+    ERR_put_error(ERR_LIB_USER, 0, 1, __FILE__, __LINE__);
+    if (!TEST_true(ERR_set_suppress_mark()))
+        goto err;
+    if (!TEST_true(ERR_set_mark()))
+        goto end;
+    ERR_put_error(ERR_LIB_USER, 0, 2, __FILE__, __LINE__);
+    if (!TEST_true(ERR_pop_to_mark())
+            || !TEST_ulong_eq(ERR_peek_last_error(),
+                              ERR_PACK(ERR_LIB_USER, 0, 1)))
+        goto end;
+    ret = 1;
+
+ end:
+    if (!TEST_true(ERR_pop_suppress_mark()))
+        ret = 0;
+ err:
+    ERR_clear_error();
+    return ret;
+}
+
+void register_tests(void)
+{
+    ADD_TEST(test_suppress_mark);
+    ADD_TEST(test_suppress_with_mark);
+}
@@ -346,6 +346,71 @@ static int test_EVP_PKCS82PKEY(void)
 }
 #endif
 
+static const EVP_MD *(*batch_digests[])(void) = {
+    EVP_sha1, EVP_sha224, EVP_sha256, EVP_sha512
+};
+
+#define BATCH_MSGS      37
+#define BATCH_MAXLEN    100003
+
+/*
+ * Hashes a batch of messages with lengths around the padding boundaries,
+ * with a few long ones that keep their lanes busy while the others drain,
+ * and compares against hashing them one at a time.
+ */
+static int test_EVP_DigestBatch(int idx)
+{
+    static const size_t short_lens[] = {
+        0, 1, 55, 56, 63, 64, 65, 111, 112, 119, 120, 127, 128, 129, 200
+    };
+    static const size_t long_lens[] = { 4096, BATCH_MAXLEN, 1000, 70000 };
+    const EVP_MD *md = batch_digests[idx]();
+    size_t mdsize = EVP_MD_size(md);
+    size_t nshort = sizeof(short_lens) / sizeof(short_lens[0]);
+    size_t nlong = sizeof(long_lens) / sizeof(long_lens[0]);
+    const void *in[BATCH_MSGS];
+    size_t lens[BATCH_MSGS], i;
+    unsigned char *data = NULL, *out = NULL;
+    unsigned char expected[EVP_MAX_MD_SIZE];
+    int ret = 0;
+
+    if (!TEST_ptr(data = OPENSSL_malloc(BATCH_MAXLEN + BATCH_MSGS))
+            || !TEST_ptr(out = OPENSSL_malloc(BATCH_MSGS * mdsize)))
+        goto done;
+    for (i = 0; i < BATCH_MAXLEN + BATCH_MSGS; i++)
+        data[i] = (unsigned char)(i * 7 + (i >> 8));
+
+    for (i = 0; i < BATCH_MSGS; i++) {
+        in[i] = data + i;
+        if (i % 9 == 0)
+            lens[i] = long_lens[(i / 9) % nlong];
+        else
+            lens[i] = short_lens[i % nshort];
+    }
+
+    if (!TEST_true(EVP_DigestBatch(md, in, lens, 0, out))
+            || !TEST_true(EVP_DigestBatch(md, in, lens, 1, out))
+            || !TEST_true(EVP_Digest(in[0], lens[0], expected, NULL, md, NULL))
+            || !TEST_mem_eq(out, mdsize, expected, mdsize)
+            || !TEST_true(EVP_DigestBatch(md, in, lens, BATCH_MSGS, out)))
+        goto done;
+
+    for (i = 0; i < BATCH_MSGS; i++) {
+        if (!TEST_true(EVP_Digest(in[i], lens[i], expected, NULL, md, NULL))
+                || !TEST_mem_eq(out + i * mdsize, mdsize, expected, mdsize)) {
+            TEST_info("message %d, length %d", (int)i, (int)lens[i]);
+            goto done;
+        }
+    }
+
+    ret = 1;
+
+ done:
+    OPENSSL_free(data);
+    OPENSSL_free(out);
+    return ret;
+}
+
 void register_tests(void)
 {
     ADD_TEST(test_EVP_DigestSignInit);
@@ -355,4 +420,6 @@ void register_tests(void)
 #ifndef OPENSSL_NO_EC
     ADD_TEST(test_EVP_PKCS82PKEY);
 #endif
+    ADD_ALL_TESTS(test_EVP_DigestBatch,
+                  sizeof(batch_digests) / sizeof(batch_digests[0]));
 }
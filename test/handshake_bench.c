@@ -0,0 +1,496 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Handshake throughput benchmark. Drives complete TLS handshakes between a
+ * client and a server SSL object connected through memory BIOs, in one or
+ * more threads sharing the same pair of SSL_CTXs, and reports handshakes per
+ * second together with the CPU time spent on each side of the connection.
+ *
+ * Usage: handshake_bench [-threads n] [-time secs] [-count n] certsdir
+ *                        [scenario...]
+ *
+ * Every thread performs at least "-count" handshakes per scenario, 1 by
+ * default.  The test recipe uses "-time 0" with a small count to make sure
+ * the scenarios, including repeated resumption, keep working.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "e_os.h"
+#if defined(_WIN32)
+# include <windows.h>
+#elif defined(OPENSSL_SYS_UNIX)
+# include <sys/time.h>
+#endif
+
+#include <openssl/crypto.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "ssltestlib.h"
+#include "testutil.h"
+
+#define HS_FULL             0
+#define HS_RESUME_ID        1
+#define HS_RESUME_TICKET    2
+#define HS_EARLY_DATA       3
+
+#define MAX_THREADS         256
+
+typedef struct {
+    const char *name;
+    int version;
+    int mode;
+    const char *cert;
+    const char *key;
+    /* Groups to offer, or NULL for the library default */
+    const char *groups;
+} SCENARIO;
+
+static const SCENARIO scenarios[] = {
+#ifndef OPENSSL_NO_TLS1_2
+    {"tls12-rsa-full", TLS1_2_VERSION, HS_FULL,
+     "servercert.pem", "serverkey.pem", NULL},
+    {"tls12-rsa-resume", TLS1_2_VERSION, HS_RESUME_ID,
+     "servercert.pem", "serverkey.pem", NULL},
+    {"tls12-rsa-ticket", TLS1_2_VERSION, HS_RESUME_TICKET,
+     "servercert.pem", "serverkey.pem", NULL},
+# ifndef OPENSSL_NO_EC
+    {"tls12-ecdsa-full", TLS1_2_VERSION, HS_FULL,
+     "server-ecdsa-cert.pem", "server-ecdsa-key.pem", NULL},
+# endif
+#endif
+#ifndef OPENSSL_NO_TLS1_3
+    {"tls13-rsa-full", TLS1_3_VERSION, HS_FULL,
+     "servercert.pem", "serverkey.pem", NULL},
+# ifndef OPENSSL_NO_EC
+    {"tls13-ecdsa-full", TLS1_3_VERSION, HS_FULL,
+     "server-ecdsa-cert.pem", "server-ecdsa-key.pem", NULL},
+    {"tls13-ed25519-full", TLS1_3_VERSION, HS_FULL,
+     "server-ed25519-cert.pem", "server-ed25519-key.pem", NULL},
+    {"tls13-rsa-p256", TLS1_3_VERSION, HS_FULL,
+     "servercert.pem", "serverkey.pem", "P-256"},
+    {"tls13-rsa-p384", TLS1_3_VERSION, HS_FULL,
+     "servercert.pem", "serverkey.pem", "P-384"},
+    {"tls13-rsa-p521", TLS1_3_VERSION, HS_FULL,
+     "servercert.pem", "serverkey.pem", "P-521"},
+# endif
+    {"tls13-rsa-psk", TLS1_3_VERSION, HS_RESUME_TICKET,
+     "servercert.pem", "serverkey.pem", NULL},
+    {"tls13-rsa-0rtt", TLS1_3_VERSION, HS_EARLY_DATA,
+     "servercert.pem", "serverkey.pem", NULL},
+#endif
+};
+
+static const char *certsdir = NULL;
+static double seconds = 3.0;
+static long mincount = 1;
+static int nthreads = 1;
+static size_t selected[OSSL_NELEM(scenarios)];
+static size_t num_selected = 0;
+
+typedef struct {
+    SSL_CTX *sctx;
+    SSL_CTX *cctx;
+    const SCENARIO *scenario;
+    long count;
+    double client_cpu;
+    double server_cpu;
+    int ok;
+} THREAD_DATA;
+
+#if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
+
+typedef unsigned int thread_t;
+
+static int run_thread(thread_t *t, void (*f)(THREAD_DATA *), THREAD_DATA *td)
+{
+    f(td);
+    return 1;
+}
+
+static int wait_for_thread(thread_t thread)
+{
+    return 1;
+}
+
+#elif defined(OPENSSL_SYS_WINDOWS)
+
+typedef HANDLE thread_t;
+
+static void (*thread_func)(THREAD_DATA *);
+
+static DWORD WINAPI thread_run(LPVOID arg)
+{
+    thread_func((THREAD_DATA *)arg);
+    return 0;
+}
+
+static int run_thread(thread_t *t, void (*f)(THREAD_DATA *), THREAD_DATA *td)
+{
+    thread_func = f;
+    *t = CreateThread(NULL, 0, thread_run, td, 0, NULL);
+    return *t != NULL;
+}
+
+static int wait_for_thread(thread_t thread)
+{
+    return WaitForSingleObject(thread, INFINITE) == 0;
+}
+
+#else
+
+typedef pthread_t thread_t;
+
+static void (*thread_func)(THREAD_DATA *);
+
+static void *thread_run(void *arg)
+{
+    thread_func((THREAD_DATA *)arg);
+    return NULL;
+}
+
+static int run_thread(thread_t *t, void (*f)(THREAD_DATA *), THREAD_DATA *td)
+{
+    thread_func = f;
+    return pthread_create(t, NULL, thread_run, td) == 0;
+}
+
+static int wait_for_thread(thread_t thread)
+{
+    return pthread_join(thread, NULL) == 0;
+}
+
+#endif
+
+/* Wall clock time in seconds */
+static double wall_time(void)
+{
+#if defined(_WIN32)
+    return GetTickCount() / 1000.0;
+#elif defined(OPENSSL_SYS_UNIX)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/*
+ * CPU time used by the calling thread in seconds. Where there is no way to
+ * get at the per-thread figure the process time is used instead, which is
+ * only meaningful when running a single thread.
+ */
+static double cpu_time(void)
+{
+#if defined(_WIN32)
+    FILETIME created, exited, kernel, user;
+
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+        return 0;
+    return ((((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime)
+            + (((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime))
+           / 1e7;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * Step one side of the handshake, charging the CPU time it takes to |*cpu|.
+ * Returns 1 when that side has finished, 0 when it needs more data from the
+ * peer and -1 on error.
+ */
+static int handshake_step(SSL *s, int (*step)(SSL *), double *cpu)
+{
+    double start = cpu_time();
+    int ret = step(s);
+
+    *cpu += cpu_time() - start;
+    if (ret > 0)
+        return 1;
+    return SSL_get_error(s, ret) == SSL_ERROR_WANT_READ ? 0 : -1;
+}
+
+static int early_data_step(SSL *s, double *cpu, int *finished)
+{
+    unsigned char buf[64];
+    size_t readbytes;
+    double start = cpu_time();
+    int ret = SSL_read_early_data(s, buf, sizeof(buf), &readbytes);
+
+    *cpu += cpu_time() - start;
+    switch (ret) {
+    case SSL_READ_EARLY_DATA_FINISH:
+        *finished = 1;
+        return 0;
+    case SSL_READ_EARLY_DATA_SUCCESS:
+        return 0;
+    default:
+        return SSL_get_error(s, 0) == SSL_ERROR_WANT_READ ? 0 : -1;
+    }
+}
+
+/*
+ * Perform one handshake, resuming |sess| if it is not NULL. On success
+ * returns 1 and, when |newsess| is not NULL, the client's session.
+ */
+static int one_handshake(THREAD_DATA *td, SSL_SESSION *sess,
+                         SSL_SESSION **newsess)
+{
+    static const unsigned char msg[] = "early";
+    SSL *sssl = NULL, *cssl = NULL;
+    int cdone = 0, sdone = 0, early = 0, early_finished = 0, loops = 0;
+    int r, ret = 0;
+    unsigned char buf;
+    size_t written;
+
+    if (!create_ssl_objects(td->sctx, td->cctx, &sssl, &cssl, NULL, NULL))
+        goto end;
+    if (sess != NULL) {
+        if (!SSL_set_session(cssl, sess))
+            goto end;
+        early = td->scenario->mode == HS_EARLY_DATA;
+    }
+
+    if (early) {
+        double start = cpu_time();
+        int ok = SSL_write_early_data(cssl, msg, sizeof(msg), &written);
+
+        td->client_cpu += cpu_time() - start;
+        if (!ok)
+            goto end;
+    }
+
+    while (!cdone || !sdone) {
+        if (!cdone) {
+            if ((r = handshake_step(cssl, SSL_connect, &td->client_cpu)) < 0)
+                goto end;
+            cdone = r;
+        }
+        if (!sdone) {
+            if (early && !early_finished)
+                r = early_data_step(sssl, &td->server_cpu, &early_finished);
+            else
+                r = handshake_step(sssl, SSL_accept, &td->server_cpu);
+            if (r < 0)
+                goto end;
+            sdone = r;
+        }
+        if (++loops > 50)
+            goto end;
+    }
+
+    /* Pick up any NewSessionTicket sent after a TLSv1.3 handshake */
+    if (SSL_version(cssl) == TLS1_3_VERSION) {
+        double start = cpu_time();
+
+        /* There is no application data, only the ticket to process */
+        r = SSL_read(cssl, &buf, sizeof(buf));
+        td->client_cpu += cpu_time() - start;
+        if (r > 0 || SSL_get_error(cssl, r) != SSL_ERROR_WANT_READ)
+            goto end;
+    }
+
+    if (sess != NULL && !SSL_session_reused(cssl))
+        goto end;
+    if (early && SSL_get_early_data_status(sssl) != SSL_EARLY_DATA_ACCEPTED)
+        goto end;
+
+    if (newsess != NULL && (*newsess = SSL_get1_session(cssl)) == NULL)
+        goto end;
+
+    /* Without a clean shutdown the session would not be resumable */
+    SSL_shutdown(cssl);
+    SSL_shutdown(sssl);
+    ret = 1;
+ end:
+    SSL_free(sssl);
+    SSL_free(cssl);
+    return ret;
+}
+
+static void bench_thread(THREAD_DATA *td)
+{
+    SSL_SESSION *sess = NULL, *newsess = NULL;
+    double start;
+
+    /* Establish the session to resume outside of the measurement */
+    if (td->scenario->mode != HS_FULL
+            && !one_handshake(td, NULL, &sess))
+        return;
+
+    td->client_cpu = td->server_cpu = 0;
+    start = wall_time();
+    do {
+        /* A TLSv1.3 PSK can only be used once, so resume the new session */
+        if (!one_handshake(td, sess, sess != NULL ? &newsess : NULL))
+            goto end;
+        if (newsess != NULL) {
+            SSL_SESSION_free(sess);
+            sess = newsess;
+            newsess = NULL;
+        }
+        td->count++;
+    } while (td->count < mincount || wall_time() - start < seconds);
+
+    td->ok = 1;
+ end:
+    SSL_SESSION_free(sess);
+    OPENSSL_thread_stop();
+}
+
+static int setup_ctxs(const SCENARIO *sc, SSL_CTX **sctx, SSL_CTX **cctx)
+{
+    char cert[1024], key[1024];
+
+    BIO_snprintf(cert, sizeof(cert), "%s/%s", certsdir, sc->cert);
+    BIO_snprintf(key, sizeof(key), "%s/%s", certsdir, sc->key);
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), sctx, cctx,
+                                       cert, key))
+            || !TEST_true(SSL_CTX_set_min_proto_version(*cctx, sc->version))
+            || !TEST_true(SSL_CTX_set_max_proto_version(*cctx, sc->version)))
+        return 0;
+
+    if (sc->groups != NULL
+            && !TEST_true(SSL_CTX_set1_groups_list(*cctx, sc->groups)))
+        return 0;
+
+    switch (sc->mode) {
+    case HS_FULL:
+        SSL_CTX_set_session_cache_mode(*sctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(*sctx, SSL_OP_NO_TICKET);
+        break;
+    case HS_RESUME_ID:
+        SSL_CTX_set_options(*sctx, SSL_OP_NO_TICKET);
+        break;
+    case HS_RESUME_TICKET:
+    case HS_EARLY_DATA:
+        SSL_CTX_set_session_cache_mode(*sctx, SSL_SESS_CACHE_OFF);
+        break;
+    }
+    return 1;
+}
+
+static int test_handshake_bench(int idx)
+{
+    const SCENARIO *sc = &scenarios[selected[idx]];
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    THREAD_DATA *td = NULL;
+    thread_t *t = NULL;
+    double start, elapsed, client_cpu = 0, server_cpu = 0;
+    long count = 0;
+    int i, started = 0, ret = 0;
+
+    if (!TEST_true(setup_ctxs(sc, &sctx, &cctx))
+            || !TEST_ptr(td = OPENSSL_zalloc(sizeof(*td) * nthreads))
+            || !TEST_ptr(t = OPENSSL_zalloc(sizeof(*t) * nthreads)))
+        goto end;
+
+    start = wall_time();
+    for (i = 0; i < nthreads; i++, started++) {
+        td[i].sctx = sctx;
+        td[i].cctx = cctx;
+        td[i].scenario = sc;
+        if (!TEST_true(run_thread(&t[i], bench_thread, &td[i])))
+            break;
+    }
+    for (i = 0; i < started; i++)
+        wait_for_thread(t[i]);
+    elapsed = wall_time() - start;
+    if (started != nthreads)
+        goto end;
+
+    for (i = 0; i < nthreads; i++) {
+        if (!TEST_true(td[i].ok)) {
+            TEST_info("%s: handshake failed in thread %d", sc->name, i);
+            goto end;
+        }
+        count += td[i].count;
+        client_cpu += td[i].client_cpu;
+        server_cpu += td[i].server_cpu;
+    }
+    if (elapsed <= 0)
+        elapsed = 1e-3;
+
+    TEST_note("%-20s %10.1f handshakes/s  client %8.1fus  server %8.1fus"
+              "  (%ld in %.2fs, %d threads)", sc->name, count / elapsed,
+              client_cpu * 1e6 / count, server_cpu * 1e6 / count, count,
+              elapsed, nthreads);
+    ret = 1;
+ end:
+    OPENSSL_free(td);
+    OPENSSL_free(t);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return ret;
+}
+
+int test_main(int argc, char *argv[])
+{
+    size_t n;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+            if (nthreads < 1 || nthreads > MAX_THREADS) {
+                TEST_error("Bad thread count %s", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-time") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-count") == 0 && i + 1 < argc) {
+            mincount = atol(argv[++i]);
+            if (mincount < 1) {
+                TEST_error("Bad handshake count %s", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            TEST_error("Unknown option %s", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (i == argc) {
+        TEST_error("Usage: %s [-threads n] [-time secs] [-count n] "
+                   "certsdir [scenario...]", argv[0]);
+        return EXIT_FAILURE;
+    }
+    certsdir = argv[i++];
+
+    if (i == argc) {
+        for (n = 0; n < OSSL_NELEM(scenarios); n++)
+            selected[num_selected++] = n;
+    }
+    for (; i < argc; i++) {
+        for (n = 0; n < OSSL_NELEM(scenarios); n++)
+            if (strcmp(argv[i], scenarios[n].name) == 0)
+                break;
+        if (n == OSSL_NELEM(scenarios)) {
+            TEST_error("Unknown scenario %s", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (num_selected < OSSL_NELEM(scenarios))
+            selected[num_selected++] = n;
+    }
+
+    ADD_ALL_TESTS(test_handshake_bench, (int)num_selected);
+    return run_tests(argv[0]);
+}
@@ -0,0 +1,22 @@
+#! /usr/bin/env perl
+# Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+
+use OpenSSL::Test qw/:DEFAULT srctop_file/;
+use OpenSSL::Test::Utils;
+
+setup("test_asn1_alloc");
+
+plan tests => 1;
+
+my @files = (srctop_file("test", "certs", "leaf.pem"),
+             srctop_file("test", "testcrl.pem"));
+push @files, srctop_file("test", "ocsp-tests", "ND1.ors")
+    unless disabled("ocsp");
+
+ok(run(test(["asn1_alloc_test", @files])));
@@ -7,13 +7,20 @@
 # https://www.openssl.org/source/license.html
 
 
-use OpenSSL::Test qw/:DEFAULT srctop_file/;
+use File::Path qw/rmtree mkpath/;
+use OpenSSL::Test qw/:DEFAULT srctop_file srctop_dir/;
 
 setup("test_verify_extra");
 
 plan tests => 1;
 
+my $hashdir = "hashdir";
+rmtree($hashdir, { safe => 0 });
+mkpath($hashdir);
+
 ok(run(test(["verify_extra_test",
              srctop_file("test", "certs", "roots.pem"),
              srctop_file("test", "certs", "untrusted.pem"),
-             srctop_file("test", "certs", "bad.pem")])));
+             srctop_file("test", "certs", "bad.pem"),
+             srctop_dir("test", "certs"),
+             $hashdir])));
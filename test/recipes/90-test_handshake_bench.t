@@ -0,0 +1,24 @@
+#! /usr/bin/env perl
+# Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+
+use OpenSSL::Test::Utils;
+use OpenSSL::Test qw/:DEFAULT srctop_dir/;
+
+setup("test_handshake_bench");
+
+plan skip_all => "No TLS/SSL protocols are supported by this OpenSSL build"
+    if alldisabled(grep { $_ ne "ssl3" } available_protocols("tls"));
+
+plan tests => 1;
+
+# Three handshakes per scenario and thread, so that the resumption scenarios
+# resume at least twice, just to check that every scenario still completes;
+# run the program by hand for real measurements.
+ok(run(test(["handshake_bench", "-threads", "2", "-time", "0", "-count", "3",
+             srctop_dir("test", "certs")])), "running handshake_bench");
@@ -14,11 +14,19 @@
 #include <openssl/crypto.h>
 #include <openssl/ssl.h>
 #include <openssl/ocsp.h>
+#include <openssl/rand.h>
 
 #include "ssltestlib.h"
 #include "testutil.h"
 #include "e_os.h"
 #include "../ssl/ssl_locl.h"
+#include "internal/ktls.h"
+
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
 
 static char *cert = NULL;
 static char *privkey = NULL;
@@ -761,6 +769,7 @@ typedef struct ssl_session_test_fixture {
     const char *test_case_name;
     int use_ext_cache;
     int use_int_cache;
+    int use_sharded_cache;
 } SSL_SESSION_TEST_FIXTURE;
 
 static int new_called = 0, remove_called = 0;
@@ -773,6 +782,7 @@ ssl_session_set_up(const char *const test_case_name)
     fixture.test_case_name = test_case_name;
     fixture.use_ext_cache = 1;
     fixture.use_int_cache = 1;
+    fixture.use_sharded_cache = 0;
 
     new_called = remove_called = 0;
 
@@ -822,7 +832,9 @@ static int execute_test_session(SSL_SESSION_TEST_FIXTURE fix)
     }
     if (fix.use_int_cache) {
         /* Also covers instance where both are set */
-        SSL_CTX_set_session_cache_mode(cctx, SSL_SESS_CACHE_CLIENT);
+        SSL_CTX_set_session_cache_mode(cctx, SSL_SESS_CACHE_CLIENT
+                                             | (fix.use_sharded_cache
+                                                ? SSL_SESS_CACHE_SHARDED : 0));
     } else {
         SSL_CTX_set_session_cache_mode(cctx,
                                        SSL_SESS_CACHE_CLIENT
@@ -953,6 +965,287 @@ static int test_session_with_both_cache(void)
     EXECUTE_TEST(execute_test_session, ssl_session_tear_down);
 }
 
+static int test_session_with_sharded_cache(void)
+{
+    SETUP_TEST_FIXTURE(SSL_SESSION_TEST_FIXTURE, ssl_session_set_up);
+    fixture.use_sharded_cache = 1;
+    EXECUTE_TEST(execute_test_session, ssl_session_tear_down);
+}
+
+#define SHARDED_CACHE_SIZE      32
+#define SHARDED_CACHE_SESSIONS  256
+
+/*
+ * Check the size limit, lookup and expiry of the sharded internal session
+ * cache directly, without running any handshakes.
+ */
+static int test_sharded_session_cache(void)
+{
+    SSL_CTX *ctx = NULL;
+    SSL *ssl = NULL;
+    SSL_SESSION *sess = NULL;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    long now = (long)time(NULL);
+    int i, version, testresult = 0;
+
+    if (!TEST_ptr(ctx = SSL_CTX_new(TLS_server_method())))
+        return 0;
+
+    SSL_CTX_sess_set_cache_size(ctx, SHARDED_CACHE_SIZE);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER
+                                        | SSL_SESS_CACHE_SHARDED);
+    if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(ctx),
+                      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_SHARDED)
+            || !TEST_ptr(ssl = SSL_new(ctx)))
+        goto end;
+
+    version = SSL_version(ssl);
+    for (i = 0; i < SHARDED_CACHE_SESSIONS; i++) {
+        if (!TEST_ptr(sess = SSL_SESSION_new())
+                || !TEST_true(RAND_bytes(id, sizeof(id)))
+                || !TEST_true(SSL_SESSION_set1_id(sess, id, sizeof(id)))
+                || !TEST_true(SSL_SESSION_set_protocol_version(sess, version)))
+            goto end;
+        if (!TEST_true(SSL_SESSION_set_time(sess, now))
+                || !TEST_true(SSL_SESSION_set_timeout(sess, 100))
+                || !TEST_true(SSL_CTX_add_session(ctx, sess)))
+            goto end;
+        SSL_SESSION_free(sess);
+        sess = NULL;
+    }
+
+    /* Each shard is limited to its share of the total cache size */
+    if (!TEST_long_gt(SSL_CTX_sess_number(ctx), 0)
+            || !TEST_long_le(SSL_CTX_sess_number(ctx), SHARDED_CACHE_SIZE)
+            || !TEST_long_eq(SSL_CTX_sess_number(ctx)
+                             + SSL_CTX_sess_cache_full(ctx),
+                             SHARDED_CACHE_SESSIONS))
+        goto end;
+
+    /* The most recently added session must still be there */
+    if (!TEST_true(SSL_has_matching_session_id(ssl, id, sizeof(id))))
+        goto end;
+
+    /* Nothing has expired yet */
+    SSL_CTX_flush_sessions(ctx, now);
+    if (!TEST_long_gt(SSL_CTX_sess_number(ctx), 0))
+        goto end;
+
+    /* Everything has expired */
+    SSL_CTX_flush_sessions(ctx, now + 200);
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), 0)
+            || !TEST_false(SSL_has_matching_session_id(ssl, id, sizeof(id))))
+        goto end;
+
+    /* The layout can't be changed once the SSL_CTX is in use */
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(ctx),
+                      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_SHARDED))
+        goto end;
+    ERR_clear_error();
+
+    if (!TEST_ptr(sess = SSL_SESSION_new())
+            || !TEST_true(SSL_SESSION_set1_id(sess, id, sizeof(id)))
+            || !TEST_true(SSL_SESSION_set_protocol_version(sess, version))
+            || !TEST_true(SSL_CTX_add_session(ctx, sess))
+            || !TEST_long_eq(SSL_CTX_sess_number(ctx), 1))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_SESSION_free(sess);
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+
+    return testresult;
+}
+
+/*
+ * Make a TLSv1.2 connection, resuming |sess| if it isn't NULL, and return the
+ * session the client ended up with in |*newsess|.
+ */
+static int ticket_connection(SSL_CTX *sctx, SSL_CTX *cctx, SSL_SESSION *sess,
+                             SSL_SESSION **newsess, int *reused)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    int ret = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || (sess != NULL && !TEST_true(SSL_set_session(clientssl, sess)))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(*newsess = SSL_get1_session(clientssl)))
+        goto end;
+    *reused = SSL_session_reused(clientssl);
+    ret = 1;
+
+ end:
+    if (serverssl != NULL)
+        shutdown_ssl_connection(serverssl, clientssl);
+    return ret;
+}
+
+/*
+ * Check that tickets issued under a session ticket key keep working, and
+ * get renewed, after it has been rotated out, until it drops off the end of
+ * the key ring.
+ */
+static int test_ticket_key_rotation(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL_SESSION *sess = NULL, *sess2 = NULL;
+    unsigned char keys[80], keys2[80];
+    const unsigned char *tick, *tick2;
+    size_t ticklen, ticklen2;
+    int i, reused, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_max_proto_version(cctx, TLS1_2_VERSION)))
+        goto end;
+    /* Resumption must come from the ticket, not the server's cache */
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_OFF);
+
+    /* Keys can be set and read back */
+    if (!TEST_long_eq(SSL_CTX_get_tlsext_ticket_keys(sctx, NULL, 0),
+                      sizeof(keys))
+            || !TEST_int_eq(RAND_bytes(keys, sizeof(keys)), 1)
+            || !TEST_true(SSL_CTX_set_tlsext_ticket_keys(sctx, keys,
+                                                         sizeof(keys)))
+            || !TEST_true(SSL_CTX_get_tlsext_ticket_keys(sctx, keys2,
+                                                         sizeof(keys2)))
+            || !TEST_mem_eq(keys, sizeof(keys), keys2, sizeof(keys2))
+            || !TEST_false(SSL_CTX_set_max_tlsext_ticket_keys(sctx, 0))
+            || !TEST_false(SSL_CTX_set_max_tlsext_ticket_keys(sctx,
+                                                 TLSEXT_MAX_TICKET_KEYS + 1))
+            || !TEST_true(SSL_CTX_set_max_tlsext_ticket_keys(sctx, 3)))
+        goto end;
+
+    if (!TEST_true(ticket_connection(sctx, cctx, NULL, &sess, &reused))
+            || !TEST_false(reused))
+        goto end;
+
+    /* Rotating in a random key changes the current key */
+    if (!TEST_true(SSL_CTX_rotate_tlsext_ticket_keys(sctx, NULL, 0))
+            || !TEST_true(SSL_CTX_get_tlsext_ticket_keys(sctx, keys2,
+                                                         sizeof(keys2)))
+            || !TEST_mem_ne(keys, sizeof(keys), keys2, sizeof(keys2)))
+        goto end;
+
+    /* The old key still decrypts, and the ticket is reissued under the new */
+    SSL_SESSION_get0_ticket(sess, &tick, &ticklen);
+    if (!TEST_true(ticket_connection(sctx, cctx, sess, &sess2, &reused))
+            || !TEST_true(reused))
+        goto end;
+    SSL_SESSION_get0_ticket(sess2, &tick2, &ticklen2);
+    if (!TEST_mem_ne(tick, ticklen, tick2, ticklen2))
+        goto end;
+    SSL_SESSION_free(sess2);
+    sess2 = NULL;
+
+    /* Two more rotations push the original key out of a ring of three */
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(SSL_CTX_rotate_tlsext_ticket_keys(sctx, NULL, 0)))
+            goto end;
+    }
+    if (!TEST_true(ticket_connection(sctx, cctx, sess, &sess2, &reused))
+            || !TEST_false(reused))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(sess2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#if defined(OPENSSL_SYS_UNIX)
+/*
+ * Check that a session established in a child process can be resumed by
+ * the parent through the shared session cache, and no longer once removed.
+ */
+static int test_shared_session_cache(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL_SESSION *sess = NULL, *sess2 = NULL;
+    unsigned char buf[4096], *p;
+    const unsigned char *q;
+    int fds[2] = { -1, -1 }, status, len = 0, reused, testresult = 0;
+    pid_t pid;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_max_proto_version(cctx, TLS1_2_VERSION))
+            || !TEST_true(SSL_CTX_set_shared_session_cache(sctx, 64))
+            || !TEST_int_eq(pipe(fds), 0))
+        goto end;
+    /* Resumption must come from the shared cache, not a ticket */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER
+                                         | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+    if ((pid = fork()) == 0) {
+        /* Hand the client's session over to the parent */
+        if (ticket_connection(sctx, cctx, NULL, &sess, &reused)
+                && (len = i2d_SSL_SESSION(sess, NULL)) > 0
+                && len <= (int)sizeof(buf)) {
+            p = buf;
+            if (i2d_SSL_SESSION(sess, &p) == len
+                    && write(fds[1], buf, len) == len)
+                _exit(EXIT_SUCCESS);
+        }
+        _exit(EXIT_FAILURE);
+    }
+    close(fds[1]);
+    fds[1] = -1;
+
+    if (!TEST_int_gt(pid, 0)
+            || !TEST_int_eq(waitpid(pid, &status, 0), pid)
+            || !TEST_true(WIFEXITED(status))
+            || !TEST_int_eq(WEXITSTATUS(status), EXIT_SUCCESS)
+            || !TEST_int_gt(len = read(fds[0], buf, sizeof(buf)), 0))
+        goto end;
+    q = buf;
+    if (!TEST_ptr(sess = d2i_SSL_SESSION(NULL, &q, len)))
+        goto end;
+
+    if (!TEST_true(ticket_connection(sctx, cctx, sess, &sess2, &reused))
+            || !TEST_true(reused)
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), 0))
+        goto end;
+    SSL_SESSION_free(sess2);
+    sess2 = NULL;
+
+    /* Once removed it can't be resumed by any process */
+    SSL_CTX_remove_session(sctx, sess);
+    if (!TEST_true(ticket_connection(sctx, cctx, sess, &sess2, &reused))
+            || !TEST_false(reused))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    if (fds[0] != -1)
+        close(fds[0]);
+    if (fds[1] != -1)
+        close(fds[1]);
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(sess2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
 #define USE_NULL    0
 #define USE_BIO_1   1
 #define USE_BIO_2   2
@@ -2613,6 +2906,676 @@ static int test_export_key_mat(int tst)
     return testresult;
 }
 
+#ifndef OPENSSL_NO_TLS1_3
+static struct {
+    const char *cipher;
+    size_t max_send_fragment;
+    int partial;
+} bulk_write_tests[] = {
+    { "TLS13-AES-128-GCM-SHA256", SSL3_RT_MAX_PLAIN_LENGTH, 0 },
+    { "TLS13-AES-256-GCM-SHA384", 4096, 1 },
+# if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    { "TLS13-CHACHA20-POLY1305-SHA256", SSL3_RT_MAX_PLAIN_LENGTH, 0 },
+# endif
+};
+
+static int bulk_writes = 0;
+
+static long bulk_write_cb(BIO *b, int oper, const char *argp, int argi,
+                          long argl, long ret)
+{
+    if (oper == BIO_CB_WRITE)
+        bulk_writes++;
+    return ret;
+}
+
+/*
+ * Large TLSv1.3 writes are split into batches of several full records,
+ * encrypted and written together. Check that they go out in fewer writes
+ * than records, that each record is framed as usual, and that the data
+ * survives intact.
+ */
+static int test_tls13_bulk_write(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *in = NULL, *out = NULL, *wire;
+    size_t frag = bulk_write_tests[tst].max_send_fragment;
+    /* Enough for a couple of batches plus a partial record */
+    size_t len = 18 * frag + 1000, sent = 0, recvd = 0, n;
+    size_t nrecs = len / frag + 1, reclen, i;
+    long wirelen;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                            bulk_write_tests[tst].cipher))
+            || !TEST_true(SSL_CTX_set_max_send_fragment(sctx, (long)frag)))
+        goto end;
+    if (bulk_write_tests[tst].partial)
+        SSL_CTX_set_mode(sctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_int_eq(SSL_version(serverssl), TLS1_3_VERSION))
+        goto end;
+
+    if (!TEST_ptr(in = OPENSSL_malloc(len))
+            || !TEST_ptr(out = OPENSSL_malloc(len))
+            || !TEST_int_eq(RAND_bytes(in, (int)len), 1))
+        goto end;
+
+    bulk_writes = 0;
+    BIO_set_callback(SSL_get_wbio(serverssl), bulk_write_cb);
+    while (sent < len) {
+        if (!TEST_true(SSL_write_ex(serverssl, in + sent, len - sent, &n)))
+            goto end;
+        sent += n;
+    }
+    BIO_set_callback(SSL_get_wbio(serverssl), NULL);
+    if (!TEST_int_lt(bulk_writes, (int)nrecs / 2))
+        goto end;
+
+    /* The batch buffer isn't kept once the write is done */
+    if (!TEST_size_t_lt(serverssl->rlayer.wbuf[0].len, 4 * frag))
+        goto end;
+
+    /* Every record, batched or not, has its own header and tag */
+    wirelen = BIO_get_mem_data(SSL_get_wbio(serverssl), (char **)&wire);
+    for (i = 0; i < nrecs; i++) {
+        reclen = (i < nrecs - 1 ? frag : len % frag) + 1 + EVP_GCM_TLS_TAG_LEN;
+        if (!TEST_long_ge(wirelen, (long)(SSL3_RT_HEADER_LENGTH + reclen))
+                || !TEST_int_eq(wire[0], SSL3_RT_APPLICATION_DATA)
+                || !TEST_size_t_eq((size_t)((wire[3] << 8) | wire[4]), reclen))
+            goto end;
+        wire += SSL3_RT_HEADER_LENGTH + reclen;
+        wirelen -= (long)(SSL3_RT_HEADER_LENGTH + reclen);
+    }
+    if (!TEST_long_eq(wirelen, 0))
+        goto end;
+
+    while (recvd < len) {
+        if (!TEST_true(SSL_read_ex(clientssl, out + recvd, len - recvd, &n)))
+            goto end;
+        recvd += n;
+    }
+    if (!TEST_mem_eq(in, len, out, recvd))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    OPENSSL_free(in);
+    OPENSSL_free(out);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
+/*
+ * A CBC ciphersuite that is MACed then encrypted by the record layer, rather
+ * than by a stitched AES-NI cipher, once Encrypt-then-MAC is turned off
+ */
+#ifndef OPENSSL_NO_CAMELLIA
+# define WRITEV_MTE_CIPHER  "CAMELLIA128-SHA"
+#else
+# define WRITEV_MTE_CIPHER  "AES128-SHA"
+#endif
+
+/*
+ * Test that SSL_writev_ex() sends the iovecs in order and in full
+ * Test 0: TLS, with enough data for several records
+ * Test 1: TLSv1.2 with a CBC ciphersuite
+ * Test 2: TLSv1.2 with a CBC ciphersuite and MAC-then-encrypt
+ * Test 3: DTLS, where it all has to fit in a single record
+ * Test 4: DTLS with a CBC ciphersuite and MAC-then-encrypt
+ */
+static int test_writev(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    SSL_IOVEC iov[5];
+    /* A small header, an empty element, the body and a trailer */
+    size_t lens[OSSL_NELEM(iov)] = { 13, 0, 0, 0, 7 };
+    unsigned char *in = NULL, *out = NULL;
+    size_t len = 0, recvd = 0, n;
+    int testresult = 0;
+    size_t i;
+
+    if (tst >= 3) {
+#ifndef OPENSSL_NO_DTLS
+        if (!TEST_true(create_ssl_ctx_pair(DTLS_server_method(),
+                                           DTLS_client_method(), &sctx,
+                                           &cctx, cert, privkey)))
+            goto end;
+#endif
+        lens[2] = 1000;
+        lens[3] = 3001;
+    } else {
+        if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                           TLS_client_method(), &sctx,
+                                           &cctx, cert, privkey)))
+            goto end;
+        if (tst == 1
+                && (!TEST_true(SSL_CTX_set_max_proto_version(cctx,
+                                                             TLS1_2_VERSION))
+                    || !TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                                          "AES128-SHA"))))
+            goto end;
+        if (tst == 2
+                && !TEST_true(SSL_CTX_set_max_proto_version(cctx,
+                                                            TLS1_2_VERSION)))
+            goto end;
+        lens[2] = 40000;
+        lens[3] = 33333;
+    }
+    if ((tst == 2 || tst == 4)
+            && (!TEST_true(SSL_CTX_set_cipher_list(sctx, WRITEV_MTE_CIPHER))
+                || !TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                                      WRITEV_MTE_CIPHER))))
+        goto end;
+    /* The record is MACed from its input, which is gathered for writev */
+    if (tst == 2 || tst == 4) {
+        SSL_CTX_set_options(sctx, SSL_OP_NO_ENCRYPT_THEN_MAC);
+        SSL_CTX_set_options(cctx, SSL_OP_NO_ENCRYPT_THEN_MAC);
+    }
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+    if ((tst == 2 || tst == 4)
+            && !TEST_str_eq(SSL_get_cipher(serverssl), WRITEV_MTE_CIPHER))
+        goto end;
+
+    for (i = 0; i < OSSL_NELEM(lens); i++)
+        len += lens[i];
+    if (!TEST_ptr(in = OPENSSL_malloc(len))
+            || !TEST_ptr(out = OPENSSL_malloc(len))
+            || !TEST_int_eq(RAND_bytes(in, (int)len), 1))
+        goto end;
+    for (i = 0, n = 0; i < OSSL_NELEM(iov); n += lens[i++]) {
+        iov[i].iov_base = in + n;
+        iov[i].iov_len = lens[i];
+    }
+
+    if (!TEST_true(SSL_writev_ex(serverssl, iov, OSSL_NELEM(iov), &n))
+            || !TEST_size_t_eq(n, len))
+        goto end;
+
+    while (recvd < len) {
+        if (!TEST_true(SSL_read_ex(clientssl, out + recvd, len - recvd, &n)))
+            goto end;
+        recvd += n;
+    }
+    if (!TEST_mem_eq(in, len, out, recvd))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    OPENSSL_free(in);
+    OPENSSL_free(out);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#define BATCH_FRAG      1024
+#define BATCH_RECS      8
+
+/*
+ * Test that with max_pipelines set the records waiting in the read buffer are
+ * all decrypted and returned together, even by a cipher without pipelining
+ * support.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ * Test 2: TLSv1.3 with a KeyUpdate in the middle of the records
+ */
+static int test_read_batch(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char in[BATCH_RECS * BATCH_FRAG], out[sizeof(in)];
+    size_t half = sizeof(in) / 2, n;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst > 0)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_max_send_fragment(sctx, BATCH_FRAG))
+            || !TEST_true(SSL_CTX_set_max_pipelines(cctx, BATCH_RECS)))
+        goto end;
+    if (tst == 0
+            && !TEST_true(SSL_CTX_set_max_proto_version(cctx, TLS1_2_VERSION)))
+        goto end;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_int_eq(RAND_bytes(in, sizeof(in)), 1))
+        goto end;
+
+    if (tst == 2) {
+        if (!TEST_true(SSL_write_ex(serverssl, in, half, &n))
+                || !TEST_true(SSL_key_update(serverssl,
+                                             SSL_KEY_UPDATE_NOT_REQUESTED))
+                || !TEST_true(SSL_write_ex(serverssl, in + half, half, &n))
+                /* The batch stops after the KeyUpdate */
+                || !TEST_true(SSL_read_ex(clientssl, out, sizeof(out), &n))
+                || !TEST_size_t_eq(n, half)
+                || !TEST_true(SSL_read_ex(clientssl, out + half, half, &n))
+                || !TEST_size_t_eq(n, half))
+            goto end;
+    } else {
+        /* Every record should come back from a single read */
+        if (!TEST_true(SSL_write_ex(serverssl, in, sizeof(in), &n))
+                || !TEST_true(SSL_read_ex(clientssl, out, sizeof(out), &n))
+                || !TEST_size_t_eq(n, sizeof(in)))
+            goto end;
+    }
+    if (!TEST_mem_eq(in, sizeof(in), out, sizeof(out)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test that SSLs with SSL_MODE_RELEASE_BUFFERS give their buffers back to the
+ * SSL_CTX buffer pool when idle, and take them from there again
+ */
+static int test_buffer_pool(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    SSL *clientssl2 = NULL, *serverssl2 = NULL;
+    unsigned char buf[1024];
+    size_t n;
+    long hits;
+    int i, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey)))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_RELEASE_BUFFERS);
+    SSL_CTX_set_mode(cctx, SSL_MODE_RELEASE_BUFFERS);
+    if (!TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, 2), 0)
+            || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 2))
+        goto end;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl2,
+                                             &clientssl2, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl2, clientssl2,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    memset(buf, 'x', sizeof(buf));
+    hits = SSL_CTX_buffer_pool_hits(sctx);
+    for (i = 0; i < 4; i++) {
+        SSL *s = (i & 1) ? serverssl2 : serverssl;
+        SSL *c = (i & 1) ? clientssl2 : clientssl;
+
+        if (!TEST_true(SSL_write_ex(c, buf, sizeof(buf), &n))
+                || !TEST_true(SSL_read_ex(s, buf, sizeof(buf), &n))
+                || !TEST_true(SSL_write_ex(s, buf, sizeof(buf), &n))
+                || !TEST_true(SSL_read_ex(c, buf, sizeof(buf), &n))
+                || !TEST_size_t_eq(n, sizeof(buf)))
+            goto end;
+        /* An idle connection holds no buffers */
+        if (!TEST_ptr_null(s->rlayer.rbuf.buf)
+                || !TEST_size_t_eq(s->rlayer.numwpipes, 0))
+            goto end;
+    }
+    /* Every buffer should have come from the pool */
+    if (!TEST_long_ge(SSL_CTX_buffer_pool_hits(sctx), hits + 8)
+            || !TEST_long_gt(SSL_CTX_buffer_pool_misses(sctx), 0))
+        goto end;
+
+    /* Disabling the pool empties it */
+    if (!TEST_long_eq(SSL_CTX_set_buffer_pool_size(sctx, 0), 2)
+            || !TEST_ptr_null(sctx->buf_pool.rbuf_freelist.head)
+            || !TEST_ptr_null(sctx->buf_pool.wbuf_freelist.head))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_free(serverssl2);
+    SSL_free(clientssl2);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test that SSL_MODE_HANDSHAKE_TIMINGS records when each handshake state is
+ * entered and where the time went, and counts the handshake in the
+ * histograms of the SSL_CTX
+ */
+static int test_handshake_timings(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    const OSSL_HANDSHAKE_STATE *states;
+    const uint64_t *times;
+    uint64_t counts[SSL_HS_HISTOGRAM_BUCKETS], sum;
+    size_t num, i;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey)))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_HANDSHAKE_TIMINGS);
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL)))
+        goto end;
+    SSL_set_mode(clientssl, SSL_MODE_HANDSHAKE_TIMINGS);
+    if (!TEST_size_t_eq(SSL_get0_handshake_timings(serverssl, NULL, NULL), 0)
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    num = SSL_get0_handshake_timings(serverssl, &states, &times);
+    if (!TEST_size_t_gt(num, 2)
+            || !TEST_int_eq(states[0], TLS_ST_SR_CLNT_HELLO)
+            || !TEST_int_eq(states[num - 1], TLS_ST_OK))
+        goto end;
+    for (i = 1; i < num; i++)
+        if (!TEST_true(times[i - 1] <= times[i]))
+            goto end;
+    if (!TEST_true(SSL_get_handshake_time(serverssl, SSL_HS_TIME_TOTAL)
+                   >= times[num - 1])
+            || !TEST_true(SSL_get_handshake_time(serverssl,
+                                                 SSL_HS_TIME_KEY_EXCHANGE) > 0)
+            || !TEST_true(SSL_get_handshake_time(serverssl,
+                                                 SSL_HS_TIME_SIGN) > 0)
+            || !TEST_true(SSL_get_handshake_time(serverssl,
+                                                 SSL_HS_TIME_IO_WAIT) > 0)
+            || !TEST_true(SSL_get_handshake_time(clientssl,
+                                                 SSL_HS_TIME_CERT_VERIFY) > 0)
+            || !TEST_size_t_gt(SSL_get0_handshake_timings(clientssl, &states,
+                                                          NULL), 0)
+            || !TEST_int_eq(states[0], TLS_ST_CW_CLNT_HELLO))
+        goto end;
+
+    /* Each side counted one handshake */
+    if (!TEST_size_t_eq(SSL_CTX_get_handshake_histogram(sctx,
+                                                        SSL_HS_TIME_TOTAL,
+                                                        NULL, 0),
+                        SSL_HS_HISTOGRAM_BUCKETS)
+            || !TEST_size_t_eq(SSL_CTX_get_handshake_histogram(sctx,
+                                                        SSL_HS_TIME_NUM,
+                                                        counts,
+                                                        OSSL_NELEM(counts)),
+                               0))
+        goto end;
+    for (i = 0; i < 2; i++) {
+        if (!TEST_size_t_eq(SSL_CTX_get_handshake_histogram(i ? cctx : sctx,
+                                                        SSL_HS_TIME_TOTAL,
+                                                        counts,
+                                                        OSSL_NELEM(counts)),
+                            OSSL_NELEM(counts)))
+            goto end;
+        for (sum = 0, num = 0; num < OSSL_NELEM(counts); num++)
+            sum += counts[num];
+        if (!TEST_true(sum == 1))
+            goto end;
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#ifndef OPENSSL_NO_EC
+/*
+ * Test that servers take their ephemeral keys out of the key share pool, and
+ * never use the same one twice.
+ * Test 0: TLSv1.3
+ * Test 1: TLSv1.2
+ */
+static int test_keyshare_pool(int idx)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    EVP_PKEY *tmpkey[2] = { NULL, NULL };
+    int i, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey)))
+        goto end;
+    if (idx == 1
+            && !TEST_true(SSL_CTX_set_max_proto_version(cctx, TLS1_2_VERSION)))
+        goto end;
+
+    /* Three groups of two keys each, filled in as many steps as asked */
+    if (!TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 0), 0)
+            || !TEST_true(SSL_CTX_set_keyshare_pool_size(sctx, 2))
+            || !TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 1), 1)
+            || !TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 0), 5)
+            || !TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 0), 0))
+        goto end;
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_true(SSL_get_server_tmp_key(clientssl, &tmpkey[i]))
+                /* The server's key came out of the pool */
+                || !TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 0), 1))
+            goto end;
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+    if (!TEST_int_ne(EVP_PKEY_cmp(tmpkey[0], tmpkey[1]), 1)
+            || !TEST_true(SSL_CTX_set_keyshare_pool_size(sctx, 0))
+            || !TEST_int_eq(SSL_CTX_fill_keyshare_pool(sctx, 0), 0))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    EVP_PKEY_free(tmpkey[0]);
+    EVP_PKEY_free(tmpkey[1]);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
+#if !defined(OPENSSL_NO_SOCK) && !defined(OPENSSL_NO_TLS1_2) \
+    && !defined(OPENSSL_NO_POSIX_IO)
+# define SENDFILE_SZ    (64 * 1024 + 123)
+
+/* Whether the kernel lets us offload TLS on a TCP socket at all */
+static int ktls_available(void)
+{
+# ifdef KTLS_LINUX
+    int cfd, sfd, ret;
+
+    if (!create_test_sockets(&cfd, &sfd))
+        return 0;
+    ret = setsockopt(cfd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+    BIO_closesocket(cfd);
+    BIO_closesocket(sfd);
+    return ret;
+# else
+    return 0;
+# endif
+}
+
+/*
+ * Test SSL_sendfile() over a TCP connection.
+ * Test 0: Without kTLS (always uses the SSL_write() fallback)
+ * Test 1: With SSL_OP_ENABLE_KTLS, which must use sendfile(2) if the kernel
+ *         supports kTLS
+ */
+static int test_sendfile(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int cfd, sfd, testresult = 0, loops = 0;
+    unsigned char *in = NULL, *out = NULL, buf[20];
+    size_t sent = 0, recvd = 0, readbytes, written;
+    FILE *fp = NULL;
+    const char *cmsg = "Hello", *smsg = "World.";
+
+    if (tst == 1 && !ktls_available()) {
+        TEST_info("kTLS is not available in this kernel, skipping test");
+        return 1;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), &sctx,
+                                       &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_max_proto_version(cctx, TLS1_2_VERSION))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                                  "AESGCM:CHACHA20:!aNULL")))
+        goto end;
+    if (tst == 1) {
+        SSL_CTX_set_options(sctx, SSL_OP_ENABLE_KTLS);
+        SSL_CTX_set_options(cctx, SSL_OP_ENABLE_KTLS);
+    }
+
+    if (!TEST_true(create_test_sockets(&cfd, &sfd))
+            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                              &clientssl, sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                               SSL_ERROR_NONE)))
+        goto end;
+
+    if (!TEST_int_eq(BIO_get_ktls_send(SSL_get_wbio(serverssl)) != 0, tst))
+        goto end;
+
+    if (!TEST_ptr(in = OPENSSL_malloc(SENDFILE_SZ))
+            || !TEST_ptr(out = OPENSSL_malloc(SENDFILE_SZ))
+            || !TEST_int_eq(RAND_bytes(in, SENDFILE_SZ), 1)
+            || !TEST_ptr(fp = tmpfile())
+            || !TEST_size_t_eq(fwrite(in, 1, SENDFILE_SZ, fp), SENDFILE_SZ)
+            || !TEST_int_eq(fflush(fp), 0))
+        goto end;
+
+    /* Send the file starting at a non-zero offset */
+    while (sent < SENDFILE_SZ - 1 || recvd < SENDFILE_SZ - 1) {
+        if (!TEST_int_lt(++loops, 1000000))
+            goto end;
+        if (sent < SENDFILE_SZ - 1) {
+            ossl_ssize_t ret = SSL_sendfile(serverssl, fileno(fp), 1 + sent,
+                                            SENDFILE_SZ - 1 - sent, 0);
+
+            if (ret > 0)
+                sent += ret;
+            else if (!TEST_int_eq(SSL_get_error(serverssl, (int)ret),
+                                  SSL_ERROR_WANT_WRITE))
+                goto end;
+        }
+        if (recvd < sent) {
+            if (SSL_read_ex(clientssl, out + recvd, SENDFILE_SZ - 1 - recvd,
+                            &readbytes))
+                recvd += readbytes;
+            else if (!TEST_int_eq(SSL_get_error(clientssl, 0),
+                                  SSL_ERROR_WANT_READ))
+                goto end;
+        }
+    }
+    if (!TEST_mem_eq(in + 1, SENDFILE_SZ - 1, out, recvd))
+        goto end;
+
+    /* No flags are defined */
+    if (!TEST_int_eq((int)SSL_sendfile(serverssl, fileno(fp), 0, 1, 1), -1))
+        goto end;
+    ERR_clear_error();
+
+    /* The connection should still be usable in both directions */
+    if (!TEST_true(SSL_write_ex(clientssl, cmsg, strlen(cmsg), &written))
+            || !TEST_true(SSL_write_ex(serverssl, smsg, strlen(smsg),
+                                       &written)))
+        goto end;
+    loops = 0;
+    while (!SSL_read_ex(serverssl, buf, sizeof(buf), &readbytes)) {
+        if (!TEST_int_eq(SSL_get_error(serverssl, 0), SSL_ERROR_WANT_READ)
+                || !TEST_int_lt(++loops, 1000000))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, readbytes, cmsg, strlen(cmsg)))
+        goto end;
+    loops = 0;
+    while (!SSL_read_ex(clientssl, buf, sizeof(buf), &readbytes)) {
+        if (!TEST_int_eq(SSL_get_error(clientssl, 0), SSL_ERROR_WANT_READ)
+                || !TEST_int_lt(++loops, 1000000))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, readbytes, smsg, strlen(smsg)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    if (fp != NULL)
+        fclose(fp);
+    OPENSSL_free(in);
+    OPENSSL_free(out);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
 int test_main(int argc, char *argv[])
 {
     int testresult = 1;
@@ -2636,6 +3599,12 @@ int test_main(int argc, char *argv[])
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
     ADD_TEST(test_session_with_both_cache);
+    ADD_TEST(test_sharded_session_cache);
+    ADD_TEST(test_session_with_sharded_cache);
+    ADD_TEST(test_ticket_key_rotation);
+#if defined(OPENSSL_SYS_UNIX)
+    ADD_TEST(test_shared_session_cache);
+#endif
     ADD_ALL_TESTS(test_ssl_set_bio, TOTAL_SSL_SET_BIO_TESTS);
     ADD_TEST(test_ssl_bio_pop_next_bio);
     ADD_TEST(test_ssl_bio_pop_ssl_bio);
@@ -2667,6 +3636,24 @@ int test_main(int argc, char *argv[])
 #endif
     ADD_ALL_TESTS(test_serverinfo, 8);
     ADD_ALL_TESTS(test_export_key_mat, 4);
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_tls13_bulk_write, OSSL_NELEM(bulk_write_tests));
+#endif
+#ifndef OPENSSL_NO_DTLS
+    ADD_ALL_TESTS(test_writev, 5);
+#else
+    ADD_ALL_TESTS(test_writev, 3);
+#endif
+    ADD_ALL_TESTS(test_read_batch, 3);
+    ADD_TEST(test_buffer_pool);
+    ADD_TEST(test_handshake_timings);
+#ifndef OPENSSL_NO_EC
+    ADD_ALL_TESTS(test_keyshare_pool, 2);
+#endif
+#if !defined(OPENSSL_NO_SOCK) && !defined(OPENSSL_NO_TLS1_2) \
+    && !defined(OPENSSL_NO_POSIX_IO)
+    ADD_ALL_TESTS(test_sendfile, 2);
+#endif
 
     testresult = run_tests(argv[0]);
 
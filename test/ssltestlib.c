@@ -9,6 +9,10 @@
 
 #include <string.h>
 
+#include <openssl/opensslconf.h>
+#ifndef OPENSSL_NO_SOCK
+# define USE_SOCKETS
+#endif
 #include "e_os.h"
 #include "ssltestlib.h"
 #include "testutil.h"
@@ -543,6 +547,92 @@ int create_ssl_ctx_pair(const SSL_METHOD *sm, const SSL_METHOD *cm,
     return 0;
 }
 
+#ifndef OPENSSL_NO_SOCK
+/*
+ * Create a connected pair of non-blocking TCP sockets over the loopback
+ * interface, for tests that need a real socket underneath the SSL objects.
+ */
+int create_test_sockets(int *cfd, int *sfd)
+{
+    BIO_ADDRINFO *res = NULL;
+    BIO_ADDR *addr = NULL;
+    union BIO_sock_info_u info;
+    int lfd = INVALID_SOCKET, afd = INVALID_SOCKET, confd = INVALID_SOCKET;
+    int ret = 0;
+
+    if (!TEST_int_eq(BIO_sock_init(), 1)
+            || !TEST_true(BIO_lookup_ex("127.0.0.1", "0", BIO_LOOKUP_SERVER,
+                                        AF_INET, SOCK_STREAM, 0, &res))
+            || !TEST_ptr(addr = BIO_ADDR_new()))
+        goto err;
+
+    /* Listen on an ephemeral port and find out which one we got */
+    lfd = BIO_socket(AF_INET, SOCK_STREAM, 0, 0);
+    info.addr = addr;
+    if (!TEST_int_ne(lfd, INVALID_SOCKET)
+            || !TEST_true(BIO_listen(lfd, BIO_ADDRINFO_address(res), 0))
+            || !TEST_true(BIO_sock_info(lfd, BIO_SOCK_INFO_ADDRESS, &info)))
+        goto err;
+
+    confd = BIO_socket(AF_INET, SOCK_STREAM, 0, 0);
+    if (!TEST_int_ne(confd, INVALID_SOCKET)
+            || !TEST_true(BIO_connect(confd, addr, BIO_SOCK_NODELAY))
+            || !TEST_true(BIO_socket_nbio(confd, 1)))
+        goto err;
+
+    afd = BIO_accept_ex(lfd, NULL, BIO_SOCK_NONBLOCK | BIO_SOCK_NODELAY);
+    if (!TEST_int_ne(afd, INVALID_SOCKET))
+        goto err;
+
+    *cfd = confd;
+    *sfd = afd;
+    confd = afd = INVALID_SOCKET;
+    ret = 1;
+
+ err:
+    BIO_ADDRINFO_free(res);
+    BIO_ADDR_free(addr);
+    if (lfd != INVALID_SOCKET)
+        BIO_closesocket(lfd);
+    if (confd != INVALID_SOCKET)
+        BIO_closesocket(confd);
+    if (afd != INVALID_SOCKET)
+        BIO_closesocket(afd);
+    return ret;
+}
+
+/*
+ * As create_ssl_objects() but using the sockets returned by
+ * create_test_sockets(). The sockets are closed when the SSL objects are
+ * freed.
+ */
+int create_ssl_objects2(SSL_CTX *serverctx, SSL_CTX *clientctx, SSL **sssl,
+                        SSL **cssl, int sfd, int cfd)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    BIO *s_bio = NULL, *c_bio = NULL;
+
+    if (!TEST_ptr(serverssl = SSL_new(serverctx))
+            || !TEST_ptr(clientssl = SSL_new(clientctx))
+            || !TEST_ptr(s_bio = BIO_new_socket(sfd, BIO_CLOSE))
+            || !TEST_ptr(c_bio = BIO_new_socket(cfd, BIO_CLOSE)))
+        goto error;
+
+    SSL_set_bio(serverssl, s_bio, s_bio);
+    SSL_set_bio(clientssl, c_bio, c_bio);
+    *sssl = serverssl;
+    *cssl = clientssl;
+    return 1;
+
+ error:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    BIO_free(s_bio);
+    BIO_free(c_bio);
+    return 0;
+}
+#endif
+
 #define MAXLOOPS    1000000
 
 /*
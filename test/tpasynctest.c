@@ -0,0 +1,207 @@
+/*
+ * Copyright 2017 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <openssl/engine.h>
+#include <openssl/async.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/bn.h>
+#include <openssl/obj_mac.h>
+#include "testutil.h"
+
+static ENGINE *e = NULL;
+static RSA *rsa = NULL;
+static EC_KEY *eckey = NULL, *peer = NULL;
+
+static const unsigned char dgst[32] = "tpasync test digest";
+
+/* Each operation is run by a worker, and checked on the calling thread */
+static int do_ops(void *arg)
+{
+    unsigned char sig[512], sec1[64], sec2[64];
+    unsigned int siglen;
+    int len1, len2;
+
+    if (!RSA_sign(NID_sha256, dgst, sizeof(dgst), sig, &siglen, rsa)
+            || RSA_verify(NID_sha256, dgst, sizeof(dgst), sig, siglen,
+                          rsa) != 1
+            || !ECDSA_sign(0, dgst, sizeof(dgst), sig, &siglen, eckey)
+            || ECDSA_verify(0, dgst, sizeof(dgst), sig, siglen, eckey) != 1)
+        return 0;
+
+    /* Derive the same secret from both sides, only one of them offloaded */
+    len1 = ECDH_compute_key(sec1, sizeof(sec1), EC_KEY_get0_public_key(peer),
+                            eckey, NULL);
+    len2 = ECDH_compute_key(sec2, sizeof(sec2), EC_KEY_get0_public_key(eckey),
+                            peer, NULL);
+    return len1 > 0 && len1 == len2 && memcmp(sec1, sec2, len1) == 0;
+}
+
+static int test_outside_job(void)
+{
+    return TEST_true(do_ops(NULL));
+}
+
+static int test_in_job(void)
+{
+    ASYNC_JOB *job = NULL;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+    OSSL_ASYNC_FD fd;
+    size_t numfds;
+    struct pollfd pfd;
+    int ret = 0, funcret = 0, pauses = 0, r;
+
+    if (!TEST_true(ASYNC_init_thread(1, 0))
+            || !TEST_ptr(waitctx = ASYNC_WAIT_CTX_new()))
+        goto end;
+
+    while ((r = ASYNC_start_job(&job, waitctx, &funcret, do_ops, NULL, 0))
+           == ASYNC_PAUSE) {
+        pauses++;
+        /* The job is resumed once the wait fd is readable */
+        if (!TEST_true(ASYNC_WAIT_CTX_get_all_fds(waitctx, &fd, &numfds))
+                || !TEST_size_t_eq(numfds, 1))
+            goto end;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (!TEST_int_eq(poll(&pfd, 1, -1), 1))
+            goto end;
+    }
+    if (!TEST_int_eq(r, ASYNC_FINISH)
+            || !TEST_int_eq(funcret, 1)
+            || !TEST_int_ge(pauses, 3))
+        goto end;
+    ret = 1;
+
+ end:
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    return ret;
+}
+
+/* Stands in for an application's own event loop */
+static int wake_fds[2];
+
+static int wake_callback(void *arg)
+{
+    char c = 'X';
+
+    return write(wake_fds[1], &c, 1) == 1;
+}
+
+static int test_in_job_callback(void)
+{
+    ASYNC_JOB *job = NULL;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+    size_t numfds;
+    struct pollfd pfd;
+    char c;
+    int ret = 0, funcret = 0, pauses = 0, r;
+
+    if (!TEST_int_eq(pipe(wake_fds), 0))
+        return 0;
+    if (!TEST_true(ASYNC_init_thread(1, 0))
+            || !TEST_ptr(waitctx = ASYNC_WAIT_CTX_new())
+            || !TEST_true(ASYNC_WAIT_CTX_set_callback(waitctx, wake_callback,
+                                                      NULL)))
+        goto end;
+
+    while ((r = ASYNC_start_job(&job, waitctx, &funcret, do_ops, NULL, 0))
+           == ASYNC_PAUSE) {
+        pauses++;
+        /* The job is resumed once the callback has been called */
+        if (!TEST_int_eq(ASYNC_WAIT_CTX_get_status(waitctx), ASYNC_STATUS_OK)
+                || !TEST_true(ASYNC_WAIT_CTX_get_all_fds(waitctx, NULL,
+                                                         &numfds))
+                || !TEST_size_t_eq(numfds, 0))
+            goto end;
+        pfd.fd = wake_fds[0];
+        pfd.events = POLLIN;
+        if (!TEST_int_eq(poll(&pfd, 1, -1), 1)
+                || !TEST_int_eq(read(wake_fds[0], &c, 1), 1))
+            goto end;
+    }
+    if (!TEST_int_eq(r, ASYNC_FINISH)
+            || !TEST_int_eq(funcret, 1)
+            || !TEST_int_ge(pauses, 3))
+        goto end;
+    ret = 1;
+
+ end:
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    return ret;
+}
+
+static int setup_keys(void)
+{
+    BIGNUM *bn = NULL;
+    EC_GROUP *group = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(bn = BN_new())
+            || !TEST_true(BN_set_word(bn, RSA_F4))
+            || !TEST_ptr(rsa = RSA_new_method(e))
+            || !TEST_true(RSA_generate_key_ex(rsa, 1024, bn, NULL))
+            || !TEST_ptr(group
+                         = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1))
+            || !TEST_ptr(eckey = EC_KEY_new_method(e))
+            || !TEST_true(EC_KEY_set_group(eckey, group))
+            || !TEST_true(EC_KEY_generate_key(eckey))
+            || !TEST_ptr(peer = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1))
+            || !TEST_true(EC_KEY_generate_key(peer)))
+        goto end;
+    ret = 1;
+
+ end:
+    BN_free(bn);
+    EC_GROUP_free(group);
+    return ret;
+}
+
+int test_main(int argc, char *argv[])
+{
+    int ret;
+
+    if (!ASYNC_is_capable()) {
+        TEST_info("Async is not supported, skipping");
+        return EXIT_SUCCESS;
+    }
+
+    ENGINE_load_builtin_engines();
+    if ((e = ENGINE_by_id("tpasync")) == NULL) {
+        /* Probably a platform env issue, not a test failure. */
+        TEST_info("Can't load tpasync engine");
+        return EXIT_SUCCESS;
+    }
+
+    if (!TEST_true(ENGINE_ctrl_cmd_string(e, "THREADS", "2", 0))
+            || !TEST_true(ENGINE_init(e))
+            || !TEST_false(ENGINE_ctrl_cmd_string(e, "THREADS", "4", 0))
+            || !setup_keys()) {
+        ret = EXIT_FAILURE;
+    } else {
+        ADD_TEST(test_outside_job);
+        ADD_TEST(test_in_job);
+        ADD_TEST(test_in_job_callback);
+        ret = run_tests(argv[0]);
+    }
+
+    RSA_free(rsa);
+    EC_KEY_free(eckey);
+    EC_KEY_free(peer);
+    ENGINE_finish(e);
+    ENGINE_free(e);
+    return ret;
+}
@@ -136,14 +136,306 @@ static int test_alt_chains_cert_forgery(const char *roots_f,
     return ret;
 }
 
+/*
+ * Looks |x| up by its subject in the store behind |sctx|.  Returns 1 if it
+ * is found, 0 if it isn't and -1 on error.
+ */
+static int store_find_cert(X509_STORE_CTX *sctx, X509 *x)
+{
+    STACK_OF(X509) *matches;
+    int i, found = 0;
+
+    matches = X509_STORE_CTX_get1_certs(sctx, X509_get_subject_name(x));
+    for (i = 0; i < sk_X509_num(matches); i++) {
+        if (!TEST_int_eq(X509_NAME_cmp(X509_get_subject_name(x),
+                X509_get_subject_name(sk_X509_value(matches, i))), 0)) {
+            found = -1;
+            break;
+        }
+        if (X509_cmp(x, sk_X509_value(matches, i)) == 0)
+            found = 1;
+    }
+    sk_X509_pop_free(matches, X509_free);
+    return found;
+}
+
+/*
+ * Checks that every certificate added to a store can be found again by its
+ * subject, including after more certificates are added to the store once it
+ * has already been searched, and after a certificate is removed from the
+ * store directly.
+ */
+static int test_store_lookup(const char *roots_f, const char *untrusted_f)
+{
+    int ret = 0;
+    int i, num;
+    STACK_OF(X509) *certs = NULL, *more = NULL;
+    STACK_OF(X509_OBJECT) *objs;
+    X509_OBJECT *obj;
+    X509_STORE_CTX *sctx = NULL;
+    X509_STORE *store = NULL;
+    X509 *x;
+
+    if (!TEST_ptr(certs = load_certs_from_file(roots_f))
+            || !TEST_ptr(more = load_certs_from_file(untrusted_f))
+            || !TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, NULL, NULL)))
+        goto err;
+
+    for (i = 0; i < sk_X509_num(more); i++) {
+        if (!TEST_ptr(x = X509_dup(sk_X509_value(more, i))))
+            goto err;
+        if (!TEST_true(sk_X509_push(certs, x))) {
+            X509_free(x);
+            goto err;
+        }
+    }
+    /* The last certificate is held back for the removal test below */
+    num = sk_X509_num(certs) - 1;
+    if (!TEST_int_gt(num, 0))
+        goto err;
+
+    if (!TEST_int_eq(store_find_cert(sctx, sk_X509_value(certs, 0)), 0))
+        goto err;
+
+    /* Search the store between additions so each one invalidates an index */
+    for (i = 0; i < num; i++) {
+        x = sk_X509_value(certs, i);
+        if (!TEST_int_ge(store_find_cert(sctx, x), 0)
+                || !TEST_true(X509_STORE_add_cert(store, x)))
+            goto err;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (!TEST_int_eq(store_find_cert(sctx, sk_X509_value(certs, i)), 1))
+            goto err;
+    }
+
+    /*
+     * Remove the first certificate and add the held back one, so that the
+     * number of objects in the store stays the same.
+     */
+    x = sk_X509_value(certs, 0);
+    if (!TEST_true(X509_STORE_lock(store)))
+        goto err;
+    objs = X509_STORE_get0_objects(store);
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        obj = sk_X509_OBJECT_value(objs, i);
+        if (X509_OBJECT_get0_X509(obj) != NULL
+                && X509_cmp(X509_OBJECT_get0_X509(obj), x) == 0) {
+            X509_OBJECT_free(sk_X509_OBJECT_delete(objs, i));
+            break;
+        }
+    }
+    X509_STORE_unlock(store);
+    if (!TEST_true(X509_STORE_add_cert(store, sk_X509_value(certs, num)))
+            || !TEST_int_eq(store_find_cert(sctx, x), 0)
+            || !TEST_int_eq(store_find_cert(sctx, sk_X509_value(certs, num)),
+                            1))
+        goto err;
+
+    ret = 1;
+
+ err:
+    X509_STORE_CTX_free(sctx);
+    X509_STORE_free(store);
+    sk_X509_pop_free(certs, X509_free);
+    sk_X509_pop_free(more, X509_free);
+    return ret;
+}
+
+static X509 *load_cert(const char *dir, const char *file)
+{
+    char path[1024];
+    BIO *bio;
+    X509 *x;
+
+    BIO_snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if ((bio = BIO_new_file(path, "r")) == NULL)
+        return NULL;
+    x = PEM_read_bio_X509(bio, NULL, 0, NULL);
+    BIO_free(bio);
+    return x;
+}
+
+static int verify_cb_calls;
+
+static int count_verify_cb(int ok, X509_STORE_CTX *ctx)
+{
+    if (ok)
+        verify_cb_calls++;
+    return ok;
+}
+
+/*
+ * Verifies |leaf| against |store| and returns the length of the verified
+ * chain, or 0 if verification failed.
+ */
+static int verify_leaf(X509_STORE *store, X509 *leaf, X509 *untrusted,
+                       int depth)
+{
+    X509_STORE_CTX *sctx = NULL;
+    STACK_OF(X509) *sk = NULL;
+    int ret = 0;
+
+    if ((sctx = X509_STORE_CTX_new()) == NULL
+            || (sk = sk_X509_new_null()) == NULL
+            || (untrusted != NULL && !sk_X509_push(sk, untrusted))
+            || !X509_STORE_CTX_init(sctx, store, leaf, sk))
+        goto err;
+    if (depth >= 0)
+        X509_STORE_CTX_set_depth(sctx, depth);
+    X509_STORE_CTX_set_verify_cb(sctx, count_verify_cb);
+    verify_cb_calls = 0;
+    if (X509_verify_cert(sctx) > 0)
+        ret = sk_X509_num(X509_STORE_CTX_get0_chain(sctx));
+ err:
+    X509_STORE_CTX_free(sctx);
+    sk_X509_free(sk);
+    return ret;
+}
+
+/*
+ * The intermediate is only supplied on the first verification, so later
+ * ones without it succeed only when the chain is taken from the cache.
+ */
+static int test_chain_cache(const char *certs_dir)
+{
+    int ret = 0;
+    X509_STORE *store = NULL;
+    X509 *root = NULL, *ca = NULL, *leaf = NULL, *other = NULL;
+
+    if (!TEST_ptr(root = load_cert(certs_dir, "root-cert.pem"))
+            || !TEST_ptr(ca = load_cert(certs_dir, "ca-cert.pem"))
+            || !TEST_ptr(leaf = load_cert(certs_dir, "ee-cert.pem"))
+            || !TEST_ptr(other = load_cert(certs_dir, "croot-cert.pem"))
+            || !TEST_ptr(store = X509_STORE_new())
+            || !TEST_true(X509_STORE_add_cert(store, root)))
+        goto err;
+
+    /* No caching unless asked for */
+    if (!TEST_int_eq(verify_leaf(store, leaf, ca, -1), 3)
+            || !TEST_int_eq(verify_leaf(store, leaf, NULL, -1), 0))
+        goto err;
+
+    if (!TEST_true(X509_STORE_set_chain_cache(store, 8, 3600))
+            || !TEST_int_eq(verify_leaf(store, leaf, ca, -1), 3)
+            || !TEST_int_eq(verify_leaf(store, leaf, NULL, -1), 3)
+            || !TEST_int_eq(verify_cb_calls, 3))
+        goto err;
+
+    /* Different parameters don't share an entry */
+    if (!TEST_int_eq(verify_leaf(store, leaf, NULL, 5), 0))
+        goto err;
+
+    /* Changing the store empties the cache */
+    if (!TEST_true(X509_STORE_add_cert(store, other))
+            || !TEST_int_eq(verify_leaf(store, leaf, NULL, -1), 0))
+        goto err;
+
+    /* And so does resetting it */
+    if (!TEST_int_eq(verify_leaf(store, leaf, ca, -1), 3)
+            || !TEST_true(X509_STORE_set_chain_cache(store, 8, 3600))
+            || !TEST_int_eq(verify_leaf(store, leaf, NULL, -1), 0))
+        goto err;
+
+    ret = 1;
+
+ err:
+    X509_STORE_free(store);
+    X509_free(root);
+    X509_free(ca);
+    X509_free(leaf);
+    X509_free(other);
+    return ret;
+}
+
+static int add_hashed_cert(const char *hash_dir, X509 *x, int suffix)
+{
+    char path[1024];
+    BIO *bio;
+    int ret;
+
+    BIO_snprintf(path, sizeof(path), "%s/%08lx.%d", hash_dir,
+                 X509_subject_name_hash(x), suffix);
+    if (!TEST_ptr(bio = BIO_new_file(path, "w")))
+        return 0;
+    ret = TEST_true(PEM_write_bio_X509(bio, x));
+    BIO_free(bio);
+    return ret;
+}
+
+static int find_in_store(X509_STORE *store, X509 *x)
+{
+    X509_STORE_CTX *ctx = X509_STORE_CTX_new();
+    X509_OBJECT *obj = NULL;
+
+    if (ctx != NULL && X509_STORE_CTX_init(ctx, store, NULL, NULL))
+        obj = X509_STORE_CTX_get_obj_by_subject(ctx, X509_LU_X509,
+                                                X509_get_subject_name(x));
+    X509_OBJECT_free(obj);
+    X509_STORE_CTX_free(ctx);
+    return obj != NULL;
+}
+
+/*
+ * |hash_dir| starts out empty.  Certificates written to it must be found
+ * once the directory's modification time shows it has changed.
+ */
+static int test_dir_index(const char *certs_dir, const char *hash_dir)
+{
+    int ret = 0;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup;
+    X509 *root = NULL, *ca = NULL, *leaf = NULL;
+
+    if (!TEST_ptr(root = load_cert(certs_dir, "root-cert.pem"))
+            || !TEST_ptr(ca = load_cert(certs_dir, "ca-cert.pem"))
+            || !TEST_ptr(leaf = load_cert(certs_dir, "ee-cert.pem"))
+            || !TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_hash_dir()))
+            || !TEST_true(X509_LOOKUP_add_dir(lookup, hash_dir,
+                                              X509_FILETYPE_PEM))
+            || !TEST_true(X509_LOOKUP_set_dir_index(lookup, 0)))
+        goto err;
+
+    if (!TEST_false(find_in_store(store, root))
+            || !TEST_true(add_hashed_cert(hash_dir, root, 0))
+            || !TEST_true(find_in_store(store, root))
+            || !TEST_false(find_in_store(store, ca)))
+        goto err;
+
+    /* Objects after a gap in the sequence numbers are not looked at */
+    if (!TEST_true(add_hashed_cert(hash_dir, ca, 1))
+            || !TEST_false(find_in_store(store, ca))
+            || !TEST_true(add_hashed_cert(hash_dir, leaf, 0))
+            || !TEST_true(find_in_store(store, leaf)))
+        goto err;
+
+    ret = 1;
+
+ err:
+    X509_STORE_free(store);
+    X509_free(root);
+    X509_free(ca);
+    X509_free(leaf);
+    return ret;
+}
+
 int test_main(int argc, char **argv)
 {
-    if (argc != 4) {
-        TEST_error("usage: verify_extra_test roots.pem untrusted.pem bad.pem\n");
+    if (argc != 6) {
+        TEST_error("usage: verify_extra_test roots.pem untrusted.pem bad.pem "
+                   "certsdir hashdir\n");
         return EXIT_FAILURE;
     }
 
-    if (!TEST_true(test_alt_chains_cert_forgery(argv[1], argv[2], argv[3])))
+    if (!TEST_true(test_alt_chains_cert_forgery(argv[1], argv[2], argv[3]))
+            || !TEST_true(test_store_lookup(argv[1], argv[2]))
+            || !TEST_true(test_chain_cache(argv[4]))
+            || !TEST_true(test_dir_index(argv[4], argv[5])))
         return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }